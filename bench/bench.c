@@ -0,0 +1,800 @@
+/*
+    Throughput benchmark for every hash function in `sha.h`.
+
+    Every algorithm is timed at message sizes growing by a factor of 4 from 16 bytes to
+    1 GiB, as a single call, through the streaming API and, where `hash_batch` supports
+    the algorithm, as a batch of equally sized messages. Each measurement is warmed up,
+    repeated and reported as the median. Cycles are TSC reference cycles, which tick at
+    a constant rate and so differ from core cycles when the clock is boosted or throttled.
+
+    The results are written as JSON, one result per line, so runs of different versions
+    can be diffed directly. Given a baseline file from an earlier run, every result that
+    got slower by more than the tolerance is reported and the exit status is 1.
+*/
+
+#define _GNU_SOURCE
+
+#include "batch.h"
+#include "blake3.h"
+#include "chunk.h"
+#include "crc.h"
+#include "drbg.h"
+#include "fhash.h"
+#include "sha.h"
+#include "siphash.h"
+
+#include <sched.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+# include <x86intrin.h>
+# define HAVE_TSC 1
+#else
+# define HAVE_TSC 0
+#endif
+
+/* Bytes of messages per batch run, and the largest message size measured in batch mode */
+#define BATCH_BYTES ((size_t)16 << 20)
+#define BATCH_MAX_SIZE ((size_t)1 << 20)
+
+/* Streaming mode feeds the message in chunks that are not a multiple of any block size */
+#define STREAM_CHUNK 1000
+
+/* Shortest time a single sample may take, short operations are repeated until they reach it */
+#define MIN_SAMPLE_NS 10e6
+
+#define MAX_REPEATS 64
+
+#define ARRAY_LEN(array) ((sizeof(array)) / (sizeof *(array)))
+
+enum mode {
+    MODE_ONESHOT,
+    MODE_STREAMING,
+    MODE_BATCH,
+};
+
+static const char *MODE_NAMES[] = {"oneshot", "streaming", "batch"};
+
+struct algorithm {
+    const char *name;
+    void (*oneshot)(const void *data, size_t len, void *out);
+    void (*streaming)(const void *data, size_t len, void *out);
+    int batch;    /* `enum hash_algorithm`, -1 if `hash_batch` does not support the algorithm */
+    size_t unit;  /* Length of the messages of a fixed-length function, sizes not a multiple of it are skipped */
+};
+
+struct result {
+    char algorithm[32];
+    char mode[16];
+    size_t size;
+    double gbps;
+    double cpb;
+};
+
+static struct {
+    size_t min_size;
+    size_t max_size;
+    unsigned repeats;
+    unsigned threads;
+    int cpu;
+    const char *filter;
+    const char *output;
+    const char *baseline;
+    double tolerance;
+} config = {16, (size_t)1 << 30, 5, 1, 0, NULL, NULL, NULL, 5.0};
+
+#define ONESHOT(fn)                                                                                                    \
+    static void fn##_oneshot(const void *data, size_t len, void *out) {                                                \
+        fn##_data(data, len, out);                                                                                     \
+    }
+
+#define STREAMING(fn, ctx_type)                                                                                        \
+    static void fn##_streaming(const void *data, size_t len, void *out) {                                              \
+        ctx_type ctx;                                                                                                  \
+                                                                                                                       \
+        fn##_init(&ctx);                                                                                               \
+        for (size_t offset = 0; offset < len; offset += STREAM_CHUNK) {                                                \
+            fn##_update(&ctx, (const uint8_t *)data + offset, chunk_len(len, offset));                                 \
+        }                                                                                                              \
+        fn##_final(&ctx, out);                                                                                         \
+    }
+
+static inline size_t
+chunk_len(size_t len, size_t offset) {
+    return len - offset < STREAM_CHUNK ? len - offset : STREAM_CHUNK;
+}
+
+ONESHOT(sha1)
+ONESHOT(sha2_224)
+ONESHOT(sha2_256)
+ONESHOT(sha2_384)
+ONESHOT(sha2_512)
+ONESHOT(sha2_512_224)
+ONESHOT(sha2_512_256)
+ONESHOT(sha3_224)
+ONESHOT(sha3_256)
+ONESHOT(sha3_384)
+ONESHOT(sha3_512)
+
+STREAMING(sha1, struct sha1_ctx)
+STREAMING(sha2_224, struct sha2_256_ctx)
+STREAMING(sha2_256, struct sha2_256_ctx)
+STREAMING(sha2_384, struct sha2_512_ctx)
+STREAMING(sha2_512, struct sha2_512_ctx)
+STREAMING(sha2_512_224, struct sha2_512_ctx)
+STREAMING(sha2_512_256, struct sha2_512_ctx)
+STREAMING(sha3_224, struct sha3_ctx)
+STREAMING(sha3_256, struct sha3_ctx)
+STREAMING(sha3_384, struct sha3_ctx)
+STREAMING(sha3_512, struct sha3_ctx)
+
+/* The fixed-length functions hash every 32 or 64-byte piece of the input as a message of its own */
+static void
+sha2_256_32_oneshot(const void *data, size_t len, void *out) {
+    for (size_t offset = 0; offset + 32 <= len; offset += 32) {
+        sha2_256_32((const uint8_t *)data + offset, out);
+    }
+}
+
+static void
+sha2_256_64_oneshot(const void *data, size_t len, void *out) {
+    for (size_t offset = 0; offset + 64 <= len; offset += 64) {
+        sha2_256_64((const uint8_t *)data + offset, out);
+    }
+}
+
+static void
+sha2_256d_oneshot(const void *data, size_t len, void *out) {
+    sha2_256d(data, len, out);
+}
+
+/* The XOFs produce as many bytes as the SHA-3 hash of the same strength */
+static void
+shake128_oneshot(const void *data, size_t len, void *out) {
+    shake128(data, len, out, 32);
+}
+
+static void
+shake256_oneshot(const void *data, size_t len, void *out) {
+    shake256(data, len, out, 64);
+}
+
+static void
+shake128_streaming(const void *data, size_t len, void *out) {
+    struct shake_ctx ctx;
+
+    shake128_init(&ctx);
+    for (size_t offset = 0; offset < len; offset += STREAM_CHUNK) {
+        shake128_update(&ctx, (const uint8_t *)data + offset, chunk_len(len, offset));
+    }
+    shake128_squeeze(&ctx, out, 32);
+}
+
+static void
+shake256_streaming(const void *data, size_t len, void *out) {
+    struct shake_ctx ctx;
+
+    shake256_init(&ctx);
+    for (size_t offset = 0; offset < len; offset += STREAM_CHUNK) {
+        shake256_update(&ctx, (const uint8_t *)data + offset, chunk_len(len, offset));
+    }
+    shake256_squeeze(&ctx, out, 64);
+}
+
+static void
+parallelhash128_oneshot(const void *data, size_t len, void *out) {
+    parallelhash128(data, len, 8192, "", 0, out, 32, config.threads);
+}
+
+static void
+parallelhash256_oneshot(const void *data, size_t len, void *out) {
+    parallelhash256(data, len, 8192, "", 0, out, 64, config.threads);
+}
+
+static void
+blake3_oneshot(const void *data, size_t len, void *out) {
+    blake3(data, len, out, BLAKE3_OUT_LEN);
+}
+
+static void
+blake3_streaming(const void *data, size_t len, void *out) {
+    struct blake3_ctx ctx;
+
+    blake3_init(&ctx);
+    for (size_t offset = 0; offset < len; offset += STREAM_CHUNK) {
+        blake3_update(&ctx, (const uint8_t *)data + offset, chunk_len(len, offset));
+    }
+    blake3_final(&ctx, out, BLAKE3_OUT_LEN);
+}
+
+static void
+blake3_parallel_oneshot(const void *data, size_t len, void *out) {
+    struct blake3_ctx ctx;
+
+    blake3_init(&ctx);
+    blake3_update_parallel(&ctx, data, len, config.threads);
+    blake3_final(&ctx, out, BLAKE3_OUT_LEN);
+}
+
+static void
+fhash64_oneshot(const void *data, size_t len, void *out) {
+    *(uint64_t *)out = fhash64(data, len, 0);
+}
+
+static void
+fhash64_streaming(const void *data, size_t len, void *out) {
+    struct fhash_ctx ctx;
+
+    fhash_init(&ctx, 0);
+    for (size_t offset = 0; offset < len; offset += STREAM_CHUNK) {
+        fhash_update(&ctx, (const uint8_t *)data + offset, chunk_len(len, offset));
+    }
+    *(uint64_t *)out = fhash64_final(&ctx);
+}
+
+static void
+fhash128_oneshot(const void *data, size_t len, void *out) {
+    struct fhash128 hash = fhash128(data, len, 0);
+
+    memcpy(out, &hash, sizeof hash);
+}
+
+/* Any fixed key will do, the speed of SipHash does not depend on it */
+static const uint8_t SIPHASH_KEY[SIPHASH_KEY_LEN] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15};
+
+static void
+siphash24_oneshot(const void *data, size_t len, void *out) {
+    struct siphash_key key;
+
+    siphash_key_init(&key, SIPHASH_KEY);
+    *(uint64_t *)out = siphash24(&key, data, len);
+}
+
+static void
+siphash13_oneshot(const void *data, size_t len, void *out) {
+    struct siphash_key key;
+
+    siphash_key_init(&key, SIPHASH_KEY);
+    *(uint64_t *)out = siphash13(&key, data, len);
+}
+
+static void
+siphash24_128_oneshot(const void *data, size_t len, void *out) {
+    struct siphash_key key;
+
+    siphash_key_init(&key, SIPHASH_KEY);
+    *(struct siphash128 *)out = siphash24_128(&key, data, len);
+}
+
+static void
+halfsiphash24_oneshot(const void *data, size_t len, void *out) {
+    struct halfsiphash_key key;
+
+    halfsiphash_key_init(&key, SIPHASH_KEY);
+    *(uint32_t *)out = halfsiphash24(&key, data, len);
+}
+
+/* Hash table keys of `key_len` bytes, the input is cut into as many as fit and hashed 64 at a time */
+static void
+siphash24_batch_keys(const void *data, size_t len, size_t key_len, void *out) {
+    struct hash_job jobs[64];
+    struct siphash_key key;
+    size_t num_keys = len / key_len;
+
+    siphash_key_init(&key, SIPHASH_KEY);
+    for (size_t first = 0; first < num_keys; first += ARRAY_LEN(jobs)) {
+        size_t n = num_keys - first < ARRAY_LEN(jobs) ? num_keys - first : ARRAY_LEN(jobs);
+
+        for (size_t j = 0; j < n; j++) {
+            jobs[j] = (struct hash_job){(const uint8_t *)data + key_len * (first + j), key_len, out};
+        }
+        siphash24_batch(&key, jobs, n);
+    }
+}
+
+/* The same input as keys of `key_len` bytes hashed one call at a time, to compare with the batch */
+#define KEYS(fn, key_len)                                                                                              \
+    static void fn##_key##key_len##_oneshot(const void *data, size_t len, void *out) {                                 \
+        for (size_t offset = 0; offset + (key_len) <= len; offset += (key_len)) {                                      \
+            fn##_oneshot((const uint8_t *)data + offset, key_len, out);                                                \
+        }                                                                                                              \
+    }
+
+#define BATCH_KEYS(key_len)                                                                                            \
+    static void siphash24_batch_key##key_len##_oneshot(const void *data, size_t len, void *out) {                      \
+        siphash24_batch_keys(data, len, key_len, out);                                                                 \
+    }
+
+KEYS(siphash24, 8)
+KEYS(siphash24, 16)
+KEYS(siphash24, 32)
+KEYS(siphash24, 64)
+KEYS(siphash13, 8)
+KEYS(siphash13, 16)
+KEYS(siphash13, 32)
+KEYS(siphash13, 64)
+KEYS(sha2_256, 8)
+KEYS(sha2_256, 16)
+KEYS(sha2_256, 32)
+KEYS(sha2_256, 64)
+BATCH_KEYS(8)
+BATCH_KEYS(16)
+BATCH_KEYS(32)
+BATCH_KEYS(64)
+
+/* Random bytes as many as the message size, the input is not used */
+static const uint8_t DRBG_SEED[32] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15};
+static uint8_t drbg_out[DRBG_MAX_REQUEST];
+
+/* Requests as large as allowed to a generator of its own */
+static void
+drbg_requests(enum drbg_mechanism mechanism, enum hash_algorithm algorithm, size_t len) {
+    struct drbg drbg;
+
+    drbg_init(&drbg, mechanism, algorithm, DRBG_SEED, sizeof DRBG_SEED, NULL, 0, NULL, 0);
+    for (size_t offset = 0; offset < len; offset += DRBG_MAX_REQUEST) {
+        drbg_generate(&drbg, drbg_out, len - offset < DRBG_MAX_REQUEST ? len - offset : DRBG_MAX_REQUEST, NULL, 0);
+    }
+}
+
+/* Reads from the buffer of the thread's generator, which is only set up again when the generator changes */
+static void
+drbg_thread_reads(enum drbg_mechanism mechanism, enum hash_algorithm algorithm, size_t len) {
+    static int current = -1;
+
+    if (current != (int)(mechanism * 16 + algorithm)) {
+        drbg_thread_init(mechanism, algorithm, DRBG_SEED, sizeof DRBG_SEED, NULL, 0);
+        current = (int)(mechanism * 16 + algorithm);
+    }
+    for (size_t offset = 0; offset < len; offset += STREAM_CHUNK) {
+        drbg_thread_bytes(drbg_out, chunk_len(len, offset));
+    }
+}
+
+#define DRBG(name, mechanism, algorithm)                                                                               \
+    static void name##_oneshot(const void *data, size_t len, void *out) {                                              \
+        (void)data, (void)out;                                                                                         \
+        drbg_requests(mechanism, algorithm, len);                                                                      \
+    }                                                                                                                  \
+                                                                                                                       \
+    static void name##_streaming(const void *data, size_t len, void *out) {                                            \
+        (void)data, (void)out;                                                                                         \
+        drbg_thread_reads(mechanism, algorithm, len);                                                                  \
+    }
+
+DRBG(hash_drbg_sha2_256, DRBG_HASH, HASH_SHA2_256)
+DRBG(hash_drbg_sha2_512, DRBG_HASH, HASH_SHA2_512)
+DRBG(hmac_drbg_sha2_256, DRBG_HMAC, HASH_SHA2_256)
+DRBG(hmac_drbg_sha2_512, DRBG_HMAC, HASH_SHA2_512)
+
+static void
+crc32c_oneshot(const void *data, size_t len, void *out) {
+    *(uint32_t *)out = crc32c(0, data, len);
+}
+
+static void
+crc32c_streaming(const void *data, size_t len, void *out) {
+    uint32_t crc = 0;
+
+    for (size_t offset = 0; offset < len; offset += STREAM_CHUNK) {
+        crc = crc32c(crc, (const uint8_t *)data + offset, chunk_len(len, offset));
+    }
+    *(uint32_t *)out = crc;
+}
+
+static void
+crc32_ieee_oneshot(const void *data, size_t len, void *out) {
+    *(uint32_t *)out = crc32_ieee(0, data, len);
+}
+
+static void
+crc64_xz_oneshot(const void *data, size_t len, void *out) {
+    *(uint64_t *)out = crc64_xz(0, data, len);
+}
+
+/* Chunks of 2 to 64 KiB around 8 KiB, their digests are folded into `out` */
+static void
+fold_chunk(const struct chunk *chunk, void *arg) {
+    uint8_t *out = arg;
+
+    for (size_t i = 0; i < sizeof chunk->digest; i++) {
+        out[i] ^= chunk->digest[i];
+    }
+}
+
+static void
+chunk_sha2_256_oneshot(const void *data, size_t len, void *out) {
+    struct chunker chunker;
+
+    chunker_init(&chunker, 2048, 8192, 65536);
+    chunker_update(&chunker, data, len, fold_chunk, out);
+    chunker_final(&chunker, fold_chunk, out);
+}
+
+static void
+chunk_sha2_256_streaming(const void *data, size_t len, void *out) {
+    struct chunker chunker;
+
+    chunker_init(&chunker, 2048, 8192, 65536);
+    for (size_t offset = 0; offset < len; offset += STREAM_CHUNK) {
+        chunker_update(&chunker, (const uint8_t *)data + offset, chunk_len(len, offset), fold_chunk, out);
+    }
+    chunker_final(&chunker, fold_chunk, out);
+}
+
+static const struct algorithm ALGORITHMS[] = {
+    {"sha1", sha1_oneshot, sha1_streaming, HASH_SHA1, 0},
+    {"sha2_224", sha2_224_oneshot, sha2_224_streaming, HASH_SHA2_224, 0},
+    {"sha2_256", sha2_256_oneshot, sha2_256_streaming, HASH_SHA2_256, 0},
+    {"sha2_256_32", sha2_256_32_oneshot, NULL, -1, 32},
+    {"sha2_256_64", sha2_256_64_oneshot, NULL, -1, 64},
+    {"sha2_256d", sha2_256d_oneshot, NULL, -1, 0},
+    {"sha2_384", sha2_384_oneshot, sha2_384_streaming, HASH_SHA2_384, 0},
+    {"sha2_512", sha2_512_oneshot, sha2_512_streaming, HASH_SHA2_512, 0},
+    {"sha2_512_224", sha2_512_224_oneshot, sha2_512_224_streaming, HASH_SHA2_512_224, 0},
+    {"sha2_512_256", sha2_512_256_oneshot, sha2_512_256_streaming, HASH_SHA2_512_256, 0},
+    {"sha3_224", sha3_224_oneshot, sha3_224_streaming, HASH_SHA3_224, 0},
+    {"sha3_256", sha3_256_oneshot, sha3_256_streaming, HASH_SHA3_256, 0},
+    {"sha3_384", sha3_384_oneshot, sha3_384_streaming, HASH_SHA3_384, 0},
+    {"sha3_512", sha3_512_oneshot, sha3_512_streaming, HASH_SHA3_512, 0},
+    {"shake128", shake128_oneshot, shake128_streaming, -1, 0},
+    {"shake256", shake256_oneshot, shake256_streaming, -1, 0},
+    {"parallelhash128", parallelhash128_oneshot, NULL, -1, 0},
+    {"parallelhash256", parallelhash256_oneshot, NULL, -1, 0},
+    {"blake3", blake3_oneshot, blake3_streaming, -1, 0},
+    {"blake3_parallel", blake3_parallel_oneshot, NULL, -1, 0},
+    {"fhash64", fhash64_oneshot, fhash64_streaming, -1, 0},
+    {"fhash128", fhash128_oneshot, NULL, -1, 0},
+    {"siphash24", siphash24_oneshot, NULL, -1, 0},
+    {"siphash13", siphash13_oneshot, NULL, -1, 0},
+    {"siphash24_128", siphash24_128_oneshot, NULL, -1, 0},
+    {"halfsiphash24", halfsiphash24_oneshot, NULL, -1, 0},
+    {"siphash24_key8", siphash24_key8_oneshot, NULL, -1, 8},
+    {"siphash24_key16", siphash24_key16_oneshot, NULL, -1, 16},
+    {"siphash24_key32", siphash24_key32_oneshot, NULL, -1, 32},
+    {"siphash24_key64", siphash24_key64_oneshot, NULL, -1, 64},
+    {"siphash13_key8", siphash13_key8_oneshot, NULL, -1, 8},
+    {"siphash13_key16", siphash13_key16_oneshot, NULL, -1, 16},
+    {"siphash13_key32", siphash13_key32_oneshot, NULL, -1, 32},
+    {"siphash13_key64", siphash13_key64_oneshot, NULL, -1, 64},
+    {"sha2_256_key8", sha2_256_key8_oneshot, NULL, -1, 8},
+    {"sha2_256_key16", sha2_256_key16_oneshot, NULL, -1, 16},
+    {"sha2_256_key32", sha2_256_key32_oneshot, NULL, -1, 32},
+    {"sha2_256_key64", sha2_256_key64_oneshot, NULL, -1, 64},
+    {"siphash24_batch_key8", siphash24_batch_key8_oneshot, NULL, -1, 8},
+    {"siphash24_batch_key16", siphash24_batch_key16_oneshot, NULL, -1, 16},
+    {"siphash24_batch_key32", siphash24_batch_key32_oneshot, NULL, -1, 32},
+    {"siphash24_batch_key64", siphash24_batch_key64_oneshot, NULL, -1, 64},
+    {"hash_drbg_sha2_256", hash_drbg_sha2_256_oneshot, hash_drbg_sha2_256_streaming, -1, 0},
+    {"hash_drbg_sha2_512", hash_drbg_sha2_512_oneshot, hash_drbg_sha2_512_streaming, -1, 0},
+    {"hmac_drbg_sha2_256", hmac_drbg_sha2_256_oneshot, hmac_drbg_sha2_256_streaming, -1, 0},
+    {"hmac_drbg_sha2_512", hmac_drbg_sha2_512_oneshot, hmac_drbg_sha2_512_streaming, -1, 0},
+    {"crc32c", crc32c_oneshot, crc32c_streaming, -1, 0},
+    {"crc32_ieee", crc32_ieee_oneshot, NULL, -1, 0},
+    {"crc64_xz", crc64_xz_oneshot, NULL, -1, 0},
+    {"chunk_sha2_256", chunk_sha2_256_oneshot, chunk_sha2_256_streaming, -1, 0},
+};
+
+/* Everything one measurement needs, `jobs` is only used in batch mode */
+struct run {
+    const struct algorithm *algorithm;
+    enum mode mode;
+    size_t size;
+    const uint8_t *data;
+    struct hash_job *jobs;
+    size_t num_jobs;
+    uint64_t out[8];
+};
+
+static double
+now_ns(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static uint64_t
+cycles(void) {
+#if HAVE_TSC
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+static void
+run_once(struct run *run) {
+    switch (run->mode) {
+        case MODE_ONESHOT:
+            run->algorithm->oneshot(run->data, run->size, run->out);
+            break;
+        case MODE_STREAMING:
+            run->algorithm->streaming(run->data, run->size, run->out);
+            break;
+        case MODE_BATCH:
+            hash_batch(run->algorithm->batch, run->jobs, run->num_jobs, config.threads);
+            break;
+    }
+}
+
+static int
+compare_doubles(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+
+    return (x > y) - (x < y);
+}
+
+static double
+median(double *values, size_t num_values) {
+    qsort(values, num_values, sizeof *values, compare_doubles);
+    return num_values % 2 ? values[num_values / 2] : (values[num_values / 2 - 1] + values[num_values / 2]) / 2;
+}
+
+/* Warm up, pick how many operations make up a sample, then take the median of `config.repeats` samples */
+static void
+measure(struct run *run, struct result *result) {
+    double ns[MAX_REPEATS], cyc[MAX_REPEATS];
+    double bytes = (double)run->size * (run->mode == MODE_BATCH ? run->num_jobs : 1);
+    double start = now_ns();
+    size_t ops;
+
+    run_once(run);
+    ops = (size_t)(MIN_SAMPLE_NS / (now_ns() - start + 1)) + 1;
+
+    for (unsigned r = 0; r < config.repeats; r++) {
+        uint64_t start_cycles = cycles();
+
+        start = now_ns();
+        for (size_t i = 0; i < ops; i++) {
+            run_once(run);
+        }
+        ns[r] = (now_ns() - start) / ops;
+        cyc[r] = (double)(cycles() - start_cycles) / ops;
+    }
+
+    snprintf(result->algorithm, sizeof result->algorithm, "%s", run->algorithm->name);
+    snprintf(result->mode, sizeof result->mode, "%s", MODE_NAMES[run->mode]);
+    result->size = run->size;
+    result->gbps = bytes / median(ns, config.repeats);
+    result->cpb = median(cyc, config.repeats) / bytes;
+}
+
+static void
+pin_threads(void) {
+#ifdef __linux__
+    cpu_set_t set;
+
+    /* Pool workers inherit the mask, so a run with N threads gets N cores to itself */
+    if (!config.threads) {
+        return;
+    }
+    CPU_ZERO(&set);
+    for (unsigned i = 0; i < config.threads; i++) {
+        CPU_SET(config.cpu + i, &set);
+    }
+    if (sched_setaffinity(0, sizeof set, &set)) {
+        perror("sched_setaffinity");
+    }
+#endif
+}
+
+/* Sizes may carry a K, M or G suffix */
+static size_t
+parse_size(const char *arg) {
+    char *end;
+    size_t size = strtoull(arg, &end, 10);
+
+    switch (*end) {
+        case 'G':
+            size <<= 10;
+            /* fall through */
+        case 'M':
+            size <<= 10;
+            /* fall through */
+        case 'K':
+            size <<= 10;
+    }
+    return size;
+}
+
+static void
+print_result(FILE *out, const struct result *result, int last) {
+    fprintf(out, "    {\"algorithm\": \"%s\", \"mode\": \"%s\", \"size\": %zu, \"gbps\": %.4f, ", result->algorithm,
+            result->mode, result->size, result->gbps);
+    if (HAVE_TSC) {
+        fprintf(out, "\"cpb\": %.3f}%s\n", result->cpb, last ? "" : ",");
+    } else {
+        fprintf(out, "\"cpb\": null}%s\n", last ? "" : ",");
+    }
+}
+
+static void
+write_json(FILE *out, const struct result *results, size_t num_results) {
+    fprintf(out, "{\n  \"version\": 1,\n  \"threads\": %u,\n  \"repeats\": %u,\n  \"results\": [\n", config.threads,
+            config.repeats);
+    for (size_t i = 0; i < num_results; i++) {
+        print_result(out, &results[i], i + 1 == num_results);
+    }
+    fprintf(out, "  ]\n}\n");
+}
+
+/* Compare against a file written by an earlier run, returns the number of regressions */
+static int
+compare_baseline(const struct result *results, size_t num_results) {
+    FILE *file = fopen(config.baseline, "r");
+    char line[512];
+    int regressions = 0;
+    size_t compared = 0;
+
+    if (!file) {
+        perror(config.baseline);
+        return 1;
+    }
+
+    while (fgets(line, sizeof line, file)) {
+        struct result old;
+
+        if (sscanf(line, " {\"algorithm\": \"%31[^\"]\", \"mode\": \"%15[^\"]\", \"size\": %zu, \"gbps\": %lf",
+                   old.algorithm, old.mode, &old.size, &old.gbps) != 4) {
+            continue;
+        }
+
+        for (size_t i = 0; i < num_results; i++) {
+            const struct result *new = &results[i];
+
+            if (strcmp(new->algorithm, old.algorithm) || strcmp(new->mode, old.mode) || new->size != old.size) {
+                continue;
+            }
+
+            compared++;
+            if (new->gbps < old.gbps * (1 - config.tolerance / 100)) {
+                fprintf(stderr, "REGRESSION %s %s %zu B: %.4f GB/s -> %.4f GB/s (%+.1f%%)\n", new->algorithm,
+                        new->mode, new->size, old.gbps, new->gbps, (new->gbps / old.gbps - 1) * 100);
+                regressions++;
+            }
+        }
+    }
+
+    fclose(file);
+    fprintf(stderr, "%zu results compared against %s, %d slower by more than %.1f%%\n", compared, config.baseline,
+            regressions, config.tolerance);
+    return regressions;
+}
+
+static void
+usage(const char *program) {
+    fprintf(stderr,
+            "usage: %s [--min-size N] [--max-size N] [--repeats N] [--threads N] [--cpu N]\n"
+            "          [--filter NAME] [--output FILE] [--baseline FILE] [--tolerance PERCENT]\n",
+            program);
+}
+
+int
+main(int argc, char **argv) {
+    size_t max_results, num_results = 0, num_sizes = 0, buffer_size;
+    struct result *results;
+    uint8_t *buffer;
+    uint64_t(*hashes)[8];
+    struct hash_job *jobs;
+    FILE *out = stdout;
+    int status = 0;
+
+    for (int i = 1; i < argc; i++) {
+        const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+
+        if (!value) {
+            usage(argv[0]);
+            return 2;
+        } else if (!strcmp(argv[i], "--min-size")) {
+            config.min_size = parse_size(value);
+        } else if (!strcmp(argv[i], "--max-size")) {
+            config.max_size = parse_size(value);
+        } else if (!strcmp(argv[i], "--repeats")) {
+            config.repeats = (unsigned)atoi(value);
+        } else if (!strcmp(argv[i], "--threads")) {
+            config.threads = (unsigned)atoi(value);
+        } else if (!strcmp(argv[i], "--cpu")) {
+            config.cpu = atoi(value);
+        } else if (!strcmp(argv[i], "--filter")) {
+            config.filter = value;
+        } else if (!strcmp(argv[i], "--output")) {
+            config.output = value;
+        } else if (!strcmp(argv[i], "--baseline")) {
+            config.baseline = value;
+        } else if (!strcmp(argv[i], "--tolerance")) {
+            config.tolerance = atof(value);
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+        i++;
+    }
+
+    if (config.repeats < 1 || config.repeats > MAX_REPEATS || config.min_size < 1 ||
+        config.max_size < config.min_size) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    for (size_t size = config.min_size; size <= config.max_size; size *= 4) {
+        num_sizes++;
+    }
+    max_results = num_sizes * ARRAY_LEN(ALGORITHMS) * 3;
+    buffer_size = config.max_size > BATCH_BYTES ? config.max_size : BATCH_BYTES;
+    results = malloc(max_results * sizeof *results);
+    buffer = malloc(buffer_size);
+    hashes = malloc(BATCH_BYTES / config.min_size * sizeof *hashes + sizeof *hashes);
+    jobs = malloc(BATCH_BYTES / config.min_size * sizeof *jobs + sizeof *jobs);
+    if (!results || !buffer || !hashes || !jobs) {
+        perror("malloc");
+        return 2;
+    }
+
+    /* Touch every page before timing anything */
+    for (size_t i = 0; i < buffer_size; i++) {
+        buffer[i] = (uint8_t)(i * 31 + (i >> 8));
+    }
+
+    pin_threads();
+
+    for (size_t a = 0; a < ARRAY_LEN(ALGORITHMS); a++) {
+        const struct algorithm *algorithm = &ALGORITHMS[a];
+
+        if (config.filter && !strstr(algorithm->name, config.filter)) {
+            continue;
+        }
+
+        for (size_t size = config.min_size; size <= config.max_size; size *= 4) {
+            /* A size that holds no whole message would time an empty loop */
+            if (algorithm->unit && size % algorithm->unit) {
+                continue;
+            }
+
+            for (enum mode mode = MODE_ONESHOT; mode <= MODE_BATCH; mode++) {
+                struct run run = {algorithm, mode, size, buffer, jobs, BATCH_BYTES / size, {0}};
+
+                if ((mode == MODE_STREAMING && !algorithm->streaming) ||
+                    (mode == MODE_BATCH && (algorithm->batch < 0 || size > BATCH_MAX_SIZE))) {
+                    continue;
+                }
+
+                for (size_t j = 0; mode == MODE_BATCH && j < run.num_jobs; j++) {
+                    jobs[j].data = buffer + j * size;
+                    jobs[j].len = size;
+                    jobs[j].hash = hashes[j];
+                }
+
+                measure(&run, &results[num_results]);
+                fprintf(stderr, "%-16s %-10s %11zu B  %8.4f GB/s  %8.2f cycles/B\n", algorithm->name,
+                        MODE_NAMES[mode], size, results[num_results].gbps, results[num_results].cpb);
+                num_results++;
+            }
+        }
+    }
+
+    if (config.output && !(out = fopen(config.output, "w"))) {
+        perror(config.output);
+        return 2;
+    }
+    write_json(out, results, num_results);
+    if (out != stdout) {
+        fclose(out);
+    }
+
+    if (config.baseline && compare_baseline(results, num_results)) {
+        status = 1;
+    }
+
+    free(results);
+    free(buffer);
+    free(hashes);
+    free(jobs);
+
+    return status;
+}
@@ -0,0 +1,482 @@
+/*
+    libhash-sum, print or check checksums like sha256sum.
+
+    Regular files are mapped with mmap and MADV_SEQUENTIAL so the kernel reads ahead
+    aggressively and nothing is copied through a userspace buffer. Pipes and other
+    files that cannot be mapped are streamed through the incremental API in large
+    chunks instead, so memory use does not grow with their size. Mapped files are
+    hashed in groups through `hash_batch`, so the work is spread over the library's
+    thread pool while the output stays in command line order.
+*/
+
+#define _DEFAULT_SOURCE
+
+#include "batch.h"
+#include "encode.h"
+#include "sha.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/* Files opened and hashed together, the pool balances them across the threads */
+#define GROUP_SIZE 256
+
+/* Chunk size for inputs that cannot be mapped */
+#define READ_CHUNK ((size_t)1 << 20)
+
+struct algorithm {
+    const char *name;
+    enum hash_algorithm algorithm;
+    size_t hex_len;
+};
+
+static const struct algorithm ALGORITHMS[] = {
+    {"sha1", HASH_SHA1, 40},
+    {"sha224", HASH_SHA2_224, 56},
+    {"sha256", HASH_SHA2_256, 64},
+    {"sha384", HASH_SHA2_384, 96},
+    {"sha512", HASH_SHA2_512, 128},
+    {"sha512-224", HASH_SHA2_512_224, 56},
+    {"sha512-256", HASH_SHA2_512_256, 64},
+    {"sha3-224", HASH_SHA3_224, 56},
+    {"sha3-256", HASH_SHA3_256, 64},
+    {"sha3-384", HASH_SHA3_384, 96},
+    {"sha3-512", HASH_SHA3_512, 128},
+};
+
+#define ARRAY_LEN(array) ((sizeof(array)) / (sizeof *(array)))
+
+/* One input file, `mapped` tells whether `data` has to be unmapped, `streamed` that `hash` is already set */
+struct input {
+    const char *path;
+    uint8_t expected[HASH_MAX_DIGEST_SIZE];  /* Digest from the manifest in check mode */
+    void *data;
+    size_t len;
+    int mapped;
+    int streamed;
+    int error;
+    uint64_t hash[8];
+};
+
+/* Incremental state of any of the algorithms */
+union stream_ctx {
+    struct sha1_ctx sha1;
+    struct sha2_256_ctx sha2_256;
+    struct sha2_512_ctx sha2_512;
+    struct sha3_ctx sha3;
+};
+
+static const struct algorithm *algorithm = &ALGORITHMS[2];
+static unsigned num_threads = 0;
+
+static void
+stream_init(union stream_ctx *ctx) {
+    switch (algorithm->algorithm) {
+        case HASH_SHA1:
+            sha1_init(&ctx->sha1);
+            break;
+        case HASH_SHA2_224:
+            sha2_224_init(&ctx->sha2_256);
+            break;
+        case HASH_SHA2_256:
+            sha2_256_init(&ctx->sha2_256);
+            break;
+        case HASH_SHA2_384:
+            sha2_384_init(&ctx->sha2_512);
+            break;
+        case HASH_SHA2_512:
+            sha2_512_init(&ctx->sha2_512);
+            break;
+        case HASH_SHA2_512_224:
+            sha2_512_224_init(&ctx->sha2_512);
+            break;
+        case HASH_SHA2_512_256:
+            sha2_512_256_init(&ctx->sha2_512);
+            break;
+        case HASH_SHA3_224:
+            sha3_224_init(&ctx->sha3);
+            break;
+        case HASH_SHA3_256:
+            sha3_256_init(&ctx->sha3);
+            break;
+        case HASH_SHA3_384:
+            sha3_384_init(&ctx->sha3);
+            break;
+        case HASH_SHA3_512:
+            sha3_512_init(&ctx->sha3);
+            break;
+    }
+}
+
+static void
+stream_update(union stream_ctx *ctx, const void *data, size_t len) {
+    switch (algorithm->algorithm) {
+        case HASH_SHA1:
+            sha1_update(&ctx->sha1, data, len);
+            break;
+        case HASH_SHA2_224:
+            sha2_224_update(&ctx->sha2_256, data, len);
+            break;
+        case HASH_SHA2_256:
+            sha2_256_update(&ctx->sha2_256, data, len);
+            break;
+        case HASH_SHA2_384:
+            sha2_384_update(&ctx->sha2_512, data, len);
+            break;
+        case HASH_SHA2_512:
+            sha2_512_update(&ctx->sha2_512, data, len);
+            break;
+        case HASH_SHA2_512_224:
+            sha2_512_224_update(&ctx->sha2_512, data, len);
+            break;
+        case HASH_SHA2_512_256:
+            sha2_512_256_update(&ctx->sha2_512, data, len);
+            break;
+        case HASH_SHA3_224:
+            sha3_224_update(&ctx->sha3, data, len);
+            break;
+        case HASH_SHA3_256:
+            sha3_256_update(&ctx->sha3, data, len);
+            break;
+        case HASH_SHA3_384:
+            sha3_384_update(&ctx->sha3, data, len);
+            break;
+        case HASH_SHA3_512:
+            sha3_512_update(&ctx->sha3, data, len);
+            break;
+    }
+}
+
+/* `hash` receives the same words as the algorithm's `*_data` function writes */
+static void
+stream_final(union stream_ctx *ctx, void *hash) {
+    switch (algorithm->algorithm) {
+        case HASH_SHA1:
+            sha1_final(&ctx->sha1, hash);
+            break;
+        case HASH_SHA2_224:
+            sha2_224_final(&ctx->sha2_256, hash);
+            break;
+        case HASH_SHA2_256:
+            sha2_256_final(&ctx->sha2_256, hash);
+            break;
+        case HASH_SHA2_384:
+            sha2_384_final(&ctx->sha2_512, hash);
+            break;
+        case HASH_SHA2_512:
+            sha2_512_final(&ctx->sha2_512, hash);
+            break;
+        case HASH_SHA2_512_224:
+            sha2_512_224_final(&ctx->sha2_512, hash);
+            break;
+        case HASH_SHA2_512_256:
+            sha2_512_256_final(&ctx->sha2_512, hash);
+            break;
+        case HASH_SHA3_224:
+            sha3_224_final(&ctx->sha3, hash);
+            break;
+        case HASH_SHA3_256:
+            sha3_256_final(&ctx->sha3, hash);
+            break;
+        case HASH_SHA3_384:
+            sha3_384_final(&ctx->sha3, hash);
+            break;
+        case HASH_SHA3_512:
+            sha3_512_final(&ctx->sha3, hash);
+            break;
+    }
+}
+
+/* Hash a file that cannot be mapped, such as a pipe, one chunk at a time */
+static int
+read_stream(int fd, struct input *input) {
+    static uint8_t chunk[READ_CHUNK];
+    union stream_ctx ctx;
+    ssize_t n;
+
+    stream_init(&ctx);
+    do {
+        while ((n = read(fd, chunk, sizeof chunk)) < 0 && errno == EINTR) {
+        }
+        if (n > 0) {
+            stream_update(&ctx, chunk, (size_t)n);
+        }
+    } while (n > 0);
+
+    if (n < 0) {
+        return -1;
+    }
+    stream_final(&ctx, input->hash);
+    input->streamed = 1;
+    return 0;
+}
+
+static void
+open_input(struct input *input) {
+    int fd = strcmp(input->path, "-") ? open(input->path, O_RDONLY) : STDIN_FILENO;
+    struct stat st;
+
+    input->data = NULL;
+    input->len = 0;
+    input->mapped = 0;
+    input->streamed = 0;
+    input->error = 0;
+
+    if (fd < 0 || fstat(fd, &st)) {
+        input->error = errno;
+        if (fd >= 0 && fd != STDIN_FILENO) {
+            close(fd);
+        }
+        return;
+    }
+
+    if (S_ISREG(st.st_mode) && st.st_size > 0) {
+        input->data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (input->data != MAP_FAILED) {
+            input->len = (size_t)st.st_size;
+            input->mapped = 1;
+            madvise(input->data, input->len, MADV_SEQUENTIAL);
+        } else {
+            input->data = NULL;
+        }
+    }
+
+    if (!input->mapped && !(S_ISREG(st.st_mode) && st.st_size == 0) && read_stream(fd, input)) {
+        input->error = errno;
+    }
+
+    if (fd != STDIN_FILENO) {
+        close(fd);
+    }
+}
+
+static void
+close_input(struct input *input) {
+    if (input->mapped) {
+        munmap(input->data, input->len);
+    }
+    input->data = NULL;
+    input->mapped = 0;
+}
+
+
+/*
+    Hash a group of inputs in parallel, then print or check them in order. Returns the number of
+    digests that did not match, inputs that could not be read are added to `unreadable`.
+*/
+static int
+process_group(struct input *inputs, size_t num_inputs, int check, int *unreadable) {
+    struct hash_job jobs[GROUP_SIZE];
+    size_t num_jobs = 0;
+    int failures = 0;
+
+    for (size_t i = 0; i < num_inputs; i++) {
+        open_input(&inputs[i]);
+        if (!inputs[i].error && !inputs[i].streamed) {
+            jobs[num_jobs].data = inputs[i].data;
+            jobs[num_jobs].len = inputs[i].len;
+            jobs[num_jobs].hash = inputs[i].hash;
+            num_jobs++;
+        }
+    }
+
+    if (hash_batch(algorithm->algorithm, jobs, num_jobs, num_threads)) {
+        fprintf(stderr, "libhash-sum: out of memory\n");
+        exit(2);
+    }
+
+    for (size_t i = 0; i < num_inputs; i++) {
+        uint8_t digest[HASH_MAX_DIGEST_SIZE];
+        char hex[HEX_ENCODED_LEN(HASH_MAX_DIGEST_SIZE) + 1];
+
+        if (inputs[i].error) {
+            close_input(&inputs[i]);
+            fprintf(stderr, "libhash-sum: %s: %s\n", inputs[i].path, strerror(inputs[i].error));
+            if (check) {
+                printf("%s: FAILED open or read\n", inputs[i].path);
+            }
+            (*unreadable)++;
+            continue;
+        }
+
+        hash_digest_bytes(algorithm->algorithm, inputs[i].hash, digest);
+        close_input(&inputs[i]);
+        if (!check) {
+            hex_encode(digest, algorithm->hex_len / 2, hex);
+            printf("%s  %s\n", hex, inputs[i].path);
+        } else if (!hash_digest_equal(digest, inputs[i].expected, algorithm->hex_len / 2)) {
+            printf("%s: FAILED\n", inputs[i].path);
+            failures++;
+        } else {
+            printf("%s: OK\n", inputs[i].path);
+        }
+    }
+
+    return failures;
+}
+
+/* Parse a ``<hex>  <path>`` line, a ``*`` before the path marks binary mode in coreutils and is ignored */
+static int
+parse_line(char *line, struct input *input) {
+    size_t len = strlen(line);
+    char *path;
+
+    while (len && (line[len - 1] == '\n' || line[len - 1] == '\r')) {
+        line[--len] = '\0';
+    }
+    if (len < algorithm->hex_len + 2 || line[algorithm->hex_len] != ' ' ||
+        hex_decode(line, algorithm->hex_len, input->expected)) {
+        return -1;
+    }
+
+    path = line + algorithm->hex_len + 1;
+    if (*path == ' ' || *path == '*') {
+        path++;
+    }
+
+    input->path = strdup(path);
+    return input->path ? 0 : -1;
+}
+
+static int
+check_manifest(const char *manifest) {
+    FILE *file = strcmp(manifest, "-") ? fopen(manifest, "r") : stdin;
+    struct input *inputs = calloc(GROUP_SIZE, sizeof *inputs);
+    size_t num_inputs = 0, num_lines = 0;
+    int failures = 0, unreadable = 0, malformed = 0;
+    char *line = NULL;
+    size_t capacity = 0;
+
+    if (!file || !inputs) {
+        fprintf(stderr, "libhash-sum: %s: %s\n", manifest, strerror(errno));
+        free(inputs);
+        return 1;
+    }
+
+    while (getline(&line, &capacity, file) > 0) {
+        num_lines++;
+        if (parse_line(line, &inputs[num_inputs])) {
+            malformed++;
+            continue;
+        }
+        if (++num_inputs == GROUP_SIZE) {
+            failures += process_group(inputs, num_inputs, 1, &unreadable);
+            for (size_t i = 0; i < num_inputs; i++) {
+                free((char *)inputs[i].path);
+            }
+            num_inputs = 0;
+        }
+    }
+    failures += process_group(inputs, num_inputs, 1, &unreadable);
+    for (size_t i = 0; i < num_inputs; i++) {
+        free((char *)inputs[i].path);
+    }
+
+    if (malformed) {
+        fprintf(stderr, "libhash-sum: %s: %d of %zu lines are improperly formatted\n", manifest, malformed, num_lines);
+    }
+    if (unreadable) {
+        fprintf(stderr, "libhash-sum: WARNING: %d listed file%s could not be read\n", unreadable,
+                unreadable == 1 ? "" : "s");
+    }
+    if (failures) {
+        fprintf(stderr, "libhash-sum: WARNING: %d computed checksum%s did NOT match\n", failures,
+                failures == 1 ? "" : "s");
+    }
+
+    free(line);
+    free(inputs);
+    if (file != stdin) {
+        fclose(file);
+    }
+    return failures || unreadable || malformed || !num_lines;
+}
+
+static void
+usage(void) {
+    fprintf(stderr, "usage: libhash-sum [-a ALGORITHM] [-j THREADS] [FILE]...\n"
+                    "       libhash-sum [-a ALGORITHM] [-j THREADS] -c MANIFEST...\n"
+                    "\n"
+                    "  -a, --algorithm=ALGORITHM  hash function to use\n"
+                    "  -c, --check                read checksums from the MANIFEST files and check them\n"
+                    "  -j, --threads=THREADS      number of threads to hash with\n"
+                    "  -h, --help                 print this help\n"
+                    "\n"
+                    "With no FILE, or when FILE is -, read standard input. ALGORITHM is one of\n");
+    for (size_t i = 0; i < ARRAY_LEN(ALGORITHMS); i++) {
+        fprintf(stderr, "%s%s", i ? ", " : "  ", ALGORITHMS[i].name);
+    }
+    fprintf(stderr, ", the default is sha256. THREADS defaults to one per core.\n");
+}
+
+int
+main(int argc, char **argv) {
+    static char *standard_input[] = {"-"};
+    static const struct option options[] = {
+        {"algorithm", required_argument, NULL, 'a'},
+        {"check", no_argument, NULL, 'c'},
+        {"threads", required_argument, NULL, 'j'},
+        {"help", no_argument, NULL, 'h'},
+        {NULL, 0, NULL, 0},
+    };
+    struct input inputs[GROUP_SIZE];
+    size_t num_inputs = 0;
+    int check = 0, status = 0, unreadable = 0, opt, num_paths;
+    char **paths;
+
+    while ((opt = getopt_long(argc, argv, "a:cj:h", options, NULL)) != -1) {
+        switch (opt) {
+            case 'a':
+                algorithm = NULL;
+                for (size_t i = 0; i < ARRAY_LEN(ALGORITHMS); i++) {
+                    if (!strcmp(optarg, ALGORITHMS[i].name)) {
+                        algorithm = &ALGORITHMS[i];
+                    }
+                }
+                if (!algorithm) {
+                    fprintf(stderr, "libhash-sum: unknown algorithm '%s'\n", optarg);
+                    usage();
+                    return 2;
+                }
+                break;
+            case 'c':
+                check = 1;
+                break;
+            case 'j':
+                num_threads = (unsigned)atoi(optarg);
+                break;
+            default:
+                usage();
+                return opt == 'h' ? 0 : 2;
+        }
+    }
+
+    paths = optind < argc ? argv + optind : standard_input;
+    num_paths = optind < argc ? argc - optind : 1;
+
+    if (check) {
+        for (int i = 0; i < num_paths; i++) {
+            status |= check_manifest(paths[i]);
+        }
+        return status;
+    }
+
+    for (int i = 0; i < num_paths; i++) {
+        inputs[num_inputs++].path = paths[i];
+        if (num_inputs == GROUP_SIZE || i + 1 == num_paths) {
+            status |= process_group(inputs, num_inputs, 0, &unreadable) != 0;
+            num_inputs = 0;
+        }
+    }
+
+    return status || unreadable;
+}
@@ -0,0 +1,51 @@
+#ifndef _BATCH
+#define _BATCH
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+enum hash_algorithm {
+    HASH_SHA1,
+    HASH_SHA2_224,
+    HASH_SHA2_256,
+    HASH_SHA2_384,
+    HASH_SHA2_512,
+    HASH_SHA3_224,
+    HASH_SHA3_256,
+    HASH_SHA3_384,
+    HASH_SHA3_512,
+    HASH_SHA2_512_224,
+    HASH_SHA2_512_256,
+};
+
+/* Engines for hashing several SHA-256 messages at once, see `hash_mb_set_backend` */
+enum hash_mb_backend {
+    HASH_MB_AUTO,
+    HASH_MB_SERIAL,
+    HASH_MB_AVX2,
+    HASH_MB_AVX512,
+};
+
+/* One independent message, `hash` receives the same words as the algorithm's `*_data` function writes. */
+struct hash_job {
+    const void *data;
+    size_t len;
+    void *hash;
+};
+
+
+int hash_batch(enum hash_algorithm algorithm, struct hash_job *jobs, size_t num_jobs, unsigned num_threads);
+
+int hash_mb_set_backend(enum hash_mb_backend backend);
+enum hash_mb_backend hash_mb_get_backend(void);
+void sha2_256_mb(struct hash_job *jobs, size_t num_jobs);
+
+#ifdef __cplusplus
+}
+#endif
+
+
+#endif /* _BATCH */
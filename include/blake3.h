@@ -0,0 +1,66 @@
+#ifndef _BLAKE3
+#define _BLAKE3
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define BLAKE3_KEY_LEN 32
+#define BLAKE3_OUT_LEN 32
+#define BLAKE3_BLOCK_LEN 64
+#define BLAKE3_CHUNK_LEN 1024
+#define BLAKE3_MAX_DEPTH 54  /* Levels of the tree of 2^64 bytes of chunks */
+
+/* Implementations of the compression of many chunks at once, see `blake3_set_backend` */
+enum blake3_backend {
+    BLAKE3_BACKEND_AUTO,
+    BLAKE3_BACKEND_SCALAR,
+    BLAKE3_BACKEND_SSE41,
+    BLAKE3_BACKEND_AVX2,
+    BLAKE3_BACKEND_AVX512,
+};
+
+/* The chunk of the message being hashed, only its last block is held */
+struct blake3_chunk {
+    uint32_t cv[8];                    /* Chaining value after the blocks compressed so far */
+    uint64_t counter;                  /* Index of the chunk in the message */
+    uint8_t block[BLAKE3_BLOCK_LEN];
+    uint8_t block_len;
+    uint8_t blocks_compressed;
+    uint8_t flags;                     /* Mode flags of every block */
+};
+
+/* Streaming context shared by the plain, keyed and derive-key modes */
+struct blake3_ctx {
+    uint32_t key[8];
+    struct blake3_chunk chunk;
+    uint8_t cv_stack_len;
+    uint8_t cv_stack[(BLAKE3_MAX_DEPTH + 1) * BLAKE3_OUT_LEN];  /* Roots of the complete subtrees on the left */
+};
+
+
+void blake3(const void *data, size_t len, void *out, size_t out_len);
+void blake3_keyed(const void *key, const void *data, size_t len, void *out, size_t out_len);
+void blake3_derive_key(const void *context, size_t context_len, const void *material, size_t len, void *out,
+                       size_t out_len);
+
+void blake3_init(struct blake3_ctx *ctx);
+void blake3_init_keyed(struct blake3_ctx *ctx, const void *key);
+void blake3_init_derive_key(struct blake3_ctx *ctx, const void *context, size_t context_len);
+void blake3_update(struct blake3_ctx *ctx, const void *data, size_t len);
+void blake3_update_parallel(struct blake3_ctx *ctx, const void *data, size_t len, unsigned num_threads);
+void blake3_final(const struct blake3_ctx *ctx, void *out, size_t out_len);
+void blake3_final_seek(const struct blake3_ctx *ctx, uint64_t seek, void *out, size_t out_len);
+
+int blake3_set_backend(enum blake3_backend backend);
+enum blake3_backend blake3_get_backend(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+
+#endif /* _BLAKE3 */
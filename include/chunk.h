@@ -0,0 +1,60 @@
+#ifndef _CHUNK
+#define _CHUNK
+
+#include "sha.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Bounds of the sizes accepted by `chunker_init` */
+#define CHUNK_MIN_SIZE 64
+#define CHUNK_MAX_AVG_SIZE (1 << 28)
+
+/* Implementations of the boundary search, see `chunk_set_backend` */
+enum chunk_backend {
+    CHUNK_BACKEND_AUTO,
+    CHUNK_BACKEND_SCALAR,
+    CHUNK_BACKEND_AVX2,
+};
+
+/* A chunk of the stream and the SHA-256 digest of its bytes, as big-endian bytes */
+struct chunk {
+    uint64_t offset;
+    size_t len;
+    uint8_t digest[32];
+};
+
+/* Called for every chunk in stream order, `chunk` is only valid during the call */
+typedef void (*chunk_callback)(const struct chunk *chunk, void *arg);
+
+/* State of a stream being cut into chunks, set up by `chunker_init` */
+struct chunker {
+    size_t min_size;
+    size_t avg_size;
+    size_t max_size;
+    uint32_t mask_small;  /* Cut mask of chunks smaller than `avg_size` */
+    uint32_t mask_large;  /* And of larger ones */
+    uint32_t hash;        /* Gear hash of the last bytes of the stream */
+    uint64_t offset;      /* Stream offset of the current chunk */
+    size_t len;           /* Bytes of the current chunk so far */
+    struct sha2_256_ctx ctx;
+};
+
+
+int chunker_init(struct chunker *chunker, size_t min_size, size_t avg_size, size_t max_size);
+void chunker_update(struct chunker *chunker, const void *data, size_t len, chunk_callback callback, void *arg);
+void chunker_final(struct chunker *chunker, chunk_callback callback, void *arg);
+
+int chunk_set_backend(enum chunk_backend backend);
+enum chunk_backend chunk_get_backend(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+
+#endif /* _CHUNK */
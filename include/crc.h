@@ -0,0 +1,36 @@
+#ifndef _CRC
+#define _CRC
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Implementations of the checksums, see `crc_set_backend` */
+enum crc_backend {
+    CRC_BACKEND_AUTO,
+    CRC_BACKEND_SCALAR,
+    CRC_BACKEND_SSE42,   /* The `crc32` instruction for CRC-32C */
+    CRC_BACKEND_PCLMUL,  /* And carry-less multiplication for CRC-32 and CRC-64 */
+};
+
+
+uint32_t crc32c(uint32_t crc, const void *data, size_t len);
+uint32_t crc32_ieee(uint32_t crc, const void *data, size_t len);
+uint64_t crc64_xz(uint64_t crc, const void *data, size_t len);
+
+uint32_t crc32c_combine(uint32_t crc1, uint32_t crc2, uint64_t len2);
+uint32_t crc32_ieee_combine(uint32_t crc1, uint32_t crc2, uint64_t len2);
+uint64_t crc64_xz_combine(uint64_t crc1, uint64_t crc2, uint64_t len2);
+
+int crc_set_backend(enum crc_backend backend);
+enum crc_backend crc_get_backend(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+
+#endif /* _CRC */
@@ -0,0 +1,53 @@
+#ifndef _DRBG
+#define _DRBG
+
+#include "batch.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define DRBG_MAX_REQUEST 65536                       /* Bytes per generate request, 2^19 bits */
+#define DRBG_RESEED_INTERVAL ((uint64_t)1 << 48)     /* Requests between two reseeds */
+#define DRBG_MAX_SEED_LEN 111                        /* The seedlen of Hash_DRBG with SHA-512, in bytes */
+
+/* Constructions of SP 800-90A */
+enum drbg_mechanism {
+    DRBG_HASH,
+    DRBG_HMAC,
+};
+
+/* Working state of one generator, it must not be shared between threads without a lock */
+struct drbg {
+    enum drbg_mechanism mechanism;
+    enum hash_algorithm algorithm;  /* HASH_SHA2_256 or HASH_SHA2_512 */
+    size_t out_len;                 /* Digest size in bytes */
+    size_t seed_len;                /* Size of `v` in bytes */
+    uint64_t reseed_counter;
+    uint8_t v[DRBG_MAX_SEED_LEN];
+    uint8_t c[DRBG_MAX_SEED_LEN];   /* The constant C of Hash_DRBG or the key of HMAC_DRBG */
+};
+
+
+int drbg_init(struct drbg *drbg, enum drbg_mechanism mechanism, enum hash_algorithm algorithm, const void *entropy,
+              size_t entropy_len, const void *nonce, size_t nonce_len, const void *personalization,
+              size_t personalization_len);
+int drbg_reseed(struct drbg *drbg, const void *entropy, size_t entropy_len, const void *additional,
+                size_t additional_len);
+int drbg_generate(struct drbg *drbg, void *out, size_t len, const void *additional, size_t additional_len);
+void drbg_clear(struct drbg *drbg);
+
+int drbg_thread_init(enum drbg_mechanism mechanism, enum hash_algorithm algorithm, const void *entropy,
+                     size_t entropy_len, const void *personalization, size_t personalization_len);
+int drbg_thread_bytes(void *out, size_t len);
+void drbg_thread_clear(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+
+#endif /* _DRBG */
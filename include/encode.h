@@ -0,0 +1,53 @@
+#ifndef _ENCODE
+#define _ENCODE
+
+#include "batch.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Largest digest in bytes, that of SHA-512 and SHA3-512 */
+#define HASH_MAX_DIGEST_SIZE 64
+
+/* Characters written for `len` bytes, not counting the terminating NUL */
+#define HEX_ENCODED_LEN(len) (2 * (len))
+#define BASE64_ENCODED_LEN(len) (((len) + 2) / 3 * 4)
+
+/* Upper bound of the bytes decoded from `len` base64 characters */
+#define BASE64_DECODED_MAX(len) ((len) / 4 * 3)
+
+/* Implementations of the hex and base64 codecs, see `encode_set_backend` */
+enum encode_backend {
+    ENCODE_BACKEND_AUTO,
+    ENCODE_BACKEND_SCALAR,
+    ENCODE_BACKEND_SSSE3,
+    ENCODE_BACKEND_AVX2,
+};
+
+
+size_t hash_digest_size(enum hash_algorithm algorithm);
+int hash_digest(enum hash_algorithm algorithm, const void *data, size_t len, void *digest);
+int hash_digest_bytes(enum hash_algorithm algorithm, const void *hash, void *digest);
+
+int hash_digest_equal(const void *a, const void *b, size_t len);
+size_t hash_digest_compare(const void *a, const void *b, size_t digest_len, size_t count, uint8_t *equal);
+
+int encode_set_backend(enum encode_backend backend);
+enum encode_backend encode_get_backend(void);
+
+void hex_encode(const void *data, size_t len, char *hex);
+int hex_decode(const char *hex, size_t hex_len, void *data);
+
+size_t base64_encode(const void *data, size_t len, char *base64);
+int base64_decode(const char *base64, size_t base64_len, void *data, size_t *data_len);
+
+#ifdef __cplusplus
+}
+#endif
+
+
+#endif /* _ENCODE */
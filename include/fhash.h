@@ -0,0 +1,57 @@
+#ifndef _FHASH
+#define _FHASH
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Size of the key material the long input loop walks over, see src/fhash.c */
+#define FHASH_SECRET_SIZE 192
+#define FHASH_BUFFER_SIZE 256
+
+/* Implementations of the loop over long inputs, see `fhash_set_backend` */
+enum fhash_backend {
+    FHASH_BACKEND_AUTO,
+    FHASH_BACKEND_SCALAR,
+    FHASH_BACKEND_SSE2,
+    FHASH_BACKEND_AVX2,
+};
+
+struct fhash128 {
+    uint64_t low;
+    uint64_t high;
+};
+
+/* State of a streaming hash, set up by `fhash_init` */
+struct fhash_ctx {
+    uint64_t acc[8];
+    uint64_t seed;
+    uint64_t total_len;
+    size_t buffered;
+    size_t stripes;                     /* Stripes accumulated since the last scramble */
+    uint8_t secret[FHASH_SECRET_SIZE];  /* Key material derived from the seed */
+    uint8_t buffer[FHASH_BUFFER_SIZE];  /* Input not accumulated yet */
+    uint8_t last_stripe[64];            /* Last 64 bytes accumulated */
+};
+
+
+uint64_t fhash64(const void *data, size_t len, uint64_t seed);
+struct fhash128 fhash128(const void *data, size_t len, uint64_t seed);
+
+void fhash_init(struct fhash_ctx *ctx, uint64_t seed);
+void fhash_update(struct fhash_ctx *ctx, const void *data, size_t len);
+uint64_t fhash64_final(const struct fhash_ctx *ctx);
+struct fhash128 fhash128_final(const struct fhash_ctx *ctx);
+
+int fhash_set_backend(enum fhash_backend backend);
+enum fhash_backend fhash_get_backend(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+
+#endif /* _FHASH */
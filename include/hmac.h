@@ -0,0 +1,66 @@
+#ifndef _HMAC
+#define _HMAC
+
+#include "batch.h"
+#include "sha.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Largest MAC in bytes, that of SHA-512 */
+#define HMAC_MAX_SIZE 64
+
+/* Streaming context of any SHA-1 or SHA-2 function, which member is live depends on the algorithm */
+union hash_ctx {
+    struct sha1_ctx sha1;
+    struct sha2_256_ctx sha2_256;
+    struct sha2_512_ctx sha2_512;
+};
+
+/* A key with the ipad and opad blocks already compressed, it can be shared by any number of threads */
+struct hmac_key {
+    enum hash_algorithm algorithm;
+    size_t digest_len;
+    size_t block_size;
+    union hash_ctx inner;  /* Midstate after ``key ^ ipad`` */
+    union hash_ctx outer;  /* Midstate after ``key ^ opad`` */
+};
+
+struct hmac_ctx {
+    const struct hmac_key *key;
+    union hash_ctx inner;
+};
+
+
+size_t hmac_size(enum hash_algorithm algorithm);
+
+int hmac_key_init(struct hmac_key *key, enum hash_algorithm algorithm, const void *secret, size_t secret_len);
+void hmac_key_clear(struct hmac_key *key);
+
+void hmac_init(struct hmac_ctx *ctx, const struct hmac_key *key);
+void hmac_update(struct hmac_ctx *ctx, const void *data, size_t len);
+void hmac_final(struct hmac_ctx *ctx, void *mac);
+
+void hmac_keyed(const struct hmac_key *key, const void *data, size_t len, void *mac);
+int hmac(enum hash_algorithm algorithm, const void *secret, size_t secret_len, const void *data, size_t len, void *mac);
+
+int hkdf_extract(enum hash_algorithm algorithm, const void *salt, size_t salt_len, const void *ikm, size_t ikm_len,
+                 void *prk);
+int hkdf_expand(enum hash_algorithm algorithm, const void *prk, size_t prk_len, const void *info, size_t info_len,
+                void *okm, size_t okm_len);
+int hkdf(enum hash_algorithm algorithm, const void *salt, size_t salt_len, const void *ikm, size_t ikm_len,
+         const void *info, size_t info_len, void *okm, size_t okm_len);
+
+int pbkdf2(enum hash_algorithm algorithm, const void *password, size_t password_len, const void *salt, size_t salt_len,
+           uint32_t iterations, void *out, size_t out_len);
+
+#ifdef __cplusplus
+}
+#endif
+
+
+#endif /* _HMAC */
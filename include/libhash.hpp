@@ -0,0 +1,354 @@
+/*
+    C++20 interface to libhash, header-only on top of the C library.
+
+    `libhash::hasher<Algorithm>` owns a streaming context and hands out digests as
+    `std::array` of big-endian bytes, the usual printed order. SHA-1 and SHA-256 also
+    have a constexpr implementation, `hasher<...>::hash` of a constant input is then
+    evaluated by the compiler and any other input goes to the runtime backends.
+
+        constexpr auto id = libhash::hasher<libhash::sha2_256>::hash("orders.v2");
+
+        libhash::hasher<libhash::sha2_512_256> h;
+        h.update(header).update(payload);
+        auto digest = h.finish();
+*/
+
+#ifndef _LIBHASH_HPP
+#define _LIBHASH_HPP
+
+#include "batch.h"
+#include "sha.h"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string_view>
+#include <type_traits>
+
+namespace libhash {
+
+namespace detail {
+
+/* Constants of FIPS 180-4, constexpr copies of the tables in `sha.c` */
+inline constexpr std::uint32_t sha1_k[4] = {0x5a827999, 0x6ed9eba1, 0x8f1bbcdc, 0xca62c1d6};
+
+inline constexpr std::uint32_t sha256_k[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+inline constexpr std::uint32_t sha1_iv[5] = {0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476, 0xc3d2e1f0};
+
+inline constexpr std::uint32_t sha256_iv[8] = {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+};
+
+constexpr std::uint32_t
+rotl32(std::uint32_t x, int n) {
+    return (x << n) | (x >> (32 - n));
+}
+
+constexpr std::uint32_t
+rotr32(std::uint32_t x, int n) {
+    return (x >> n) | (x << (32 - n));
+}
+
+/* Byte `i` of the message followed by the padding of a 64-byte block hash, `len` bytes of `data` are message */
+template <class Byte>
+constexpr std::uint8_t
+padded_byte(const Byte *data, std::size_t len, std::size_t padded_len, std::size_t i) {
+    if (i < len) {
+        return static_cast<std::uint8_t>(data[i]);
+    }
+    if (i == len) {
+        return 0x80;
+    }
+    if (i >= padded_len - 8) {
+        return static_cast<std::uint8_t>((static_cast<std::uint64_t>(len) * 8) >> (8 * (padded_len - 1 - i)));
+    }
+    return 0;
+}
+
+/* Schedule words of the block starting at byte `offset` of the padded message */
+template <class Byte>
+constexpr void
+load_block(std::uint32_t *w, const Byte *data, std::size_t len, std::size_t padded_len, std::size_t offset) {
+    for (std::size_t t = 0; t < 16; t++) {
+        w[t] = 0;
+        for (std::size_t j = 0; j < 4; j++) {
+            w[t] = (w[t] << 8) | padded_byte(data, len, padded_len, offset + 4 * t + j);
+        }
+    }
+}
+
+template <std::size_t N>
+constexpr std::array<std::uint8_t, 4 * N>
+store_words(const std::uint32_t (&state)[N]) {
+    std::array<std::uint8_t, 4 * N> out{};
+
+    for (std::size_t i = 0; i < 4 * N; i++) {
+        out[i] = static_cast<std::uint8_t>(state[i / 4] >> (24 - 8 * (i % 4)));
+    }
+    return out;
+}
+
+/* SHA-1 written for constant evaluation, the runtime uses `sha1_data` */
+template <class Byte>
+constexpr std::array<std::uint8_t, 20>
+sha1(const Byte *data, std::size_t len) {
+    std::uint32_t state[5] = {sha1_iv[0], sha1_iv[1], sha1_iv[2], sha1_iv[3], sha1_iv[4]};
+    std::size_t padded_len = (len + 8) / 64 * 64 + 64;
+
+    for (std::size_t offset = 0; offset < padded_len; offset += 64) {
+        std::uint32_t w[80] = {};
+        std::uint32_t a = state[0], b = state[1], c = state[2], d = state[3], e = state[4];
+
+        load_block(w, data, len, padded_len, offset);
+        for (std::size_t t = 16; t < 80; t++) {
+            w[t] = rotl32(w[t - 3] ^ w[t - 8] ^ w[t - 14] ^ w[t - 16], 1);
+        }
+
+        for (std::size_t t = 0; t < 80; t++) {
+            std::uint32_t f = t < 20 ? (d ^ (b & (c ^ d))) : t >= 40 && t < 60 ? ((b & c) | (d & (b | c))) : b ^ c ^ d;
+            std::uint32_t temp = rotl32(a, 5) + f + e + sha1_k[t / 20] + w[t];
+            e = d;
+            d = c;
+            c = rotl32(b, 30);
+            b = a;
+            a = temp;
+        }
+
+        state[0] += a;
+        state[1] += b;
+        state[2] += c;
+        state[3] += d;
+        state[4] += e;
+    }
+    return store_words(state);
+}
+
+/* SHA-256 written for constant evaluation, the runtime uses `sha2_256_data` */
+template <class Byte>
+constexpr std::array<std::uint8_t, 32>
+sha256(const Byte *data, std::size_t len) {
+    std::uint32_t state[8] = {sha256_iv[0], sha256_iv[1], sha256_iv[2], sha256_iv[3],
+                              sha256_iv[4], sha256_iv[5], sha256_iv[6], sha256_iv[7]};
+    std::size_t padded_len = (len + 8) / 64 * 64 + 64;
+
+    for (std::size_t offset = 0; offset < padded_len; offset += 64) {
+        std::uint32_t w[64] = {};
+        std::uint32_t a = state[0], b = state[1], c = state[2], d = state[3], e = state[4], f = state[5],
+                      g = state[6], h = state[7];
+
+        load_block(w, data, len, padded_len, offset);
+        for (std::size_t t = 16; t < 64; t++) {
+            std::uint32_t s0 = rotr32(w[t - 15], 7) ^ rotr32(w[t - 15], 18) ^ (w[t - 15] >> 3);
+            std::uint32_t s1 = rotr32(w[t - 2], 17) ^ rotr32(w[t - 2], 19) ^ (w[t - 2] >> 10);
+            w[t] = w[t - 16] + s0 + w[t - 7] + s1;
+        }
+
+        for (std::size_t t = 0; t < 64; t++) {
+            std::uint32_t temp1 = h + (rotr32(e, 6) ^ rotr32(e, 11) ^ rotr32(e, 25)) + (g ^ (e & (f ^ g))) +
+                                  sha256_k[t] + w[t];
+            std::uint32_t temp2 = (rotr32(a, 2) ^ rotr32(a, 13) ^ rotr32(a, 22)) + ((a & b) | (c & (a | b)));
+            h = g;
+            g = f;
+            f = e;
+            e = d + temp1;
+            d = c;
+            c = b;
+            b = a;
+            a = temp1 + temp2;
+        }
+
+        state[0] += a;
+        state[1] += b;
+        state[2] += c;
+        state[3] += d;
+        state[4] += e;
+        state[5] += f;
+        state[6] += g;
+        state[7] += h;
+    }
+    return store_words(state);
+}
+
+}  // namespace detail
+
+/*
+    Algorithm tags for `hasher`. Each one names the C context and functions, the size of
+    the words written by the C `final` function and the digest size in bytes.
+*/
+#define LIBHASH_ALGORITHM(tag, ctx, word, size, id)                                                                    \
+    struct tag {                                                                                                       \
+        using context_type = ::ctx;                                                                                    \
+        using word_type = word;                                                                                        \
+        static constexpr std::size_t digest_size = size;                                                               \
+        static constexpr ::hash_algorithm algorithm = id;                                                              \
+                                                                                                                       \
+        static void init(context_type *c) noexcept {                                                                   \
+            ::tag##_init(c);                                                                                           \
+        }                                                                                                              \
+        static void update(context_type *c, const void *data, std::size_t len) noexcept {                              \
+            ::tag##_update(c, data, len);                                                                              \
+        }                                                                                                              \
+        static void finish(context_type *c, word_type *hash) noexcept {                                                \
+            ::tag##_final(c, hash);                                                                                    \
+        }                                                                                                              \
+        static void oneshot(const void *data, std::size_t len, word_type *hash) noexcept {                             \
+            ::tag##_data(data, len, hash);                                                                             \
+        }                                                                                                              \
+    }
+
+LIBHASH_ALGORITHM(sha1, sha1_ctx, std::uint32_t, 20, HASH_SHA1);
+LIBHASH_ALGORITHM(sha2_224, sha2_256_ctx, std::uint32_t, 28, HASH_SHA2_224);
+LIBHASH_ALGORITHM(sha2_256, sha2_256_ctx, std::uint32_t, 32, HASH_SHA2_256);
+LIBHASH_ALGORITHM(sha2_384, sha2_512_ctx, std::uint64_t, 48, HASH_SHA2_384);
+LIBHASH_ALGORITHM(sha2_512, sha2_512_ctx, std::uint64_t, 64, HASH_SHA2_512);
+LIBHASH_ALGORITHM(sha2_512_224, sha2_512_ctx, std::uint64_t, 28, HASH_SHA2_512_224);
+LIBHASH_ALGORITHM(sha2_512_256, sha2_512_ctx, std::uint64_t, 32, HASH_SHA2_512_256);
+LIBHASH_ALGORITHM(sha3_224, sha3_ctx, std::uint64_t, 28, HASH_SHA3_224);
+LIBHASH_ALGORITHM(sha3_256, sha3_ctx, std::uint64_t, 32, HASH_SHA3_256);
+LIBHASH_ALGORITHM(sha3_384, sha3_ctx, std::uint64_t, 48, HASH_SHA3_384);
+LIBHASH_ALGORITHM(sha3_512, sha3_ctx, std::uint64_t, 64, HASH_SHA3_512);
+
+#undef LIBHASH_ALGORITHM
+
+/* Algorithms with a constexpr implementation in `detail` */
+template <class Algorithm>
+inline constexpr bool is_constexpr_v = std::is_same_v<Algorithm, sha1> || std::is_same_v<Algorithm, sha2_256>;
+
+/*
+    Streaming hash of `Algorithm`. The context is initialized on construction and wiped on
+    destruction. Copies are independent, so a common prefix can be hashed once and forked.
+*/
+template <class Algorithm>
+class hasher {
+  public:
+    using digest_type = std::array<std::uint8_t, Algorithm::digest_size>;
+
+    static constexpr std::size_t digest_size = Algorithm::digest_size;
+
+    hasher() noexcept {
+        Algorithm::init(&ctx_);
+    }
+
+    hasher(const hasher &) noexcept = default;
+    hasher &operator=(const hasher &) noexcept = default;
+
+    ~hasher() {
+        wipe(&ctx_, sizeof ctx_);
+    }
+
+    hasher &update(std::span<const std::byte> data) noexcept {
+        Algorithm::update(&ctx_, data.data(), data.size());
+        return *this;
+    }
+
+    hasher &update(std::span<const std::uint8_t> data) noexcept {
+        Algorithm::update(&ctx_, data.data(), data.size());
+        return *this;
+    }
+
+    hasher &update(std::string_view data) noexcept {
+        Algorithm::update(&ctx_, data.data(), data.size());
+        return *this;
+    }
+
+    /* Digest of everything fed so far, the hasher then starts over with an empty message */
+    digest_type finish() noexcept {
+        typename Algorithm::word_type words[(Algorithm::digest_size + sizeof(typename Algorithm::word_type) - 1) /
+                                            sizeof(typename Algorithm::word_type)];
+
+        Algorithm::finish(&ctx_, words);
+        Algorithm::init(&ctx_);
+        return to_bytes(words);
+    }
+
+    /* One-shot digests, constant inputs are hashed at compile time when `Algorithm` allows it */
+    static constexpr digest_type hash(std::string_view data) noexcept
+        requires is_constexpr_v<Algorithm>
+    {
+        if (std::is_constant_evaluated()) {
+            return constant_hash(data.data(), data.size());
+        }
+        return runtime_hash(data.data(), data.size());
+    }
+
+    static constexpr digest_type hash(std::span<const std::uint8_t> data) noexcept
+        requires is_constexpr_v<Algorithm>
+    {
+        if (std::is_constant_evaluated()) {
+            return constant_hash(data.data(), data.size());
+        }
+        return runtime_hash(data.data(), data.size());
+    }
+
+    static digest_type hash(std::string_view data) noexcept
+        requires(!is_constexpr_v<Algorithm>)
+    {
+        return runtime_hash(data.data(), data.size());
+    }
+
+    static digest_type hash(std::span<const std::uint8_t> data) noexcept
+        requires(!is_constexpr_v<Algorithm>)
+    {
+        return runtime_hash(data.data(), data.size());
+    }
+
+    static digest_type hash(std::span<const std::byte> data) noexcept {
+        return runtime_hash(data.data(), data.size());
+    }
+
+  private:
+    typename Algorithm::context_type ctx_;
+
+    template <class Byte>
+    static constexpr digest_type constant_hash(const Byte *data, std::size_t len) noexcept {
+        if constexpr (std::is_same_v<Algorithm, sha1>) {
+            return detail::sha1(data, len);
+        } else {
+            return detail::sha256(data, len);
+        }
+    }
+
+    static digest_type runtime_hash(const void *data, std::size_t len) noexcept {
+        typename Algorithm::word_type words[(Algorithm::digest_size + sizeof(typename Algorithm::word_type) - 1) /
+                                            sizeof(typename Algorithm::word_type)];
+
+        Algorithm::oneshot(data, len, words);
+        return to_bytes(words);
+    }
+
+    /* The C functions write big-endian words in host order */
+    template <class Word, std::size_t N>
+    static digest_type to_bytes(const Word (&words)[N]) noexcept {
+        digest_type out;
+
+        for (std::size_t i = 0; i < out.size(); i++) {
+            out[i] = static_cast<std::uint8_t>(words[i / sizeof(Word)] >> (8 * (sizeof(Word) - 1 - i % sizeof(Word))));
+        }
+        return out;
+    }
+
+    /* Contexts hold message bytes, clear them in a way the compiler cannot drop */
+    static void wipe(void *data, std::size_t len) noexcept {
+        volatile std::uint8_t *bytes = static_cast<volatile std::uint8_t *>(data);
+
+        while (len--) {
+            *bytes++ = 0;
+        }
+    }
+};
+
+}  // namespace libhash
+
+
+#endif /* _LIBHASH_HPP */
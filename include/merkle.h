@@ -0,0 +1,55 @@
+#ifndef _MERKLE
+#define _MERKLE
+
+#include "batch.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Tree heights are bounded by the bits of a leaf index, plus the root level */
+#define MERKLE_MAX_LEVELS 65
+
+/* One leaf of a tree built from a list of chunks */
+struct merkle_leaf {
+    const void *data;
+    size_t len;
+};
+
+/*
+    A Merkle tree with every level kept in `nodes`, leaf hashes first and the root last.
+    Node `i` of level `k` starts at byte `(level_start[k] + i) * digest_len`, digests are
+    stored as big-endian bytes.
+*/
+struct merkle_tree {
+    enum hash_algorithm algorithm;
+    size_t digest_len;
+    size_t num_leaves;
+    size_t num_levels;
+    size_t level_start[MERKLE_MAX_LEVELS + 1];
+    uint8_t *nodes;
+};
+
+
+int merkle_build(struct merkle_tree *tree, enum hash_algorithm algorithm, const void *data, size_t len,
+                 size_t chunk_size, unsigned num_threads);
+int merkle_build_leaves(struct merkle_tree *tree, enum hash_algorithm algorithm, const struct merkle_leaf *leaves,
+                        size_t num_leaves, unsigned num_threads);
+void merkle_free(struct merkle_tree *tree);
+
+void merkle_root(const struct merkle_tree *tree, void *root);
+int merkle_update(struct merkle_tree *tree, size_t index, const void *data, size_t len);
+
+size_t merkle_proof(const struct merkle_tree *tree, size_t index, void *proof);
+int merkle_verify(enum hash_algorithm algorithm, const void *root, size_t num_leaves, size_t index, const void *data,
+                  size_t len, const void *proof, size_t proof_len);
+
+#ifdef __cplusplus
+}
+#endif
+
+
+#endif /* _MERKLE */
@@ -1,11 +1,16 @@
 #ifndef _SHA
 #define _SHA
 
+#include <stddef.h>
 #include <stdint.h>
 
-#define CH(x, y, z) (((x) & (y)) | (~(x) & (z)))
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CH(x, y, z) ((z) ^ ((x) & ((y) ^ (z))))
 #define PARITY(x, y, z) ((x) ^ (y) ^ (z))
-#define MAJ(x, y, z) (((x) & (y)) ^ ((x) & (z)) ^ ((y) & (z)))
+#define MAJ(x, y, z) (((x) & (y)) | ((z) & ((x) | (y))))
 
 #define ROTL(x, n) (((x) << (n)) | ((x) >> ((sizeof(x) * 8) - (n))))
 #define ROTR(x, n) (((x) >> (n)) | ((x) << ((sizeof(x) * 8) - (n))))
@@ -23,14 +28,103 @@
 #define SIGMA512_1_SMALL(x) (ROTR(x, 19) ^ ROTR(x, 61) ^ ((x) >> 6))
 
 
+/* Implementations of the SHA-1/SHA-2 compression functions, see `sha_set_backend` */
+enum sha_backend {
+    SHA_BACKEND_AUTO,
+    SHA_BACKEND_SCALAR,
+    SHA_BACKEND_SHANI,
+};
+
+/* Streaming contexts, only one block of the message is held at a time. */
+struct sha1_ctx {
+    uint32_t state[5];
+    uint64_t length;  /* Number of bytes fed so far */
+    uint8_t block[64];
+};
+
+/* Shared by SHA-224 and SHA-256 */
+struct sha2_256_ctx {
+    uint32_t state[8];
+    uint64_t length;  /* Number of bytes fed so far */
+    uint8_t block[64];
+};
+
+/* Shared by SHA-384, SHA-512, SHA-512/224 and SHA-512/256 */
+struct sha2_512_ctx {
+    uint64_t state[8];
+    uint64_t length;  /* Number of bytes fed so far */
+    uint8_t block[128];
+};
+
+/* Shared by all SHA-3 functions, the message is XORed straight into the Keccak state */
+struct sha3_ctx {
+    uint64_t state[25];
+    uint64_t length;  /* Number of bytes absorbed so far */
+    size_t rate;      /* Bytes absorbed per permutation */
+    size_t used;      /* Bytes absorbed into the current block */
+};
+
+/* Shared by SHAKE and cSHAKE, once squeezing starts `sponge.used` counts the bytes handed out */
+struct shake_ctx {
+    struct sha3_ctx sponge;
+    uint8_t suffix;  /* Domain separation bits appended to the message */
+    int squeezing;
+};
+
+
+int sha_set_backend(enum sha_backend backend);
+enum sha_backend sha_get_backend(void);
+
 /* SHA-1 Family */
 void sha1(const char *message, uint32_t *hash);
+void sha1_data(const void *data, size_t len, uint32_t *hash);
+
+void sha1_init(struct sha1_ctx *ctx);
+void sha1_update(struct sha1_ctx *ctx, const void *data, size_t len);
+void sha1_final(struct sha1_ctx *ctx, uint32_t *hash);
 
 /* SHA-2 Family */
 void sha2_224(const char *message, uint32_t *hash);
 void sha2_256(const char *message, uint32_t *hash);
 void sha2_384(const char *message, uint64_t *hash);
 void sha2_512(const char *message, uint64_t *hash);
+void sha2_512_224(const char *message, uint64_t *hash);
+void sha2_512_256(const char *message, uint64_t *hash);
+
+void sha2_224_data(const void *data, size_t len, uint32_t *hash);
+void sha2_256_data(const void *data, size_t len, uint32_t *hash);
+void sha2_384_data(const void *data, size_t len, uint64_t *hash);
+void sha2_512_data(const void *data, size_t len, uint64_t *hash);
+void sha2_512_224_data(const void *data, size_t len, uint64_t *hash);
+void sha2_512_256_data(const void *data, size_t len, uint64_t *hash);
+
+void sha2_256_32(const void *data, uint32_t *hash);
+void sha2_256_64(const void *data, uint32_t *hash);
+void sha2_256d(const void *data, size_t len, uint32_t *hash);
+
+void sha2_224_init(struct sha2_256_ctx *ctx);
+void sha2_224_update(struct sha2_256_ctx *ctx, const void *data, size_t len);
+void sha2_224_final(struct sha2_256_ctx *ctx, uint32_t *hash);
+
+void sha2_256_init(struct sha2_256_ctx *ctx);
+void sha2_256_update(struct sha2_256_ctx *ctx, const void *data, size_t len);
+void sha2_256_final(struct sha2_256_ctx *ctx, uint32_t *hash);
+
+void sha2_384_init(struct sha2_512_ctx *ctx);
+void sha2_384_update(struct sha2_512_ctx *ctx, const void *data, size_t len);
+void sha2_384_final(struct sha2_512_ctx *ctx, uint64_t *hash);
+
+void sha2_512_init(struct sha2_512_ctx *ctx);
+void sha2_512_update(struct sha2_512_ctx *ctx, const void *data, size_t len);
+void sha2_512_final(struct sha2_512_ctx *ctx, uint64_t *hash);
+
+void sha2_512_224_init(struct sha2_512_ctx *ctx);
+void sha2_512_224_update(struct sha2_512_ctx *ctx, const void *data, size_t len);
+void sha2_512_224_final(struct sha2_512_ctx *ctx, uint64_t *hash);
+
+void sha2_512_256_init(struct sha2_512_ctx *ctx);
+void sha2_512_256_update(struct sha2_512_ctx *ctx, const void *data, size_t len);
+void sha2_512_256_final(struct sha2_512_ctx *ctx, uint64_t *hash);
 
 /* SHA-3 Family */
 void sha3_224(const char *message, uint64_t *hash);
@@ -38,5 +132,52 @@ void sha3_256(const char *message, uint64_t *hash);
 void sha3_384(const char *message, uint64_t *hash);
 void sha3_512(const char *message, uint64_t *hash);
 
+void sha3_224_data(const void *data, size_t len, uint64_t *hash);
+void sha3_256_data(const void *data, size_t len, uint64_t *hash);
+void sha3_384_data(const void *data, size_t len, uint64_t *hash);
+void sha3_512_data(const void *data, size_t len, uint64_t *hash);
+
+void sha3_224_init(struct sha3_ctx *ctx);
+void sha3_224_update(struct sha3_ctx *ctx, const void *data, size_t len);
+void sha3_224_final(struct sha3_ctx *ctx, uint64_t *hash);
+
+void sha3_256_init(struct sha3_ctx *ctx);
+void sha3_256_update(struct sha3_ctx *ctx, const void *data, size_t len);
+void sha3_256_final(struct sha3_ctx *ctx, uint64_t *hash);
+
+void sha3_384_init(struct sha3_ctx *ctx);
+void sha3_384_update(struct sha3_ctx *ctx, const void *data, size_t len);
+void sha3_384_final(struct sha3_ctx *ctx, uint64_t *hash);
+
+void sha3_512_init(struct sha3_ctx *ctx);
+void sha3_512_update(struct sha3_ctx *ctx, const void *data, size_t len);
+void sha3_512_final(struct sha3_ctx *ctx, uint64_t *hash);
+
+void shake128(const void *data, size_t len, void *out, size_t out_len);
+void shake256(const void *data, size_t len, void *out, size_t out_len);
+void cshake128(const void *data, size_t len, const void *name, size_t name_len, const void *custom, size_t custom_len,
+               void *out, size_t out_len);
+void cshake256(const void *data, size_t len, const void *name, size_t name_len, const void *custom, size_t custom_len,
+               void *out, size_t out_len);
+
+void shake128_init(struct shake_ctx *ctx);
+void cshake128_init(struct shake_ctx *ctx, const void *name, size_t name_len, const void *custom, size_t custom_len);
+void shake128_update(struct shake_ctx *ctx, const void *data, size_t len);
+void shake128_squeeze(struct shake_ctx *ctx, void *out, size_t len);
+
+void shake256_init(struct shake_ctx *ctx);
+void cshake256_init(struct shake_ctx *ctx, const void *name, size_t name_len, const void *custom, size_t custom_len);
+void shake256_update(struct shake_ctx *ctx, const void *data, size_t len);
+void shake256_squeeze(struct shake_ctx *ctx, void *out, size_t len);
+
+int parallelhash128(const void *data, size_t len, size_t block_size, const void *custom, size_t custom_len, void *out,
+                    size_t out_len, unsigned num_threads);
+int parallelhash256(const void *data, size_t len, size_t block_size, const void *custom, size_t custom_len, void *out,
+                    size_t out_len, unsigned num_threads);
+
+#ifdef __cplusplus
+}
+#endif
+
 
 #endif /* _SHA */
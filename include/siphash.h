@@ -0,0 +1,61 @@
+#ifndef _SIPHASH
+#define _SIPHASH
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SIPHASH_KEY_LEN 16
+#define HALFSIPHASH_KEY_LEN 8
+
+/* Implementations of the batch functions, see `siphash_set_backend` */
+enum siphash_backend {
+    SIPHASH_BACKEND_AUTO,
+    SIPHASH_BACKEND_SCALAR,
+    SIPHASH_BACKEND_AVX2,    /* 4 messages at once */
+    SIPHASH_BACKEND_AVX512,  /* 8 messages at once */
+};
+
+struct siphash128 {
+    uint64_t low;
+    uint64_t high;
+};
+
+/* Initial state derived from a secret key, computed once for any number of messages */
+struct siphash_key {
+    uint64_t v[4];
+};
+
+struct halfsiphash_key {
+    uint32_t v[4];
+};
+
+struct hash_job;
+
+
+void siphash_key_init(struct siphash_key *schedule, const void *key);
+void halfsiphash_key_init(struct halfsiphash_key *schedule, const void *key);
+
+uint64_t siphash24(const struct siphash_key *key, const void *data, size_t len);
+struct siphash128 siphash24_128(const struct siphash_key *key, const void *data, size_t len);
+uint64_t siphash13(const struct siphash_key *key, const void *data, size_t len);
+struct siphash128 siphash13_128(const struct siphash_key *key, const void *data, size_t len);
+
+uint32_t halfsiphash24(const struct halfsiphash_key *key, const void *data, size_t len);
+uint64_t halfsiphash24_64(const struct halfsiphash_key *key, const void *data, size_t len);
+
+void siphash24_batch(const struct siphash_key *key, struct hash_job *jobs, size_t num_jobs);
+void siphash13_batch(const struct siphash_key *key, struct hash_job *jobs, size_t num_jobs);
+
+int siphash_set_backend(enum siphash_backend backend);
+enum siphash_backend siphash_get_backend(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+
+#endif /* _SIPHASH */
@@ -0,0 +1,52 @@
+#ifndef _STATE
+#define _STATE
+
+#include "batch.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Version written by `hash_state_export`, `hash_state_import` accepts this version only */
+#define HASH_STATE_VERSION 1
+
+/* Largest exported state in bytes, that of the SHA-3 functions */
+#define HASH_STATE_MAX_SIZE 224
+
+/*
+    Exported states are portable between hosts and processes, every field has a fixed size
+    and byte order:
+
+    ======  ====  ===========================================================================
+    Offset  Size  Field
+    ======  ====  ===========================================================================
+    0       4     Magic ``"LHST"``
+    4       1     Format version, `HASH_STATE_VERSION`
+    5       1     Algorithm, the value of `enum hash_algorithm`
+    6       2     Zero
+    8       8     Number of message bytes fed so far, big-endian
+    16      n     Chaining values: big-endian words for SHA-1 and SHA-2, the 200 byte Keccak
+                  state with little-endian lanes for SHA-3
+    16 + n  b     SHA-1 and SHA-2 only, the buffered partial block zero-filled to the block size
+    end-8   8     The first 8 bytes of the SHA-256 of every preceding byte
+    ======  ====  ===========================================================================
+
+    The algorithm values are part of the format, new algorithms are only ever appended to
+    `enum hash_algorithm`.
+*/
+
+size_t hash_state_size(enum hash_algorithm algorithm);
+
+int hash_state_export(enum hash_algorithm algorithm, const void *ctx, void *buf, size_t buf_len);
+int hash_state_import(enum hash_algorithm algorithm, void *ctx, const void *buf, size_t len);
+int hash_state_info(const void *buf, size_t len, enum hash_algorithm *algorithm, uint64_t *length);
+
+#ifdef __cplusplus
+}
+#endif
+
+
+#endif /* _STATE */
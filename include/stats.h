@@ -0,0 +1,52 @@
+#ifndef _STATS
+#define _STATS
+
+#include "batch.h"
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Algorithms counted by `hash_stats_get`, the values of `enum hash_algorithm` */
+#define HASH_STATS_NUM_ALGORITHMS (HASH_SHA2_512_256 + 1)
+
+/*
+    Calls are counted by message size, bucket 0 holds calls of less than 64 bytes and
+    bucket ``i`` those of less than ``64 << 2 * i`` bytes, the last one everything from
+    256 KiB up.
+*/
+#define HASH_STATS_NUM_BUCKETS 8
+
+/* Code that compressed the blocks of an algorithm */
+enum hash_stats_backend {
+    HASH_STATS_SCALAR,
+    HASH_STATS_SHANI,
+    HASH_STATS_AVX2,    /* Multi-buffer lanes of `sha2_256_mb` and the SHA-3 batch */
+    HASH_STATS_AVX512,  /* Multi-buffer lanes of `sha2_256_mb` */
+    HASH_STATS_NUM_BACKENDS,
+};
+
+/* Totals of one algorithm over all threads */
+struct hash_stats {
+    uint64_t calls;   /* `*_data` and `*_update` calls, and jobs of the batch functions */
+    uint64_t bytes;   /* Message bytes hashed */
+    uint64_t blocks;  /* Blocks compressed, padding included, permutations for SHA-3 */
+    uint64_t blocks_by_backend[HASH_STATS_NUM_BACKENDS];
+    uint64_t calls_by_size[HASH_STATS_NUM_BUCKETS];
+};
+
+
+void hash_stats_enable(int enabled);
+int hash_stats_enabled(void);
+
+int hash_stats_get(enum hash_algorithm algorithm, struct hash_stats *stats);
+void hash_stats_reset(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+
+#endif /* _STATS */
@@ -0,0 +1,122 @@
+#include "batch.h"
+
+#include "pool.h"
+#include "sha.h"
+#include "sha_internal.h"
+
+#include <stddef.h>
+
+/*
+    Most jobs per task, a task is the unit that workers hand out and steal. It is small
+    enough to keep stealing effective when lengths vary and big enough to fill every SIMD
+    lane of `sha2_256_mb` many times over. Smaller batches are cut into one task per
+    thread instead, so a few large messages still get a thread each.
+*/
+#define BATCH_GROUP 64
+
+struct batch {
+    enum hash_algorithm algorithm;
+    struct hash_job *jobs;
+    size_t num_jobs;
+    size_t group;  /* Jobs per task */
+};
+
+static void
+batch_job(enum hash_algorithm algorithm, struct hash_job *job) {
+    switch (algorithm) {
+        case HASH_SHA1:
+            sha1_data(job->data, job->len, job->hash);
+            break;
+        case HASH_SHA2_224:
+            sha2_224_data(job->data, job->len, job->hash);
+            break;
+        case HASH_SHA2_256:
+            sha2_256_data(job->data, job->len, job->hash);
+            break;
+        case HASH_SHA2_384:
+            sha2_384_data(job->data, job->len, job->hash);
+            break;
+        case HASH_SHA2_512:
+            sha2_512_data(job->data, job->len, job->hash);
+            break;
+        case HASH_SHA2_512_224:
+            sha2_512_224_data(job->data, job->len, job->hash);
+            break;
+        case HASH_SHA2_512_256:
+            sha2_512_256_data(job->data, job->len, job->hash);
+            break;
+        default:
+            break;
+    }
+}
+
+static void
+batch_task(void *arg, size_t index) {
+    struct batch *batch = arg;
+    size_t begin = index * batch->group;
+    size_t end = begin + batch->group < batch->num_jobs ? begin + batch->group : batch->num_jobs;
+
+    switch (batch->algorithm) {
+        case HASH_SHA2_256:
+            sha2_256_mb(batch->jobs + begin, end - begin);
+            return;
+        case HASH_SHA3_224:
+            sha3_mb(batch->jobs + begin, end - begin, 144, 28);
+            return;
+        case HASH_SHA3_256:
+            sha3_mb(batch->jobs + begin, end - begin, 136, 32);
+            return;
+        case HASH_SHA3_384:
+            sha3_mb(batch->jobs + begin, end - begin, 104, 48);
+            return;
+        case HASH_SHA3_512:
+            sha3_mb(batch->jobs + begin, end - begin, 72, 64);
+            return;
+        default:
+            break;
+    }
+
+    for (size_t i = begin; i < end; i++) {
+        batch_job(batch->algorithm, &batch->jobs[i]);
+    }
+}
+
+/**
+   Hash many independent messages with :c:var:`algorithm` across a pool of threads.
+
+   The jobs are split evenly between the workers up front and idle workers steal
+   from the busy ones, so throughput scales with the number of cores even when
+   message lengths vary widely. The hashing core keeps no shared state, so the
+   jobs need no locking of their own. SHA-256 jobs are additionally hashed several
+   at a time in SIMD lanes by :c:func:`sha2_256_mb`, and SHA-3 jobs four at a time
+   with an interleaved Keccak permutation.
+
+   :param algorithm: The hash function applied to every job.
+   :type algorithm: enum hash_algorithm
+   :param jobs: The messages to hash, each job's hash is written to its own buffer.
+   :type jobs: struct hash_job *
+   :param num_jobs: Number of elements in :c:var:`jobs`.
+   :type num_jobs: size_t
+   :param num_threads: Number of threads to use including the calling one, 0 uses
+                       one thread per online core.
+   :type num_threads: unsigned
+   :return: 0 on success, -1 if :c:var:`algorithm` is unknown or the pool could not be allocated.
+   :rtype: int
+*/
+int
+hash_batch(enum hash_algorithm algorithm, struct hash_job *jobs, size_t num_jobs, unsigned num_threads) {
+    struct batch batch = {algorithm, jobs, num_jobs, BATCH_GROUP};
+
+    if ((unsigned)algorithm > HASH_SHA2_512_256) {
+        return -1;
+    }
+
+    if (!num_threads) {
+        num_threads = hash_pool_default_threads();
+    }
+    if (num_jobs / num_threads < BATCH_GROUP) {
+        batch.group = num_jobs > num_threads ? (num_jobs + num_threads - 1) / num_threads : 1;
+    }
+
+    return hash_pool_run((num_jobs + batch.group - 1) / batch.group, 1, num_threads, batch_task, &batch);
+}
@@ -0,0 +1,1181 @@
+/*
+    BLAKE3 (https://github.com/BLAKE3-team/BLAKE3-specs/blob/master/blake3.pdf).
+
+    The message is cut into chunks of 1 KiB which are hashed on their own with a chaining
+    value and their index, and the chaining values are merged pairwise into a binary tree
+    whose left subtrees are complete. Streaming keeps the roots of the complete subtrees
+    on a stack, merging them lazily so that the last one can still become the root.
+
+    Because chunks are independent, the SIMD kernels hash 4 (SSE4.1), 8 (AVX2) or 16
+    (AVX-512) chunks at once with word `i` of every lane in one vector, and compress the
+    parent nodes of a level the same way. Large subtrees are split into pieces hashed by
+    the worker pool, whose roots are then merged on the calling thread.
+
+    The layout of the tree, and so the hash, does not depend on the backend, the number
+    of threads or how the message was split between calls.
+*/
+
+#include "blake3.h"
+
+#include "cpu.h"
+#include "pool.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#define CHUNK_START (1 << 0)
+#define CHUNK_END (1 << 1)
+#define PARENT (1 << 2)
+#define ROOT (1 << 3)
+#define KEYED_HASH (1 << 4)
+#define DERIVE_KEY_CONTEXT (1 << 5)
+#define DERIVE_KEY_MATERIAL (1 << 6)
+
+#define MAX_SIMD_DEGREE 16
+
+/* Subtrees are split into pieces of at least PIECE_LEN bytes for the threads, at most MAX_PIECES of them */
+#define PIECE_LEN ((size_t)64 << 10)
+#define MAX_PIECES 256
+
+#define ROTR32(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+static const uint32_t IV[8] = {0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+                               0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+
+/* Message words used by each round, the permutation applied 0 to 6 times */
+static const uint8_t MSG_SCHEDULE[7][16] = {
+    {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15},  {2, 6, 3, 10, 7, 0, 4, 13, 1, 11, 12, 5, 9, 14, 15, 8},
+    {3, 4, 10, 12, 13, 2, 7, 14, 6, 5, 9, 0, 11, 15, 8, 1},  {10, 7, 12, 9, 14, 3, 13, 15, 4, 0, 11, 2, 5, 8, 1, 6},
+    {12, 13, 9, 11, 15, 10, 14, 8, 7, 2, 5, 3, 0, 1, 6, 4},  {9, 14, 11, 5, 8, 12, 15, 1, 13, 3, 0, 10, 2, 6, 4, 7},
+    {11, 15, 5, 0, 1, 9, 8, 6, 14, 10, 2, 12, 3, 4, 7, 13},
+};
+
+/* Everything needed to compress the last block of a node, either for its chaining value or as the root */
+struct output {
+    uint32_t cv[8];
+    uint8_t block[BLAKE3_BLOCK_LEN];
+    uint8_t block_len;
+    uint64_t counter;
+    uint8_t flags;
+};
+
+static enum blake3_backend active_backend = BLAKE3_BACKEND_SCALAR;
+
+static inline uint32_t
+load32_le(const uint8_t *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline void
+store32_le(uint8_t *p, uint32_t x) {
+    p[0] = (uint8_t)x;
+    p[1] = (uint8_t)(x >> 8);
+    p[2] = (uint8_t)(x >> 16);
+    p[3] = (uint8_t)(x >> 24);
+}
+
+static void
+store_cv(uint8_t *out, const uint32_t *cv) {
+    for (int i = 0; i < 8; i++) {
+        store32_le(out + 4 * i, cv[i]);
+    }
+}
+
+static void
+load_key(uint32_t *key, const uint8_t *bytes) {
+    for (int i = 0; i < 8; i++) {
+        key[i] = load32_le(bytes + 4 * i);
+    }
+}
+
+/* The quarter round, mixing two message words into a column or a diagonal of the state */
+#define G(a, b, c, d, x, y)                                                                                            \
+    do {                                                                                                               \
+        a = a + b + (x);                                                                                               \
+        d = ROTR32(d ^ a, 16);                                                                                         \
+        c = c + d;                                                                                                     \
+        b = ROTR32(b ^ c, 12);                                                                                         \
+        a = a + b + (y);                                                                                               \
+        d = ROTR32(d ^ a, 8);                                                                                          \
+        c = c + d;                                                                                                     \
+        b = ROTR32(b ^ c, 7);                                                                                          \
+    } while (0)
+
+/* Columns then diagonals, `G` is a macro of the state and message types of each kernel */
+#define ROUND(G, v, m, s)                                                                                              \
+    do {                                                                                                               \
+        G(v[0], v[4], v[8], v[12], m[(s)[0]], m[(s)[1]]);                                                              \
+        G(v[1], v[5], v[9], v[13], m[(s)[2]], m[(s)[3]]);                                                              \
+        G(v[2], v[6], v[10], v[14], m[(s)[4]], m[(s)[5]]);                                                             \
+        G(v[3], v[7], v[11], v[15], m[(s)[6]], m[(s)[7]]);                                                             \
+        G(v[0], v[5], v[10], v[15], m[(s)[8]], m[(s)[9]]);                                                             \
+        G(v[1], v[6], v[11], v[12], m[(s)[10]], m[(s)[11]]);                                                           \
+        G(v[2], v[7], v[8], v[13], m[(s)[12]], m[(s)[13]]);                                                            \
+        G(v[3], v[4], v[9], v[14], m[(s)[14]], m[(s)[15]]);                                                            \
+    } while (0)
+
+static inline void
+compress(const uint32_t cv[8], const uint8_t block[BLAKE3_BLOCK_LEN], uint8_t block_len, uint64_t counter,
+         uint8_t flags, uint32_t v[16]) {
+    uint32_t m[16];
+
+    for (int i = 0; i < 16; i++) {
+        m[i] = load32_le(block + 4 * i);
+    }
+    for (int i = 0; i < 8; i++) {
+        v[i] = cv[i];
+    }
+    v[8] = IV[0];
+    v[9] = IV[1];
+    v[10] = IV[2];
+    v[11] = IV[3];
+    v[12] = (uint32_t)counter;
+    v[13] = (uint32_t)(counter >> 32);
+    v[14] = block_len;
+    v[15] = flags;
+
+    ROUND(G, v, m, MSG_SCHEDULE[0]);
+    ROUND(G, v, m, MSG_SCHEDULE[1]);
+    ROUND(G, v, m, MSG_SCHEDULE[2]);
+    ROUND(G, v, m, MSG_SCHEDULE[3]);
+    ROUND(G, v, m, MSG_SCHEDULE[4]);
+    ROUND(G, v, m, MSG_SCHEDULE[5]);
+    ROUND(G, v, m, MSG_SCHEDULE[6]);
+}
+
+static void
+compress_in_place(uint32_t cv[8], const uint8_t block[BLAKE3_BLOCK_LEN], uint8_t block_len, uint64_t counter,
+                  uint8_t flags) {
+    uint32_t v[16];
+
+    compress(cv, block, block_len, counter, flags, v);
+    for (int i = 0; i < 8; i++) {
+        cv[i] = v[i] ^ v[i + 8];
+    }
+}
+
+/* The whole state is output when extending the root, the second half keyed with the chaining value */
+static void
+compress_xof(const uint32_t cv[8], const uint8_t block[BLAKE3_BLOCK_LEN], uint8_t block_len, uint64_t counter,
+             uint8_t flags, uint8_t out[64]) {
+    uint32_t v[16];
+
+    compress(cv, block, block_len, counter, flags, v);
+    for (int i = 0; i < 8; i++) {
+        store32_le(out + 4 * i, v[i] ^ v[i + 8]);
+        store32_le(out + 32 + 4 * i, v[i + 8] ^ cv[i]);
+    }
+}
+
+/* Hash one input of `blocks` full blocks, a whole chunk or a parent node */
+static void
+hash_one(const uint8_t *input, size_t blocks, const uint32_t key[8], uint64_t counter, uint8_t flags,
+         uint8_t flags_start, uint8_t flags_end, uint8_t out[BLAKE3_OUT_LEN]) {
+    uint32_t cv[8];
+    uint8_t block_flags = flags | flags_start;
+
+    memcpy(cv, key, sizeof cv);
+    for (; blocks; blocks--, input += BLAKE3_BLOCK_LEN) {
+        if (blocks == 1) {
+            block_flags |= flags_end;
+        }
+        compress_in_place(cv, input, BLAKE3_BLOCK_LEN, counter, block_flags);
+        block_flags = flags;
+    }
+    store_cv(out, cv);
+}
+
+#ifdef HASH_X86
+
+# include <immintrin.h>
+
+# define ROT16_128(x) _mm_shuffle_epi8(x, _mm_setr_epi8(2, 3, 0, 1, 6, 7, 4, 5, 10, 11, 8, 9, 14, 15, 12, 13))
+# define ROT8_128(x) _mm_shuffle_epi8(x, _mm_setr_epi8(1, 2, 3, 0, 5, 6, 7, 4, 9, 10, 11, 8, 13, 14, 15, 12))
+# define ROTR_128(x, n) _mm_or_si128(_mm_srli_epi32(x, n), _mm_slli_epi32(x, 32 - (n)))
+
+# define G128(a, b, c, d, x, y)                                                                                        \
+    do {                                                                                                               \
+        a = _mm_add_epi32(_mm_add_epi32(a, b), x);                                                                     \
+        d = ROT16_128(_mm_xor_si128(d, a));                                                                            \
+        c = _mm_add_epi32(c, d);                                                                                       \
+        b = ROTR_128(_mm_xor_si128(b, c), 12);                                                                         \
+        a = _mm_add_epi32(_mm_add_epi32(a, b), y);                                                                     \
+        d = ROT8_128(_mm_xor_si128(d, a));                                                                             \
+        c = _mm_add_epi32(c, d);                                                                                       \
+        b = ROTR_128(_mm_xor_si128(b, c), 7);                                                                          \
+    } while (0)
+
+# define ROT16_256(x)                                                                                                  \
+    _mm256_shuffle_epi8(x, _mm256_setr_epi8(2, 3, 0, 1, 6, 7, 4, 5, 10, 11, 8, 9, 14, 15, 12, 13, 2, 3, 0, 1, 6, 7, 4, \
+                                            5, 10, 11, 8, 9, 14, 15, 12, 13))
+# define ROT8_256(x)                                                                                                   \
+    _mm256_shuffle_epi8(x, _mm256_setr_epi8(1, 2, 3, 0, 5, 6, 7, 4, 9, 10, 11, 8, 13, 14, 15, 12, 1, 2, 3, 0, 5, 6, 7, \
+                                            4, 9, 10, 11, 8, 13, 14, 15, 12))
+# define ROTR_256(x, n) _mm256_or_si256(_mm256_srli_epi32(x, n), _mm256_slli_epi32(x, 32 - (n)))
+
+# define G256(a, b, c, d, x, y)                                                                                        \
+    do {                                                                                                               \
+        a = _mm256_add_epi32(_mm256_add_epi32(a, b), x);                                                               \
+        d = ROT16_256(_mm256_xor_si256(d, a));                                                                         \
+        c = _mm256_add_epi32(c, d);                                                                                    \
+        b = ROTR_256(_mm256_xor_si256(b, c), 12);                                                                      \
+        a = _mm256_add_epi32(_mm256_add_epi32(a, b), y);                                                               \
+        d = ROT8_256(_mm256_xor_si256(d, a));                                                                          \
+        c = _mm256_add_epi32(c, d);                                                                                    \
+        b = ROTR_256(_mm256_xor_si256(b, c), 7);                                                                       \
+    } while (0)
+
+# define G512(a, b, c, d, x, y)                                                                                        \
+    do {                                                                                                               \
+        a = _mm512_add_epi32(_mm512_add_epi32(a, b), x);                                                               \
+        d = _mm512_ror_epi32(_mm512_xor_si512(d, a), 16);                                                              \
+        c = _mm512_add_epi32(c, d);                                                                                    \
+        b = _mm512_ror_epi32(_mm512_xor_si512(b, c), 12);                                                              \
+        a = _mm512_add_epi32(_mm512_add_epi32(a, b), y);                                                               \
+        d = _mm512_ror_epi32(_mm512_xor_si512(d, a), 8);                                                               \
+        c = _mm512_add_epi32(c, d);                                                                                    \
+        b = _mm512_ror_epi32(_mm512_xor_si512(b, c), 7);                                                               \
+    } while (0)
+
+/* Counters of the lanes, consecutive chunks or all 0 for parent nodes */
+static void
+lane_counters(uint64_t counter, int increment, size_t lanes, uint32_t *low, uint32_t *high) {
+    for (size_t l = 0; l < lanes; l++) {
+        uint64_t c = counter + (increment ? l : 0);
+
+        low[l] = (uint32_t)c;
+        high[l] = (uint32_t)(c >> 32);
+    }
+}
+
+/* Rows of 4 words become columns, used both to load the message and to store the chaining values */
+__attribute__((target("sse4.1"))) static inline void
+transpose4(__m128i *x) {
+    __m128i t0 = _mm_unpacklo_epi32(x[0], x[1]);
+    __m128i t1 = _mm_unpacklo_epi32(x[2], x[3]);
+    __m128i t2 = _mm_unpackhi_epi32(x[0], x[1]);
+    __m128i t3 = _mm_unpackhi_epi32(x[2], x[3]);
+
+    x[0] = _mm_unpacklo_epi64(t0, t1);
+    x[1] = _mm_unpackhi_epi64(t0, t1);
+    x[2] = _mm_unpacklo_epi64(t2, t3);
+    x[3] = _mm_unpackhi_epi64(t2, t3);
+}
+
+__attribute__((target("sse4.1"))) static void
+hash4_sse41(const uint8_t *const *inputs, size_t blocks, const uint32_t key[8], uint64_t counter, int increment,
+            uint8_t flags, uint8_t flags_start, uint8_t flags_end, uint8_t *out) {
+    uint32_t low[4], high[4];
+    __m128i h[8], v[16], m[16];
+
+    lane_counters(counter, increment, 4, low, high);
+    for (int i = 0; i < 8; i++) {
+        h[i] = _mm_set1_epi32((int)key[i]);
+    }
+
+    for (size_t b = 0; b < blocks; b++) {
+        uint8_t block_flags = flags | (b == 0 ? flags_start : 0) | (b + 1 == blocks ? flags_end : 0);
+
+        for (int q = 0; q < 4; q++) {
+            for (int l = 0; l < 4; l++) {
+                m[4 * q + l] = _mm_loadu_si128((const __m128i *)(inputs[l] + b * BLAKE3_BLOCK_LEN + 16 * q));
+            }
+            transpose4(m + 4 * q);
+        }
+        for (int i = 0; i < 8; i++) {
+            v[i] = h[i];
+        }
+        v[8] = _mm_set1_epi32((int)IV[0]);
+        v[9] = _mm_set1_epi32((int)IV[1]);
+        v[10] = _mm_set1_epi32((int)IV[2]);
+        v[11] = _mm_set1_epi32((int)IV[3]);
+        v[12] = _mm_loadu_si128((const __m128i *)low);
+        v[13] = _mm_loadu_si128((const __m128i *)high);
+        v[14] = _mm_set1_epi32(BLAKE3_BLOCK_LEN);
+        v[15] = _mm_set1_epi32(block_flags);
+
+        ROUND(G128, v, m, MSG_SCHEDULE[0]);
+        ROUND(G128, v, m, MSG_SCHEDULE[1]);
+        ROUND(G128, v, m, MSG_SCHEDULE[2]);
+        ROUND(G128, v, m, MSG_SCHEDULE[3]);
+        ROUND(G128, v, m, MSG_SCHEDULE[4]);
+        ROUND(G128, v, m, MSG_SCHEDULE[5]);
+        ROUND(G128, v, m, MSG_SCHEDULE[6]);
+
+        for (int i = 0; i < 8; i++) {
+            h[i] = _mm_xor_si128(v[i], v[i + 8]);
+        }
+    }
+
+    transpose4(h);
+    transpose4(h + 4);
+    for (int l = 0; l < 4; l++) {
+        _mm_storeu_si128((__m128i *)(out + 32 * l), h[l]);
+        _mm_storeu_si128((__m128i *)(out + 32 * l + 16), h[l + 4]);
+    }
+}
+
+/* The 8x8 transpose of src/sha_mb.c, three rounds of shuffles */
+__attribute__((target("avx2"))) static inline void
+transpose8(__m256i *x) {
+    __m256i t[8], u[8];
+
+    for (int l = 0; l < 8; l += 2) {
+        t[l] = _mm256_unpacklo_epi32(x[l], x[l + 1]);
+        t[l + 1] = _mm256_unpackhi_epi32(x[l], x[l + 1]);
+    }
+    for (int l = 0; l < 8; l += 4) {
+        u[l] = _mm256_unpacklo_epi64(t[l], t[l + 2]);
+        u[l + 1] = _mm256_unpackhi_epi64(t[l], t[l + 2]);
+        u[l + 2] = _mm256_unpacklo_epi64(t[l + 1], t[l + 3]);
+        u[l + 3] = _mm256_unpackhi_epi64(t[l + 1], t[l + 3]);
+    }
+    for (int j = 0; j < 4; j++) {
+        x[j] = _mm256_permute2x128_si256(u[j], u[j + 4], 0x20);
+        x[j + 4] = _mm256_permute2x128_si256(u[j], u[j + 4], 0x31);
+    }
+}
+
+__attribute__((target("avx2"))) static void
+hash8_avx2(const uint8_t *const *inputs, size_t blocks, const uint32_t key[8], uint64_t counter, int increment,
+           uint8_t flags, uint8_t flags_start, uint8_t flags_end, uint8_t *out) {
+    uint32_t low[8], high[8];
+    __m256i h[8], v[16], m[16];
+
+    lane_counters(counter, increment, 8, low, high);
+    for (int i = 0; i < 8; i++) {
+        h[i] = _mm256_set1_epi32((int)key[i]);
+    }
+
+    for (size_t b = 0; b < blocks; b++) {
+        uint8_t block_flags = flags | (b == 0 ? flags_start : 0) | (b + 1 == blocks ? flags_end : 0);
+
+        for (int l = 0; l < 8; l++) {
+            m[l] = _mm256_loadu_si256((const __m256i *)(inputs[l] + b * BLAKE3_BLOCK_LEN));
+            m[l + 8] = _mm256_loadu_si256((const __m256i *)(inputs[l] + b * BLAKE3_BLOCK_LEN + 32));
+        }
+        transpose8(m);
+        transpose8(m + 8);
+        for (int i = 0; i < 8; i++) {
+            v[i] = h[i];
+        }
+        v[8] = _mm256_set1_epi32((int)IV[0]);
+        v[9] = _mm256_set1_epi32((int)IV[1]);
+        v[10] = _mm256_set1_epi32((int)IV[2]);
+        v[11] = _mm256_set1_epi32((int)IV[3]);
+        v[12] = _mm256_loadu_si256((const __m256i *)low);
+        v[13] = _mm256_loadu_si256((const __m256i *)high);
+        v[14] = _mm256_set1_epi32(BLAKE3_BLOCK_LEN);
+        v[15] = _mm256_set1_epi32(block_flags);
+
+        ROUND(G256, v, m, MSG_SCHEDULE[0]);
+        ROUND(G256, v, m, MSG_SCHEDULE[1]);
+        ROUND(G256, v, m, MSG_SCHEDULE[2]);
+        ROUND(G256, v, m, MSG_SCHEDULE[3]);
+        ROUND(G256, v, m, MSG_SCHEDULE[4]);
+        ROUND(G256, v, m, MSG_SCHEDULE[5]);
+        ROUND(G256, v, m, MSG_SCHEDULE[6]);
+
+        for (int i = 0; i < 8; i++) {
+            h[i] = _mm256_xor_si256(v[i], v[i + 8]);
+        }
+    }
+
+    transpose8(h);
+    for (int l = 0; l < 8; l++) {
+        _mm256_storeu_si256((__m256i *)(out + 32 * l), h[l]);
+    }
+}
+
+/* The 16x16 transpose of src/sha_mb.c */
+__attribute__((target("avx512f"))) static inline void
+transpose16(__m512i *x) {
+    __m512i t[16], u[16];
+
+    for (int l = 0; l < 16; l += 2) {
+        t[l] = _mm512_unpacklo_epi32(x[l], x[l + 1]);
+        t[l + 1] = _mm512_unpackhi_epi32(x[l], x[l + 1]);
+    }
+    for (int l = 0; l < 16; l += 4) {
+        u[l] = _mm512_unpacklo_epi64(t[l], t[l + 2]);
+        u[l + 1] = _mm512_unpackhi_epi64(t[l], t[l + 2]);
+        u[l + 2] = _mm512_unpacklo_epi64(t[l + 1], t[l + 3]);
+        u[l + 3] = _mm512_unpackhi_epi64(t[l + 1], t[l + 3]);
+    }
+    for (int j = 0; j < 4; j++) {
+        __m512i v0 = _mm512_shuffle_i32x4(u[j], u[j + 4], 0x44);
+        __m512i v1 = _mm512_shuffle_i32x4(u[j], u[j + 4], 0xee);
+        __m512i v2 = _mm512_shuffle_i32x4(u[j + 8], u[j + 12], 0x44);
+        __m512i v3 = _mm512_shuffle_i32x4(u[j + 8], u[j + 12], 0xee);
+
+        x[j] = _mm512_shuffle_i32x4(v0, v2, 0x88);
+        x[j + 4] = _mm512_shuffle_i32x4(v0, v2, 0xdd);
+        x[j + 8] = _mm512_shuffle_i32x4(v1, v3, 0x88);
+        x[j + 12] = _mm512_shuffle_i32x4(v1, v3, 0xdd);
+    }
+}
+
+__attribute__((target("avx512f"))) static void
+hash16_avx512(const uint8_t *const *inputs, size_t blocks, const uint32_t key[8], uint64_t counter, int increment,
+              uint8_t flags, uint8_t flags_start, uint8_t flags_end, uint8_t *out) {
+    uint32_t low[16], high[16];
+    __m512i h[16], v[16], m[16];
+
+    lane_counters(counter, increment, 16, low, high);
+    for (int i = 0; i < 8; i++) {
+        h[i] = _mm512_set1_epi32((int)key[i]);
+    }
+
+    for (size_t b = 0; b < blocks; b++) {
+        uint8_t block_flags = flags | (b == 0 ? flags_start : 0) | (b + 1 == blocks ? flags_end : 0);
+
+        for (int l = 0; l < 16; l++) {
+            m[l] = _mm512_loadu_si512(inputs[l] + b * BLAKE3_BLOCK_LEN);
+        }
+        transpose16(m);
+        for (int i = 0; i < 8; i++) {
+            v[i] = h[i];
+        }
+        v[8] = _mm512_set1_epi32((int)IV[0]);
+        v[9] = _mm512_set1_epi32((int)IV[1]);
+        v[10] = _mm512_set1_epi32((int)IV[2]);
+        v[11] = _mm512_set1_epi32((int)IV[3]);
+        v[12] = _mm512_loadu_si512(low);
+        v[13] = _mm512_loadu_si512(high);
+        v[14] = _mm512_set1_epi32(BLAKE3_BLOCK_LEN);
+        v[15] = _mm512_set1_epi32(block_flags);
+
+        ROUND(G512, v, m, MSG_SCHEDULE[0]);
+        ROUND(G512, v, m, MSG_SCHEDULE[1]);
+        ROUND(G512, v, m, MSG_SCHEDULE[2]);
+        ROUND(G512, v, m, MSG_SCHEDULE[3]);
+        ROUND(G512, v, m, MSG_SCHEDULE[4]);
+        ROUND(G512, v, m, MSG_SCHEDULE[5]);
+        ROUND(G512, v, m, MSG_SCHEDULE[6]);
+
+        for (int i = 0; i < 8; i++) {
+            h[i] = _mm512_xor_si512(v[i], v[i + 8]);
+        }
+    }
+
+    /* Only the first 8 words of each row are the chaining value of a lane */
+    for (int i = 8; i < 16; i++) {
+        h[i] = _mm512_setzero_si512();
+    }
+    transpose16(h);
+    for (int l = 0; l < 16; l++) {
+        _mm256_storeu_si256((__m256i *)(out + 32 * l), _mm512_castsi512_si256(h[l]));
+    }
+}
+
+#endif /* HASH_X86 */
+
+/* Number of inputs the widest kernel of the backend hashes at once */
+static size_t
+simd_degree(void) {
+    switch (active_backend) {
+        case BLAKE3_BACKEND_AVX512:
+            return 16;
+        case BLAKE3_BACKEND_AVX2:
+            return 8;
+        case BLAKE3_BACKEND_SSE41:
+            return 4;
+        default:
+            return 1;
+    }
+}
+
+/*
+    Hash `num_inputs` inputs of `blocks` blocks each into consecutive chaining values,
+    with the widest kernel first and the narrower ones on what is left.
+*/
+static void
+hash_many(const uint8_t *const *inputs, size_t num_inputs, size_t blocks, const uint32_t key[8], uint64_t counter,
+          int increment, uint8_t flags, uint8_t flags_start, uint8_t flags_end, uint8_t *out) {
+#ifdef HASH_X86
+    if (active_backend >= BLAKE3_BACKEND_AVX512) {
+        for (; num_inputs >= 16; inputs += 16, num_inputs -= 16, out += 16 * BLAKE3_OUT_LEN) {
+            hash16_avx512(inputs, blocks, key, counter, increment, flags, flags_start, flags_end, out);
+            counter += increment ? 16 : 0;
+        }
+    }
+    if (active_backend >= BLAKE3_BACKEND_AVX2) {
+        for (; num_inputs >= 8; inputs += 8, num_inputs -= 8, out += 8 * BLAKE3_OUT_LEN) {
+            hash8_avx2(inputs, blocks, key, counter, increment, flags, flags_start, flags_end, out);
+            counter += increment ? 8 : 0;
+        }
+    }
+    if (active_backend >= BLAKE3_BACKEND_SSE41) {
+        for (; num_inputs >= 4; inputs += 4, num_inputs -= 4, out += 4 * BLAKE3_OUT_LEN) {
+            hash4_sse41(inputs, blocks, key, counter, increment, flags, flags_start, flags_end, out);
+            counter += increment ? 4 : 0;
+        }
+    }
+#endif
+    for (; num_inputs; inputs++, num_inputs--, out += BLAKE3_OUT_LEN) {
+        hash_one(*inputs, blocks, key, counter, flags, flags_start, flags_end, out);
+        counter += increment ? 1 : 0;
+    }
+}
+
+static void
+chunk_init(struct blake3_chunk *chunk, const uint32_t key[8], uint64_t counter, uint8_t flags) {
+    memcpy(chunk->cv, key, sizeof chunk->cv);
+    chunk->counter = counter;
+    memset(chunk->block, 0, sizeof chunk->block);
+    chunk->block_len = 0;
+    chunk->blocks_compressed = 0;
+    chunk->flags = flags;
+}
+
+static size_t
+chunk_len(const struct blake3_chunk *chunk) {
+    return BLAKE3_BLOCK_LEN * (size_t)chunk->blocks_compressed + chunk->block_len;
+}
+
+static uint8_t
+chunk_start_flag(const struct blake3_chunk *chunk) {
+    return chunk->blocks_compressed ? 0 : CHUNK_START;
+}
+
+/* The last block is always kept, it may end the chunk and then takes another flag */
+static void
+chunk_update(struct blake3_chunk *chunk, const uint8_t *data, size_t len) {
+    if (chunk->block_len) {
+        size_t take = (size_t)BLAKE3_BLOCK_LEN - chunk->block_len;
+
+        take = take < len ? take : len;
+
+        memcpy(chunk->block + chunk->block_len, data, take);
+        chunk->block_len += (uint8_t)take;
+        data += take;
+        len -= take;
+        if (!len) {
+            return;
+        }
+        compress_in_place(chunk->cv, chunk->block, BLAKE3_BLOCK_LEN, chunk->counter,
+                          chunk->flags | chunk_start_flag(chunk));
+        chunk->blocks_compressed++;
+        chunk->block_len = 0;
+        memset(chunk->block, 0, sizeof chunk->block);
+    }
+
+    for (; len > BLAKE3_BLOCK_LEN; data += BLAKE3_BLOCK_LEN, len -= BLAKE3_BLOCK_LEN) {
+        compress_in_place(chunk->cv, data, BLAKE3_BLOCK_LEN, chunk->counter, chunk->flags | chunk_start_flag(chunk));
+        chunk->blocks_compressed++;
+    }
+
+    memcpy(chunk->block, data, len);
+    chunk->block_len = (uint8_t)len;
+}
+
+static struct output
+chunk_output(const struct blake3_chunk *chunk) {
+    struct output output;
+
+    memcpy(output.cv, chunk->cv, sizeof output.cv);
+    memcpy(output.block, chunk->block, sizeof output.block);
+    output.block_len = chunk->block_len;
+    output.counter = chunk->counter;
+    output.flags = chunk->flags | chunk_start_flag(chunk) | CHUNK_END;
+    return output;
+}
+
+static struct output
+parent_output(const uint8_t block[BLAKE3_BLOCK_LEN], const uint32_t key[8], uint8_t flags) {
+    struct output output;
+
+    memcpy(output.cv, key, sizeof output.cv);
+    memcpy(output.block, block, sizeof output.block);
+    output.block_len = BLAKE3_BLOCK_LEN;
+    output.counter = 0;
+    output.flags = flags | PARENT;
+    return output;
+}
+
+static void
+output_cv(const struct output *output, uint8_t cv[BLAKE3_OUT_LEN]) {
+    uint32_t words[8];
+
+    memcpy(words, output->cv, sizeof words);
+    compress_in_place(words, output->block, output->block_len, output->counter, output->flags);
+    store_cv(cv, words);
+}
+
+/* Bytes `seek` to `seek + len` of the output of the root, the counter is the index of each 64-byte block */
+static void
+output_root(const struct output *output, uint64_t seek, uint8_t *out, size_t len) {
+    uint64_t counter = seek / 64;
+    size_t offset = (size_t)(seek % 64);
+    uint8_t block[64];
+
+    while (len) {
+        size_t take = 64 - offset < len ? 64 - offset : len;
+
+        compress_xof(output->cv, output->block, output->block_len, counter++, output->flags | ROOT, block);
+        memcpy(out, block + offset, take);
+        out += take;
+        len -= take;
+        offset = 0;
+    }
+}
+
+static uint64_t
+round_down_to_power_of_2(uint64_t x) {
+    return (uint64_t)1 << (63 - __builtin_clzll(x | 1));
+}
+
+/* Length of the left subtree of `len` bytes, the largest power of 2 of chunks leaving at least one byte */
+static size_t
+left_len(size_t len) {
+    size_t full_chunks = (len - 1) / BLAKE3_CHUNK_LEN;
+
+    return (size_t)round_down_to_power_of_2(full_chunks) * BLAKE3_CHUNK_LEN;
+}
+
+/* Chaining values of the chunks of `data`, the last one may be partial */
+static size_t
+compress_chunks(const uint8_t *data, size_t len, const uint32_t key[8], uint64_t counter, uint8_t flags,
+                uint8_t *out) {
+    const uint8_t *chunks[MAX_SIMD_DEGREE];
+    size_t num_chunks = 0;
+
+    for (; len >= BLAKE3_CHUNK_LEN; data += BLAKE3_CHUNK_LEN, len -= BLAKE3_CHUNK_LEN) {
+        chunks[num_chunks++] = data;
+    }
+    hash_many(chunks, num_chunks, BLAKE3_CHUNK_LEN / BLAKE3_BLOCK_LEN, key, counter, 1, flags, CHUNK_START, CHUNK_END,
+              out);
+    if (!len) {
+        return num_chunks;
+    }
+
+    struct blake3_chunk chunk;
+    struct output output;
+
+    chunk_init(&chunk, key, counter + num_chunks, flags);
+    chunk_update(&chunk, data, len);
+    output = chunk_output(&chunk);
+    output_cv(&output, out + num_chunks * BLAKE3_OUT_LEN);
+    return num_chunks + 1;
+}
+
+/* Merge pairs of chaining values into their parents, an odd one out is carried up as it is */
+static size_t
+compress_parents(const uint8_t *cvs, size_t num_cvs, const uint32_t key[8], uint8_t flags, uint8_t *out) {
+    const uint8_t *parents[MAX_SIMD_DEGREE];
+    size_t num_parents = 0;
+
+    for (; num_cvs - 2 * num_parents >= 2; num_parents++) {
+        parents[num_parents] = cvs + 2 * num_parents * BLAKE3_OUT_LEN;
+    }
+    hash_many(parents, num_parents, 1, key, 0, 0, flags | PARENT, 0, 0, out);
+    if (num_cvs > 2 * num_parents) {
+        memcpy(out + num_parents * BLAKE3_OUT_LEN, cvs + 2 * num_parents * BLAKE3_OUT_LEN, BLAKE3_OUT_LEN);
+        return num_parents + 1;
+    }
+    return num_parents;
+}
+
+/*
+    Reduce a subtree to as many chaining values as the kernels take at once, so that each
+    level of the tree is compressed by full SIMD lanes. The recursion stops at subtrees of
+    `simd_degree` chunks, which are hashed by a single call of the widest kernel.
+*/
+static size_t
+compress_subtree_wide(const uint8_t *data, size_t len, const uint32_t key[8], uint64_t counter, uint8_t flags,
+                      uint8_t *out) {
+    size_t degree = simd_degree();
+
+    if (len <= degree * BLAKE3_CHUNK_LEN) {
+        return compress_chunks(data, len, key, counter, flags, out);
+    }
+
+    uint8_t cvs[2 * (MAX_SIMD_DEGREE > 2 ? MAX_SIMD_DEGREE : 2) * BLAKE3_OUT_LEN];
+    size_t left = left_len(len), num_left, num_right;
+
+    /* With one lane the left half still returns two chaining values */
+    if (left > BLAKE3_CHUNK_LEN && degree == 1) {
+        degree = 2;
+    }
+    num_left = compress_subtree_wide(data, left, key, counter, flags, cvs);
+    num_right = compress_subtree_wide(data + left, len - left, key, counter + left / BLAKE3_CHUNK_LEN, flags,
+                                      cvs + degree * BLAKE3_OUT_LEN);
+
+    /* Only with one lane, the two halves are then the children of the root of this subtree */
+    if (num_left == 1) {
+        memcpy(out, cvs, 2 * BLAKE3_OUT_LEN);
+        return 2;
+    }
+    return compress_parents(cvs, num_left + num_right, key, flags, out);
+}
+
+/* The two children of the root of a subtree of at least two chunks, the root itself may be that of the message */
+static void
+compress_subtree_to_parent(const uint8_t *data, size_t len, const uint32_t key[8], uint64_t counter, uint8_t flags,
+                           uint8_t out[2 * BLAKE3_OUT_LEN]) {
+    uint8_t cvs[MAX_SIMD_DEGREE * BLAKE3_OUT_LEN], parents[MAX_SIMD_DEGREE / 2 * BLAKE3_OUT_LEN];
+    size_t num_cvs = compress_subtree_wide(data, len, key, counter, flags, cvs);
+
+    while (num_cvs > 2) {
+        num_cvs = compress_parents(cvs, num_cvs, key, flags, parents);
+        memcpy(cvs, parents, num_cvs * BLAKE3_OUT_LEN);
+    }
+    memcpy(out, cvs, 2 * BLAKE3_OUT_LEN);
+}
+
+/* Equal pieces of a subtree, hashed to the chaining values of their roots by the worker pool */
+struct pieces {
+    const uint8_t *data;
+    size_t piece_len;
+    const uint32_t *key;
+    uint64_t counter;  /* Of the first chunk of the subtree */
+    uint8_t flags;
+    uint8_t *cvs;
+};
+
+static void
+piece_task(void *arg, size_t index) {
+    struct pieces *pieces = arg;
+    uint8_t children[2 * BLAKE3_OUT_LEN];
+    struct output output;
+
+    compress_subtree_to_parent(pieces->data + index * pieces->piece_len, pieces->piece_len, pieces->key,
+                               pieces->counter + index * (pieces->piece_len / BLAKE3_CHUNK_LEN), pieces->flags,
+                               children);
+    output = parent_output(children, pieces->key, pieces->flags);
+    output_cv(&output, pieces->cvs + index * BLAKE3_OUT_LEN);
+}
+
+/* As `compress_subtree_to_parent` for a subtree of a power of 2 chunks, at least 2 pieces long */
+static void
+compress_subtree_parallel(const uint8_t *data, size_t len, const uint32_t key[8], uint64_t counter, uint8_t flags,
+                          unsigned num_threads, uint8_t out[2 * BLAKE3_OUT_LEN]) {
+    uint8_t cvs[MAX_PIECES * BLAKE3_OUT_LEN];
+    const uint8_t *parents[MAX_PIECES / 2];
+    struct pieces pieces = {data, PIECE_LEN, key, counter, flags, cvs};
+    size_t num_pieces;
+
+    while (len / pieces.piece_len > MAX_PIECES) {
+        pieces.piece_len *= 2;
+    }
+    num_pieces = len / pieces.piece_len;
+
+    if (hash_pool_run(num_pieces, 1, num_threads, piece_task, &pieces)) {
+        for (size_t i = 0; i < num_pieces; i++) {
+            piece_task(&pieces, i);
+        }
+    }
+
+    /* Every level has an even number of nodes, a power of 2, and is merged in place from the left */
+    for (; num_pieces > 2; num_pieces /= 2) {
+        for (size_t i = 0; i < num_pieces / 2; i++) {
+            parents[i] = cvs + 2 * i * BLAKE3_OUT_LEN;
+        }
+        hash_many(parents, num_pieces / 2, 1, key, 0, 0, flags | PARENT, 0, 0, cvs);
+    }
+    memcpy(out, cvs, 2 * BLAKE3_OUT_LEN);
+}
+
+/* Merge the subtrees on the stack that are complete before chunk `total_chunks`, keeping the last one unmerged */
+static void
+merge_cv_stack(struct blake3_ctx *ctx, uint64_t total_chunks) {
+    size_t post_merge_len = (size_t)__builtin_popcountll(total_chunks);
+
+    while (ctx->cv_stack_len > post_merge_len) {
+        uint8_t *children = ctx->cv_stack + (ctx->cv_stack_len - 2) * BLAKE3_OUT_LEN;
+        struct output output = parent_output(children, ctx->key, ctx->chunk.flags);
+
+        output_cv(&output, children);
+        ctx->cv_stack_len--;
+    }
+}
+
+static void
+push_cv(struct blake3_ctx *ctx, const uint8_t cv[BLAKE3_OUT_LEN], uint64_t chunk_counter) {
+    merge_cv_stack(ctx, chunk_counter);
+    memcpy(ctx->cv_stack + ctx->cv_stack_len * BLAKE3_OUT_LEN, cv, BLAKE3_OUT_LEN);
+    ctx->cv_stack_len++;
+}
+
+static void
+ctx_init(struct blake3_ctx *ctx, const uint32_t key[8], uint8_t flags) {
+    memcpy(ctx->key, key, sizeof ctx->key);
+    chunk_init(&ctx->chunk, key, 0, flags);
+    ctx->cv_stack_len = 0;
+}
+
+/*
+    Finish the current chunk, then take the largest subtrees that the chunk count so far
+    allows, keeping the last chunk in the context since it may turn out to be the root.
+*/
+static void
+update(struct blake3_ctx *ctx, const uint8_t *data, size_t len, unsigned num_threads) {
+    if (chunk_len(&ctx->chunk)) {
+        size_t take = BLAKE3_CHUNK_LEN - chunk_len(&ctx->chunk) < len ? BLAKE3_CHUNK_LEN - chunk_len(&ctx->chunk) : len;
+        uint8_t cv[BLAKE3_OUT_LEN];
+        struct output output;
+
+        chunk_update(&ctx->chunk, data, take);
+        data += take;
+        len -= take;
+        if (!len) {
+            return;
+        }
+        output = chunk_output(&ctx->chunk);
+        output_cv(&output, cv);
+        push_cv(ctx, cv, ctx->chunk.counter);
+        chunk_init(&ctx->chunk, ctx->key, ctx->chunk.counter + 1, ctx->chunk.flags);
+    }
+
+    while (len > BLAKE3_CHUNK_LEN) {
+        uint64_t subtree_len = round_down_to_power_of_2(len);
+        uint64_t bytes_so_far = ctx->chunk.counter * BLAKE3_CHUNK_LEN;
+
+        while ((subtree_len - 1) & bytes_so_far) {
+            subtree_len /= 2;
+        }
+
+        if (subtree_len <= BLAKE3_CHUNK_LEN) {
+            struct blake3_chunk chunk;
+            uint8_t cv[BLAKE3_OUT_LEN];
+            struct output output;
+
+            chunk_init(&chunk, ctx->key, ctx->chunk.counter, ctx->chunk.flags);
+            chunk_update(&chunk, data, (size_t)subtree_len);
+            output = chunk_output(&chunk);
+            output_cv(&output, cv);
+            push_cv(ctx, cv, chunk.counter);
+        } else {
+            uint8_t children[2 * BLAKE3_OUT_LEN];
+
+            if (num_threads != 1 && subtree_len >= 2 * PIECE_LEN) {
+                compress_subtree_parallel(data, (size_t)subtree_len, ctx->key, ctx->chunk.counter, ctx->chunk.flags,
+                                          num_threads, children);
+            } else {
+                compress_subtree_to_parent(data, (size_t)subtree_len, ctx->key, ctx->chunk.counter, ctx->chunk.flags,
+                                           children);
+            }
+            push_cv(ctx, children, ctx->chunk.counter);
+            push_cv(ctx, children + BLAKE3_OUT_LEN, ctx->chunk.counter + subtree_len / BLAKE3_CHUNK_LEN / 2);
+        }
+        ctx->chunk.counter += subtree_len / BLAKE3_CHUNK_LEN;
+        data += subtree_len;
+        len -= (size_t)subtree_len;
+    }
+
+    if (len) {
+        chunk_update(&ctx->chunk, data, len);
+        merge_cv_stack(ctx, ctx->chunk.counter);
+    }
+}
+
+/**
+   Initialize :c:var:`ctx` to compute a BLAKE3 hash incrementally with
+   :c:func:`blake3_update` and :c:func:`blake3_final`.
+
+   :param ctx: The context to initialize.
+   :type ctx: struct blake3_ctx *
+*/
+void
+blake3_init(struct blake3_ctx *ctx) {
+    ctx_init(ctx, IV, 0);
+}
+
+/**
+   Initialize :c:var:`ctx` for the keyed mode of BLAKE3, a MAC and PRF.
+
+   :param ctx: The context to initialize.
+   :type ctx: struct blake3_ctx *
+   :param key: The secret key, ``BLAKE3_KEY_LEN`` bytes.
+   :type key: const void *
+*/
+void
+blake3_init_keyed(struct blake3_ctx *ctx, const void *key) {
+    uint32_t words[8];
+
+    load_key(words, key);
+    ctx_init(ctx, words, KEYED_HASH);
+}
+
+/**
+   Initialize :c:var:`ctx` to derive keys from the key material passed to
+   :c:func:`blake3_update`.
+
+   The context string should be hardcoded, globally unique and application-specific,
+   e.g. ``"example.com 2024-01-01 session tokens v1"``, so that the keys of different
+   uses are independent even when they are derived from the same material.
+
+   :param ctx: The context to initialize.
+   :type ctx: struct blake3_ctx *
+   :param context: The context string.
+   :type context: const void *
+   :param context_len: Length of :c:var:`context` in bytes.
+   :type context_len: size_t
+*/
+void
+blake3_init_derive_key(struct blake3_ctx *ctx, const void *context, size_t context_len) {
+    struct blake3_ctx context_ctx;
+    uint8_t context_key[BLAKE3_KEY_LEN];
+    uint32_t words[8];
+
+    ctx_init(&context_ctx, IV, DERIVE_KEY_CONTEXT);
+    update(&context_ctx, context, context_len, 1);
+    blake3_final(&context_ctx, context_key, sizeof context_key);
+    load_key(words, context_key);
+    ctx_init(ctx, words, DERIVE_KEY_MATERIAL);
+}
+
+/**
+   Feed the next chunk of the message into :c:var:`ctx`.
+
+   Runs of whole chunks are hashed as subtrees by the SIMD kernels, so large updates
+   are much faster than small ones.
+
+   :param ctx: A context set up by one of the ``blake3_init`` functions.
+   :type ctx: struct blake3_ctx *
+   :param data: The next chunk of the message.
+   :type data: const void *
+   :param len: Length of :c:var:`data` in bytes.
+   :type len: size_t
+*/
+void
+blake3_update(struct blake3_ctx *ctx, const void *data, size_t len) {
+    update(ctx, data, len, 1);
+}
+
+/**
+   Feed the next chunk of the message into :c:var:`ctx`, hashing large subtrees across
+   a pool of threads.
+
+   The hash is the same as with :c:func:`blake3_update`. Subtrees of at least 128 KiB
+   are split into pieces hashed by different threads, so this pays off from a few
+   hundred KiB.
+
+   :param ctx: A context set up by one of the ``blake3_init`` functions.
+   :type ctx: struct blake3_ctx *
+   :param data: The next chunk of the message.
+   :type data: const void *
+   :param len: Length of :c:var:`data` in bytes.
+   :type len: size_t
+   :param num_threads: Number of threads to use including the calling one, 0 uses
+                       one thread per online core.
+   :type num_threads: unsigned
+*/
+void
+blake3_update_parallel(struct blake3_ctx *ctx, const void *data, size_t len, unsigned num_threads) {
+    update(ctx, data, len, num_threads);
+}
+
+/**
+   Write :c:var:`out_len` bytes of output from :c:var:`ctx` to :c:var:`out`.
+
+   BLAKE3 is an extendable-output function, the first ``BLAKE3_OUT_LEN`` bytes are the
+   hash and any length can be read. The context is not changed, more data can still
+   be fed to it.
+
+   :param ctx: A context fed with the message.
+   :type ctx: const struct blake3_ctx *
+   :param out: Receives :c:var:`out_len` bytes of output.
+   :type out: void *
+   :param out_len: Number of bytes to write.
+   :type out_len: size_t
+*/
+void
+blake3_final(const struct blake3_ctx *ctx, void *out, size_t out_len) {
+    blake3_final_seek(ctx, 0, out, out_len);
+}
+
+/**
+   Write :c:var:`out_len` bytes of output from :c:var:`ctx`, starting at byte
+   :c:var:`seek` of the output stream.
+
+   Every 64-byte block of the output is computed on its own, so the stream can be read
+   from any offset without computing what comes before.
+
+   :param ctx: A context fed with the message.
+   :type ctx: const struct blake3_ctx *
+   :param seek: Offset in the output stream of the first byte to write.
+   :type seek: uint64_t
+   :param out: Receives :c:var:`out_len` bytes of output.
+   :type out: void *
+   :param out_len: Number of bytes to write.
+   :type out_len: size_t
+*/
+void
+blake3_final_seek(const struct blake3_ctx *ctx, uint64_t seek, void *out, size_t out_len) {
+    struct output output;
+    size_t remaining;
+
+    if (!ctx->cv_stack_len) {
+        output = chunk_output(&ctx->chunk);
+        output_root(&output, seek, out, out_len);
+        return;
+    }
+
+    /* Without a partial chunk the last two entries of the stack are the children of the root, or of its right child */
+    if (chunk_len(&ctx->chunk)) {
+        remaining = ctx->cv_stack_len;
+        output = chunk_output(&ctx->chunk);
+    } else {
+        remaining = ctx->cv_stack_len - 2;
+        output = parent_output(ctx->cv_stack + remaining * BLAKE3_OUT_LEN, ctx->key, ctx->chunk.flags);
+    }
+    while (remaining--) {
+        uint8_t children[2 * BLAKE3_OUT_LEN];
+
+        memcpy(children, ctx->cv_stack + remaining * BLAKE3_OUT_LEN, BLAKE3_OUT_LEN);
+        output_cv(&output, children + BLAKE3_OUT_LEN);
+        output = parent_output(children, ctx->key, ctx->chunk.flags);
+    }
+    output_root(&output, seek, out, out_len);
+}
+
+/**
+   Compute :c:var:`out_len` bytes of the BLAKE3 hash of :c:var:`len` bytes of :c:var:`data`.
+
+   :param data: The input message.
+   :type data: const void *
+   :param len: Length of :c:var:`data` in bytes.
+   :type len: size_t
+   :param out: Receives :c:var:`out_len` bytes of output, ``BLAKE3_OUT_LEN`` for the
+               usual 256-bit hash.
+   :type out: void *
+   :param out_len: Number of bytes to write.
+   :type out_len: size_t
+*/
+void
+blake3(const void *data, size_t len, void *out, size_t out_len) {
+    struct blake3_ctx ctx;
+
+    blake3_init(&ctx);
+    update(&ctx, data, len, 1);
+    blake3_final(&ctx, out, out_len);
+}
+
+/**
+   Compute :c:var:`out_len` bytes of the keyed BLAKE3 hash of :c:var:`len` bytes of
+   :c:var:`data`, a MAC that needs no HMAC construction.
+
+   :param key: The secret key, ``BLAKE3_KEY_LEN`` bytes.
+   :type key: const void *
+   :param data: The input message.
+   :type data: const void *
+   :param len: Length of :c:var:`data` in bytes.
+   :type len: size_t
+   :param out: Receives :c:var:`out_len` bytes of output.
+   :type out: void *
+   :param out_len: Number of bytes to write.
+   :type out_len: size_t
+*/
+void
+blake3_keyed(const void *key, const void *data, size_t len, void *out, size_t out_len) {
+    struct blake3_ctx ctx;
+
+    blake3_init_keyed(&ctx, key);
+    update(&ctx, data, len, 1);
+    blake3_final(&ctx, out, out_len);
+}
+
+/**
+   Derive :c:var:`out_len` bytes of key from :c:var:`len` bytes of key
+   :c:var:`material`, see :c:func:`blake3_init_derive_key` for the context string.
+
+   :param context: The context string.
+   :type context: const void *
+   :param context_len: Length of :c:var:`context` in bytes.
+   :type context_len: size_t
+   :param material: The input key material.
+   :type material: const void *
+   :param len: Length of :c:var:`material` in bytes.
+   :type len: size_t
+   :param out: Receives :c:var:`out_len` bytes of derived key.
+   :type out: void *
+   :param out_len: Number of bytes to write.
+   :type out_len: size_t
+*/
+void
+blake3_derive_key(const void *context, size_t context_len, const void *material, size_t len, void *out,
+                  size_t out_len) {
+    struct blake3_ctx ctx;
+
+    blake3_init_derive_key(&ctx, context, context_len);
+    update(&ctx, material, len, 1);
+    blake3_final(&ctx, out, out_len);
+}
+
+/**
+   Select the implementation used to compress many chunks at once.
+
+   The fastest backend supported by the CPU is selected when the library is loaded,
+   this is only needed to force a particular one, e.g. to compare their outputs.
+   It is not thread-safe and should be called before any hash is computed.
+
+   :param backend: ``BLAKE3_BACKEND_AUTO`` for the fastest supported backend,
+                   ``BLAKE3_BACKEND_SCALAR`` for the portable C code, or
+                   ``BLAKE3_BACKEND_SSE41``, ``BLAKE3_BACKEND_AVX2`` or
+                   ``BLAKE3_BACKEND_AVX512`` for 4, 8 or 16 chunks at once.
+   :type backend: enum blake3_backend
+   :return: 0 on success, -1 if the CPU does not support :c:var:`backend`.
+   :rtype: int
+*/
+int
+blake3_set_backend(enum blake3_backend backend) {
+    unsigned features = hash_cpu_features();
+
+    if (backend == BLAKE3_BACKEND_AUTO) {
+        if (features & CPU_AVX512F) {
+            backend = BLAKE3_BACKEND_AVX512;
+        } else if (features & CPU_AVX2) {
+            backend = BLAKE3_BACKEND_AVX2;
+        } else if (features & CPU_SSE41) {
+            backend = BLAKE3_BACKEND_SSE41;
+        } else {
+            backend = BLAKE3_BACKEND_SCALAR;
+        }
+    }
+
+    switch (backend) {
+        case BLAKE3_BACKEND_SCALAR:
+            break;
+        case BLAKE3_BACKEND_SSE41:
+            if (!(features & CPU_SSE41)) {
+                return -1;
+            }
+            break;
+        case BLAKE3_BACKEND_AVX2:
+            if (!(features & CPU_AVX2)) {
+                return -1;
+            }
+            break;
+        case BLAKE3_BACKEND_AVX512:
+            if (!(features & CPU_AVX512F)) {
+                return -1;
+            }
+            break;
+        default:
+            return -1;
+    }
+
+    active_backend = backend;
+    return 0;
+}
+
+/**
+   Get the backend currently used to compress many chunks at once.
+
+   :return: ``BLAKE3_BACKEND_SCALAR``, ``BLAKE3_BACKEND_SSE41``, ``BLAKE3_BACKEND_AVX2``
+            or ``BLAKE3_BACKEND_AVX512``.
+   :rtype: enum blake3_backend
+*/
+enum blake3_backend
+blake3_get_backend(void) {
+    return active_backend;
+}
+
+#ifdef __GNUC__
+__attribute__((constructor)) static void
+blake3_select_backend(void) {
+    blake3_set_backend(BLAKE3_BACKEND_AUTO);
+}
+#endif
@@ -0,0 +1,409 @@
+/*
+    Content-defined chunking in the manner of FastCDC (W. Xia et al., USENIX ATC 2016).
+
+    A gear hash rolls over the stream, ``hash = (hash << 1) + GEAR[byte]``, and a chunk ends
+    after a byte whose hash has the top bits of the cut mask clear. The hash is 32 bits
+    wide, so it depends on the last 32 bytes only and cut points move with the content
+    around them: an insertion changes the chunks it touches and leaves the others alone.
+    Chunks shorter than `avg_size` are cut with a mask of two more bits than the average
+    calls for and longer ones with two fewer, which keeps most chunks close to the average,
+    and no chunk is cut before `min_size` or allowed past `max_size`. Unlike the paper the
+    hash is not restarted at each cut, so it has no effect on later cut points either.
+
+    The stream is processed in segments small enough to stay in L1. The boundary search
+    marks every byte where either mask matches in two bitmaps, the AVX2 backend hashes
+    eight stripes of the segment at once for this. The chunks are then cut along the
+    bitmaps and their bytes hashed with SHA-256 while the segment is still in the cache.
+
+    ``GEAR[i]`` is the first four bytes of the SHA-256 digest of the byte ``i``.
+*/
+
+#include "chunk.h"
+
+#include "cpu.h"
+#include "encode.h"
+#include "sha.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+/* Bytes scanned before their chunks are hashed */
+#define CHUNK_SEGMENT 16384
+
+static const uint32_t GEAR[256] = {
+    0x6e340b9c, 0x4bf5122f, 0xdbc1b4c9, 0x084fed08, 0xe52d9c50, 0xe77b9a9a, 0x67586e98, 0xca358758,
+    0xbeead779, 0x2b4c342f, 0x01ba4719, 0xe7cf46a0, 0xef6cbd21, 0x9d1e0e2d, 0x4d7b3ef7, 0xdc0e9c36,
+    0xc555eab4, 0x4a64a107, 0xf299791c, 0xab897fbd, 0x83891d7f, 0x2f0fd1e8, 0x7cb7c454, 0x8f11b05d,
+    0x452ba1dd, 0x68aa2e2e, 0x58f7b078, 0x77adfc95, 0xbd4fc42a, 0x1f18d650, 0x9652595f, 0xffe679bb,
+    0x36a9e7f1, 0xbb7208bc, 0x8a331fdd, 0x334359b9, 0x09fc9608, 0xbbf3f11c, 0x951dcee3, 0x265fda17,
+    0x32ebb1ab, 0xba5ec51d, 0x684888c0, 0xa318c242, 0xd03502c4, 0x3973e022, 0xcdb4ee2a, 0x8a5edab2,
+    0x5feceb66, 0x6b86b273, 0xd4735e3a, 0x4e074085, 0x4b227777, 0xef2d127d, 0xe7f6c011, 0x7902699b,
+    0x2c624232, 0x19581e27, 0xe7ac0786, 0x41b805ea, 0xdabd3aff, 0x380918b9, 0x62b67e1f, 0x8a8de823,
+    0xc3641f85, 0x559aead0, 0xdf7e70e5, 0x6b23c0d5, 0x3f39d5c3, 0xa9f51566, 0xf67ab10a, 0x333e0a1e,
+    0x44bd7ae6, 0xa83dd0cc, 0x6da43b94, 0x86be9a55, 0x72dfcfb0, 0x08f27188, 0x8ce86a6a, 0xc4694f2e,
+    0x5c62e091, 0x4ae81572, 0x8c257489, 0x8de0b3c4, 0xe632b709, 0xa25513c7, 0xde5a6f78, 0xfcb5f40d,
+    0x4b68ab38, 0x18f5384d, 0xbbeebd87, 0x245843ab, 0xa9253dc8, 0xcfae0d42, 0x74cd9ef9, 0xd2e2adf7,
+    0x8d33f520, 0xca978112, 0x3e23e816, 0x2e7d2c03, 0x18ac3e73, 0x3f79bb7b, 0x252f10c8, 0xcd0aa985,
+    0xaaa94026, 0xde7d1b72, 0x189f4003, 0x8254c329, 0xacac86c0, 0x62c66a7a, 0x1b16b1df, 0x65c74c15,
+    0x148de9c5, 0x8e35c2cd, 0x454349e4, 0x043a7187, 0xe3b98a4d, 0x0bfe935e, 0x4c94485e, 0x50e721e4,
+    0x2d711642, 0xa1fce436, 0x594e519a, 0x021fb596, 0xcbe5cfdf, 0xd10b36aa, 0x7ace431c, 0x620bfdaa,
+    0x76be8b52, 0x591b7cc9, 0xa5ab782c, 0x5ee0dd4d, 0xaaa8e61e, 0xc00e7f88, 0x3cbdaf66, 0x4bfa260a,
+    0x4f362f90, 0xe9b0c031, 0x2d319369, 0x3ebe1b59, 0x9defb0a9, 0x075198bf, 0x949f94d8, 0x5e37305c,
+    0x9e076cea, 0x7da59d0d, 0x95606213, 0xd16bd22f, 0x67c872d4, 0x5bad0d11, 0x84873854, 0x2a0ab732,
+    0x79bec7ff, 0xfd9528b9, 0x0605d153, 0x8d36bbb3, 0x6e3faf1e, 0x9d277175, 0x35af2d15, 0x1f184f10,
+    0xc19a797f, 0x8a8950f7, 0x0a43b22d, 0x6d90fbac, 0x88aa3e3b, 0x6922e93e, 0xfe1dcd3a, 0x2dbf9365,
+    0x74e1ade3, 0x9e8e8c37, 0xbceef655, 0x087d80f7, 0xee6bb86b, 0x22adaf05, 0x19753a9b, 0x5a6e7a47,
+    0xf4f97c88, 0x149488d8, 0x9be3799f, 0x65f15821, 0x27952171, 0x892f60b3, 0xca41841c, 0x4d6a8e90,
+    0xd3bb0d59, 0x04d6c0c9, 0x281c9399, 0xcbecda1c, 0x26e5bfe4, 0x68325720, 0x47850848, 0xb12dc850,
+    0xe4ff5e7d, 0xd1bbd73b, 0xc557e713, 0xae3f4619, 0xd1211001, 0x5a0ec31d, 0x49994461, 0x3340883a,
+    0x7c5bd2d1, 0x4fb733be, 0x13598656, 0x383e5d7d, 0x1dd83126, 0x9a7b7b3a, 0xc337ded6, 0x7a4a4b50,
+    0xd4b0c0a4, 0xb5c9a5f4, 0x85f97e04, 0x28969cdf, 0x528a84ce, 0xcdce9374, 0x0a2c6ea0, 0x414a21e5,
+    0xaf193a8c, 0x19152ddf, 0x5d5c7d20, 0xb7d25296, 0xfb95aa98, 0x2795044c, 0x7941cb07, 0x2ea970ff,
+    0x7d8c5da7, 0xf031efa5, 0x30a5bfa5, 0x457e4854, 0x5e1effe9, 0xab61ba11, 0x0a3aaee7, 0xd0752b60,
+    0xe6f20750, 0xde2e331d, 0x3ad4e44a, 0xf8d20e59, 0x45f83d17, 0xf3df1f9c, 0x94455e3e, 0x4d4d75d7,
+    0xfde50285, 0xd4f09e5c, 0x966c7c47, 0x782e0202, 0x2017ff34, 0x27abdedd, 0xb0b2988b, 0x50868f20,
+    0xe596a8e5, 0xd5202253, 0xaa7225e7, 0x04b8d34e, 0x98722e2e, 0x3e151409, 0xaa687b58, 0xa8100ae6,
+};
+
+static enum chunk_backend active_backend = CHUNK_BACKEND_SCALAR;
+
+static inline void
+set_bit(uint64_t *bits, size_t i) {
+    bits[i / 64] |= (uint64_t)1 << (i % 64);
+}
+
+/* Hash `data[begin:len]` and mark where the masks match, returns the hash after the last byte */
+static uint32_t
+scan_scalar(const uint8_t *data, size_t begin, size_t len, uint32_t hash, uint32_t mask_small, uint32_t mask_large,
+            uint64_t *small, uint64_t *large) {
+    for (size_t i = begin; i < len; i++) {
+        hash = (hash << 1) + GEAR[data[i]];
+        if (!(hash & mask_large)) {
+            set_bit(large, i);
+            if (!(hash & mask_small)) {
+                set_bit(small, i);
+            }
+        }
+    }
+    return hash;
+}
+
+#ifdef HASH_X86
+
+# include <immintrin.h>
+
+__attribute__((target("avx2"))) static inline __m256i
+gear_avx2(__m256i hash, __m256i bytes) {
+    return _mm256_add_epi32(_mm256_slli_epi32(hash, 1), _mm256_i32gather_epi32((const int *)GEAR, bytes, 4));
+}
+
+__attribute__((target("avx2"))) static inline __m256i
+match_avx2(__m256i hash, __m256i mask) {
+    return _mm256_cmpeq_epi32(_mm256_and_si256(hash, mask), _mm256_setzero_si256());
+}
+
+/* Mark the bytes at `positions` whose lanes matched the large mask, and those of them matching the small one */
+__attribute__((target("avx2"))) static void
+mark_avx2(__m256i hash, __m256i positions, uint32_t mask_small, uint32_t mask_large, uint64_t *small,
+          uint64_t *large) {
+    uint32_t hashes[8], offsets[8];
+
+    _mm256_storeu_si256((__m256i *)hashes, hash);
+    _mm256_storeu_si256((__m256i *)offsets, positions);
+    for (size_t i = 0; i < 8; i++) {
+        if (!(hashes[i] & mask_large)) {
+            set_bit(large, offsets[i]);
+            if (!(hashes[i] & mask_small)) {
+                set_bit(small, offsets[i]);
+            }
+        }
+    }
+}
+
+/*
+    The segment is cut into eight stripes hashed side by side, one per lane. The hash only
+    depends on the last 32 bytes, so each lane starts by hashing the 32 bytes before its
+    stripe, except the first one which carries on from `hash`. The bytes left over after
+    the stripes are hashed by the scalar code.
+*/
+__attribute__((target("avx2"))) static uint32_t
+scan_avx2(const uint8_t *data, size_t len, uint32_t hash, uint32_t mask_small, uint32_t mask_large, uint64_t *small,
+          uint64_t *large) {
+    const size_t stripe = len / 8 & ~(size_t)3;
+    const __m256i low_byte = _mm256_set1_epi32(0xff);
+    const __m256i large_mask = _mm256_set1_epi32((int)mask_large);
+    __m256i starts, h = _mm256_setzero_si256();
+
+    if (stripe < 32) {
+        return scan_scalar(data, 0, len, hash, mask_small, mask_large, small, large);
+    }
+    starts = _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32((int)stripe));
+
+    __m256i warm_up = _mm256_max_epi32(_mm256_sub_epi32(starts, _mm256_set1_epi32(32)), _mm256_setzero_si256());
+    for (int j = 0; j < 32; j += 4) {
+        __m256i bytes = _mm256_i32gather_epi32((const int *)data, _mm256_add_epi32(warm_up, _mm256_set1_epi32(j)), 1);
+        h = gear_avx2(h, _mm256_and_si256(bytes, low_byte));
+        h = gear_avx2(h, _mm256_and_si256(_mm256_srli_epi32(bytes, 8), low_byte));
+        h = gear_avx2(h, _mm256_and_si256(_mm256_srli_epi32(bytes, 16), low_byte));
+        h = gear_avx2(h, _mm256_srli_epi32(bytes, 24));
+    }
+    h = _mm256_blend_epi32(h, _mm256_set1_epi32((int)hash), 1);
+
+    for (size_t j = 0; j < stripe; j += 4) {
+        __m256i positions = _mm256_add_epi32(starts, _mm256_set1_epi32((int)j));
+        __m256i bytes = _mm256_i32gather_epi32((const int *)data, positions, 1);
+        __m256i h0 = gear_avx2(h, _mm256_and_si256(bytes, low_byte));
+        __m256i h1 = gear_avx2(h0, _mm256_and_si256(_mm256_srli_epi32(bytes, 8), low_byte));
+        __m256i h2 = gear_avx2(h1, _mm256_and_si256(_mm256_srli_epi32(bytes, 16), low_byte));
+        h = gear_avx2(h2, _mm256_srli_epi32(bytes, 24));
+
+        __m256i matches = _mm256_or_si256(_mm256_or_si256(match_avx2(h0, large_mask), match_avx2(h1, large_mask)),
+                                          _mm256_or_si256(match_avx2(h2, large_mask), match_avx2(h, large_mask)));
+        if (!_mm256_testz_si256(matches, matches)) {
+            const __m256i one = _mm256_set1_epi32(1);
+            mark_avx2(h0, positions, mask_small, mask_large, small, large);
+            positions = _mm256_add_epi32(positions, one);
+            mark_avx2(h1, positions, mask_small, mask_large, small, large);
+            positions = _mm256_add_epi32(positions, one);
+            mark_avx2(h2, positions, mask_small, mask_large, small, large);
+            positions = _mm256_add_epi32(positions, one);
+            mark_avx2(h, positions, mask_small, mask_large, small, large);
+        }
+    }
+
+    hash = (uint32_t)_mm256_extract_epi32(h, 7);
+    return scan_scalar(data, 8 * stripe, len, hash, mask_small, mask_large, small, large);
+}
+
+#endif
+
+static uint32_t
+scan(const uint8_t *data, size_t len, uint32_t hash, uint32_t mask_small, uint32_t mask_large, uint64_t *small,
+     uint64_t *large) {
+    switch (active_backend) {
+#ifdef HASH_X86
+        case CHUNK_BACKEND_AVX2:
+            return scan_avx2(data, len, hash, mask_small, mask_large, small, large);
+#endif
+        default:
+            return scan_scalar(data, 0, len, hash, mask_small, mask_large, small, large);
+    }
+}
+
+/* First bit set in `bits[begin:end]`, `end` if there is none */
+static size_t
+find_bit(const uint64_t *bits, size_t begin, size_t end) {
+    while (begin < end) {
+        uint64_t word = bits[begin / 64] >> (begin % 64);
+
+        if (word) {
+            begin += __builtin_ctzll(word);
+            return begin < end ? begin : end;
+        }
+        begin = (begin / 64 + 1) * 64;
+    }
+    return end;
+}
+
+/* Bytes to go from a chunk of `len` bytes until the byte that makes it `size` bytes long */
+static inline size_t
+until(size_t size, size_t len) {
+    return size > len + 1 ? size - len - 1 : 0;
+}
+
+/*
+    Segment offset of the byte ending the current chunk, which is `pos` bytes into the
+    segment, or an offset of `segment` or more if the chunk goes on past the segment.
+*/
+static size_t
+cut_point(const struct chunker *chunker, const uint64_t *small, const uint64_t *large, size_t pos, size_t segment) {
+    size_t first = pos + until(chunker->min_size, chunker->len);
+    size_t average = pos + until(chunker->avg_size, chunker->len);
+    size_t last = pos + until(chunker->max_size, chunker->len);
+    size_t end = average < segment ? average : segment;
+    size_t cut = find_bit(small, first, end);
+
+    if (cut < end) {
+        return cut;
+    }
+    end = last < segment ? last : segment;
+    cut = find_bit(large, average, end);
+    return cut < end ? cut : last;
+}
+
+static void
+emit(struct chunker *chunker, chunk_callback callback, void *arg) {
+    struct chunk chunk = {chunker->offset, chunker->len, {0}};
+    uint32_t hash[8];
+
+    sha2_256_final(&chunker->ctx, hash);
+    hash_digest_bytes(HASH_SHA2_256, hash, chunk.digest);
+    callback(&chunk, arg);
+
+    chunker->offset += chunker->len;
+    chunker->len = 0;
+    sha2_256_init(&chunker->ctx);
+}
+
+/**
+   Start cutting a stream into chunks. Cut points depend on the content, so data inserted
+   into or removed from a stream only changes the chunks around the edit.
+
+   :param chunker: The chunker to initialize.
+   :type chunker: struct chunker *
+   :param min_size: Smallest chunk in bytes, at least ``CHUNK_MIN_SIZE``. Only the last
+                    chunk of a stream can be shorter.
+   :type min_size: size_t
+   :param avg_size: Size chunks are cut around, a power of 2 no larger than
+                    ``CHUNK_MAX_AVG_SIZE``. A minimum of a quarter and a maximum of four
+                    times the average are typical.
+   :type avg_size: size_t
+   :param max_size: Largest chunk in bytes, chunks are cut at this size when the content
+                    has no cut point.
+   :type max_size: size_t
+   :return: 0 on success, -1 if the sizes are out of order or out of range.
+   :rtype: int
+*/
+int
+chunker_init(struct chunker *chunker, size_t min_size, size_t avg_size, size_t max_size) {
+    unsigned bits = 0;
+
+    if (min_size < CHUNK_MIN_SIZE || min_size > avg_size || avg_size > max_size || avg_size > CHUNK_MAX_AVG_SIZE ||
+        (avg_size & (avg_size - 1))) {
+        return -1;
+    }
+    while ((size_t)1 << bits < avg_size) {
+        bits++;
+    }
+
+    chunker->min_size = min_size;
+    chunker->avg_size = avg_size;
+    chunker->max_size = max_size;
+    chunker->mask_small = ~(uint32_t)0 << (32 - (bits + 2));
+    chunker->mask_large = ~(uint32_t)0 << (32 - (bits - 2));
+    chunker->hash = 0;
+    chunker->offset = 0;
+    chunker->len = 0;
+    sha2_256_init(&chunker->ctx);
+    return 0;
+}
+
+/**
+   Cut the next bytes of the stream into chunks. :c:var:`callback` is called with every
+   chunk that ends in :c:var:`data`, the bytes after the last one are carried over to the
+   next call. How the stream is split between calls does not change the chunks.
+
+   :param chunker: A chunker initialized with :c:func:`chunker_init`.
+   :type chunker: struct chunker *
+   :param data: Next bytes of the stream.
+   :type data: const void *
+   :param len: Length of :c:var:`data` in bytes.
+   :type len: size_t
+   :param callback: Receives the offset, length and SHA-256 digest of each chunk in order.
+   :type callback: chunk_callback
+   :param arg: Passed on to :c:var:`callback`.
+   :type arg: void *
+*/
+void
+chunker_update(struct chunker *chunker, const void *data, size_t len, chunk_callback callback, void *arg) {
+    const uint8_t *in = data;
+    uint64_t small[CHUNK_SEGMENT / 64], large[CHUNK_SEGMENT / 64];
+
+    while (len) {
+        size_t segment = len < CHUNK_SEGMENT ? len : CHUNK_SEGMENT;
+        size_t words = (segment + 63) / 64;
+
+        memset(small, 0, words * sizeof *small);
+        memset(large, 0, words * sizeof *large);
+        chunker->hash = scan(in, segment, chunker->hash, chunker->mask_small, chunker->mask_large, small, large);
+
+        for (size_t pos = 0; pos < segment;) {
+            size_t cut = cut_point(chunker, small, large, pos, segment);
+            size_t end = cut < segment ? cut + 1 : segment;
+
+            sha2_256_update(&chunker->ctx, in + pos, end - pos);
+            chunker->len += end - pos;
+            if (cut < segment) {
+                emit(chunker, callback, arg);
+            }
+            pos = end;
+        }
+        in += segment;
+        len -= segment;
+    }
+}
+
+/**
+   End the stream, :c:var:`callback` is called with the last chunk if the stream does not
+   end on a cut point. The chunker has to be initialized again to cut another stream.
+
+   :param chunker: A chunker initialized with :c:func:`chunker_init`.
+   :type chunker: struct chunker *
+   :param callback: Receives the last chunk.
+   :type callback: chunk_callback
+   :param arg: Passed on to :c:var:`callback`.
+   :type arg: void *
+*/
+void
+chunker_final(struct chunker *chunker, chunk_callback callback, void *arg) {
+    if (chunker->len) {
+        emit(chunker, callback, arg);
+    }
+}
+
+/**
+   Select the implementation of the chunk boundary search.
+
+   The fastest backend supported by the CPU is selected when the library is loaded,
+   this is only needed to force a particular one, e.g. to compare their outputs.
+   It is not thread-safe and should be called before any chunking starts.
+
+   :param backend: ``CHUNK_BACKEND_AUTO`` for the fastest supported backend,
+                   ``CHUNK_BACKEND_SCALAR`` for the portable C code or
+                   ``CHUNK_BACKEND_AVX2`` to hash eight stripes of the input at once.
+   :type backend: enum chunk_backend
+   :return: 0 on success, -1 if the CPU does not support :c:var:`backend`.
+   :rtype: int
+*/
+int
+chunk_set_backend(enum chunk_backend backend) {
+    unsigned features = hash_cpu_features();
+
+    if (backend == CHUNK_BACKEND_AUTO) {
+        backend = features & CPU_AVX2 ? CHUNK_BACKEND_AVX2 : CHUNK_BACKEND_SCALAR;
+    }
+
+    switch (backend) {
+        case CHUNK_BACKEND_SCALAR:
+            break;
+        case CHUNK_BACKEND_AVX2:
+            if (!(features & CPU_AVX2)) {
+                return -1;
+            }
+            break;
+        default:
+            return -1;
+    }
+
+    active_backend = backend;
+    return 0;
+}
+
+/**
+   Get the backend currently used to find chunk boundaries.
+
+   :return: ``CHUNK_BACKEND_SCALAR`` or ``CHUNK_BACKEND_AVX2``.
+   :rtype: enum chunk_backend
+*/
+enum chunk_backend
+chunk_get_backend(void) {
+    return active_backend;
+}
+
+#ifdef __GNUC__
+__attribute__((constructor)) static void
+chunk_select_backend(void) {
+    chunk_set_backend(CHUNK_BACKEND_AUTO);
+}
+#endif
@@ -0,0 +1,49 @@
+#include "cpu.h"
+
+#ifdef HASH_X86
+# include <cpuid.h>
+#endif
+
+/*
+    Query CPUID once and cache the set of ``CPU_*`` flags the library cares about.
+
+    Threads that race on the first call all compute the same value. `detected` is set with
+    release ordering after `features` is stored, so a thread that reads it set also sees the flags.
+*/
+unsigned
+hash_cpu_features(void) {
+    static unsigned features, detected;
+
+    if (__atomic_load_n(&detected, __ATOMIC_ACQUIRE)) {
+        return __atomic_load_n(&features, __ATOMIC_RELAXED);
+    }
+
+#ifdef HASH_X86
+    unsigned eax, ebx, ecx, edx, found = 0;
+    unsigned long long xcr0 = 0;
+
+    if (__get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
+        found |= edx & bit_SSE2 ? CPU_SSE2 : 0;
+        found |= ecx & bit_SSSE3 ? CPU_SSSE3 : 0;
+        found |= ecx & bit_SSE4_1 ? CPU_SSE41 : 0;
+        found |= ecx & bit_SSE4_2 ? CPU_SSE42 : 0;
+        found |= ecx & bit_PCLMUL ? CPU_PCLMUL : 0;
+
+        /* The wide registers are only usable if the OS saves them on context switches */
+        if (ecx & bit_OSXSAVE) {
+            unsigned lo, hi;
+            __asm__("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+            xcr0 = ((unsigned long long)hi << 32) | lo;
+        }
+    }
+    if (__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx)) {
+        found |= ebx & (1u << 29) ? CPU_SHA : 0;
+        found |= (ebx & bit_AVX2) && (xcr0 & 0x06) == 0x06 ? CPU_AVX2 : 0;
+        found |= (ebx & bit_AVX512F) && (xcr0 & 0xe6) == 0xe6 ? CPU_AVX512F : 0;
+    }
+    __atomic_store_n(&features, found, __ATOMIC_RELAXED);
+#endif
+
+    __atomic_store_n(&detected, 1, __ATOMIC_RELEASE);
+    return __atomic_load_n(&features, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,23 @@
+/* Runtime detection of the instruction set extensions used by the accelerated backends. */
+
+#ifndef _CPU
+#define _CPU
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+# define HASH_X86 1
+#endif
+
+#define CPU_SSSE3 (1u << 0)
+#define CPU_SSE41 (1u << 1)
+#define CPU_SHA (1u << 2)
+#define CPU_AVX2 (1u << 3)
+#define CPU_AVX512F (1u << 4)
+#define CPU_SSE2 (1u << 5)
+#define CPU_SSE42 (1u << 6)
+#define CPU_PCLMUL (1u << 7)
+
+
+unsigned hash_cpu_features(void);
+
+
+#endif /* _CPU */
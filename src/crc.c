@@ -0,0 +1,533 @@
+/*
+    CRC-32C (Castagnoli), CRC-32 (IEEE 802.3, as in zlib and gzip) and CRC-64/XZ (ECMA-182).
+
+    All three are reflected CRCs whose register starts and ends inverted, so a checksum
+    is continued by passing it back in and two checksums can be combined without the data.
+    The portable code uses slicing-by-8 tables built on first use.
+
+    CRC-32C has an instruction of its own in SSE4.2 with a latency of 3 cycles and a
+    throughput of 1, so the buffer is cut into three parts hashed side by side, which are
+    then merged by shifting the CRCs of the first parts over the length of the others
+    (M. Adler, https://stackoverflow.com/a/17646775). CRC-32 and CRC-64 fold the buffer
+    16 bytes at a time with PCLMULQDQ (V. Gopal et al., "Fast CRC Computation for Generic
+    Polynomials Using PCLMULQDQ Instruction", Intel 2009): four 128-bit lanes are each
+    multiplied by x^512 mod P and added to the next 64 bytes, then folded into a single
+    lane whose 16 bytes have the same CRC as the whole buffer, and the tables finish it.
+*/
+
+#include "crc.h"
+
+#include "cpu.h"
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+/* Reflected polynomials, bit `width - 1` is the coefficient of x^0 */
+#define CRC32C_POLY 0x82f63b78u
+#define CRC32_POLY 0xedb88320u
+#define CRC64_POLY 0xc96c5795d7870f42ull
+
+/* Lengths of the parts hashed side by side with the CRC-32C instruction */
+#define CRC32C_LONG 8192
+#define CRC32C_SHORT 256
+
+#if defined(HASH_X86) && defined(__x86_64__)
+# define CRC_X86_64 1
+#endif
+
+struct crc_poly {
+    uint64_t poly;
+    unsigned width;
+    uint64_t x2n[64];  /* x^(2^n) mod P */
+};
+
+static struct crc_poly crc32c_poly = {CRC32C_POLY, 32, {0}};
+static struct crc_poly crc32_poly = {CRC32_POLY, 32, {0}};
+static struct crc_poly crc64_poly = {CRC64_POLY, 64, {0}};
+
+static uint32_t crc32c_table[8][256];
+static uint32_t crc32_table[8][256];
+static uint64_t crc64_table[8][256];
+
+/* Shift a CRC-32C over the lengths of the parts, one table per byte of the CRC */
+static uint32_t crc32c_long[4][256];
+static uint32_t crc32c_short[4][256];
+
+static pthread_once_t tables_once = PTHREAD_ONCE_INIT;
+
+static enum crc_backend active_backend = CRC_BACKEND_SCALAR;
+
+/* a(x) b(x) mod P, `a` must not be 0 */
+static uint64_t
+multmodp(const struct crc_poly *p, uint64_t a, uint64_t b) {
+    uint64_t m = (uint64_t)1 << (p->width - 1), product = 0;
+
+    for (;;) {
+        if (a & m) {
+            product ^= b;
+            if (!(a & (m - 1))) {
+                break;
+            }
+        }
+        m >>= 1;
+        b = b & 1 ? (b >> 1) ^ p->poly : b >> 1;
+    }
+    return product;
+}
+
+/* x^(8 len) mod P, the operator shifting a CRC over `len` zero bytes */
+static uint64_t
+x8nmodp(const struct crc_poly *p, uint64_t len) {
+    uint64_t x = (uint64_t)1 << (p->width - 1);
+
+    for (unsigned n = 3; len; len >>= 1, n++) {
+        if (len & 1) {
+            x = multmodp(p, p->x2n[n & 63], x);
+        }
+    }
+    return x;
+}
+
+static void
+init_poly(struct crc_poly *p) {
+    p->x2n[0] = (uint64_t)1 << (p->width - 2);
+    for (size_t n = 1; n < 64; n++) {
+        p->x2n[n] = multmodp(p, p->x2n[n - 1], p->x2n[n - 1]);
+    }
+}
+
+static void
+build_table32(uint32_t table[8][256], uint32_t poly) {
+    for (uint32_t b = 0; b < 256; b++) {
+        uint32_t crc = b;
+
+        for (int i = 0; i < 8; i++) {
+            crc = crc & 1 ? (crc >> 1) ^ poly : crc >> 1;
+        }
+        table[0][b] = crc;
+    }
+    for (size_t k = 1; k < 8; k++) {
+        for (size_t b = 0; b < 256; b++) {
+            table[k][b] = (table[k - 1][b] >> 8) ^ table[0][table[k - 1][b] & 0xff];
+        }
+    }
+}
+
+static void
+build_table64(uint64_t table[8][256], uint64_t poly) {
+    for (uint64_t b = 0; b < 256; b++) {
+        uint64_t crc = b;
+
+        for (int i = 0; i < 8; i++) {
+            crc = crc & 1 ? (crc >> 1) ^ poly : crc >> 1;
+        }
+        table[0][b] = crc;
+    }
+    for (size_t k = 1; k < 8; k++) {
+        for (size_t b = 0; b < 256; b++) {
+            table[k][b] = (table[k - 1][b] >> 8) ^ table[0][table[k - 1][b] & 0xff];
+        }
+    }
+}
+
+static void
+build_shift32(uint32_t table[4][256], const struct crc_poly *p, uint64_t len) {
+    uint64_t shift = x8nmodp(p, len);
+
+    for (size_t k = 0; k < 4; k++) {
+        for (uint32_t b = 0; b < 256; b++) {
+            table[k][b] = (uint32_t)multmodp(p, shift, (uint64_t)b << (8 * k));
+        }
+    }
+}
+
+static void
+build_tables(void) {
+    init_poly(&crc32c_poly);
+    init_poly(&crc32_poly);
+    init_poly(&crc64_poly);
+    build_table32(crc32c_table, CRC32C_POLY);
+    build_table32(crc32_table, CRC32_POLY);
+    build_table64(crc64_table, CRC64_POLY);
+    build_shift32(crc32c_long, &crc32c_poly, CRC32C_LONG);
+    build_shift32(crc32c_short, &crc32c_poly, CRC32C_SHORT);
+}
+
+static inline uint32_t
+load32_le(const uint8_t *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline uint64_t
+load64_le(const uint8_t *p) {
+    return (uint64_t)load32_le(p) | ((uint64_t)load32_le(p + 4) << 32);
+}
+
+/* The register of a reflected CRC is updated 8 bytes at a time, without the inversions */
+static uint32_t
+crc32_slice8(uint32_t table[8][256], uint32_t crc, const uint8_t *p, size_t len) {
+    for (; len >= 8; p += 8, len -= 8) {
+        uint32_t low = crc ^ load32_le(p), high = load32_le(p + 4);
+
+        crc = table[7][low & 0xff] ^ table[6][(low >> 8) & 0xff] ^ table[5][(low >> 16) & 0xff] ^ table[4][low >> 24] ^
+              table[3][high & 0xff] ^ table[2][(high >> 8) & 0xff] ^ table[1][(high >> 16) & 0xff] ^
+              table[0][high >> 24];
+    }
+    for (; len; p++, len--) {
+        crc = (crc >> 8) ^ table[0][(crc ^ *p) & 0xff];
+    }
+    return crc;
+}
+
+static uint64_t
+crc64_slice8(uint64_t table[8][256], uint64_t crc, const uint8_t *p, size_t len) {
+    for (; len >= 8; p += 8, len -= 8) {
+        uint64_t x = crc ^ load64_le(p);
+
+        crc = table[7][x & 0xff] ^ table[6][(x >> 8) & 0xff] ^ table[5][(x >> 16) & 0xff] ^
+              table[4][(x >> 24) & 0xff] ^ table[3][(x >> 32) & 0xff] ^ table[2][(x >> 40) & 0xff] ^
+              table[1][(x >> 48) & 0xff] ^ table[0][x >> 56];
+    }
+    for (; len; p++, len--) {
+        crc = (crc >> 8) ^ table[0][(crc ^ *p) & 0xff];
+    }
+    return crc;
+}
+
+static inline uint32_t
+shift32(uint32_t table[4][256], uint32_t crc) {
+    return table[0][crc & 0xff] ^ table[1][(crc >> 8) & 0xff] ^ table[2][(crc >> 16) & 0xff] ^ table[3][crc >> 24];
+}
+
+#ifdef CRC_X86_64
+
+# include <immintrin.h>
+
+/*
+    Folding constants, x^(D + 63) mod P for the low and x^(D - 1) mod P for the high half
+    of a lane to move it D bits further, in the bit order of the lanes. The extra x^-1
+    makes up for the product of two reflected 64-bit words landing one bit short.
+*/
+static const uint64_t CRC32_FOLD[4] = {0x653d982200000000, 0xcad38e8f00000000, 0x65673b4600000000,
+                                       0x9ba54c6f00000000};
+static const uint64_t CRC64_FOLD[4] = {0x6ae3efbb9dd441f3, 0x081f6054a7842df4, 0xe05dd497ca393ae4,
+                                       0xdabe95afc7875f40};
+
+__attribute__((target("sse4.2"))) static uint32_t
+crc32c_sse42(uint32_t crc, const uint8_t *p, size_t len) {
+    uint64_t crc0 = crc, x;
+
+    for (; len >= 3 * CRC32C_LONG; p += 3 * CRC32C_LONG, len -= 3 * CRC32C_LONG) {
+        uint64_t crc1 = 0, crc2 = 0;
+
+        for (size_t i = 0; i < CRC32C_LONG; i += 8) {
+            memcpy(&x, p + i, 8);
+            crc0 = _mm_crc32_u64(crc0, x);
+            memcpy(&x, p + i + CRC32C_LONG, 8);
+            crc1 = _mm_crc32_u64(crc1, x);
+            memcpy(&x, p + i + 2 * CRC32C_LONG, 8);
+            crc2 = _mm_crc32_u64(crc2, x);
+        }
+        crc0 = shift32(crc32c_long, (uint32_t)crc0) ^ crc1;
+        crc0 = shift32(crc32c_long, (uint32_t)crc0) ^ crc2;
+    }
+    for (; len >= 3 * CRC32C_SHORT; p += 3 * CRC32C_SHORT, len -= 3 * CRC32C_SHORT) {
+        uint64_t crc1 = 0, crc2 = 0;
+
+        for (size_t i = 0; i < CRC32C_SHORT; i += 8) {
+            memcpy(&x, p + i, 8);
+            crc0 = _mm_crc32_u64(crc0, x);
+            memcpy(&x, p + i + CRC32C_SHORT, 8);
+            crc1 = _mm_crc32_u64(crc1, x);
+            memcpy(&x, p + i + 2 * CRC32C_SHORT, 8);
+            crc2 = _mm_crc32_u64(crc2, x);
+        }
+        crc0 = shift32(crc32c_short, (uint32_t)crc0) ^ crc1;
+        crc0 = shift32(crc32c_short, (uint32_t)crc0) ^ crc2;
+    }
+    for (; len >= 8; p += 8, len -= 8) {
+        memcpy(&x, p, 8);
+        crc0 = _mm_crc32_u64(crc0, x);
+    }
+    for (; len; p++, len--) {
+        crc0 = _mm_crc32_u8((uint32_t)crc0, *p);
+    }
+    return (uint32_t)crc0;
+}
+
+__attribute__((target("pclmul"))) static inline __m128i
+fold(__m128i lane, __m128i constants) {
+    return _mm_xor_si128(_mm_clmulepi64_si128(lane, constants, 0x00), _mm_clmulepi64_si128(lane, constants, 0x11));
+}
+
+/*
+    Fold `len` bytes, a multiple of 16 of at least 64, into 16 bytes with the same CRC.
+    The register is added to the first bytes, the CRC of `out` from a register of 0 is
+    then that of the buffer from `crc`.
+*/
+__attribute__((target("pclmul"))) static void
+fold_pclmul(uint64_t crc, const uint8_t *p, size_t len, const uint64_t *constants, uint8_t *out) {
+    const __m128i fold512 = _mm_set_epi64x((long long)constants[1], (long long)constants[0]);
+    const __m128i fold128 = _mm_set_epi64x((long long)constants[3], (long long)constants[2]);
+    __m128i x0 = _mm_xor_si128(_mm_loadu_si128((const __m128i *)p), _mm_set_epi64x(0, (long long)crc));
+    __m128i x1 = _mm_loadu_si128((const __m128i *)(p + 16));
+    __m128i x2 = _mm_loadu_si128((const __m128i *)(p + 32));
+    __m128i x3 = _mm_loadu_si128((const __m128i *)(p + 48));
+
+    for (p += 64, len -= 64; len >= 64; p += 64, len -= 64) {
+        x0 = _mm_xor_si128(fold(x0, fold512), _mm_loadu_si128((const __m128i *)p));
+        x1 = _mm_xor_si128(fold(x1, fold512), _mm_loadu_si128((const __m128i *)(p + 16)));
+        x2 = _mm_xor_si128(fold(x2, fold512), _mm_loadu_si128((const __m128i *)(p + 32)));
+        x3 = _mm_xor_si128(fold(x3, fold512), _mm_loadu_si128((const __m128i *)(p + 48)));
+    }
+    x0 = _mm_xor_si128(fold(x0, fold128), x1);
+    x0 = _mm_xor_si128(fold(x0, fold128), x2);
+    x0 = _mm_xor_si128(fold(x0, fold128), x3);
+    for (; len; p += 16, len -= 16) {
+        x0 = _mm_xor_si128(fold(x0, fold128), _mm_loadu_si128((const __m128i *)p));
+    }
+    _mm_storeu_si128((__m128i *)out, x0);
+}
+
+static uint32_t
+crc32_pclmul(uint32_t crc, const uint8_t *p, size_t len) {
+    uint8_t folded[16];
+
+    if (len >= 64) {
+        fold_pclmul(crc, p, len & ~(size_t)15, CRC32_FOLD, folded);
+        crc = crc32_slice8(crc32_table, 0, folded, 16);
+        p += len & ~(size_t)15;
+        len &= 15;
+    }
+    return crc32_slice8(crc32_table, crc, p, len);
+}
+
+static uint64_t
+crc64_pclmul(uint64_t crc, const uint8_t *p, size_t len) {
+    uint8_t folded[16];
+
+    if (len >= 64) {
+        fold_pclmul(crc, p, len & ~(size_t)15, CRC64_FOLD, folded);
+        crc = crc64_slice8(crc64_table, 0, folded, 16);
+        p += len & ~(size_t)15;
+        len &= 15;
+    }
+    return crc64_slice8(crc64_table, crc, p, len);
+}
+
+#endif
+
+/**
+   Compute or continue the CRC-32C (Castagnoli) of :c:var:`data`, the checksum of iSCSI,
+   ext4, Btrfs and many storage formats. It runs at several bytes per cycle with SSE4.2.
+
+   Start with a :c:var:`crc` of 0 and pass the result back in with the next piece of the
+   data to checksum a stream.
+
+   :param crc: 0, or the CRC of the preceding data.
+   :type crc: uint32_t
+   :param data: Bytes to checksum.
+   :type data: const void *
+   :param len: Length of :c:var:`data` in bytes.
+   :type len: size_t
+   :return: The CRC of the preceding data and :c:var:`data`.
+   :rtype: uint32_t
+*/
+uint32_t
+crc32c(uint32_t crc, const void *data, size_t len) {
+    pthread_once(&tables_once, build_tables);
+
+    switch (active_backend) {
+#ifdef CRC_X86_64
+        case CRC_BACKEND_SSE42:
+        case CRC_BACKEND_PCLMUL:
+            return ~crc32c_sse42(~crc, data, len);
+#endif
+        default:
+            return ~crc32_slice8(crc32c_table, ~crc, data, len);
+    }
+}
+
+/**
+   Compute or continue the CRC-32 of :c:var:`data` used by Ethernet, zlib, gzip, zip and
+   PNG, the same value as zlib's ``crc32``. It is computed with PCLMULQDQ where available.
+
+   :param crc: 0, or the CRC of the preceding data.
+   :type crc: uint32_t
+   :param data: Bytes to checksum.
+   :type data: const void *
+   :param len: Length of :c:var:`data` in bytes.
+   :type len: size_t
+   :return: The CRC of the preceding data and :c:var:`data`.
+   :rtype: uint32_t
+*/
+uint32_t
+crc32_ieee(uint32_t crc, const void *data, size_t len) {
+    pthread_once(&tables_once, build_tables);
+
+    switch (active_backend) {
+#ifdef CRC_X86_64
+        case CRC_BACKEND_PCLMUL:
+            return ~crc32_pclmul(~crc, data, len);
+#endif
+        default:
+            return ~crc32_slice8(crc32_table, ~crc, data, len);
+    }
+}
+
+/**
+   Compute or continue the CRC-64 of :c:var:`data` used by xz, with the ECMA-182
+   polynomial. It is computed with PCLMULQDQ where available.
+
+   :param crc: 0, or the CRC of the preceding data.
+   :type crc: uint64_t
+   :param data: Bytes to checksum.
+   :type data: const void *
+   :param len: Length of :c:var:`data` in bytes.
+   :type len: size_t
+   :return: The CRC of the preceding data and :c:var:`data`.
+   :rtype: uint64_t
+*/
+uint64_t
+crc64_xz(uint64_t crc, const void *data, size_t len) {
+    pthread_once(&tables_once, build_tables);
+
+    switch (active_backend) {
+#ifdef CRC_X86_64
+        case CRC_BACKEND_PCLMUL:
+            return ~crc64_pclmul(~crc, data, len);
+#endif
+        default:
+            return ~crc64_slice8(crc64_table, ~crc, data, len);
+    }
+}
+
+/**
+   Get the CRC-32C of two pieces of data from the CRCs of each, so that the pieces of a
+   buffer can be checksummed in parallel. It takes time logarithmic in :c:var:`len2`.
+
+   :param crc1: CRC of the first piece.
+   :type crc1: uint32_t
+   :param crc2: CRC of the second piece.
+   :type crc2: uint32_t
+   :param len2: Length of the second piece in bytes.
+   :type len2: uint64_t
+   :return: The CRC of the first piece followed by the second.
+   :rtype: uint32_t
+*/
+uint32_t
+crc32c_combine(uint32_t crc1, uint32_t crc2, uint64_t len2) {
+    pthread_once(&tables_once, build_tables);
+    return (uint32_t)multmodp(&crc32c_poly, x8nmodp(&crc32c_poly, len2), crc1) ^ crc2;
+}
+
+/**
+   Get the CRC-32 of two pieces of data from the CRCs of each, as :c:func:`crc32c_combine`.
+
+   :param crc1: CRC of the first piece.
+   :type crc1: uint32_t
+   :param crc2: CRC of the second piece.
+   :type crc2: uint32_t
+   :param len2: Length of the second piece in bytes.
+   :type len2: uint64_t
+   :return: The CRC of the first piece followed by the second.
+   :rtype: uint32_t
+*/
+uint32_t
+crc32_ieee_combine(uint32_t crc1, uint32_t crc2, uint64_t len2) {
+    pthread_once(&tables_once, build_tables);
+    return (uint32_t)multmodp(&crc32_poly, x8nmodp(&crc32_poly, len2), crc1) ^ crc2;
+}
+
+/**
+   Get the CRC-64 of two pieces of data from the CRCs of each, as :c:func:`crc32c_combine`.
+
+   :param crc1: CRC of the first piece.
+   :type crc1: uint64_t
+   :param crc2: CRC of the second piece.
+   :type crc2: uint64_t
+   :param len2: Length of the second piece in bytes.
+   :type len2: uint64_t
+   :return: The CRC of the first piece followed by the second.
+   :rtype: uint64_t
+*/
+uint64_t
+crc64_xz_combine(uint64_t crc1, uint64_t crc2, uint64_t len2) {
+    pthread_once(&tables_once, build_tables);
+    return multmodp(&crc64_poly, x8nmodp(&crc64_poly, len2), crc1) ^ crc2;
+}
+
+/**
+   Select the implementation of the checksums.
+
+   The fastest backend supported by the CPU is selected when the library is loaded,
+   this is only needed to force a particular one, e.g. to compare their outputs.
+   It is not thread-safe and should be called before any checksum is computed.
+
+   :param backend: ``CRC_BACKEND_AUTO`` for the fastest supported backend,
+                   ``CRC_BACKEND_SCALAR`` for the portable C code,
+                   ``CRC_BACKEND_SSE42`` for the CRC-32C instruction or
+                   ``CRC_BACKEND_PCLMUL`` for that and carry-less multiplication for the
+                   other checksums.
+   :type backend: enum crc_backend
+   :return: 0 on success, -1 if the CPU does not support :c:var:`backend`.
+   :rtype: int
+*/
+int
+crc_set_backend(enum crc_backend backend) {
+    unsigned features = hash_cpu_features();
+
+#ifndef CRC_X86_64
+    features = 0;  /* The kernels use 64-bit instructions */
+#endif
+
+    if (backend == CRC_BACKEND_AUTO) {
+        if ((features & CPU_SSE42) && (features & CPU_PCLMUL)) {
+            backend = CRC_BACKEND_PCLMUL;
+        } else if (features & CPU_SSE42) {
+            backend = CRC_BACKEND_SSE42;
+        } else {
+            backend = CRC_BACKEND_SCALAR;
+        }
+    }
+
+    switch (backend) {
+        case CRC_BACKEND_SCALAR:
+            break;
+        case CRC_BACKEND_SSE42:
+            if (!(features & CPU_SSE42)) {
+                return -1;
+            }
+            break;
+        case CRC_BACKEND_PCLMUL:
+            if (!(features & CPU_SSE42) || !(features & CPU_PCLMUL)) {
+                return -1;
+            }
+            break;
+        default:
+            return -1;
+    }
+
+    active_backend = backend;
+    return 0;
+}
+
+/**
+   Get the backend currently used by the checksums.
+
+   :return: ``CRC_BACKEND_SCALAR``, ``CRC_BACKEND_SSE42`` or ``CRC_BACKEND_PCLMUL``.
+   :rtype: enum crc_backend
+*/
+enum crc_backend
+crc_get_backend(void) {
+    return active_backend;
+}
+
+#ifdef __GNUC__
+__attribute__((constructor)) static void
+crc_select_backend(void) {
+    crc_set_backend(CRC_BACKEND_AUTO);
+}
+#endif
@@ -0,0 +1,520 @@
+/*
+    Hash_DRBG and HMAC_DRBG of NIST SP 800-90A Rev. 1 (https://doi.org/10.6028/NIST.SP.800-90Ar1)
+    over SHA-256 and SHA-512.
+
+    Both are deterministic: the same entropy, nonce, personalization and sequence of
+    requests give the same bytes on every platform, which is what sharding and sampling
+    need. Hash_DRBG produces its output as the hashes of V, V + 1, V + 2 ... whose inputs
+    are all known up front, so a request is hashed as a batch of independent single-block
+    messages that `sha2_256_mb` spreads over SIMD lanes. Each HMAC_DRBG block is the MAC of
+    the previous one, so it is sequential, but the key is expanded once per request and a
+    block then costs two compressions.
+
+    The per-thread generators keep a buffer of one full request. Reading bytes is a copy
+    out of the calling thread's buffer, with no lock and no shared cache line, and the
+    buffer is refilled one request at a time.
+*/
+
+#include "drbg.h"
+
+#include "batch.h"
+#include "hmac.h"
+#include "sha.h"
+#include "sha_internal.h"
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Output blocks of Hash_DRBG hashed per call to the batch function */
+#define HASHGEN_GROUP 64
+
+/* A piece of a message made of several concatenated inputs */
+struct span {
+    const void *data;
+    size_t len;
+};
+
+/* A generator and a buffer of its next output, owned by one thread */
+struct drbg_thread {
+    struct drbg drbg;
+    size_t used;  /* Bytes of `buffer` already handed out */
+    uint8_t buffer[DRBG_MAX_REQUEST];
+};
+
+static pthread_once_t key_once = PTHREAD_ONCE_INIT;
+static pthread_key_t thread_key;
+
+static _Thread_local struct drbg_thread *local;
+
+/* Hash the concatenation of `num_spans` inputs, `drbg->out_len` bytes are written to `out` */
+static void
+digest(const struct drbg *drbg, const struct span *spans, size_t num_spans, uint8_t *out) {
+    if (drbg->algorithm == HASH_SHA2_256) {
+        struct sha2_256_ctx ctx;
+        uint32_t words[8];
+
+        sha2_256_init(&ctx);
+        for (size_t i = 0; i < num_spans; i++) {
+            sha2_256_update(&ctx, spans[i].data, spans[i].len);
+        }
+        sha2_256_final(&ctx, words);
+        hash_store_words(out, words, 4, 32);
+    } else {
+        struct sha2_512_ctx ctx;
+        uint64_t words[8];
+
+        sha2_512_init(&ctx);
+        for (size_t i = 0; i < num_spans; i++) {
+            sha2_512_update(&ctx, spans[i].data, spans[i].len);
+        }
+        sha2_512_final(&ctx, words);
+        hash_store_words(out, words, 8, 64);
+    }
+}
+
+/* `v += x` for big-endian numbers, `x` may be shorter than `v` and the carry out of `v` is dropped */
+static void
+add_be(uint8_t *v, size_t v_len, const uint8_t *x, size_t x_len) {
+    unsigned carry = 0;
+
+    for (size_t i = 1; i <= v_len; i++) {
+        carry += v[v_len - i] + (i <= x_len ? x[x_len - i] : 0);
+        v[v_len - i] = carry & 0xff;
+        carry >>= 8;
+    }
+}
+
+static void
+increment_be(uint8_t *v, size_t v_len) {
+    for (size_t i = v_len; i-- && !++v[i];) {
+    }
+}
+
+/* Hash_df of section 10.3.1, derives `drbg->seed_len` bytes from the concatenated inputs */
+static void
+hash_df(const struct drbg *drbg, const struct span *input, size_t num_inputs, uint8_t *out) {
+    uint32_t bits = (uint32_t)drbg->seed_len * 8;
+    uint8_t header[5] = {1, bits >> 24, (bits >> 16) & 0xff, (bits >> 8) & 0xff, bits & 0xff};
+    uint8_t temp[64];
+    struct span spans[5] = {{header, sizeof header}};
+
+    memcpy(spans + 1, input, num_inputs * sizeof *input);
+    for (size_t done = 0; done < drbg->seed_len; done += drbg->out_len, header[0]++) {
+        size_t n = drbg->seed_len - done < drbg->out_len ? drbg->seed_len - done : drbg->out_len;
+
+        digest(drbg, spans, num_inputs + 1, temp);
+        memcpy(out + done, temp, n);
+    }
+    hash_wipe(temp, sizeof temp);
+}
+
+/* C is derived from a new V by both instantiation and reseeding */
+static void
+hash_derive_c(struct drbg *drbg) {
+    static const uint8_t zero = 0x00;
+
+    hash_df(drbg, (const struct span[]){{&zero, 1}, {drbg->v, drbg->seed_len}}, 2, drbg->c);
+    drbg->reseed_counter = 1;
+}
+
+/* Hashgen of section 10.1.1.4: the hashes of V, V + 1, V + 2 ... hashed a group at a time */
+static void
+hashgen(const struct drbg *drbg, uint8_t *out, size_t len) {
+    uint8_t data[HASHGEN_GROUP][DRBG_MAX_SEED_LEN], counter[DRBG_MAX_SEED_LEN];
+    union {
+        uint32_t w32[8];
+        uint64_t w64[8];
+    } words[HASHGEN_GROUP];
+    struct hash_job jobs[HASHGEN_GROUP];
+
+    memcpy(counter, drbg->v, drbg->seed_len);
+    while (len) {
+        size_t num_jobs = (len + drbg->out_len - 1) / drbg->out_len;
+
+        num_jobs = num_jobs < HASHGEN_GROUP ? num_jobs : HASHGEN_GROUP;
+        for (size_t j = 0; j < num_jobs; j++) {
+            memcpy(data[j], counter, drbg->seed_len);
+            increment_be(counter, drbg->seed_len);
+            jobs[j] = (struct hash_job){data[j], drbg->seed_len, &words[j]};
+        }
+
+        if (drbg->algorithm == HASH_SHA2_256) {
+            sha2_256_mb(jobs, num_jobs);
+        } else {
+            for (size_t j = 0; j < num_jobs; j++) {
+                sha2_512_data(jobs[j].data, jobs[j].len, jobs[j].hash);
+            }
+        }
+
+        for (size_t j = 0; j < num_jobs; j++) {
+            size_t n = len < drbg->out_len ? len : drbg->out_len;
+
+            if (drbg->algorithm == HASH_SHA2_256) {
+                hash_store_words(out, words[j].w32, 4, n);
+            } else {
+                hash_store_words(out, words[j].w64, 8, n);
+            }
+            out += n;
+            len -= n;
+        }
+    }
+
+    hash_wipe(data, sizeof data);
+    hash_wipe(words, sizeof words);
+    hash_wipe(counter, sizeof counter);
+}
+
+static void
+hash_generate(struct drbg *drbg, uint8_t *out, size_t len, const void *additional, size_t additional_len) {
+    uint8_t prefix, h[64], counter[8];
+
+    if (additional_len) {
+        prefix = 0x02;
+        digest(drbg, (const struct span[]){{&prefix, 1}, {drbg->v, drbg->seed_len}, {additional, additional_len}}, 3,
+               h);
+        add_be(drbg->v, drbg->seed_len, h, drbg->out_len);
+    }
+
+    hashgen(drbg, out, len);
+
+    prefix = 0x03;
+    digest(drbg, (const struct span[]){{&prefix, 1}, {drbg->v, drbg->seed_len}}, 2, h);
+    for (int i = 0; i < 8; i++) {
+        counter[i] = (drbg->reseed_counter >> (56 - 8 * i)) & 0xff;
+    }
+    add_be(drbg->v, drbg->seed_len, h, drbg->out_len);
+    add_be(drbg->v, drbg->seed_len, drbg->c, drbg->seed_len);
+    add_be(drbg->v, drbg->seed_len, counter, sizeof counter);
+    hash_wipe(h, sizeof h);
+}
+
+/* HMAC_DRBG_Update of section 10.1.2.2, the provided data is the concatenation of the inputs */
+static void
+hmac_update_state(struct drbg *drbg, const struct span *provided, size_t num_provided) {
+    size_t provided_len = 0;
+    struct hmac_key key;
+    struct hmac_ctx ctx;
+
+    for (size_t i = 0; i < num_provided; i++) {
+        provided_len += provided[i].len;
+    }
+
+    for (uint8_t round = 0; round < 2; round++) {
+        hmac_key_init(&key, drbg->algorithm, drbg->c, drbg->out_len);
+        hmac_init(&ctx, &key);
+        hmac_update(&ctx, drbg->v, drbg->out_len);
+        hmac_update(&ctx, &round, 1);
+        for (size_t i = 0; i < num_provided; i++) {
+            hmac_update(&ctx, provided[i].data, provided[i].len);
+        }
+        hmac_final(&ctx, drbg->c);
+
+        hmac_key_init(&key, drbg->algorithm, drbg->c, drbg->out_len);
+        hmac_keyed(&key, drbg->v, drbg->out_len, drbg->v);
+        if (!provided_len) {
+            break;
+        }
+    }
+    hmac_key_clear(&key);
+}
+
+static void
+hmac_generate(struct drbg *drbg, uint8_t *out, size_t len, const void *additional, size_t additional_len) {
+    struct span provided = {additional, additional_len};
+    struct hmac_key key;
+
+    if (additional_len) {
+        hmac_update_state(drbg, &provided, 1);
+    }
+
+    hmac_key_init(&key, drbg->algorithm, drbg->c, drbg->out_len);
+    while (len) {
+        size_t n = len < drbg->out_len ? len : drbg->out_len;
+
+        hmac_keyed(&key, drbg->v, drbg->out_len, drbg->v);
+        memcpy(out, drbg->v, n);
+        out += n;
+        len -= n;
+    }
+    hmac_key_clear(&key);
+
+    hmac_update_state(drbg, &provided, 1);
+}
+
+/**
+   Instantiate a generator from :c:var:`entropy`, :c:var:`nonce` and :c:var:`personalization`.
+
+   The output is fully determined by these inputs and by the requests that follow, so a
+   seed that is not secret gives a reproducible stream, e.g. one per shard with the
+   shard as personalization. For a security strength of 256 bits the entropy has to hold
+   at least 256 bits of it, and the nonce half as many.
+
+   :param drbg: The generator to instantiate.
+   :type drbg: struct drbg *
+   :param mechanism: ``DRBG_HASH`` for Hash_DRBG or ``DRBG_HMAC`` for HMAC_DRBG.
+   :type mechanism: enum drbg_mechanism
+   :param algorithm: ``HASH_SHA2_256`` or ``HASH_SHA2_512``.
+   :type algorithm: enum hash_algorithm
+   :param entropy: The entropy input.
+   :type entropy: const void *
+   :param entropy_len: Length of :c:var:`entropy` in bytes.
+   :type entropy_len: size_t
+   :param nonce: The nonce, may be empty.
+   :type nonce: const void *
+   :param nonce_len: Length of :c:var:`nonce` in bytes.
+   :type nonce_len: size_t
+   :param personalization: The personalization string, may be empty.
+   :type personalization: const void *
+   :param personalization_len: Length of :c:var:`personalization` in bytes.
+   :type personalization_len: size_t
+   :return: 0 on success, -1 if :c:var:`mechanism` or :c:var:`algorithm` is not supported.
+   :rtype: int
+*/
+int
+drbg_init(struct drbg *drbg, enum drbg_mechanism mechanism, enum hash_algorithm algorithm, const void *entropy,
+          size_t entropy_len, const void *nonce, size_t nonce_len, const void *personalization,
+          size_t personalization_len) {
+    const struct span seed_material[] = {
+        {entropy, entropy_len},
+        {nonce, nonce_len},
+        {personalization, personalization_len},
+    };
+
+    if ((mechanism != DRBG_HASH && mechanism != DRBG_HMAC) ||
+        (algorithm != HASH_SHA2_256 && algorithm != HASH_SHA2_512)) {
+        return -1;
+    }
+
+    drbg->mechanism = mechanism;
+    drbg->algorithm = algorithm;
+    drbg->out_len = algorithm == HASH_SHA2_256 ? 32 : 64;
+
+    if (mechanism == DRBG_HASH) {
+        drbg->seed_len = algorithm == HASH_SHA2_256 ? 55 : 111;
+        hash_df(drbg, seed_material, 3, drbg->v);
+        hash_derive_c(drbg);
+    } else {
+        drbg->seed_len = drbg->out_len;
+        memset(drbg->c, 0x00, drbg->out_len);
+        memset(drbg->v, 0x01, drbg->out_len);
+        hmac_update_state(drbg, seed_material, 3);
+        drbg->reseed_counter = 1;
+    }
+    return 0;
+}
+
+/**
+   Mix fresh :c:var:`entropy` and :c:var:`additional` input into :c:var:`drbg` and reset
+   its count of requests.
+
+   :param drbg: A generator set up by :c:func:`drbg_init`.
+   :type drbg: struct drbg *
+   :param entropy: The entropy input.
+   :type entropy: const void *
+   :param entropy_len: Length of :c:var:`entropy` in bytes.
+   :type entropy_len: size_t
+   :param additional: Additional input, may be empty.
+   :type additional: const void *
+   :param additional_len: Length of :c:var:`additional` in bytes.
+   :type additional_len: size_t
+   :return: 0 on success.
+   :rtype: int
+*/
+int
+drbg_reseed(struct drbg *drbg, const void *entropy, size_t entropy_len, const void *additional,
+            size_t additional_len) {
+    if (drbg->mechanism == DRBG_HASH) {
+        static const uint8_t prefix = 0x01;
+        uint8_t v[DRBG_MAX_SEED_LEN];
+
+        memcpy(v, drbg->v, drbg->seed_len);
+        hash_df(drbg,
+                (const struct span[]){{&prefix, 1}, {v, drbg->seed_len}, {entropy, entropy_len},
+                                      {additional, additional_len}},
+                4, drbg->v);
+        hash_derive_c(drbg);
+        hash_wipe(v, sizeof v);
+    } else {
+        hmac_update_state(drbg, (const struct span[]){{entropy, entropy_len}, {additional, additional_len}}, 2);
+        drbg->reseed_counter = 1;
+    }
+    return 0;
+}
+
+/**
+   Generate :c:var:`len` pseudorandom bytes, one request of SP 800-90A.
+
+   With Hash_DRBG over SHA-256 the output blocks are hashed side by side by
+   :c:func:`sha2_256_mb`, which makes long requests the cheapest per byte.
+
+   :param drbg: A generator set up by :c:func:`drbg_init`.
+   :type drbg: struct drbg *
+   :param out: Receives the bytes.
+   :type out: void *
+   :param len: Number of bytes, at most ``DRBG_MAX_REQUEST``.
+   :type len: size_t
+   :param additional: Additional input, may be empty.
+   :type additional: const void *
+   :param additional_len: Length of :c:var:`additional` in bytes.
+   :type additional_len: size_t
+   :return: 0 on success, -1 if :c:var:`len` is too large or ``DRBG_RESEED_INTERVAL``
+            requests were made since the last reseed, in which case nothing is generated.
+   :rtype: int
+*/
+int
+drbg_generate(struct drbg *drbg, void *out, size_t len, const void *additional, size_t additional_len) {
+    if (len > DRBG_MAX_REQUEST || drbg->reseed_counter > DRBG_RESEED_INTERVAL) {
+        return -1;
+    }
+
+    if (drbg->mechanism == DRBG_HASH) {
+        hash_generate(drbg, out, len, additional, additional_len);
+    } else {
+        hmac_generate(drbg, out, len, additional, additional_len);
+    }
+    drbg->reseed_counter++;
+    return 0;
+}
+
+/**
+   Erase the state of :c:var:`drbg`.
+
+   :param drbg: A generator set up by :c:func:`drbg_init`.
+   :type drbg: struct drbg *
+*/
+void
+drbg_clear(struct drbg *drbg) {
+    hash_wipe(drbg, sizeof *drbg);
+}
+
+static void
+thread_exit(void *arg) {
+    struct drbg_thread *t = arg;
+
+    hash_wipe(t, sizeof *t);
+    free(t);
+    /* A later destructor that reads bytes on this thread gets -1 instead of the freed block */
+    local = NULL;
+}
+
+static void
+create_key(void) {
+    pthread_key_create(&thread_key, thread_exit);
+}
+
+/**
+   Instantiate the generator of the calling thread, see :c:func:`drbg_init`.
+
+   Each thread has a generator of its own that only it can read, so threads that
+   need reproducible streams should each get a distinct personalization. The
+   generator is erased when the thread exits.
+
+   :param mechanism: ``DRBG_HASH`` for Hash_DRBG or ``DRBG_HMAC`` for HMAC_DRBG.
+   :type mechanism: enum drbg_mechanism
+   :param algorithm: ``HASH_SHA2_256`` or ``HASH_SHA2_512``.
+   :type algorithm: enum hash_algorithm
+   :param entropy: The entropy input, or the seed of a reproducible stream.
+   :type entropy: const void *
+   :param entropy_len: Length of :c:var:`entropy` in bytes.
+   :type entropy_len: size_t
+   :param personalization: The personalization string, may be empty.
+   :type personalization: const void *
+   :param personalization_len: Length of :c:var:`personalization` in bytes.
+   :type personalization_len: size_t
+   :return: 0 on success, -1 if the arguments are not supported or the buffer cannot be allocated.
+   :rtype: int
+*/
+int
+drbg_thread_init(enum drbg_mechanism mechanism, enum hash_algorithm algorithm, const void *entropy,
+                 size_t entropy_len, const void *personalization, size_t personalization_len) {
+    struct drbg_thread *t = local;
+
+    if (!t) {
+        t = malloc(sizeof *t);
+        if (!t || pthread_once(&key_once, create_key) || pthread_setspecific(thread_key, t)) {
+            free(t);
+            return -1;
+        }
+        local = t;
+    }
+
+    if (drbg_init(&t->drbg, mechanism, algorithm, entropy, entropy_len, NULL, 0, personalization,
+                  personalization_len)) {
+        drbg_thread_clear();
+        return -1;
+    }
+    t->used = sizeof t->buffer;
+    return 0;
+}
+
+/**
+   Copy the next :c:var:`len` bytes of the calling thread's generator to :c:var:`out`.
+
+   The bytes come out of a per-thread buffer of ``DRBG_MAX_REQUEST`` bytes, which is
+   refilled by a request of that size without additional input once it is used up. The
+   stream is the same however it is split between calls.
+
+   :param out: Receives the bytes.
+   :type out: void *
+   :param len: Number of bytes, any size.
+   :type len: size_t
+   :return: 0 on success, -1 if the thread has no generator or it has to be reseeded, in
+            which case the bytes already copied are lost.
+   :rtype: int
+*/
+int
+drbg_thread_bytes(void *out, size_t len) {
+    struct drbg_thread *t = local;
+    uint8_t *dest = out;
+
+    if (!t) {
+        return -1;
+    }
+
+    while (len) {
+        size_t n;
+
+        /* Whole requests go straight to the caller, the stream is the same as through the buffer */
+        if (t->used == sizeof t->buffer && len >= sizeof t->buffer) {
+            if (drbg_generate(&t->drbg, dest, sizeof t->buffer, NULL, 0)) {
+                return -1;
+            }
+            dest += sizeof t->buffer;
+            len -= sizeof t->buffer;
+            continue;
+        }
+
+        if (t->used == sizeof t->buffer) {
+            if (drbg_generate(&t->drbg, t->buffer, sizeof t->buffer, NULL, 0)) {
+                return -1;
+            }
+            t->used = 0;
+        }
+
+        n = sizeof t->buffer - t->used < len ? sizeof t->buffer - t->used : len;
+        memcpy(dest, t->buffer + t->used, n);
+        /* Bytes handed out are not kept, the buffer outlives the call so this store cannot be dropped */
+        memset(t->buffer + t->used, 0, n);
+        t->used += n;
+        dest += n;
+        len -= n;
+    }
+    return 0;
+}
+
+/**
+   Erase and free the generator of the calling thread, it needs :c:func:`drbg_thread_init`
+   before it can be used again.
+*/
+void
+drbg_thread_clear(void) {
+    struct drbg_thread *t = local;
+
+    if (t) {
+        pthread_setspecific(thread_key, NULL);
+        thread_exit(t);
+    }
+}
@@ -0,0 +1,765 @@
+/*
+    Canonical byte digests and their text encodings.
+
+    The `*_data` and `*_final` functions write host-endian words, the byte string the
+    standards define as the digest is their big-endian serialization. Hex and base64 have
+    SSSE3 and AVX2 kernels for the bulk of the input, built on the nibble lookups with
+    `pshufb` of W. Muła and D. Lemire (https://arxiv.org/abs/1704.00605). The kernels stop
+    at the first block they cannot handle, invalid characters or padding, and the scalar
+    code finishes the input and reports errors, so every backend accepts exactly the same
+    strings.
+*/
+
+#include "encode.h"
+
+#include "cpu.h"
+#include "sha.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+static const char HEX_DIGITS[] = "0123456789abcdef";
+static const char BASE64_ALPHABET[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+/* Bytes of each digest and the size of the words the `*_data` functions write them as */
+static const struct {
+    size_t size;
+    size_t word_size;
+} DIGESTS[] = {
+    [HASH_SHA1] = {20, 4},
+    [HASH_SHA2_224] = {28, 4},
+    [HASH_SHA2_256] = {32, 4},
+    [HASH_SHA2_384] = {48, 8},
+    [HASH_SHA2_512] = {64, 8},
+    [HASH_SHA3_224] = {28, 8},
+    [HASH_SHA3_256] = {32, 8},
+    [HASH_SHA3_384] = {48, 8},
+    [HASH_SHA3_512] = {64, 8},
+    [HASH_SHA2_512_224] = {28, 8},
+    [HASH_SHA2_512_256] = {32, 8},
+};
+
+static enum encode_backend active_backend = ENCODE_BACKEND_SCALAR;
+
+#ifdef HASH_X86
+
+# include <immintrin.h>
+
+/* Lookups of the base64 kernels, repeated in both halves of the AVX2 registers */
+# define BASE64_ENCODE_SHUFFLE 1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10
+# define BASE64_ENCODE_OFFSETS                                                                                         \
+     'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,     \
+         '+' - 62, '/' - 63, 'A', 0, 0
+# define BASE64_DECODE_LO 0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1a, 0x1b, 0x1b, 0x1b, 0x1a
+# define BASE64_DECODE_HI 0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10
+# define BASE64_DECODE_ROLL 0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0
+# define BASE64_DECODE_PACK 2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1
+
+/* 16 bytes to 32 hex digits per iteration, returns the number of bytes encoded */
+__attribute__((target("ssse3"))) static size_t
+hex_encode_ssse3(const uint8_t *data, size_t len, char *hex) {
+    const __m128i digits = _mm_loadu_si128((const __m128i *)HEX_DIGITS);
+    const __m128i nibble = _mm_set1_epi8(0x0f);
+    size_t i;
+
+    for (i = 0; i + 16 <= len; i += 16) {
+        __m128i x = _mm_loadu_si128((const __m128i *)(data + i));
+        __m128i hi = _mm_shuffle_epi8(digits, _mm_and_si128(_mm_srli_epi16(x, 4), nibble));
+        __m128i lo = _mm_shuffle_epi8(digits, _mm_and_si128(x, nibble));
+
+        _mm_storeu_si128((__m128i *)(hex + 2 * i), _mm_unpacklo_epi8(hi, lo));
+        _mm_storeu_si128((__m128i *)(hex + 2 * i + 16), _mm_unpackhi_epi8(hi, lo));
+    }
+    return i;
+}
+
+/* Values of 16 hex digits, `valid` is cleared in the lanes that hold anything else */
+__attribute__((target("ssse3"))) static inline __m128i
+hex_values_ssse3(__m128i c, __m128i *valid) {
+    __m128i digit = _mm_sub_epi8(c, _mm_set1_epi8('0'));
+    __m128i letter = _mm_sub_epi8(_mm_or_si128(c, _mm_set1_epi8(0x20)), _mm_set1_epi8('a'));
+    __m128i is_digit = _mm_cmpeq_epi8(_mm_min_epu8(digit, _mm_set1_epi8(9)), digit);
+    __m128i is_letter = _mm_cmpeq_epi8(_mm_min_epu8(letter, _mm_set1_epi8(5)), letter);
+
+    *valid = _mm_and_si128(*valid, _mm_or_si128(is_digit, is_letter));
+    return _mm_or_si128(_mm_and_si128(is_digit, digit),
+                        _mm_and_si128(is_letter, _mm_add_epi8(letter, _mm_set1_epi8(10))));
+}
+
+/* 32 hex digits to 16 bytes per iteration, returns the number of digits decoded */
+__attribute__((target("ssse3"))) static size_t
+hex_decode_ssse3(const char *hex, size_t len, uint8_t *data) {
+    const __m128i weights = _mm_set1_epi16(0x0110);  /* High nibble times 16 plus low nibble */
+    size_t i;
+
+    for (i = 0; i + 32 <= len; i += 32) {
+        __m128i valid = _mm_set1_epi8(-1);
+        __m128i a = hex_values_ssse3(_mm_loadu_si128((const __m128i *)(hex + i)), &valid);
+        __m128i b = hex_values_ssse3(_mm_loadu_si128((const __m128i *)(hex + i + 16)), &valid);
+
+        if (_mm_movemask_epi8(valid) != 0xffff) {
+            break;
+        }
+        a = _mm_maddubs_epi16(a, weights);
+        b = _mm_maddubs_epi16(b, weights);
+        _mm_storeu_si128((__m128i *)(data + i / 2), _mm_packus_epi16(a, b));
+    }
+    return i;
+}
+
+/* 12 bytes to 16 characters per iteration, 16 bytes are loaded so the last 4 are left to the caller */
+__attribute__((target("ssse3"))) static size_t
+base64_encode_ssse3(const uint8_t *data, size_t len, char *base64) {
+    const __m128i shuffle = _mm_setr_epi8(BASE64_ENCODE_SHUFFLE);
+    const __m128i offsets = _mm_setr_epi8(BASE64_ENCODE_OFFSETS);
+    size_t i;
+
+    for (i = 0; i + 16 <= len; i += 12) {
+        __m128i x = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(data + i)), shuffle);
+
+        /* Move the four 6-bit fields of every 3 bytes into their own byte */
+        __m128i ac = _mm_mulhi_epu16(_mm_and_si128(x, _mm_set1_epi32(0x0fc0fc00)), _mm_set1_epi32(0x04000040));
+        __m128i bd = _mm_mullo_epi16(_mm_and_si128(x, _mm_set1_epi32(0x003f03f0)), _mm_set1_epi32(0x01000010));
+        __m128i indices = _mm_or_si128(ac, bd);
+
+        /* 0-25 map to offset 13, 26-51 to 0, 52-61 to 1-10, 62 and 63 to 11 and 12 */
+        __m128i range = _mm_subs_epu8(indices, _mm_set1_epi8(51));
+        range = _mm_or_si128(range, _mm_and_si128(_mm_cmpgt_epi8(_mm_set1_epi8(26), indices), _mm_set1_epi8(13)));
+        _mm_storeu_si128((__m128i *)(base64 + i / 3 * 4),
+                         _mm_add_epi8(indices, _mm_shuffle_epi8(offsets, range)));
+    }
+    return i;
+}
+
+/* 16 characters to 12 bytes per iteration, returns the number of characters decoded */
+__attribute__((target("ssse3"))) static size_t
+base64_decode_ssse3(const char *base64, size_t len, uint8_t *data) {
+    const __m128i lut_lo = _mm_setr_epi8(BASE64_DECODE_LO);
+    const __m128i lut_hi = _mm_setr_epi8(BASE64_DECODE_HI);
+    const __m128i lut_roll = _mm_setr_epi8(BASE64_DECODE_ROLL);
+    const __m128i pack = _mm_setr_epi8(BASE64_DECODE_PACK);
+    const __m128i nibble = _mm_set1_epi8(0x0f);
+    size_t i;
+
+    for (i = 0; i + 16 <= len; i += 16) {
+        __m128i c = _mm_loadu_si128((const __m128i *)(base64 + i));
+        __m128i hi = _mm_and_si128(_mm_srli_epi32(c, 4), nibble);
+        __m128i lo = _mm_and_si128(c, nibble);
+        __m128i invalid = _mm_and_si128(_mm_shuffle_epi8(lut_lo, lo), _mm_shuffle_epi8(lut_hi, hi));
+        __m128i x;
+        uint32_t tail;
+
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(invalid, _mm_setzero_si128())) != 0xffff) {
+            break;
+        }
+
+        /* '/' shares its high nibble with '+' but not its offset */
+        x = _mm_add_epi8(c, _mm_shuffle_epi8(lut_roll, _mm_add_epi8(_mm_cmpeq_epi8(c, _mm_set1_epi8('/')), hi)));
+        x = _mm_madd_epi16(_mm_maddubs_epi16(x, _mm_set1_epi32(0x01400140)), _mm_set1_epi32(0x00011000));
+        x = _mm_shuffle_epi8(x, pack);
+        tail = (uint32_t)_mm_cvtsi128_si32(_mm_srli_si128(x, 8));
+        _mm_storel_epi64((__m128i *)(data + i / 4 * 3), x);
+        memcpy(data + i / 4 * 3 + 8, &tail, 4);
+    }
+    return i;
+}
+
+/* 32 bytes to 64 hex digits per iteration, the SSSE3 kernel takes a remaining half block */
+__attribute__((target("avx2"))) static size_t
+hex_encode_avx2(const uint8_t *data, size_t len, char *hex) {
+    const __m256i digits = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)HEX_DIGITS));
+    const __m256i nibble = _mm256_set1_epi8(0x0f);
+    size_t i;
+
+    for (i = 0; i + 32 <= len; i += 32) {
+        __m256i x = _mm256_loadu_si256((const __m256i *)(data + i));
+        __m256i hi = _mm256_shuffle_epi8(digits, _mm256_and_si256(_mm256_srli_epi16(x, 4), nibble));
+        __m256i lo = _mm256_shuffle_epi8(digits, _mm256_and_si256(x, nibble));
+        __m256i first = _mm256_unpacklo_epi8(hi, lo);  /* Bytes 0-7 and 16-23 */
+        __m256i second = _mm256_unpackhi_epi8(hi, lo);  /* Bytes 8-15 and 24-31 */
+
+        _mm256_storeu_si256((__m256i *)(hex + 2 * i), _mm256_permute2x128_si256(first, second, 0x20));
+        _mm256_storeu_si256((__m256i *)(hex + 2 * i + 32), _mm256_permute2x128_si256(first, second, 0x31));
+    }
+    return i + hex_encode_ssse3(data + i, len - i, hex + 2 * i);
+}
+
+__attribute__((target("avx2"))) static inline __m256i
+hex_values_avx2(__m256i c, __m256i *valid) {
+    __m256i digit = _mm256_sub_epi8(c, _mm256_set1_epi8('0'));
+    __m256i letter = _mm256_sub_epi8(_mm256_or_si256(c, _mm256_set1_epi8(0x20)), _mm256_set1_epi8('a'));
+    __m256i is_digit = _mm256_cmpeq_epi8(_mm256_min_epu8(digit, _mm256_set1_epi8(9)), digit);
+    __m256i is_letter = _mm256_cmpeq_epi8(_mm256_min_epu8(letter, _mm256_set1_epi8(5)), letter);
+
+    *valid = _mm256_and_si256(*valid, _mm256_or_si256(is_digit, is_letter));
+    return _mm256_or_si256(_mm256_and_si256(is_digit, digit),
+                           _mm256_and_si256(is_letter, _mm256_add_epi8(letter, _mm256_set1_epi8(10))));
+}
+
+__attribute__((target("avx2"))) static size_t
+hex_decode_avx2(const char *hex, size_t len, uint8_t *data) {
+    const __m256i weights = _mm256_set1_epi16(0x0110);
+    size_t i;
+
+    for (i = 0; i + 64 <= len; i += 64) {
+        __m256i valid = _mm256_set1_epi8(-1);
+        __m256i a = hex_values_avx2(_mm256_loadu_si256((const __m256i *)(hex + i)), &valid);
+        __m256i b = hex_values_avx2(_mm256_loadu_si256((const __m256i *)(hex + i + 32)), &valid);
+
+        if (_mm256_movemask_epi8(valid) != -1) {
+            break;
+        }
+        a = _mm256_maddubs_epi16(a, weights);
+        b = _mm256_maddubs_epi16(b, weights);
+
+        /* The pack interleaves the halves of `a` and `b`, put them back in order */
+        _mm256_storeu_si256((__m256i *)(data + i / 2), _mm256_permute4x64_epi64(_mm256_packus_epi16(a, b), 0xd8));
+    }
+    return i + hex_decode_ssse3(hex + i, len - i, data + i / 2);
+}
+
+/* 24 bytes to 32 characters per iteration, each half of the register takes 12 of them */
+__attribute__((target("avx2"))) static size_t
+base64_encode_avx2(const uint8_t *data, size_t len, char *base64) {
+    const __m256i shuffle = _mm256_setr_epi8(BASE64_ENCODE_SHUFFLE, BASE64_ENCODE_SHUFFLE);
+    const __m256i offsets = _mm256_setr_epi8(BASE64_ENCODE_OFFSETS, BASE64_ENCODE_OFFSETS);
+    size_t i;
+
+    for (i = 0; i + 28 <= len; i += 24) {
+        __m256i x = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i *)(data + i))),
+                                            _mm_loadu_si128((const __m128i *)(data + i + 12)), 1);
+        __m256i ac, bd, indices, range;
+
+        x = _mm256_shuffle_epi8(x, shuffle);
+        ac = _mm256_mulhi_epu16(_mm256_and_si256(x, _mm256_set1_epi32(0x0fc0fc00)), _mm256_set1_epi32(0x04000040));
+        bd = _mm256_mullo_epi16(_mm256_and_si256(x, _mm256_set1_epi32(0x003f03f0)), _mm256_set1_epi32(0x01000010));
+        indices = _mm256_or_si256(ac, bd);
+
+        range = _mm256_subs_epu8(indices, _mm256_set1_epi8(51));
+        range = _mm256_or_si256(range, _mm256_and_si256(_mm256_cmpgt_epi8(_mm256_set1_epi8(26), indices),
+                                                        _mm256_set1_epi8(13)));
+        _mm256_storeu_si256((__m256i *)(base64 + i / 3 * 4),
+                            _mm256_add_epi8(indices, _mm256_shuffle_epi8(offsets, range)));
+    }
+    return i + base64_encode_ssse3(data + i, len - i, base64 + i / 3 * 4);
+}
+
+__attribute__((target("avx2"))) static size_t
+base64_decode_avx2(const char *base64, size_t len, uint8_t *data) {
+    const __m256i lut_lo = _mm256_setr_epi8(BASE64_DECODE_LO, BASE64_DECODE_LO);
+    const __m256i lut_hi = _mm256_setr_epi8(BASE64_DECODE_HI, BASE64_DECODE_HI);
+    const __m256i lut_roll = _mm256_setr_epi8(BASE64_DECODE_ROLL, BASE64_DECODE_ROLL);
+    const __m256i pack = _mm256_setr_epi8(BASE64_DECODE_PACK, BASE64_DECODE_PACK);
+    const __m256i nibble = _mm256_set1_epi8(0x0f);
+    size_t i;
+
+    for (i = 0; i + 32 <= len; i += 32) {
+        __m256i c = _mm256_loadu_si256((const __m256i *)(base64 + i));
+        __m256i hi = _mm256_and_si256(_mm256_srli_epi32(c, 4), nibble);
+        __m256i lo = _mm256_and_si256(c, nibble);
+        __m256i x;
+
+        if (!_mm256_testz_si256(_mm256_shuffle_epi8(lut_lo, lo), _mm256_shuffle_epi8(lut_hi, hi))) {
+            break;
+        }
+
+        x = _mm256_add_epi8(c, _mm256_shuffle_epi8(lut_roll,
+                                                   _mm256_add_epi8(_mm256_cmpeq_epi8(c, _mm256_set1_epi8('/')), hi)));
+        x = _mm256_madd_epi16(_mm256_maddubs_epi16(x, _mm256_set1_epi32(0x01400140)), _mm256_set1_epi32(0x00011000));
+
+        /* 12 bytes at the bottom of each half, gathered into the low 24 bytes */
+        x = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(x, pack), _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7));
+        _mm_storeu_si128((__m128i *)(data + i / 4 * 3), _mm256_castsi256_si128(x));
+        _mm_storel_epi64((__m128i *)(data + i / 4 * 3 + 16), _mm256_extracti128_si256(x, 1));
+    }
+    return i + base64_decode_ssse3(base64 + i, len - i, data + i / 4 * 3);
+}
+
+#endif /* HASH_X86 */
+
+/**
+   Size in bytes of the digests of :c:var:`algorithm`.
+
+   :param algorithm: Hash function.
+   :type algorithm: enum hash_algorithm
+   :return: The digest size, or 0 if :c:var:`algorithm` is not supported.
+   :rtype: size_t
+*/
+size_t
+hash_digest_size(enum hash_algorithm algorithm) {
+    return (unsigned)algorithm < sizeof DIGESTS / sizeof *DIGESTS ? DIGESTS[algorithm].size : 0;
+}
+
+/**
+   Convert the words written by an algorithm's `*_data` or `*_final` function to the
+   digest as a byte string, in the order it is printed and compared.
+
+   :param algorithm: Function that computed :c:var:`hash`.
+   :type algorithm: enum hash_algorithm
+   :param hash: The `uint32_t` or `uint64_t` words of the digest.
+   :type hash: const void *
+   :param digest: Receives :c:func:`hash_digest_size` bytes, it may not overlap :c:var:`hash`.
+   :type digest: void *
+   :return: 0 on success, -1 if :c:var:`algorithm` is not supported.
+   :rtype: int
+*/
+int
+hash_digest_bytes(enum hash_algorithm algorithm, const void *hash, void *digest) {
+    uint8_t *out = digest;
+    size_t size = hash_digest_size(algorithm);
+
+    if (!size) {
+        return -1;
+    }
+
+    if (DIGESTS[algorithm].word_size == 4) {
+        const uint32_t *words = hash;
+        for (size_t i = 0; i < size / 4; i++) {
+            out[4 * i] = words[i] >> 24;
+            out[4 * i + 1] = (words[i] >> 16) & 0xff;
+            out[4 * i + 2] = (words[i] >> 8) & 0xff;
+            out[4 * i + 3] = words[i] & 0xff;
+        }
+    } else {
+        /* 224-bit digests end in the upper half of their last word */
+        const uint64_t *words = hash;
+        for (size_t i = 0; i < size; i++) {
+            out[i] = (words[i / 8] >> (56 - 8 * (i % 8))) & 0xff;
+        }
+    }
+    return 0;
+}
+
+/**
+   Compute the digest of a message as a byte string, the one-shot counterpart of
+   :c:func:`hash_digest_bytes`.
+
+   :param algorithm: Hash function.
+   :type algorithm: enum hash_algorithm
+   :param data: The message.
+   :type data: const void *
+   :param len: Length of :c:var:`data` in bytes.
+   :type len: size_t
+   :param digest: Receives :c:func:`hash_digest_size` bytes.
+   :type digest: void *
+   :return: 0 on success, -1 if :c:var:`algorithm` is not supported.
+   :rtype: int
+*/
+int
+hash_digest(enum hash_algorithm algorithm, const void *data, size_t len, void *digest) {
+    uint64_t hash[8];
+
+    switch (algorithm) {
+        case HASH_SHA1:
+            sha1_data(data, len, (uint32_t *)hash);
+            break;
+        case HASH_SHA2_224:
+            sha2_224_data(data, len, (uint32_t *)hash);
+            break;
+        case HASH_SHA2_256:
+            sha2_256_data(data, len, (uint32_t *)hash);
+            break;
+        case HASH_SHA2_384:
+            sha2_384_data(data, len, hash);
+            break;
+        case HASH_SHA2_512:
+            sha2_512_data(data, len, hash);
+            break;
+        case HASH_SHA3_224:
+            sha3_224_data(data, len, hash);
+            break;
+        case HASH_SHA3_256:
+            sha3_256_data(data, len, hash);
+            break;
+        case HASH_SHA3_384:
+            sha3_384_data(data, len, hash);
+            break;
+        case HASH_SHA3_512:
+            sha3_512_data(data, len, hash);
+            break;
+        case HASH_SHA2_512_224:
+            sha2_512_224_data(data, len, hash);
+            break;
+        case HASH_SHA2_512_256:
+            sha2_512_256_data(data, len, hash);
+            break;
+        default:
+            return -1;
+    }
+    return hash_digest_bytes(algorithm, hash, digest);
+}
+
+/* Zero if the two buffers are equal, the time taken depends on `len` only */
+static uint64_t
+difference(const uint8_t *a, const uint8_t *b, size_t len) {
+    uint64_t diff = 0;
+    size_t i = 0;
+
+    for (; i + 8 <= len; i += 8) {
+        uint64_t x, y;
+        memcpy(&x, a + i, 8);
+        memcpy(&y, b + i, 8);
+        diff |= x ^ y;
+    }
+    for (; i < len; i++) {
+        diff |= a[i] ^ b[i];
+    }
+    return diff;
+}
+
+/**
+   Compare two digests in constant time, the time taken does not depend on where or
+   whether they differ.
+
+   :param a: First digest.
+   :type a: const void *
+   :param b: Second digest.
+   :type b: const void *
+   :param len: Length of each digest in bytes.
+   :type len: size_t
+   :return: 1 if the digests are equal, 0 otherwise.
+   :rtype: int
+*/
+int
+hash_digest_equal(const void *a, const void *b, size_t len) {
+    uint64_t diff = difference(a, b, len);
+
+    return (int)(((diff | (0 - diff)) >> 63) ^ 1);
+}
+
+/**
+   Compare two arrays of digests pairwise in constant time, for instance the digests
+   listed in a manifest against freshly computed ones. Every pair is compared in full
+   whatever the outcome of the others, so the timing reveals nothing but :c:var:`count`.
+
+   :param a: :c:var:`count` digests stored back to back.
+   :type a: const void *
+   :param b: :c:var:`count` digests stored back to back.
+   :type b: const void *
+   :param digest_len: Length of each digest in bytes.
+   :type digest_len: size_t
+   :param count: Number of digests in each array.
+   :type count: size_t
+   :param equal: Receives :c:var:`count` flags, 1 where the digests are equal and 0 where
+                 they differ, or NULL if only the number of mismatches is needed.
+   :type equal: uint8_t *
+   :return: Number of pairs that differ.
+   :rtype: size_t
+*/
+size_t
+hash_digest_compare(const void *a, const void *b, size_t digest_len, size_t count, uint8_t *equal) {
+    const uint8_t *x = a, *y = b;
+    size_t mismatches = 0;
+
+    for (size_t i = 0; i < count; i++) {
+        uint64_t diff = difference(x + i * digest_len, y + i * digest_len, digest_len);
+        uint64_t differs = (diff | (0 - diff)) >> 63;
+
+        if (equal) {
+            equal[i] = differs ^ 1;
+        }
+        mismatches += differs;
+    }
+    return mismatches;
+}
+
+/**
+   Select the implementation of the hex and base64 encoders and decoders.
+
+   The fastest backend supported by the CPU is selected when the library is loaded,
+   this is only needed to force a particular one, e.g. to compare their outputs.
+   It is not thread-safe and should be called before any encoding starts.
+
+   :param backend: ``ENCODE_BACKEND_AUTO`` for the fastest supported backend,
+                   ``ENCODE_BACKEND_SCALAR`` for the portable C code,
+                   ``ENCODE_BACKEND_SSSE3`` for 16 bytes or ``ENCODE_BACKEND_AVX2`` for
+                   32 bytes at a time.
+   :type backend: enum encode_backend
+   :return: 0 on success, -1 if the CPU does not support :c:var:`backend`.
+   :rtype: int
+*/
+int
+encode_set_backend(enum encode_backend backend) {
+    unsigned features = hash_cpu_features();
+
+    if (backend == ENCODE_BACKEND_AUTO) {
+        if (features & CPU_AVX2) {
+            backend = ENCODE_BACKEND_AVX2;
+        } else if (features & CPU_SSSE3) {
+            backend = ENCODE_BACKEND_SSSE3;
+        } else {
+            backend = ENCODE_BACKEND_SCALAR;
+        }
+    }
+
+    switch (backend) {
+        case ENCODE_BACKEND_SCALAR:
+            break;
+        case ENCODE_BACKEND_SSSE3:
+            if (!(features & CPU_SSSE3)) {
+                return -1;
+            }
+            break;
+        case ENCODE_BACKEND_AVX2:
+            if (!(features & CPU_AVX2)) {
+                return -1;
+            }
+            break;
+        default:
+            return -1;
+    }
+
+    active_backend = backend;
+    return 0;
+}
+
+/**
+   Get the backend currently used by the hex and base64 functions.
+
+   :return: ``ENCODE_BACKEND_SCALAR``, ``ENCODE_BACKEND_SSSE3`` or ``ENCODE_BACKEND_AVX2``.
+   :rtype: enum encode_backend
+*/
+enum encode_backend
+encode_get_backend(void) {
+    return active_backend;
+}
+
+#ifdef __GNUC__
+__attribute__((constructor)) static void
+encode_select_backend(void) {
+    encode_set_backend(ENCODE_BACKEND_AUTO);
+}
+#endif
+
+/**
+   Encode bytes as lowercase hex digits, such as a digest from :c:func:`hash_digest`.
+
+   :param data: Bytes to encode.
+   :type data: const void *
+   :param len: Length of :c:var:`data` in bytes.
+   :type len: size_t
+   :param hex: Receives ``HEX_ENCODED_LEN(len)`` digits and a terminating NUL.
+   :type hex: char *
+*/
+void
+hex_encode(const void *data, size_t len, char *hex) {
+    const uint8_t *in = data;
+    size_t i = 0;
+
+    switch (active_backend) {
+#ifdef HASH_X86
+        case ENCODE_BACKEND_AVX2:
+            i = hex_encode_avx2(in, len, hex);
+            break;
+        case ENCODE_BACKEND_SSSE3:
+            i = hex_encode_ssse3(in, len, hex);
+            break;
+#endif
+        default:
+            break;
+    }
+
+    for (; i < len; i++) {
+        hex[2 * i] = HEX_DIGITS[in[i] >> 4];
+        hex[2 * i + 1] = HEX_DIGITS[in[i] & 0x0f];
+    }
+    hex[2 * len] = '\0';
+}
+
+/* Value of a hex digit in either case, or -1 */
+static int
+hex_value(unsigned char c) {
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    c |= 0x20;
+    return c >= 'a' && c <= 'f' ? c - 'a' + 10 : -1;
+}
+
+/**
+   Decode hex digits in upper or lower case.
+
+   :param hex: The digits, they do not have to be NUL-terminated.
+   :type hex: const char *
+   :param hex_len: Number of digits.
+   :type hex_len: size_t
+   :param data: Receives ``hex_len / 2`` bytes.
+   :type data: void *
+   :return: 0 on success, -1 if :c:var:`hex_len` is odd or a character is not a hex digit.
+            :c:var:`data` may have been partially written on failure.
+   :rtype: int
+*/
+int
+hex_decode(const char *hex, size_t hex_len, void *data) {
+    uint8_t *out = data;
+    size_t i = 0;
+
+    if (hex_len % 2) {
+        return -1;
+    }
+
+    switch (active_backend) {
+#ifdef HASH_X86
+        case ENCODE_BACKEND_AVX2:
+            i = hex_decode_avx2(hex, hex_len, out);
+            break;
+        case ENCODE_BACKEND_SSSE3:
+            i = hex_decode_ssse3(hex, hex_len, out);
+            break;
+#endif
+        default:
+            break;
+    }
+
+    for (; i < hex_len; i += 2) {
+        int hi = hex_value(hex[i]), lo = hex_value(hex[i + 1]);
+
+        if (hi < 0 || lo < 0) {
+            return -1;
+        }
+        out[i / 2] = (uint8_t)(hi << 4 | lo);
+    }
+    return 0;
+}
+
+/**
+   Encode bytes as base64 with the standard alphabet and ``=`` padding of RFC 4648.
+
+   :param data: Bytes to encode.
+   :type data: const void *
+   :param len: Length of :c:var:`data` in bytes.
+   :type len: size_t
+   :param base64: Receives ``BASE64_ENCODED_LEN(len)`` characters and a terminating NUL.
+   :type base64: char *
+   :return: Number of characters written, not counting the NUL.
+   :rtype: size_t
+*/
+size_t
+base64_encode(const void *data, size_t len, char *base64) {
+    const uint8_t *in = data;
+    char *out;
+    size_t i = 0;
+
+    switch (active_backend) {
+#ifdef HASH_X86
+        case ENCODE_BACKEND_AVX2:
+            i = base64_encode_avx2(in, len, base64);
+            break;
+        case ENCODE_BACKEND_SSSE3:
+            i = base64_encode_ssse3(in, len, base64);
+            break;
+#endif
+        default:
+            break;
+    }
+
+    out = base64 + i / 3 * 4;
+    for (; i + 3 <= len; i += 3) {
+        uint32_t x = (uint32_t)in[i] << 16 | (uint32_t)in[i + 1] << 8 | in[i + 2];
+        *out++ = BASE64_ALPHABET[x >> 18];
+        *out++ = BASE64_ALPHABET[(x >> 12) & 0x3f];
+        *out++ = BASE64_ALPHABET[(x >> 6) & 0x3f];
+        *out++ = BASE64_ALPHABET[x & 0x3f];
+    }
+    if (i < len) {
+        uint32_t x = (uint32_t)in[i] << 16 | (i + 1 < len ? (uint32_t)in[i + 1] << 8 : 0);
+        *out++ = BASE64_ALPHABET[x >> 18];
+        *out++ = BASE64_ALPHABET[(x >> 12) & 0x3f];
+        *out++ = i + 1 < len ? BASE64_ALPHABET[(x >> 6) & 0x3f] : '=';
+        *out++ = '=';
+    }
+    *out = '\0';
+    return out - base64;
+}
+
+/* Value of a base64 character, or -1 */
+static int
+base64_value(unsigned char c) {
+    if (c >= 'A' && c <= 'Z') {
+        return c - 'A';
+    }
+    if (c >= 'a' && c <= 'z') {
+        return c - 'a' + 26;
+    }
+    if (c >= '0' && c <= '9') {
+        return c - '0' + 52;
+    }
+    return c == '+' ? 62 : c == '/' ? 63 : -1;
+}
+
+/**
+   Decode base64 with the standard alphabet. Only the canonical encoding is accepted:
+   the input is padded with ``=`` to a multiple of 4 characters, and the bits after the
+   last byte are zero, so every byte string has exactly one valid encoding.
+
+   :param base64: The characters, they do not have to be NUL-terminated.
+   :type base64: const char *
+   :param base64_len: Number of characters.
+   :type base64_len: size_t
+   :param data: Receives up to ``BASE64_DECODED_MAX(base64_len)`` bytes.
+   :type data: void *
+   :param data_len: Receives the number of bytes decoded.
+   :type data_len: size_t *
+   :return: 0 on success, -1 if :c:var:`base64` is not a canonical encoding.
+            :c:var:`data` may have been partially written on failure.
+   :rtype: int
+*/
+int
+base64_decode(const char *base64, size_t base64_len, void *data, size_t *data_len) {
+    uint8_t *out = data;
+    size_t i = 0;
+
+    if (base64_len % 4) {
+        return -1;
+    }
+
+    switch (active_backend) {
+#ifdef HASH_X86
+        case ENCODE_BACKEND_AVX2:
+            i = base64_decode_avx2(base64, base64_len, out);
+            break;
+        case ENCODE_BACKEND_SSSE3:
+            i = base64_decode_ssse3(base64, base64_len, out);
+            break;
+#endif
+        default:
+            break;
+    }
+
+    for (out += i / 4 * 3; i < base64_len; i += 4) {
+        int a = base64_value(base64[i]), b = base64_value(base64[i + 1]);
+        int c = base64_value(base64[i + 2]), d = base64_value(base64[i + 3]);
+        int last = i + 4 == base64_len;
+
+        if (a < 0 || b < 0) {
+            return -1;
+        }
+        *out++ = (uint8_t)(a << 2 | b >> 4);
+
+        if (last && base64[i + 2] == '=' && base64[i + 3] == '=') {
+            if (b & 0x0f) {
+                return -1;
+            }
+            break;
+        }
+        if (c < 0) {
+            return -1;
+        }
+        *out++ = (uint8_t)((b & 0x0f) << 4 | c >> 2);
+
+        if (last && base64[i + 3] == '=') {
+            if (c & 0x03) {
+                return -1;
+            }
+            break;
+        }
+        if (d < 0) {
+            return -1;
+        }
+        *out++ = (uint8_t)((c & 0x03) << 6 | d);
+    }
+
+    *data_len = out - (uint8_t *)data;
+    return 0;
+}
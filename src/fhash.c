@@ -0,0 +1,764 @@
+/*
+    A fast non-cryptographic hash for hash tables, bucketing and checksums of trusted data.
+
+    The construction follows XXH3 by Y. Collet (https://github.com/Cyan4973/xxHash): inputs
+    of up to 16 bytes are mixed with a few multiplications, inputs of up to 240 bytes in
+    16-byte pieces folded through 64x64 to 128-bit products, and longer ones by eight
+    64-bit accumulators that take 64-byte stripes of input against a sliding window of
+    the secret, with a scramble after every block of 16 stripes. The stripe loop has SSE2
+    and AVX2 kernels which give the same results as the scalar code.
+
+    The secret is the first 192 bytes of SHAKE256("fhash") rather than that of XXH3, so
+    the hashes are not those of xxHash. They are the same on every platform and will not
+    change between versions of the library. The hash does not resist collisions chosen by
+    an attacker who can see its outputs, use SipHash or a cryptographic hash for that.
+*/
+
+#include "fhash.h"
+
+#include "cpu.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#define PRIME32_1 0x9e3779b1u
+#define PRIME32_2 0x85ebca77u
+#define PRIME32_3 0xc2b2ae3du
+#define PRIME64_1 0x9e3779b185ebca87ull
+#define PRIME64_2 0xc2b2ae3d27d4eb4full
+#define PRIME64_3 0x165667b19e3779f9ull
+#define PRIME64_4 0x85ebca77c2b2ae63ull
+#define PRIME64_5 0x27d4eb2f165667c5ull
+
+#define STRIPE_LEN 64
+#define SECRET_CONSUME_RATE 8
+#define STRIPES_PER_BLOCK ((FHASH_SECRET_SIZE - STRIPE_LEN) / SECRET_CONSUME_RATE)
+#define MIDSIZE_MAX 240
+
+static const uint8_t SECRET[FHASH_SECRET_SIZE] = {
+    0x6c, 0x3e, 0xca, 0xf2, 0xb6, 0x52, 0xf9, 0xc6, 0x9d, 0xad, 0x56, 0xc3, 0xf8, 0x0d, 0xc0, 0x94,
+    0xe9, 0x4c, 0xad, 0x1c, 0x34, 0x3f, 0xc5, 0xfd, 0x43, 0x81, 0x17, 0x85, 0xa7, 0x59, 0xa0, 0x0f,
+    0x94, 0xe0, 0xcc, 0xb1, 0xf9, 0xf1, 0x6e, 0xc7, 0x3a, 0x48, 0x04, 0x98, 0xb8, 0xde, 0xb8, 0xe2,
+    0x96, 0xba, 0x9d, 0xd6, 0x13, 0xda, 0x76, 0xc1, 0xce, 0x5d, 0xa3, 0xc8, 0xf4, 0xe6, 0xf9, 0x4a,
+    0xbc, 0x49, 0xc3, 0x3c, 0x66, 0x82, 0x52, 0x8c, 0x06, 0xaa, 0x37, 0x4f, 0x28, 0xfd, 0xd3, 0x9e,
+    0x7a, 0x59, 0xca, 0xca, 0x9c, 0x23, 0x81, 0x45, 0x1e, 0xdb, 0xe2, 0xd7, 0x92, 0xd7, 0x4c, 0x6f,
+    0x3f, 0xfa, 0xf2, 0xd6, 0xaf, 0x5d, 0x56, 0x29, 0x00, 0x39, 0x35, 0xaf, 0x6e, 0x12, 0xeb, 0xbc,
+    0x9f, 0xfc, 0xa2, 0x1c, 0x35, 0x26, 0x53, 0x18, 0xb4, 0xfe, 0x3e, 0x58, 0x6f, 0xb6, 0xa0, 0x24,
+    0xcf, 0x9e, 0xb4, 0xbb, 0xf9, 0xa6, 0x14, 0x8c, 0xaf, 0x04, 0x7c, 0x30, 0xb5, 0x75, 0x16, 0xb6,
+    0x3c, 0x8d, 0x16, 0x1e, 0x5a, 0xab, 0xd7, 0x65, 0xb6, 0xe9, 0x16, 0x09, 0x8d, 0x2b, 0xeb, 0x0d,
+    0xad, 0xef, 0xbd, 0xb3, 0x0c, 0x2b, 0x0b, 0xa1, 0xce, 0x96, 0x03, 0x56, 0x31, 0x5b, 0xcd, 0x0c,
+    0x63, 0x67, 0xf6, 0x48, 0x89, 0x1e, 0xb3, 0xe5, 0xdb, 0x3f, 0xf6, 0x4f, 0xd5, 0x59, 0x7a, 0x82,
+};
+
+static const uint64_t INIT_ACC[8] = {PRIME32_3, PRIME64_1, PRIME64_2, PRIME64_3,
+                                     PRIME64_4, PRIME32_2, PRIME64_5, PRIME32_1};
+
+static enum fhash_backend active_backend = FHASH_BACKEND_SCALAR;
+
+static inline uint32_t
+load32_le(const uint8_t *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline uint64_t
+load64_le(const uint8_t *p) {
+    return (uint64_t)p[0] | ((uint64_t)p[1] << 8) | ((uint64_t)p[2] << 16) | ((uint64_t)p[3] << 24) |
+           ((uint64_t)p[4] << 32) | ((uint64_t)p[5] << 40) | ((uint64_t)p[6] << 48) | ((uint64_t)p[7] << 56);
+}
+
+static inline void
+store64_le(uint8_t *p, uint64_t x) {
+    for (size_t i = 0; i < 8; i++) {
+        p[i] = (uint8_t)(x >> (8 * i));
+    }
+}
+
+static inline uint64_t
+rotl64(uint64_t x, unsigned n) {
+    return (x << n) | (x >> (64 - n));
+}
+
+static inline uint32_t
+rotl32(uint32_t x, unsigned n) {
+    return (x << n) | (x >> (32 - n));
+}
+
+static inline struct fhash128
+mul128(uint64_t a, uint64_t b) {
+#ifdef __SIZEOF_INT128__
+    __extension__ typedef unsigned __int128 uint128_t;
+    uint128_t product = (uint128_t)a * b;
+    return (struct fhash128){(uint64_t)product, (uint64_t)(product >> 64)};
+#else
+    uint64_t lo_lo = (a & 0xffffffff) * (b & 0xffffffff);
+    uint64_t hi_lo = (a >> 32) * (b & 0xffffffff);
+    uint64_t lo_hi = (a & 0xffffffff) * (b >> 32);
+    uint64_t hi_hi = (a >> 32) * (b >> 32);
+    uint64_t cross = (lo_lo >> 32) + (hi_lo & 0xffffffff) + lo_hi;
+    return (struct fhash128){(cross << 32) | (lo_lo & 0xffffffff), hi_hi + (hi_lo >> 32) + (cross >> 32)};
+#endif
+}
+
+/* Both halves of the 128-bit product folded together, the core mixing step */
+static inline uint64_t
+mul_fold64(uint64_t a, uint64_t b) {
+    struct fhash128 product = mul128(a, b);
+    return product.low ^ product.high;
+}
+
+static inline uint64_t
+avalanche(uint64_t h) {
+    h ^= h >> 37;
+    h *= 0x165667919e3779f9ull;
+    return h ^ (h >> 32);
+}
+
+/* Two rounds for the inputs of up to 3 bytes, whose bits are not spread by any multiplication before */
+static inline uint64_t
+avalanche_short(uint64_t h) {
+    h ^= h >> 33;
+    h *= PRIME64_2;
+    h ^= h >> 29;
+    h *= PRIME64_3;
+    return h ^ (h >> 32);
+}
+
+/* A stronger finish for the inputs of 4 to 8 bytes, which are mixed with a single XOR */
+static inline uint64_t
+rrmxmx(uint64_t h, uint64_t len) {
+    h ^= rotl64(h, 49) ^ rotl64(h, 24);
+    h *= 0x9fb21c651e98df25ull;
+    h ^= (h >> 35) + len;
+    h *= 0x9fb21c651e98df25ull;
+    return h ^ (h >> 28);
+}
+
+static inline uint64_t
+mix16(const uint8_t *in, const uint8_t *secret, uint64_t seed) {
+    return mul_fold64(load64_le(in) ^ (load64_le(secret) + seed), load64_le(in + 8) ^ (load64_le(secret + 8) - seed));
+}
+
+/* Merge the accumulators into one word */
+static uint64_t
+merge(const uint64_t *acc, const uint8_t *secret, uint64_t start) {
+    uint64_t h = start;
+
+    for (size_t i = 0; i < 4; i++) {
+        h += mul_fold64(acc[2 * i] ^ load64_le(secret + 16 * i), acc[2 * i + 1] ^ load64_le(secret + 16 * i + 8));
+    }
+    return avalanche(h);
+}
+
+/*
+    Seeds other than 0 give the long input loop a secret of its own, the seed is added
+    to the even words of the default secret and subtracted from the odd ones.
+*/
+static void
+derive_secret(uint8_t *secret, uint64_t seed) {
+    for (size_t i = 0; i < FHASH_SECRET_SIZE; i += 16) {
+        store64_le(secret + i, load64_le(SECRET + i) + seed);
+        store64_le(secret + i + 8, load64_le(SECRET + i + 8) - seed);
+    }
+}
+
+/* Stripes of 64 bytes, each against the secret 8 bytes further than the one before */
+static void
+accumulate_scalar(uint64_t *acc, const uint8_t *in, const uint8_t *secret, size_t num_stripes) {
+    for (size_t n = 0; n < num_stripes; n++) {
+        const uint8_t *stripe = in + n * STRIPE_LEN, *key = secret + n * SECRET_CONSUME_RATE;
+
+        for (size_t i = 0; i < 8; i++) {
+            uint64_t data = load64_le(stripe + 8 * i);
+            uint64_t keyed = data ^ load64_le(key + 8 * i);
+
+            acc[i ^ 1] += data;
+            acc[i] += (keyed & 0xffffffff) * (keyed >> 32);
+        }
+    }
+}
+
+static void
+scramble_scalar(uint64_t *acc, const uint8_t *secret) {
+    for (size_t i = 0; i < 8; i++) {
+        acc[i] ^= acc[i] >> 47;
+        acc[i] ^= load64_le(secret + 8 * i);
+        acc[i] *= PRIME32_1;
+    }
+}
+
+#ifdef HASH_X86
+
+# include <immintrin.h>
+
+/* The accumulators are little-endian in memory like the input, so the kernels load both directly */
+__attribute__((target("sse2"))) static void
+accumulate_sse2(uint64_t *acc, const uint8_t *in, const uint8_t *secret, size_t num_stripes) {
+    __m128i a[4];
+
+    for (size_t i = 0; i < 4; i++) {
+        a[i] = _mm_loadu_si128((const __m128i *)(acc + 2 * i));
+    }
+    for (size_t n = 0; n < num_stripes; n++) {
+        const uint8_t *stripe = in + n * STRIPE_LEN, *key = secret + n * SECRET_CONSUME_RATE;
+
+        for (size_t i = 0; i < 4; i++) {
+            __m128i data = _mm_loadu_si128((const __m128i *)(stripe + 16 * i));
+            __m128i keyed = _mm_xor_si128(data, _mm_loadu_si128((const __m128i *)(key + 16 * i)));
+            __m128i product = _mm_mul_epu32(keyed, _mm_shuffle_epi32(keyed, _MM_SHUFFLE(0, 3, 0, 1)));
+
+            a[i] = _mm_add_epi64(a[i], _mm_shuffle_epi32(data, _MM_SHUFFLE(1, 0, 3, 2)));
+            a[i] = _mm_add_epi64(a[i], product);
+        }
+    }
+    for (size_t i = 0; i < 4; i++) {
+        _mm_storeu_si128((__m128i *)(acc + 2 * i), a[i]);
+    }
+}
+
+/* A 64-bit multiplication by a 32-bit constant from two 32x32 to 64-bit products */
+__attribute__((target("sse2"))) static void
+scramble_sse2(uint64_t *acc, const uint8_t *secret) {
+    const __m128i prime = _mm_set1_epi32((int)PRIME32_1);
+
+    for (size_t i = 0; i < 4; i++) {
+        __m128i a = _mm_loadu_si128((const __m128i *)(acc + 2 * i));
+
+        a = _mm_xor_si128(a, _mm_srli_epi64(a, 47));
+        a = _mm_xor_si128(a, _mm_loadu_si128((const __m128i *)(secret + 16 * i)));
+        __m128i low = _mm_mul_epu32(a, prime);
+        __m128i high = _mm_mul_epu32(_mm_shuffle_epi32(a, _MM_SHUFFLE(0, 3, 0, 1)), prime);
+        _mm_storeu_si128((__m128i *)(acc + 2 * i), _mm_add_epi64(low, _mm_slli_epi64(high, 32)));
+    }
+}
+
+__attribute__((target("avx2"))) static void
+accumulate_avx2(uint64_t *acc, const uint8_t *in, const uint8_t *secret, size_t num_stripes) {
+    __m256i a0 = _mm256_loadu_si256((const __m256i *)acc);
+    __m256i a1 = _mm256_loadu_si256((const __m256i *)(acc + 4));
+
+    for (size_t n = 0; n < num_stripes; n++) {
+        const uint8_t *stripe = in + n * STRIPE_LEN, *key = secret + n * SECRET_CONSUME_RATE;
+        __m256i d0 = _mm256_loadu_si256((const __m256i *)stripe);
+        __m256i d1 = _mm256_loadu_si256((const __m256i *)(stripe + 32));
+        __m256i k0 = _mm256_xor_si256(d0, _mm256_loadu_si256((const __m256i *)key));
+        __m256i k1 = _mm256_xor_si256(d1, _mm256_loadu_si256((const __m256i *)(key + 32)));
+
+        a0 = _mm256_add_epi64(a0, _mm256_shuffle_epi32(d0, _MM_SHUFFLE(1, 0, 3, 2)));
+        a1 = _mm256_add_epi64(a1, _mm256_shuffle_epi32(d1, _MM_SHUFFLE(1, 0, 3, 2)));
+        a0 = _mm256_add_epi64(a0, _mm256_mul_epu32(k0, _mm256_shuffle_epi32(k0, _MM_SHUFFLE(0, 3, 0, 1))));
+        a1 = _mm256_add_epi64(a1, _mm256_mul_epu32(k1, _mm256_shuffle_epi32(k1, _MM_SHUFFLE(0, 3, 0, 1))));
+    }
+    _mm256_storeu_si256((__m256i *)acc, a0);
+    _mm256_storeu_si256((__m256i *)(acc + 4), a1);
+}
+
+__attribute__((target("avx2"))) static void
+scramble_avx2(uint64_t *acc, const uint8_t *secret) {
+    const __m256i prime = _mm256_set1_epi32((int)PRIME32_1);
+
+    for (size_t i = 0; i < 2; i++) {
+        __m256i a = _mm256_loadu_si256((const __m256i *)(acc + 4 * i));
+
+        a = _mm256_xor_si256(a, _mm256_srli_epi64(a, 47));
+        a = _mm256_xor_si256(a, _mm256_loadu_si256((const __m256i *)(secret + 32 * i)));
+        __m256i low = _mm256_mul_epu32(a, prime);
+        __m256i high = _mm256_mul_epu32(_mm256_shuffle_epi32(a, _MM_SHUFFLE(0, 3, 0, 1)), prime);
+        _mm256_storeu_si256((__m256i *)(acc + 4 * i), _mm256_add_epi64(low, _mm256_slli_epi64(high, 32)));
+    }
+}
+
+#endif
+
+static void
+accumulate(uint64_t *acc, const uint8_t *in, const uint8_t *secret, size_t num_stripes) {
+    switch (active_backend) {
+#ifdef HASH_X86
+        case FHASH_BACKEND_AVX2:
+            accumulate_avx2(acc, in, secret, num_stripes);
+            break;
+        case FHASH_BACKEND_SSE2:
+            accumulate_sse2(acc, in, secret, num_stripes);
+            break;
+#endif
+        default:
+            accumulate_scalar(acc, in, secret, num_stripes);
+            break;
+    }
+}
+
+static void
+scramble(uint64_t *acc, const uint8_t *secret) {
+    switch (active_backend) {
+#ifdef HASH_X86
+        case FHASH_BACKEND_AVX2:
+            scramble_avx2(acc, secret);
+            break;
+        case FHASH_BACKEND_SSE2:
+            scramble_sse2(acc, secret);
+            break;
+#endif
+        default:
+            scramble_scalar(acc, secret);
+            break;
+    }
+}
+
+/*
+    Accumulate the next `num_stripes` stripes of a long input, `*stripes` of the current
+    block are already done. The accumulators are scrambled at the end of every block.
+*/
+static void
+consume_stripes(uint64_t *acc, size_t *stripes, const uint8_t *in, size_t num_stripes, const uint8_t *secret) {
+    while (num_stripes) {
+        size_t n = STRIPES_PER_BLOCK - *stripes;
+
+        n = n < num_stripes ? n : num_stripes;
+        accumulate(acc, in, secret + *stripes * SECRET_CONSUME_RATE, n);
+        *stripes += n;
+        in += n * STRIPE_LEN;
+        num_stripes -= n;
+        if (*stripes == STRIPES_PER_BLOCK) {
+            scramble(acc, secret + FHASH_SECRET_SIZE - STRIPE_LEN);
+            *stripes = 0;
+        }
+    }
+}
+
+/* The last stripe is always the last 64 bytes of the input, overlapping the stripe before it */
+static inline void
+finish_long(uint64_t *acc, const uint8_t *last_stripe, const uint8_t *secret) {
+    accumulate(acc, last_stripe, secret + FHASH_SECRET_SIZE - STRIPE_LEN - 7, 1);
+}
+
+static void
+hash_long(const uint8_t *in, size_t len, uint64_t *acc, const uint8_t *secret) {
+    size_t stripes = 0;
+
+    memcpy(acc, INIT_ACC, sizeof INIT_ACC);
+    consume_stripes(acc, &stripes, in, (len - 1) / STRIPE_LEN, secret);
+    finish_long(acc, in + len - STRIPE_LEN, secret);
+}
+
+/* Inputs of up to 16 bytes */
+static inline uint64_t
+hash64_short(const uint8_t *in, size_t len, uint64_t seed) {
+    if (len > 8) {
+        uint64_t low = load64_le(in) ^ ((load64_le(SECRET + 24) ^ load64_le(SECRET + 32)) + seed);
+        uint64_t high = load64_le(in + len - 8) ^ ((load64_le(SECRET + 40) ^ load64_le(SECRET + 48)) - seed);
+        return avalanche(len + __builtin_bswap64(low) + high + mul_fold64(low, high));
+    }
+    if (len >= 4) {
+        uint64_t input = load32_le(in + len - 4) + ((uint64_t)load32_le(in) << 32);
+
+        seed ^= (uint64_t)__builtin_bswap32((uint32_t)seed) << 32;
+        return rrmxmx(input ^ ((load64_le(SECRET + 8) ^ load64_le(SECRET + 16)) - seed), len);
+    }
+    if (len) {
+        uint32_t combined = ((uint32_t)in[0] << 16) | ((uint32_t)in[len >> 1] << 24) | in[len - 1] | (uint32_t)len << 8;
+        return avalanche_short(combined ^ ((uint64_t)(load32_le(SECRET) ^ load32_le(SECRET + 4)) + seed));
+    }
+    return avalanche_short(seed ^ load64_le(SECRET + 56) ^ load64_le(SECRET + 64));
+}
+
+/* Inputs of 17 to 128 bytes, 16 bytes from each end working inwards */
+static inline uint64_t
+hash64_medium(const uint8_t *in, size_t len, uint64_t seed) {
+    uint64_t acc = len * PRIME64_1;
+
+    if (len > 32) {
+        if (len > 64) {
+            if (len > 96) {
+                acc += mix16(in + 48, SECRET + 96, seed);
+                acc += mix16(in + len - 64, SECRET + 112, seed);
+            }
+            acc += mix16(in + 32, SECRET + 64, seed);
+            acc += mix16(in + len - 48, SECRET + 80, seed);
+        }
+        acc += mix16(in + 16, SECRET + 32, seed);
+        acc += mix16(in + len - 32, SECRET + 48, seed);
+    }
+    acc += mix16(in, SECRET, seed);
+    acc += mix16(in + len - 16, SECRET + 16, seed);
+    return avalanche(acc);
+}
+
+/* Inputs of 129 to 240 bytes, the pieces after the first 8 reuse the secret at an offset of 3 */
+static uint64_t
+hash64_large(const uint8_t *in, size_t len, uint64_t seed) {
+    uint64_t acc = len * PRIME64_1;
+
+    for (size_t i = 0; i < 8; i++) {
+        acc += mix16(in + 16 * i, SECRET + 16 * i, seed);
+    }
+    acc = avalanche(acc);
+    for (size_t i = 8; i < len / 16; i++) {
+        acc += mix16(in + 16 * i, SECRET + 16 * (i - 8) + 3, seed);
+    }
+    acc += mix16(in + len - 16, SECRET + 119, seed);
+    return avalanche(acc);
+}
+
+static uint64_t
+hash64(const uint8_t *in, size_t len, uint64_t seed) {
+    if (len <= 16) {
+        return hash64_short(in, len, seed);
+    }
+    if (len <= 128) {
+        return hash64_medium(in, len, seed);
+    }
+    return hash64_large(in, len, seed);
+}
+
+/* 32 bytes into both halves, each half also takes the other half's input unmixed */
+static inline void
+mix32(struct fhash128 *acc, const uint8_t *a, const uint8_t *b, const uint8_t *secret, uint64_t seed) {
+    acc->low += mix16(a, secret, seed);
+    acc->low ^= load64_le(b) + load64_le(b + 8);
+    acc->high += mix16(b, secret + 16, seed);
+    acc->high ^= load64_le(a) + load64_le(a + 8);
+}
+
+static inline struct fhash128
+finish128(struct fhash128 acc, size_t len, uint64_t seed) {
+    struct fhash128 h;
+
+    h.low = avalanche(acc.low + acc.high);
+    h.high = 0 - avalanche(acc.low * PRIME64_1 + acc.high * PRIME64_4 + (len - seed) * PRIME64_2);
+    return h;
+}
+
+static struct fhash128
+hash128_short(const uint8_t *in, size_t len, uint64_t seed) {
+    struct fhash128 h;
+
+    if (len > 8) {
+        uint64_t low = load64_le(in), high = load64_le(in + len - 8);
+        struct fhash128 m = mul128(low ^ high ^ ((load64_le(SECRET + 32) ^ load64_le(SECRET + 40)) - seed), PRIME64_1);
+
+        m.low += (uint64_t)(len - 1) << 54;
+        high ^= (load64_le(SECRET + 48) ^ load64_le(SECRET + 56)) + seed;
+        m.high += high + (high & 0xffffffff) * (PRIME32_2 - 1);
+        m.low ^= __builtin_bswap64(m.high);
+        h = mul128(m.low, PRIME64_2);
+        h.high += m.high * PRIME64_2;
+        return (struct fhash128){avalanche(h.low), avalanche(h.high)};
+    }
+    if (len >= 4) {
+        uint64_t input = load32_le(in) + ((uint64_t)load32_le(in + len - 4) << 32);
+
+        seed ^= (uint64_t)__builtin_bswap32((uint32_t)seed) << 32;
+        h = mul128(input ^ ((load64_le(SECRET + 16) ^ load64_le(SECRET + 24)) + seed), PRIME64_1 + (len << 2));
+        h.high += h.low << 1;
+        h.low ^= h.high >> 3;
+        h.low ^= h.low >> 35;
+        h.low *= 0x9fb21c651e98df25ull;
+        h.low ^= h.low >> 28;
+        return (struct fhash128){h.low, avalanche(h.high)};
+    }
+    if (len) {
+        uint32_t low = ((uint32_t)in[0] << 16) | ((uint32_t)in[len >> 1] << 24) | in[len - 1] | (uint32_t)len << 8;
+        uint32_t high = rotl32(__builtin_bswap32(low), 13);
+
+        h.low = avalanche_short(low ^ ((uint64_t)(load32_le(SECRET) ^ load32_le(SECRET + 4)) + seed));
+        h.high = avalanche_short(high ^ ((uint64_t)(load32_le(SECRET + 8) ^ load32_le(SECRET + 12)) - seed));
+        return h;
+    }
+    h.low = avalanche_short(seed ^ load64_le(SECRET + 64) ^ load64_le(SECRET + 72));
+    h.high = avalanche_short(seed ^ load64_le(SECRET + 80) ^ load64_le(SECRET + 88));
+    return h;
+}
+
+static struct fhash128
+hash128(const uint8_t *in, size_t len, uint64_t seed) {
+    struct fhash128 acc = {len * PRIME64_1, 0};
+
+    if (len <= 16) {
+        return hash128_short(in, len, seed);
+    }
+    if (len <= 128) {
+        if (len > 32) {
+            if (len > 64) {
+                if (len > 96) {
+                    mix32(&acc, in + 48, in + len - 64, SECRET + 96, seed);
+                }
+                mix32(&acc, in + 32, in + len - 48, SECRET + 64, seed);
+            }
+            mix32(&acc, in + 16, in + len - 32, SECRET + 32, seed);
+        }
+        mix32(&acc, in, in + len - 16, SECRET, seed);
+        return finish128(acc, len, seed);
+    }
+
+    for (size_t i = 0; i < 4; i++) {
+        mix32(&acc, in + 32 * i, in + 32 * i + 16, SECRET + 32 * i, seed);
+    }
+    acc.low = avalanche(acc.low);
+    acc.high = avalanche(acc.high);
+    for (size_t i = 4; i < len / 32; i++) {
+        mix32(&acc, in + 32 * i, in + 32 * i + 16, SECRET + 32 * (i - 4) + 3, seed);
+    }
+    mix32(&acc, in + len - 16, in + len - 32, SECRET + 103, 0 - seed);
+    return finish128(acc, len, seed);
+}
+
+static inline uint64_t
+long_hash64(const uint64_t *acc, const uint8_t *secret, uint64_t len) {
+    return merge(acc, secret + 11, len * PRIME64_1);
+}
+
+static inline struct fhash128
+long_hash128(const uint64_t *acc, const uint8_t *secret, uint64_t len) {
+    return (struct fhash128){merge(acc, secret + 11, len * PRIME64_1),
+                             merge(acc, secret + FHASH_SECRET_SIZE - STRIPE_LEN - 11, ~(len * PRIME64_2))};
+}
+
+/**
+   Hash :c:var:`data` to 64 bits. Inputs of up to 16 bytes take a handful of
+   multiplications, long ones are hashed at several bytes per cycle.
+
+   This is not a cryptographic hash: use it for hash tables, bucketing and checksums of
+   data that nobody is trying to make collide.
+
+   :param data: Bytes to hash.
+   :type data: const void *
+   :param len: Length of :c:var:`data` in bytes.
+   :type len: size_t
+   :param seed: Selects one of 2^64 unrelated hash functions, 0 for the default one.
+   :type seed: uint64_t
+   :return: The hash.
+   :rtype: uint64_t
+*/
+uint64_t
+fhash64(const void *data, size_t len, uint64_t seed) {
+    uint64_t acc[8];
+    uint8_t secret[FHASH_SECRET_SIZE];
+
+    if (len <= MIDSIZE_MAX) {
+        return hash64(data, len, seed);
+    }
+    if (seed) {
+        derive_secret(secret, seed);
+    }
+    hash_long(data, len, acc, seed ? secret : SECRET);
+    return long_hash64(acc, seed ? secret : SECRET, len);
+}
+
+/**
+   Hash :c:var:`data` to 128 bits, for when 64-bit hashes of many keys could collide.
+
+   :param data: Bytes to hash.
+   :type data: const void *
+   :param len: Length of :c:var:`data` in bytes.
+   :type len: size_t
+   :param seed: Selects one of 2^64 unrelated hash functions, 0 for the default one.
+   :type seed: uint64_t
+   :return: The hash.
+   :rtype: struct fhash128
+*/
+struct fhash128
+fhash128(const void *data, size_t len, uint64_t seed) {
+    uint64_t acc[8];
+    uint8_t secret[FHASH_SECRET_SIZE];
+
+    if (len <= MIDSIZE_MAX) {
+        return hash128(data, len, seed);
+    }
+    if (seed) {
+        derive_secret(secret, seed);
+    }
+    hash_long(data, len, acc, seed ? secret : SECRET);
+    return long_hash128(acc, seed ? secret : SECRET, len);
+}
+
+/**
+   Start hashing a message that arrives in pieces. The hashes of a streamed message are
+   those of :c:func:`fhash64` and :c:func:`fhash128` with the same seed.
+
+   :param ctx: The context to initialize.
+   :type ctx: struct fhash_ctx *
+   :param seed: Selects one of 2^64 unrelated hash functions, 0 for the default one.
+   :type seed: uint64_t
+*/
+void
+fhash_init(struct fhash_ctx *ctx, uint64_t seed) {
+    memcpy(ctx->acc, INIT_ACC, sizeof INIT_ACC);
+    ctx->seed = seed;
+    ctx->total_len = 0;
+    ctx->buffered = 0;
+    ctx->stripes = 0;
+    if (seed) {
+        derive_secret(ctx->secret, seed);
+    } else {
+        memcpy(ctx->secret, SECRET, FHASH_SECRET_SIZE);
+    }
+}
+
+/**
+   Add the next piece of the message.
+
+   :param ctx: A context initialized with :c:func:`fhash_init`.
+   :type ctx: struct fhash_ctx *
+   :param data: Next bytes of the message.
+   :type data: const void *
+   :param len: Length of :c:var:`data` in bytes.
+   :type len: size_t
+*/
+void
+fhash_update(struct fhash_ctx *ctx, const void *data, size_t len) {
+    const uint8_t *in = data;
+
+    ctx->total_len += len;
+    if (len <= FHASH_BUFFER_SIZE - ctx->buffered) {
+        memcpy(ctx->buffer + ctx->buffered, in, len);
+        ctx->buffered += len;
+        return;
+    }
+
+    /* More input follows the buffer, so none of it is the last stripe */
+    if (ctx->buffered) {
+        size_t fill = FHASH_BUFFER_SIZE - ctx->buffered;
+
+        memcpy(ctx->buffer + ctx->buffered, in, fill);
+        in += fill;
+        len -= fill;
+        consume_stripes(ctx->acc, &ctx->stripes, ctx->buffer, FHASH_BUFFER_SIZE / STRIPE_LEN, ctx->secret);
+        memcpy(ctx->last_stripe, ctx->buffer + FHASH_BUFFER_SIZE - STRIPE_LEN, STRIPE_LEN);
+    }
+    if (len > FHASH_BUFFER_SIZE) {
+        size_t num_stripes = (len - 1) / STRIPE_LEN;
+
+        consume_stripes(ctx->acc, &ctx->stripes, in, num_stripes, ctx->secret);
+        in += num_stripes * STRIPE_LEN;
+        len -= num_stripes * STRIPE_LEN;
+        memcpy(ctx->last_stripe, in - STRIPE_LEN, STRIPE_LEN);
+    }
+    memcpy(ctx->buffer, in, len);
+    ctx->buffered = len;
+}
+
+/* Accumulators of a long message, the context is left as it is so more input can follow */
+static void
+digest_long(const struct fhash_ctx *ctx, uint64_t *acc) {
+    uint8_t last[STRIPE_LEN];
+    size_t stripes = ctx->stripes;
+
+    memcpy(acc, ctx->acc, sizeof ctx->acc);
+    if (ctx->buffered >= STRIPE_LEN) {
+        consume_stripes(acc, &stripes, ctx->buffer, (ctx->buffered - 1) / STRIPE_LEN, ctx->secret);
+        finish_long(acc, ctx->buffer + ctx->buffered - STRIPE_LEN, ctx->secret);
+    } else {
+        memcpy(last, ctx->last_stripe + ctx->buffered, STRIPE_LEN - ctx->buffered);
+        memcpy(last + STRIPE_LEN - ctx->buffered, ctx->buffer, ctx->buffered);
+        finish_long(acc, last, ctx->secret);
+    }
+}
+
+/**
+   Get the 64-bit hash of the message so far. The context is not changed, more input can
+   be added afterwards.
+
+   :param ctx: A context initialized with :c:func:`fhash_init`.
+   :type ctx: const struct fhash_ctx *
+   :return: The hash.
+   :rtype: uint64_t
+*/
+uint64_t
+fhash64_final(const struct fhash_ctx *ctx) {
+    uint64_t acc[8];
+
+    if (ctx->total_len <= MIDSIZE_MAX) {
+        return hash64(ctx->buffer, ctx->total_len, ctx->seed);
+    }
+    digest_long(ctx, acc);
+    return long_hash64(acc, ctx->secret, ctx->total_len);
+}
+
+/**
+   Get the 128-bit hash of the message so far. The context is not changed, more input can
+   be added afterwards.
+
+   :param ctx: A context initialized with :c:func:`fhash_init`.
+   :type ctx: const struct fhash_ctx *
+   :return: The hash.
+   :rtype: struct fhash128
+*/
+struct fhash128
+fhash128_final(const struct fhash_ctx *ctx) {
+    uint64_t acc[8];
+
+    if (ctx->total_len <= MIDSIZE_MAX) {
+        return hash128(ctx->buffer, ctx->total_len, ctx->seed);
+    }
+    digest_long(ctx, acc);
+    return long_hash128(acc, ctx->secret, ctx->total_len);
+}
+
+/**
+   Select the implementation of the loop over inputs longer than 240 bytes. Every backend
+   gives the same hashes.
+
+   The fastest backend supported by the CPU is selected when the library is loaded,
+   this is only needed to force a particular one, e.g. to compare their outputs.
+   It is not thread-safe and should be called before any hashing starts.
+
+   :param backend: ``FHASH_BACKEND_AUTO`` for the fastest supported backend,
+                   ``FHASH_BACKEND_SCALAR`` for the portable C code,
+                   ``FHASH_BACKEND_SSE2`` for 16 bytes or ``FHASH_BACKEND_AVX2`` for
+                   32 bytes at a time.
+   :type backend: enum fhash_backend
+   :return: 0 on success, -1 if the CPU does not support :c:var:`backend`.
+   :rtype: int
+*/
+int
+fhash_set_backend(enum fhash_backend backend) {
+    unsigned features = hash_cpu_features();
+
+    if (backend == FHASH_BACKEND_AUTO) {
+        if (features & CPU_AVX2) {
+            backend = FHASH_BACKEND_AVX2;
+        } else if (features & CPU_SSE2) {
+            backend = FHASH_BACKEND_SSE2;
+        } else {
+            backend = FHASH_BACKEND_SCALAR;
+        }
+    }
+
+    switch (backend) {
+        case FHASH_BACKEND_SCALAR:
+            break;
+        case FHASH_BACKEND_SSE2:
+            if (!(features & CPU_SSE2)) {
+                return -1;
+            }
+            break;
+        case FHASH_BACKEND_AVX2:
+            if (!(features & CPU_AVX2)) {
+                return -1;
+            }
+            break;
+        default:
+            return -1;
+    }
+
+    active_backend = backend;
+    return 0;
+}
+
+/**
+   Get the backend currently used for long inputs.
+
+   :return: ``FHASH_BACKEND_SCALAR``, ``FHASH_BACKEND_SSE2`` or ``FHASH_BACKEND_AVX2``.
+   :rtype: enum fhash_backend
+*/
+enum fhash_backend
+fhash_get_backend(void) {
+    return active_backend;
+}
+
+#ifdef __GNUC__
+__attribute__((constructor)) static void
+fhash_select_backend(void) {
+    fhash_set_backend(FHASH_BACKEND_AUTO);
+}
+#endif
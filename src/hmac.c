@@ -0,0 +1,545 @@
+/*
+    HMAC (RFC 2104), HKDF (RFC 5869) and PBKDF2 (RFC 8018) over SHA-1 and SHA-2.
+
+    The key is padded and XORed with ipad and opad once, and the contexts after those
+    two blocks are kept in `struct hmac_key`. Every MAC then starts from the cached
+    midstates, which saves two compressions per message.
+
+    PBKDF2 goes further. Each iteration hashes a digest that fits a single block
+    together with its padding, so the padded blocks are laid out once. The iteration
+    is then exactly two calls to the compression function, one from each midstate.
+*/
+
+#include "hmac.h"
+
+#include "sha.h"
+#include "sha_internal.h"
+#include "stats_internal.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#define IPAD 0x36
+#define OPAD 0x5c
+
+static void
+ctx_init(enum hash_algorithm algorithm, union hash_ctx *ctx) {
+    switch (algorithm) {
+        case HASH_SHA1:
+            sha1_init(&ctx->sha1);
+            break;
+        case HASH_SHA2_224:
+            sha2_224_init(&ctx->sha2_256);
+            break;
+        case HASH_SHA2_256:
+            sha2_256_init(&ctx->sha2_256);
+            break;
+        case HASH_SHA2_384:
+            sha2_384_init(&ctx->sha2_512);
+            break;
+        case HASH_SHA2_512_224:
+            sha2_512_224_init(&ctx->sha2_512);
+            break;
+        case HASH_SHA2_512_256:
+            sha2_512_256_init(&ctx->sha2_512);
+            break;
+        default:
+            sha2_512_init(&ctx->sha2_512);
+            break;
+    }
+}
+
+static void
+ctx_update(enum hash_algorithm algorithm, union hash_ctx *ctx, const void *data, size_t len) {
+    switch (algorithm) {
+        case HASH_SHA1:
+            sha1_update(&ctx->sha1, data, len);
+            break;
+        case HASH_SHA2_224:
+            sha2_224_update(&ctx->sha2_256, data, len);
+            break;
+        case HASH_SHA2_256:
+            sha2_256_update(&ctx->sha2_256, data, len);
+            break;
+        case HASH_SHA2_384:
+            sha2_384_update(&ctx->sha2_512, data, len);
+            break;
+        case HASH_SHA2_512_224:
+            sha2_512_224_update(&ctx->sha2_512, data, len);
+            break;
+        case HASH_SHA2_512_256:
+            sha2_512_256_update(&ctx->sha2_512, data, len);
+            break;
+        default:
+            sha2_512_update(&ctx->sha2_512, data, len);
+            break;
+    }
+}
+
+/* Finish `ctx` and write the digest as `digest_len` big-endian bytes */
+static void
+ctx_final(enum hash_algorithm algorithm, union hash_ctx *ctx, uint8_t *out, size_t digest_len) {
+    uint32_t words32[8];
+    uint64_t words64[8];
+
+    switch (algorithm) {
+        case HASH_SHA1:
+            sha1_final(&ctx->sha1, words32);
+            break;
+        case HASH_SHA2_224:
+            sha2_224_final(&ctx->sha2_256, words32);
+            break;
+        case HASH_SHA2_256:
+            sha2_256_final(&ctx->sha2_256, words32);
+            break;
+        case HASH_SHA2_384:
+            sha2_384_final(&ctx->sha2_512, words64);
+            break;
+        case HASH_SHA2_512_224:
+            sha2_512_224_final(&ctx->sha2_512, words64);
+            break;
+        case HASH_SHA2_512_256:
+            sha2_512_256_final(&ctx->sha2_512, words64);
+            break;
+        default:
+            sha2_512_final(&ctx->sha2_512, words64);
+            break;
+    }
+
+    if (algorithm < HASH_SHA2_384) {
+        hash_store_words(out, words32, 4, digest_len);
+    } else {
+        hash_store_words(out, words64, 8, digest_len);
+    }
+}
+
+/**
+   Size in bytes of the MAC produced with :c:var:`algorithm`.
+
+   :param algorithm: A SHA-1 or SHA-2 function.
+   :type algorithm: enum hash_algorithm
+   :return: The digest size, or 0 if :c:var:`algorithm` cannot be used for HMAC.
+   :rtype: size_t
+*/
+size_t
+hmac_size(enum hash_algorithm algorithm) {
+    switch (algorithm) {
+        case HASH_SHA1:
+            return 20;
+        case HASH_SHA2_224:
+            return 28;
+        case HASH_SHA2_256:
+            return 32;
+        case HASH_SHA2_384:
+            return 48;
+        case HASH_SHA2_512:
+            return 64;
+        case HASH_SHA2_512_224:
+            return 28;
+        case HASH_SHA2_512_256:
+            return 32;
+        default:
+            return 0;
+    }
+}
+
+/**
+   Precompute :c:var:`key` for MACs with :c:var:`secret`.
+
+   Keys longer than a block are hashed first, as HMAC requires. The result holds the
+   midstates after the ipad and opad blocks, so the secret itself is not kept.
+
+   :param key: Receives the precomputed key.
+   :type key: struct hmac_key *
+   :param algorithm: A SHA-1 or SHA-2 function.
+   :type algorithm: enum hash_algorithm
+   :param secret: The key bytes.
+   :type secret: const void *
+   :param secret_len: Length of :c:var:`secret` in bytes.
+   :type secret_len: size_t
+   :return: 0 on success, -1 if :c:var:`algorithm` cannot be used for HMAC.
+   :rtype: int
+*/
+int
+hmac_key_init(struct hmac_key *key, enum hash_algorithm algorithm, const void *secret, size_t secret_len) {
+    uint8_t pad[128] = {0};
+
+    if (!hmac_size(algorithm)) {
+        return -1;
+    }
+
+    key->algorithm = algorithm;
+    key->digest_len = hmac_size(algorithm);
+    key->block_size = algorithm < HASH_SHA2_384 ? 64 : 128;
+
+    if (secret_len > key->block_size) {
+        ctx_init(algorithm, &key->inner);
+        ctx_update(algorithm, &key->inner, secret, secret_len);
+        ctx_final(algorithm, &key->inner, pad, key->digest_len);
+    } else if (secret_len) {
+        memcpy(pad, secret, secret_len);
+    }
+
+    for (size_t i = 0; i < key->block_size; i++) {
+        pad[i] ^= IPAD;
+    }
+    ctx_init(algorithm, &key->inner);
+    ctx_update(algorithm, &key->inner, pad, key->block_size);
+
+    for (size_t i = 0; i < key->block_size; i++) {
+        pad[i] ^= IPAD ^ OPAD;
+    }
+    ctx_init(algorithm, &key->outer);
+    ctx_update(algorithm, &key->outer, pad, key->block_size);
+
+    hash_wipe(pad, sizeof pad);
+    return 0;
+}
+
+/**
+   Erase the midstates held by :c:var:`key`.
+
+   :param key: A key set up by :c:func:`hmac_key_init`.
+   :type key: struct hmac_key *
+*/
+void
+hmac_key_clear(struct hmac_key *key) {
+    hash_wipe(key, sizeof *key);
+}
+
+/**
+   Start a MAC with :c:var:`key`, no key material is hashed again.
+
+   :param ctx: The context to initialize.
+   :type ctx: struct hmac_ctx *
+   :param key: A key set up by :c:func:`hmac_key_init`, it has to outlive :c:var:`ctx`.
+   :type key: const struct hmac_key *
+*/
+void
+hmac_init(struct hmac_ctx *ctx, const struct hmac_key *key) {
+    ctx->key = key;
+    ctx->inner = key->inner;
+}
+
+/**
+   Feed the next :c:var:`len` bytes of the message into :c:var:`ctx`.
+
+   :param ctx: A context initialized by :c:func:`hmac_init`.
+   :type ctx: struct hmac_ctx *
+   :param data: The next chunk of the message.
+   :type data: const void *
+   :param len: Length of :c:var:`data` in bytes.
+   :type len: size_t
+*/
+void
+hmac_update(struct hmac_ctx *ctx, const void *data, size_t len) {
+    ctx_update(ctx->key->algorithm, &ctx->inner, data, len);
+}
+
+/**
+   Write the MAC of the message fed to :c:var:`ctx`.
+
+   :param ctx: A context fed by :c:func:`hmac_update`.
+   :type ctx: struct hmac_ctx *
+   :param mac: Receives :c:func:`hmac_size` bytes.
+   :type mac: void *
+*/
+void
+hmac_final(struct hmac_ctx *ctx, void *mac) {
+    const struct hmac_key *key = ctx->key;
+    uint8_t inner[HMAC_MAX_SIZE];
+    union hash_ctx outer = key->outer;
+
+    ctx_final(key->algorithm, &ctx->inner, inner, key->digest_len);
+    ctx_update(key->algorithm, &outer, inner, key->digest_len);
+    ctx_final(key->algorithm, &outer, mac, key->digest_len);
+}
+
+/**
+   Compute the MAC of :c:var:`len` bytes of :c:var:`data` with a precomputed key.
+
+   :param key: A key set up by :c:func:`hmac_key_init`.
+   :type key: const struct hmac_key *
+   :param data: The message.
+   :type data: const void *
+   :param len: Length of :c:var:`data` in bytes.
+   :type len: size_t
+   :param mac: Receives :c:func:`hmac_size` bytes.
+   :type mac: void *
+*/
+void
+hmac_keyed(const struct hmac_key *key, const void *data, size_t len, void *mac) {
+    struct hmac_ctx ctx;
+
+    hmac_init(&ctx, key);
+    hmac_update(&ctx, data, len);
+    hmac_final(&ctx, mac);
+}
+
+/**
+   Compute the MAC of :c:var:`len` bytes of :c:var:`data` in one call.
+
+   Callers that use the same key repeatedly should keep a key from
+   :c:func:`hmac_key_init` and call :c:func:`hmac_keyed` instead.
+
+   :param algorithm: A SHA-1 or SHA-2 function.
+   :type algorithm: enum hash_algorithm
+   :param secret: The key bytes.
+   :type secret: const void *
+   :param secret_len: Length of :c:var:`secret` in bytes.
+   :type secret_len: size_t
+   :param data: The message.
+   :type data: const void *
+   :param len: Length of :c:var:`data` in bytes.
+   :type len: size_t
+   :param mac: Receives :c:func:`hmac_size` bytes.
+   :type mac: void *
+   :return: 0 on success, -1 if :c:var:`algorithm` cannot be used for HMAC.
+   :rtype: int
+*/
+int
+hmac(enum hash_algorithm algorithm, const void *secret, size_t secret_len, const void *data, size_t len, void *mac) {
+    struct hmac_key key;
+
+    if (hmac_key_init(&key, algorithm, secret, secret_len)) {
+        return -1;
+    }
+    hmac_keyed(&key, data, len, mac);
+    hmac_key_clear(&key);
+    return 0;
+}
+
+/**
+   HKDF-Extract, condense :c:var:`ikm` into the pseudorandom key :c:var:`prk`.
+
+   :param algorithm: A SHA-1 or SHA-2 function.
+   :type algorithm: enum hash_algorithm
+   :param salt: Optional salt, an empty salt stands for a block of zeros.
+   :type salt: const void *
+   :param salt_len: Length of :c:var:`salt` in bytes.
+   :type salt_len: size_t
+   :param ikm: The input keying material.
+   :type ikm: const void *
+   :param ikm_len: Length of :c:var:`ikm` in bytes.
+   :type ikm_len: size_t
+   :param prk: Receives :c:func:`hmac_size` bytes.
+   :type prk: void *
+   :return: 0 on success, -1 if :c:var:`algorithm` cannot be used for HMAC.
+   :rtype: int
+*/
+int
+hkdf_extract(enum hash_algorithm algorithm, const void *salt, size_t salt_len, const void *ikm, size_t ikm_len,
+             void *prk) {
+    return hmac(algorithm, salt, salt_len, ikm, ikm_len, prk);
+}
+
+/**
+   HKDF-Expand, stretch :c:var:`prk` into :c:var:`okm_len` bytes bound to :c:var:`info`.
+
+   :param algorithm: A SHA-1 or SHA-2 function.
+   :type algorithm: enum hash_algorithm
+   :param prk: A pseudorandom key, usually from :c:func:`hkdf_extract`.
+   :type prk: const void *
+   :param prk_len: Length of :c:var:`prk` in bytes.
+   :type prk_len: size_t
+   :param info: Optional context and application specific information.
+   :type info: const void *
+   :param info_len: Length of :c:var:`info` in bytes.
+   :type info_len: size_t
+   :param okm: Receives :c:var:`okm_len` bytes of output keying material.
+   :type okm: void *
+   :param okm_len: At most 255 times :c:func:`hmac_size`.
+   :type okm_len: size_t
+   :return: 0 on success, -1 if :c:var:`algorithm` cannot be used or :c:var:`okm_len` is too long.
+   :rtype: int
+*/
+int
+hkdf_expand(enum hash_algorithm algorithm, const void *prk, size_t prk_len, const void *info, size_t info_len,
+            void *okm, size_t okm_len) {
+    uint8_t block[HMAC_MAX_SIZE];
+    uint8_t *out = okm;
+    struct hmac_key key;
+
+    if (hmac_key_init(&key, algorithm, prk, prk_len) || okm_len > 255 * key.digest_len) {
+        return -1;
+    }
+
+    for (uint8_t counter = 1; okm_len; counter++) {
+        size_t n = okm_len < key.digest_len ? okm_len : key.digest_len;
+        struct hmac_ctx ctx;
+
+        hmac_init(&ctx, &key);
+        if (counter > 1) {
+            hmac_update(&ctx, block, key.digest_len);
+        }
+        hmac_update(&ctx, info, info_len);
+        hmac_update(&ctx, &counter, 1);
+        hmac_final(&ctx, block);
+
+        memcpy(out, block, n);
+        out += n;
+        okm_len -= n;
+    }
+
+    hash_wipe(block, sizeof block);
+    hmac_key_clear(&key);
+    return 0;
+}
+
+/**
+   HKDF, extract and expand in one call.
+
+   :param algorithm: A SHA-1 or SHA-2 function.
+   :type algorithm: enum hash_algorithm
+   :param salt: Optional salt.
+   :type salt: const void *
+   :param salt_len: Length of :c:var:`salt` in bytes.
+   :type salt_len: size_t
+   :param ikm: The input keying material.
+   :type ikm: const void *
+   :param ikm_len: Length of :c:var:`ikm` in bytes.
+   :type ikm_len: size_t
+   :param info: Optional context and application specific information.
+   :type info: const void *
+   :param info_len: Length of :c:var:`info` in bytes.
+   :type info_len: size_t
+   :param okm: Receives :c:var:`okm_len` bytes of output keying material.
+   :type okm: void *
+   :param okm_len: At most 255 times :c:func:`hmac_size`.
+   :type okm_len: size_t
+   :return: 0 on success, -1 if :c:var:`algorithm` cannot be used or :c:var:`okm_len` is too long.
+   :rtype: int
+*/
+int
+hkdf(enum hash_algorithm algorithm, const void *salt, size_t salt_len, const void *ikm, size_t ikm_len,
+     const void *info, size_t info_len, void *okm, size_t okm_len) {
+    uint8_t prk[HMAC_MAX_SIZE];
+    int status;
+
+    if (hkdf_extract(algorithm, salt, salt_len, ikm, ikm_len, prk)) {
+        return -1;
+    }
+    status = hkdf_expand(algorithm, prk, hmac_size(algorithm), info, info_len, okm, okm_len);
+    hash_wipe(prk, sizeof prk);
+    return status;
+}
+
+/*
+    Lay out `block` as a message of `digest_len` bytes that follows one already compressed
+    block, so only the digest has to be rewritten between iterations.
+*/
+static void
+pad_block(uint8_t *block, size_t block_size, size_t digest_len) {
+    uint64_t bits = (uint64_t)(block_size + digest_len) * 8;
+
+    memset(block, 0, block_size);
+    block[digest_len] = 0x80;
+    for (size_t i = 0; i < 8; i++) {
+        block[block_size - 1 - i] = (bits >> (8 * i)) & 0xff;
+    }
+}
+
+/* SHA-NI only covers SHA-1 and SHA-256, the SHA-512 compression is always scalar */
+static enum hash_stats_backend
+compress_backend(enum hash_algorithm algorithm) {
+    return algorithm < HASH_SHA2_384 && sha_get_backend() == SHA_BACKEND_SHANI ? HASH_STATS_SHANI : HASH_STATS_SCALAR;
+}
+
+/* One compression from `midstate` over the padded `block`, the digest goes back into `out` */
+static void
+compress_padded(enum hash_algorithm algorithm, const union hash_ctx *midstate, const uint8_t *block, uint8_t *out,
+                size_t digest_len) {
+    /* Part of a PBKDF2 call whose first iteration was already counted, so it adds a block but no call */
+    STATS_BLOCKS(algorithm, compress_backend(algorithm), 1);
+    if (algorithm == HASH_SHA1) {
+        uint32_t state[5];
+
+        memcpy(state, midstate->sha1.state, sizeof state);
+        sha1_compress(state, block, 1);
+        hash_store_words(out, state, 4, digest_len);
+    } else if (algorithm < HASH_SHA2_384) {
+        uint32_t state[8];
+
+        memcpy(state, midstate->sha2_256.state, sizeof state);
+        sha256_compress(state, block, 1);
+        hash_store_words(out, state, 4, digest_len);
+    } else {
+        uint64_t state[8];
+
+        memcpy(state, midstate->sha2_512.state, sizeof state);
+        sha512_compress(state, block, 1);
+        hash_store_words(out, state, 8, digest_len);
+    }
+}
+
+/**
+   Derive :c:var:`out_len` bytes from a password with PBKDF2-HMAC.
+
+   After the first one, every iteration is exactly two compressions, one from each of
+   the cached HMAC midstates over a block laid out once with its padding.
+
+   :param algorithm: A SHA-1 or SHA-2 function.
+   :type algorithm: enum hash_algorithm
+   :param password: The password.
+   :type password: const void *
+   :param password_len: Length of :c:var:`password` in bytes.
+   :type password_len: size_t
+   :param salt: The salt.
+   :type salt: const void *
+   :param salt_len: Length of :c:var:`salt` in bytes.
+   :type salt_len: size_t
+   :param iterations: Number of iterations, at least 1.
+   :type iterations: uint32_t
+   :param out: Receives :c:var:`out_len` bytes of derived key.
+   :type out: void *
+   :param out_len: Length of the derived key in bytes.
+   :type out_len: size_t
+   :return: 0 on success, -1 if :c:var:`algorithm` cannot be used for HMAC or
+            :c:var:`iterations` is 0.
+   :rtype: int
+*/
+int
+pbkdf2(enum hash_algorithm algorithm, const void *password, size_t password_len, const void *salt, size_t salt_len,
+       uint32_t iterations, void *out, size_t out_len) {
+    uint8_t inner[128], outer[128], sum[HMAC_MAX_SIZE];
+    uint8_t *dest = out;
+    struct hmac_key key;
+
+    if (!iterations || hmac_key_init(&key, algorithm, password, password_len)) {
+        return -1;
+    }
+
+    pad_block(inner, key.block_size, key.digest_len);
+    pad_block(outer, key.block_size, key.digest_len);
+
+    for (uint32_t counter = 1; out_len; counter++) {
+        uint8_t be_counter[4] = {counter >> 24, (counter >> 16) & 0xff, (counter >> 8) & 0xff, counter & 0xff};
+        size_t n = out_len < key.digest_len ? out_len : key.digest_len;
+        struct hmac_ctx ctx;
+
+        hmac_init(&ctx, &key);
+        hmac_update(&ctx, salt, salt_len);
+        hmac_update(&ctx, be_counter, 4);
+        hmac_final(&ctx, inner);
+        memcpy(sum, inner, key.digest_len);
+
+        for (uint32_t i = 1; i < iterations; i++) {
+            compress_padded(algorithm, &key.inner, inner, outer, key.digest_len);
+            compress_padded(algorithm, &key.outer, outer, inner, key.digest_len);
+            for (size_t j = 0; j < key.digest_len; j++) {
+                sum[j] ^= inner[j];
+            }
+        }
+
+        memcpy(dest, sum, n);
+        dest += n;
+        out_len -= n;
+    }
+
+    hash_wipe(inner, sizeof inner);
+    hash_wipe(outer, sizeof outer);
+    hash_wipe(sum, sizeof sum);
+    hmac_key_clear(&key);
+    return 0;
+}
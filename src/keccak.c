@@ -0,0 +1,386 @@
+/*
+    Keccak-f[1600] permutation, the core of the SHA-3 family.
+
+    Implementation details are derived from the Keccak team's reference and optimized
+    implementations (https://keccak.team/files/Keccak-implementation-3.2.pdf).
+
+    The 25 lanes live in local variables named after their position, the row
+    (``b``, ``g``, ``k``, ``m``, ``s`` for y = 0..4) followed by the column (``a``,
+    ``e``, ``i``, ``o``, ``u`` for x = 0..4). Rounds alternate between the ``A`` and
+    ``E`` sets of variables, so no lane is ever copied and every round is unrolled.
+*/
+
+#include "keccak.h"
+
+#include "cpu.h"
+#include "sha.h"
+
+#include <stdint.h>
+
+const uint64_t KECCAK_RC[24] = {
+    0x0000000000000001, 0x0000000000008082, 0x800000000000808a, 0x8000000080008000, 0x000000000000808b,
+    0x0000000080000001, 0x8000000080008081, 0x8000000000008009, 0x000000000000008a, 0x0000000000000088,
+    0x0000000080008009, 0x000000008000000a, 0x000000008000808b, 0x800000000000008b, 0x8000000000008089,
+    0x8000000000008003, 0x8000000000008002, 0x8000000000000080, 0x000000000000800a, 0x800000008000000a,
+    0x8000000080008081, 0x8000000000008080, 0x0000000080000001, 0x8000000080008008,
+};
+
+/*
+    One round from the lanes ``A##..`` to ``E##..``.
+
+    Lane complementing: lanes 1, 2, 8, 12, 17 and 20 are kept inverted for the whole
+    permutation. Inverting an input of chi turns its ``~x & y`` into an ``&`` or ``|``
+    of the stored lanes, which leaves only 8 NOTs per round instead of 25. Theta and
+    rho-pi only XOR and rotate, so the inversions pass through them predictably.
+*/
+#define KECCAK_ROUND(A, E, rc)                                                                                         \
+    do {                                                                                                               \
+        Ca = A##ba ^ A##ga ^ A##ka ^ A##ma ^ A##sa;                                                                    \
+        Ce = A##be ^ A##ge ^ A##ke ^ A##me ^ A##se;                                                                    \
+        Ci = A##bi ^ A##gi ^ A##ki ^ A##mi ^ A##si;                                                                    \
+        Co = A##bo ^ A##go ^ A##ko ^ A##mo ^ A##so;                                                                    \
+        Cu = A##bu ^ A##gu ^ A##ku ^ A##mu ^ A##su;                                                                    \
+        Da = Cu ^ ROTL(Ce, 1);                                                                                         \
+        De = Ca ^ ROTL(Ci, 1);                                                                                         \
+        Di = Ce ^ ROTL(Co, 1);                                                                                         \
+        Do = Ci ^ ROTL(Cu, 1);                                                                                         \
+        Du = Co ^ ROTL(Ca, 1);                                                                                         \
+        Ba = A##ba ^ Da;                                                                                               \
+        Be = ROTL(A##ge ^ De, 44);                                                                                     \
+        Bi = ROTL(A##ki ^ Di, 43);                                                                                     \
+        Bo = ROTL(A##mo ^ Do, 21);                                                                                     \
+        Bu = ROTL(A##su ^ Du, 14);                                                                                     \
+        E##ba = Ba ^ (Be | Bi);                                                                                        \
+        E##be = Be ^ (~Bi | Bo);                                                                                       \
+        E##bi = Bi ^ (Bo & Bu);                                                                                        \
+        E##bo = Bo ^ (Bu | Ba);                                                                                        \
+        E##bu = Bu ^ (Ba & Be);                                                                                        \
+        Ba = ROTL(A##bo ^ Do, 28);                                                                                     \
+        Be = ROTL(A##gu ^ Du, 20);                                                                                     \
+        Bi = ROTL(A##ka ^ Da, 3);                                                                                      \
+        Bo = ROTL(A##me ^ De, 45);                                                                                     \
+        Bu = ROTL(A##si ^ Di, 61);                                                                                     \
+        E##ga = Ba ^ (Be | Bi);                                                                                        \
+        E##ge = Be ^ (Bi & Bo);                                                                                        \
+        E##gi = Bi ^ (Bo | ~Bu);                                                                                       \
+        E##go = Bo ^ (Bu | Ba);                                                                                        \
+        E##gu = Bu ^ (Ba & Be);                                                                                        \
+        Ba = ROTL(A##be ^ De, 1);                                                                                      \
+        Be = ROTL(A##gi ^ Di, 6);                                                                                      \
+        Bi = ROTL(A##ko ^ Do, 25);                                                                                     \
+        Bo = ROTL(A##mu ^ Du, 8);                                                                                      \
+        Bu = ROTL(A##sa ^ Da, 18);                                                                                     \
+        E##ka = Ba ^ (Be | Bi);                                                                                        \
+        E##ke = Be ^ (Bi & Bo);                                                                                        \
+        E##ki = Bi ^ (~Bo & Bu);                                                                                       \
+        E##ko = Bo ^ (~(Bu | Ba));                                                                                     \
+        E##ku = Bu ^ (Ba & Be);                                                                                        \
+        Ba = ROTL(A##bu ^ Du, 27);                                                                                     \
+        Be = ROTL(A##ga ^ Da, 36);                                                                                     \
+        Bi = ROTL(A##ke ^ De, 10);                                                                                     \
+        Bo = ROTL(A##mi ^ Di, 15);                                                                                     \
+        Bu = ROTL(A##so ^ Do, 56);                                                                                     \
+        E##ma = Ba ^ (Be & Bi);                                                                                        \
+        E##me = Be ^ (Bi | Bo);                                                                                        \
+        E##mi = Bi ^ (~Bo | Bu);                                                                                       \
+        E##mo = Bo ^ (~(Bu & Ba));                                                                                     \
+        E##mu = Bu ^ (Ba | Be);                                                                                        \
+        Ba = ROTL(A##bi ^ Di, 62);                                                                                     \
+        Be = ROTL(A##go ^ Do, 55);                                                                                     \
+        Bi = ROTL(A##ku ^ Du, 39);                                                                                     \
+        Bo = ROTL(A##ma ^ Da, 41);                                                                                     \
+        Bu = ROTL(A##se ^ De, 2);                                                                                      \
+        E##sa = Ba ^ (~Be & Bi);                                                                                       \
+        E##se = Be ^ (~(Bi | Bo));                                                                                     \
+        E##si = Bi ^ (Bo & Bu);                                                                                        \
+        E##so = Bo ^ (Bu | Ba);                                                                                        \
+        E##su = Bu ^ (Ba & Be);                                                                                        \
+        E##ba ^= rc;                                                                                                   \
+    } while (0)
+
+void
+keccak_f1600(uint64_t *state) {
+    uint64_t Aba, Abe, Abi, Abo, Abu;
+    uint64_t Aga, Age, Agi, Ago, Agu;
+    uint64_t Aka, Ake, Aki, Ako, Aku;
+    uint64_t Ama, Ame, Ami, Amo, Amu;
+    uint64_t Asa, Ase, Asi, Aso, Asu;
+    uint64_t Eba, Ebe, Ebi, Ebo, Ebu;
+    uint64_t Ega, Ege, Egi, Ego, Egu;
+    uint64_t Eka, Eke, Eki, Eko, Eku;
+    uint64_t Ema, Eme, Emi, Emo, Emu;
+    uint64_t Esa, Ese, Esi, Eso, Esu;
+    uint64_t Ba, Be, Bi, Bo, Bu, Ca, Ce, Ci, Co, Cu, Da, De, Di, Do, Du;
+
+    Aba = state[0];
+    Abe = ~state[1];
+    Abi = ~state[2];
+    Abo = state[3];
+    Abu = state[4];
+    Aga = state[5];
+    Age = state[6];
+    Agi = state[7];
+    Ago = ~state[8];
+    Agu = state[9];
+    Aka = state[10];
+    Ake = state[11];
+    Aki = ~state[12];
+    Ako = state[13];
+    Aku = state[14];
+    Ama = state[15];
+    Ame = state[16];
+    Ami = ~state[17];
+    Amo = state[18];
+    Amu = state[19];
+    Asa = ~state[20];
+    Ase = state[21];
+    Asi = state[22];
+    Aso = state[23];
+    Asu = state[24];
+
+    KECCAK_ROUND(A, E, KECCAK_RC[0]);
+    KECCAK_ROUND(E, A, KECCAK_RC[1]);
+    KECCAK_ROUND(A, E, KECCAK_RC[2]);
+    KECCAK_ROUND(E, A, KECCAK_RC[3]);
+    KECCAK_ROUND(A, E, KECCAK_RC[4]);
+    KECCAK_ROUND(E, A, KECCAK_RC[5]);
+    KECCAK_ROUND(A, E, KECCAK_RC[6]);
+    KECCAK_ROUND(E, A, KECCAK_RC[7]);
+    KECCAK_ROUND(A, E, KECCAK_RC[8]);
+    KECCAK_ROUND(E, A, KECCAK_RC[9]);
+    KECCAK_ROUND(A, E, KECCAK_RC[10]);
+    KECCAK_ROUND(E, A, KECCAK_RC[11]);
+    KECCAK_ROUND(A, E, KECCAK_RC[12]);
+    KECCAK_ROUND(E, A, KECCAK_RC[13]);
+    KECCAK_ROUND(A, E, KECCAK_RC[14]);
+    KECCAK_ROUND(E, A, KECCAK_RC[15]);
+    KECCAK_ROUND(A, E, KECCAK_RC[16]);
+    KECCAK_ROUND(E, A, KECCAK_RC[17]);
+    KECCAK_ROUND(A, E, KECCAK_RC[18]);
+    KECCAK_ROUND(E, A, KECCAK_RC[19]);
+    KECCAK_ROUND(A, E, KECCAK_RC[20]);
+    KECCAK_ROUND(E, A, KECCAK_RC[21]);
+    KECCAK_ROUND(A, E, KECCAK_RC[22]);
+    KECCAK_ROUND(E, A, KECCAK_RC[23]);
+
+    state[0] = Aba;
+    state[1] = ~Abe;
+    state[2] = ~Abi;
+    state[3] = Abo;
+    state[4] = Abu;
+    state[5] = Aga;
+    state[6] = Age;
+    state[7] = Agi;
+    state[8] = ~Ago;
+    state[9] = Agu;
+    state[10] = Aka;
+    state[11] = Ake;
+    state[12] = ~Aki;
+    state[13] = Ako;
+    state[14] = Aku;
+    state[15] = Ama;
+    state[16] = Ame;
+    state[17] = ~Ami;
+    state[18] = Amo;
+    state[19] = Amu;
+    state[20] = ~Asa;
+    state[21] = Ase;
+    state[22] = Asi;
+    state[23] = Aso;
+    state[24] = Asu;
+}
+
+#ifdef HASH_X86
+
+# include <immintrin.h>
+
+# define XOR(x, y) _mm256_xor_si256(x, y)
+# define XOR5(a, b, c, d, e) XOR(XOR(XOR(a, b), XOR(c, d)), e)
+# define ANDN(x, y) _mm256_andnot_si256(x, y)
+# define ROL(x, n) _mm256_or_si256(_mm256_slli_epi64(x, n), _mm256_srli_epi64(x, 64 - (n)))
+
+/* Same round on four independent states, one per 64-bit lane of the AVX2 registers */
+# define KECCAK_ROUND_X4(A, E, rc)                                                                                     \
+    do {                                                                                                               \
+        Ca = XOR5(A##ba, A##ga, A##ka, A##ma, A##sa);                                                                  \
+        Ce = XOR5(A##be, A##ge, A##ke, A##me, A##se);                                                                  \
+        Ci = XOR5(A##bi, A##gi, A##ki, A##mi, A##si);                                                                  \
+        Co = XOR5(A##bo, A##go, A##ko, A##mo, A##so);                                                                  \
+        Cu = XOR5(A##bu, A##gu, A##ku, A##mu, A##su);                                                                  \
+        Da = XOR(Cu, ROL(Ce, 1));                                                                                      \
+        De = XOR(Ca, ROL(Ci, 1));                                                                                      \
+        Di = XOR(Ce, ROL(Co, 1));                                                                                      \
+        Do = XOR(Ci, ROL(Cu, 1));                                                                                      \
+        Du = XOR(Co, ROL(Ca, 1));                                                                                      \
+        Ba = XOR(A##ba, Da);                                                                                           \
+        Be = ROL(XOR(A##ge, De), 44);                                                                                  \
+        Bi = ROL(XOR(A##ki, Di), 43);                                                                                  \
+        Bo = ROL(XOR(A##mo, Do), 21);                                                                                  \
+        Bu = ROL(XOR(A##su, Du), 14);                                                                                  \
+        E##ba = XOR(Ba, ANDN(Be, Bi));                                                                                 \
+        E##be = XOR(Be, ANDN(Bi, Bo));                                                                                 \
+        E##bi = XOR(Bi, ANDN(Bo, Bu));                                                                                 \
+        E##bo = XOR(Bo, ANDN(Bu, Ba));                                                                                 \
+        E##bu = XOR(Bu, ANDN(Ba, Be));                                                                                 \
+        Ba = ROL(XOR(A##bo, Do), 28);                                                                                  \
+        Be = ROL(XOR(A##gu, Du), 20);                                                                                  \
+        Bi = ROL(XOR(A##ka, Da), 3);                                                                                   \
+        Bo = ROL(XOR(A##me, De), 45);                                                                                  \
+        Bu = ROL(XOR(A##si, Di), 61);                                                                                  \
+        E##ga = XOR(Ba, ANDN(Be, Bi));                                                                                 \
+        E##ge = XOR(Be, ANDN(Bi, Bo));                                                                                 \
+        E##gi = XOR(Bi, ANDN(Bo, Bu));                                                                                 \
+        E##go = XOR(Bo, ANDN(Bu, Ba));                                                                                 \
+        E##gu = XOR(Bu, ANDN(Ba, Be));                                                                                 \
+        Ba = ROL(XOR(A##be, De), 1);                                                                                   \
+        Be = ROL(XOR(A##gi, Di), 6);                                                                                   \
+        Bi = ROL(XOR(A##ko, Do), 25);                                                                                  \
+        Bo = ROL(XOR(A##mu, Du), 8);                                                                                   \
+        Bu = ROL(XOR(A##sa, Da), 18);                                                                                  \
+        E##ka = XOR(Ba, ANDN(Be, Bi));                                                                                 \
+        E##ke = XOR(Be, ANDN(Bi, Bo));                                                                                 \
+        E##ki = XOR(Bi, ANDN(Bo, Bu));                                                                                 \
+        E##ko = XOR(Bo, ANDN(Bu, Ba));                                                                                 \
+        E##ku = XOR(Bu, ANDN(Ba, Be));                                                                                 \
+        Ba = ROL(XOR(A##bu, Du), 27);                                                                                  \
+        Be = ROL(XOR(A##ga, Da), 36);                                                                                  \
+        Bi = ROL(XOR(A##ke, De), 10);                                                                                  \
+        Bo = ROL(XOR(A##mi, Di), 15);                                                                                  \
+        Bu = ROL(XOR(A##so, Do), 56);                                                                                  \
+        E##ma = XOR(Ba, ANDN(Be, Bi));                                                                                 \
+        E##me = XOR(Be, ANDN(Bi, Bo));                                                                                 \
+        E##mi = XOR(Bi, ANDN(Bo, Bu));                                                                                 \
+        E##mo = XOR(Bo, ANDN(Bu, Ba));                                                                                 \
+        E##mu = XOR(Bu, ANDN(Ba, Be));                                                                                 \
+        Ba = ROL(XOR(A##bi, Di), 62);                                                                                  \
+        Be = ROL(XOR(A##go, Do), 55);                                                                                  \
+        Bi = ROL(XOR(A##ku, Du), 39);                                                                                  \
+        Bo = ROL(XOR(A##ma, Da), 41);                                                                                  \
+        Bu = ROL(XOR(A##se, De), 2);                                                                                   \
+        E##sa = XOR(Ba, ANDN(Be, Bi));                                                                                 \
+        E##se = XOR(Be, ANDN(Bi, Bo));                                                                                 \
+        E##si = XOR(Bi, ANDN(Bo, Bu));                                                                                 \
+        E##so = XOR(Bo, ANDN(Bu, Ba));                                                                                 \
+        E##su = XOR(Bu, ANDN(Ba, Be));                                                                                 \
+        E##ba = XOR(E##ba, rc);                                                                                        \
+    } while (0)
+
+__attribute__((target("avx2"))) static void
+keccak_f1600_x4_avx2(uint64_t *states) {
+    __m256i Aba, Abe, Abi, Abo, Abu;
+    __m256i Aga, Age, Agi, Ago, Agu;
+    __m256i Aka, Ake, Aki, Ako, Aku;
+    __m256i Ama, Ame, Ami, Amo, Amu;
+    __m256i Asa, Ase, Asi, Aso, Asu;
+    __m256i Eba, Ebe, Ebi, Ebo, Ebu;
+    __m256i Ega, Ege, Egi, Ego, Egu;
+    __m256i Eka, Eke, Eki, Eko, Eku;
+    __m256i Ema, Eme, Emi, Emo, Emu;
+    __m256i Esa, Ese, Esi, Eso, Esu;
+    __m256i Ba, Be, Bi, Bo, Bu, Ca, Ce, Ci, Co, Cu, Da, De, Di, Do, Du;
+
+    Aba = _mm256_loadu_si256((const __m256i *)&states[0 * 4]);
+    Abe = _mm256_loadu_si256((const __m256i *)&states[1 * 4]);
+    Abi = _mm256_loadu_si256((const __m256i *)&states[2 * 4]);
+    Abo = _mm256_loadu_si256((const __m256i *)&states[3 * 4]);
+    Abu = _mm256_loadu_si256((const __m256i *)&states[4 * 4]);
+    Aga = _mm256_loadu_si256((const __m256i *)&states[5 * 4]);
+    Age = _mm256_loadu_si256((const __m256i *)&states[6 * 4]);
+    Agi = _mm256_loadu_si256((const __m256i *)&states[7 * 4]);
+    Ago = _mm256_loadu_si256((const __m256i *)&states[8 * 4]);
+    Agu = _mm256_loadu_si256((const __m256i *)&states[9 * 4]);
+    Aka = _mm256_loadu_si256((const __m256i *)&states[10 * 4]);
+    Ake = _mm256_loadu_si256((const __m256i *)&states[11 * 4]);
+    Aki = _mm256_loadu_si256((const __m256i *)&states[12 * 4]);
+    Ako = _mm256_loadu_si256((const __m256i *)&states[13 * 4]);
+    Aku = _mm256_loadu_si256((const __m256i *)&states[14 * 4]);
+    Ama = _mm256_loadu_si256((const __m256i *)&states[15 * 4]);
+    Ame = _mm256_loadu_si256((const __m256i *)&states[16 * 4]);
+    Ami = _mm256_loadu_si256((const __m256i *)&states[17 * 4]);
+    Amo = _mm256_loadu_si256((const __m256i *)&states[18 * 4]);
+    Amu = _mm256_loadu_si256((const __m256i *)&states[19 * 4]);
+    Asa = _mm256_loadu_si256((const __m256i *)&states[20 * 4]);
+    Ase = _mm256_loadu_si256((const __m256i *)&states[21 * 4]);
+    Asi = _mm256_loadu_si256((const __m256i *)&states[22 * 4]);
+    Aso = _mm256_loadu_si256((const __m256i *)&states[23 * 4]);
+    Asu = _mm256_loadu_si256((const __m256i *)&states[24 * 4]);
+
+    KECCAK_ROUND_X4(A, E, _mm256_set1_epi64x(KECCAK_RC[0]));
+    KECCAK_ROUND_X4(E, A, _mm256_set1_epi64x(KECCAK_RC[1]));
+    KECCAK_ROUND_X4(A, E, _mm256_set1_epi64x(KECCAK_RC[2]));
+    KECCAK_ROUND_X4(E, A, _mm256_set1_epi64x(KECCAK_RC[3]));
+    KECCAK_ROUND_X4(A, E, _mm256_set1_epi64x(KECCAK_RC[4]));
+    KECCAK_ROUND_X4(E, A, _mm256_set1_epi64x(KECCAK_RC[5]));
+    KECCAK_ROUND_X4(A, E, _mm256_set1_epi64x(KECCAK_RC[6]));
+    KECCAK_ROUND_X4(E, A, _mm256_set1_epi64x(KECCAK_RC[7]));
+    KECCAK_ROUND_X4(A, E, _mm256_set1_epi64x(KECCAK_RC[8]));
+    KECCAK_ROUND_X4(E, A, _mm256_set1_epi64x(KECCAK_RC[9]));
+    KECCAK_ROUND_X4(A, E, _mm256_set1_epi64x(KECCAK_RC[10]));
+    KECCAK_ROUND_X4(E, A, _mm256_set1_epi64x(KECCAK_RC[11]));
+    KECCAK_ROUND_X4(A, E, _mm256_set1_epi64x(KECCAK_RC[12]));
+    KECCAK_ROUND_X4(E, A, _mm256_set1_epi64x(KECCAK_RC[13]));
+    KECCAK_ROUND_X4(A, E, _mm256_set1_epi64x(KECCAK_RC[14]));
+    KECCAK_ROUND_X4(E, A, _mm256_set1_epi64x(KECCAK_RC[15]));
+    KECCAK_ROUND_X4(A, E, _mm256_set1_epi64x(KECCAK_RC[16]));
+    KECCAK_ROUND_X4(E, A, _mm256_set1_epi64x(KECCAK_RC[17]));
+    KECCAK_ROUND_X4(A, E, _mm256_set1_epi64x(KECCAK_RC[18]));
+    KECCAK_ROUND_X4(E, A, _mm256_set1_epi64x(KECCAK_RC[19]));
+    KECCAK_ROUND_X4(A, E, _mm256_set1_epi64x(KECCAK_RC[20]));
+    KECCAK_ROUND_X4(E, A, _mm256_set1_epi64x(KECCAK_RC[21]));
+    KECCAK_ROUND_X4(A, E, _mm256_set1_epi64x(KECCAK_RC[22]));
+    KECCAK_ROUND_X4(E, A, _mm256_set1_epi64x(KECCAK_RC[23]));
+
+    _mm256_storeu_si256((__m256i *)&states[0 * 4], Aba);
+    _mm256_storeu_si256((__m256i *)&states[1 * 4], Abe);
+    _mm256_storeu_si256((__m256i *)&states[2 * 4], Abi);
+    _mm256_storeu_si256((__m256i *)&states[3 * 4], Abo);
+    _mm256_storeu_si256((__m256i *)&states[4 * 4], Abu);
+    _mm256_storeu_si256((__m256i *)&states[5 * 4], Aga);
+    _mm256_storeu_si256((__m256i *)&states[6 * 4], Age);
+    _mm256_storeu_si256((__m256i *)&states[7 * 4], Agi);
+    _mm256_storeu_si256((__m256i *)&states[8 * 4], Ago);
+    _mm256_storeu_si256((__m256i *)&states[9 * 4], Agu);
+    _mm256_storeu_si256((__m256i *)&states[10 * 4], Aka);
+    _mm256_storeu_si256((__m256i *)&states[11 * 4], Ake);
+    _mm256_storeu_si256((__m256i *)&states[12 * 4], Aki);
+    _mm256_storeu_si256((__m256i *)&states[13 * 4], Ako);
+    _mm256_storeu_si256((__m256i *)&states[14 * 4], Aku);
+    _mm256_storeu_si256((__m256i *)&states[15 * 4], Ama);
+    _mm256_storeu_si256((__m256i *)&states[16 * 4], Ame);
+    _mm256_storeu_si256((__m256i *)&states[17 * 4], Ami);
+    _mm256_storeu_si256((__m256i *)&states[18 * 4], Amo);
+    _mm256_storeu_si256((__m256i *)&states[19 * 4], Amu);
+    _mm256_storeu_si256((__m256i *)&states[20 * 4], Asa);
+    _mm256_storeu_si256((__m256i *)&states[21 * 4], Ase);
+    _mm256_storeu_si256((__m256i *)&states[22 * 4], Asi);
+    _mm256_storeu_si256((__m256i *)&states[23 * 4], Aso);
+    _mm256_storeu_si256((__m256i *)&states[24 * 4], Asu);
+}
+
+#endif /* HASH_X86 */
+
+/*
+    Permute four independent states stored interleaved, lane ``i`` of state ``k`` is at
+    ``states[i * 4 + k]``. Uses AVX2 when the CPU has it.
+*/
+void
+keccak_f1600_x4(uint64_t *states) {
+#ifdef HASH_X86
+    if (hash_cpu_features() & CPU_AVX2) {
+        keccak_f1600_x4_avx2(states);
+        return;
+    }
+#endif
+
+    for (int k = 0; k < 4; k++) {
+        uint64_t state[25];
+
+        for (int i = 0; i < 25; i++) {
+            state[i] = states[i * 4 + k];
+        }
+        keccak_f1600(state);
+        for (int i = 0; i < 25; i++) {
+            states[i * 4 + k] = state[i];
+        }
+    }
+}
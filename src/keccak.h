@@ -0,0 +1,14 @@
+/* Keccak-f[1600] permutations shared by the SHA-3 based functions, these are not installed. */
+
+#ifndef _KECCAK
+#define _KECCAK
+
+#include <stdint.h>
+
+extern const uint64_t KECCAK_RC[24];
+
+void keccak_f1600(uint64_t *state);
+void keccak_f1600_x4(uint64_t *states);
+
+
+#endif /* _KECCAK */
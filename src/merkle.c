@@ -0,0 +1,379 @@
+/*
+    Merkle trees in the shape of RFC 6962 (https://www.rfc-editor.org/rfc/rfc6962#section-2.1).
+
+    Leaves are hashed as ``H(0x00 || data)`` and interior nodes as ``H(0x01 || left || right)``,
+    so a leaf can never pass for an interior node. Levels are built bottom up by pairing
+    neighbours, and the last node of a level with an odd count moves up unchanged. This
+    gives the same root as the recursive definition of the RFC.
+
+    Every level is kept, so changing one leaf rehashes only the nodes on its path to the
+    root, and inclusion proofs are read straight out of the stored levels.
+*/
+
+#include "merkle.h"
+
+#include "pool.h"
+#include "sha.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Nodes per pool task, and the smallest level that is worth handing to the pool */
+#define MERKLE_GROUP 256
+#define MERKLE_PARALLEL_MIN 4096
+
+#define LEAF_PREFIX 0x00
+#define NODE_PREFIX 0x01
+
+struct level_build {
+    struct merkle_tree *tree;
+    const struct merkle_leaf *leaves;  /* Leaf data when building level 0 */
+    const uint8_t *data;               /* Or a buffer cut into `chunk_size` pieces */
+    size_t len;
+    size_t chunk_size;
+    size_t level;
+};
+
+static void
+store_be32(uint8_t *out, const uint32_t *words, size_t num_words) {
+    for (size_t i = 0; i < num_words; i++) {
+        out[4 * i] = words[i] >> 24;
+        out[4 * i + 1] = (words[i] >> 16) & 0xff;
+        out[4 * i + 2] = (words[i] >> 8) & 0xff;
+        out[4 * i + 3] = words[i] & 0xff;
+    }
+}
+
+static void
+store_be64(uint8_t *out, const uint64_t *words, size_t num_words) {
+    for (size_t i = 0; i < num_words; i++) {
+        for (size_t j = 0; j < 8; j++) {
+            out[8 * i + j] = (words[i] >> (56 - 8 * j)) & 0xff;
+        }
+    }
+}
+
+/* ``H(prefix || a || b)``, written to `out` as big-endian bytes */
+static void
+hash_prefixed(enum hash_algorithm algorithm, uint8_t prefix, const void *a, size_t a_len, const void *b, size_t b_len,
+              uint8_t *out) {
+    if (algorithm == HASH_SHA2_256) {
+        struct sha2_256_ctx ctx;
+        uint32_t hash[8];
+
+        sha2_256_init(&ctx);
+        sha2_256_update(&ctx, &prefix, 1);
+        sha2_256_update(&ctx, a, a_len);
+        sha2_256_update(&ctx, b, b_len);
+        sha2_256_final(&ctx, hash);
+        store_be32(out, hash, 8);
+    } else {
+        struct sha2_512_ctx ctx;
+        uint64_t hash[8];
+
+        sha2_512_init(&ctx);
+        sha2_512_update(&ctx, &prefix, 1);
+        sha2_512_update(&ctx, a, a_len);
+        sha2_512_update(&ctx, b, b_len);
+        sha2_512_final(&ctx, hash);
+        store_be64(out, hash, 8);
+    }
+}
+
+static inline uint8_t *
+node(const struct merkle_tree *tree, size_t level, size_t index) {
+    return tree->nodes + (tree->level_start[level] + index) * tree->digest_len;
+}
+
+static inline size_t
+level_size(const struct merkle_tree *tree, size_t level) {
+    return tree->level_start[level + 1] - tree->level_start[level];
+}
+
+/* Hash node `index` of `level` from its children, a node without a right child is copied */
+static void
+hash_node(struct merkle_tree *tree, size_t level, size_t index) {
+    uint8_t *left = node(tree, level - 1, 2 * index);
+
+    if (2 * index + 1 < level_size(tree, level - 1)) {
+        hash_prefixed(tree->algorithm, NODE_PREFIX, left, tree->digest_len, left + tree->digest_len, tree->digest_len,
+                      node(tree, level, index));
+    } else {
+        memcpy(node(tree, level, index), left, tree->digest_len);
+    }
+}
+
+static void
+hash_leaf(struct merkle_tree *tree, size_t index, const void *data, size_t len) {
+    hash_prefixed(tree->algorithm, LEAF_PREFIX, data, len, NULL, 0, node(tree, 0, index));
+}
+
+static void
+level_task(void *arg, size_t index) {
+    struct level_build *build = arg;
+    size_t begin = index * MERKLE_GROUP;
+    size_t end = begin + MERKLE_GROUP < level_size(build->tree, build->level) ? begin + MERKLE_GROUP
+                                                                            : level_size(build->tree, build->level);
+
+    for (size_t i = begin; i < end; i++) {
+        if (build->level) {
+            hash_node(build->tree, build->level, i);
+        } else if (build->leaves) {
+            hash_leaf(build->tree, i, build->leaves[i].data, build->leaves[i].len);
+        } else {
+            size_t offset = i * build->chunk_size;
+            size_t len = build->len - offset < build->chunk_size ? build->len - offset : build->chunk_size;
+
+            hash_leaf(build->tree, i, build->data + offset, len);
+        }
+    }
+}
+
+/* Lay out the levels for `num_leaves` leaves and hash them all, leaf data comes from `build` */
+static int
+build_tree(struct merkle_tree *tree, enum hash_algorithm algorithm, size_t num_leaves, struct level_build *build,
+           unsigned num_threads) {
+    size_t total = 0;
+
+    if ((algorithm != HASH_SHA2_256 && algorithm != HASH_SHA2_512) || !num_leaves) {
+        return -1;
+    }
+
+    tree->algorithm = algorithm;
+    tree->digest_len = algorithm == HASH_SHA2_256 ? 32 : 64;
+    tree->num_leaves = num_leaves;
+    tree->num_levels = 0;
+    for (size_t count = num_leaves;; count = (count + 1) / 2) {
+        tree->level_start[tree->num_levels++] = total;
+        total += count;
+        if (count == 1) {
+            break;
+        }
+    }
+    tree->level_start[tree->num_levels] = total;
+
+    tree->nodes = malloc(total * tree->digest_len);
+    if (!tree->nodes) {
+        return -1;
+    }
+
+    build->tree = tree;
+    for (build->level = 0; build->level < tree->num_levels; build->level++) {
+        size_t count = level_size(tree, build->level);
+        size_t num_tasks = (count + MERKLE_GROUP - 1) / MERKLE_GROUP;
+
+        if (count < MERKLE_PARALLEL_MIN) {
+            for (size_t i = 0; i < num_tasks; i++) {
+                level_task(build, i);
+            }
+        } else if (hash_pool_run(num_tasks, 1, num_threads, level_task, build)) {
+            merkle_free(tree);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/**
+   Build a Merkle tree over :c:var:`data` cut into chunks of :c:var:`chunk_size` bytes.
+
+   The last chunk may be shorter, and an empty buffer gives a single empty leaf. Large
+   levels are hashed in parallel on a pool of threads. The tree owns its nodes until
+   :c:func:`merkle_free` is called, the data itself is not referenced after this returns.
+
+   :param tree: Receives the tree.
+   :type tree: struct merkle_tree *
+   :param algorithm: Either `HASH_SHA2_256` or `HASH_SHA2_512`.
+   :type algorithm: enum hash_algorithm
+   :param data: The content to split into leaves.
+   :type data: const void *
+   :param len: Length of :c:var:`data` in bytes.
+   :type len: size_t
+   :param chunk_size: Bytes per leaf, at least 1.
+   :type chunk_size: size_t
+   :param num_threads: Number of threads to use including the calling one, 0 uses
+                       one thread per online core.
+   :type num_threads: unsigned
+   :return: 0 on success, -1 if an argument is invalid or memory could not be allocated.
+   :rtype: int
+*/
+int
+merkle_build(struct merkle_tree *tree, enum hash_algorithm algorithm, const void *data, size_t len,
+             size_t chunk_size, unsigned num_threads) {
+    struct level_build build = {NULL, NULL, data, len, chunk_size, 0};
+
+    if (!chunk_size) {
+        return -1;
+    }
+    return build_tree(tree, algorithm, len ? (len - 1) / chunk_size + 1 : 1, &build, num_threads);
+}
+
+/**
+   Build a Merkle tree with one leaf per element of :c:var:`leaves`.
+
+   :param tree: Receives the tree.
+   :type tree: struct merkle_tree *
+   :param algorithm: Either `HASH_SHA2_256` or `HASH_SHA2_512`.
+   :type algorithm: enum hash_algorithm
+   :param leaves: The content of each leaf, leaves may have different lengths.
+   :type leaves: const struct merkle_leaf *
+   :param num_leaves: Number of elements in :c:var:`leaves`, at least 1.
+   :type num_leaves: size_t
+   :param num_threads: Number of threads to use including the calling one, 0 uses
+                       one thread per online core.
+   :type num_threads: unsigned
+   :return: 0 on success, -1 if an argument is invalid or memory could not be allocated.
+   :rtype: int
+*/
+int
+merkle_build_leaves(struct merkle_tree *tree, enum hash_algorithm algorithm, const struct merkle_leaf *leaves,
+                    size_t num_leaves, unsigned num_threads) {
+    struct level_build build = {NULL, leaves, NULL, 0, 0, 0};
+
+    return build_tree(tree, algorithm, num_leaves, &build, num_threads);
+}
+
+/**
+   Release the nodes of :c:var:`tree`.
+
+   :param tree: A tree built by :c:func:`merkle_build` or :c:func:`merkle_build_leaves`.
+   :type tree: struct merkle_tree *
+*/
+void
+merkle_free(struct merkle_tree *tree) {
+    free(tree->nodes);
+    tree->nodes = NULL;
+}
+
+/**
+   Copy the root hash of :c:var:`tree` to :c:var:`root`.
+
+   :param tree: A built tree.
+   :type tree: const struct merkle_tree *
+   :param root: Receives `tree->digest_len` bytes.
+   :type root: void *
+*/
+void
+merkle_root(const struct merkle_tree *tree, void *root) {
+    memcpy(root, node(tree, tree->num_levels - 1, 0), tree->digest_len);
+}
+
+/**
+   Replace the content of leaf :c:var:`index` and rehash the path to the root.
+
+   Only one node per level is recomputed, so the cost is logarithmic in the number of
+   leaves.
+
+   :param tree: A built tree.
+   :type tree: struct merkle_tree *
+   :param index: The leaf to replace.
+   :type index: size_t
+   :param data: The new content of the leaf.
+   :type data: const void *
+   :param len: Length of :c:var:`data` in bytes.
+   :type len: size_t
+   :return: 0 on success, -1 if :c:var:`index` is out of range.
+   :rtype: int
+*/
+int
+merkle_update(struct merkle_tree *tree, size_t index, const void *data, size_t len) {
+    if (index >= tree->num_leaves) {
+        return -1;
+    }
+
+    hash_leaf(tree, index, data, len);
+    for (size_t level = 1; level < tree->num_levels; level++) {
+        index /= 2;
+        hash_node(tree, level, index);
+    }
+    return 0;
+}
+
+/**
+   Write the inclusion proof of leaf :c:var:`index` to :c:var:`proof`.
+
+   The proof is the list of sibling hashes from the leaf up to the root. Levels where
+   the node has no sibling are skipped, so proofs of the last leaves can be shorter.
+
+   :param tree: A built tree.
+   :type tree: const struct merkle_tree *
+   :param index: The leaf to prove, less than `tree->num_leaves`.
+   :type index: size_t
+   :param proof: Receives the sibling hashes, room for `tree->num_levels - 1` digests is
+                 always enough.
+   :type proof: void *
+   :return: The number of digests written.
+   :rtype: size_t
+*/
+size_t
+merkle_proof(const struct merkle_tree *tree, size_t index, void *proof) {
+    uint8_t *out = proof;
+    size_t num_siblings = 0;
+
+    for (size_t level = 0; level + 1 < tree->num_levels; level++, index /= 2) {
+        if ((index ^ 1) < level_size(tree, level)) {
+            memcpy(out + num_siblings++ * tree->digest_len, node(tree, level, index ^ 1), tree->digest_len);
+        }
+    }
+    return num_siblings;
+}
+
+/**
+   Check that :c:var:`data` is leaf :c:var:`index` of the tree with the given :c:var:`root`.
+
+   Only the root, the number of leaves and the proof are needed, not the tree itself.
+
+   :param algorithm: Either `HASH_SHA2_256` or `HASH_SHA2_512`.
+   :type algorithm: enum hash_algorithm
+   :param root: The trusted root hash.
+   :type root: const void *
+   :param num_leaves: Number of leaves of the tree.
+   :type num_leaves: size_t
+   :param index: Position of the leaf.
+   :type index: size_t
+   :param data: The content of the leaf.
+   :type data: const void *
+   :param len: Length of :c:var:`data` in bytes.
+   :type len: size_t
+   :param proof: Sibling hashes as written by :c:func:`merkle_proof`.
+   :type proof: const void *
+   :param proof_len: Number of digests in :c:var:`proof`.
+   :type proof_len: size_t
+   :return: 0 if the proof is valid, -1 otherwise.
+   :rtype: int
+*/
+int
+merkle_verify(enum hash_algorithm algorithm, const void *root, size_t num_leaves, size_t index, const void *data,
+              size_t len, const void *proof, size_t proof_len) {
+    size_t digest_len = algorithm == HASH_SHA2_256 ? 32 : 64;
+    const uint8_t *sibling = proof;
+    uint8_t hash[64];
+    size_t used = 0;
+
+    if ((algorithm != HASH_SHA2_256 && algorithm != HASH_SHA2_512) || index >= num_leaves) {
+        return -1;
+    }
+
+    hash_prefixed(algorithm, LEAF_PREFIX, data, len, NULL, 0, hash);
+    for (size_t count = num_leaves; count > 1; count = (count + 1) / 2, index /= 2) {
+        if ((index ^ 1) >= count) {
+            continue;
+        }
+        if (used == proof_len) {
+            return -1;
+        }
+
+        if (index & 1) {
+            hash_prefixed(algorithm, NODE_PREFIX, sibling, digest_len, hash, digest_len, hash);
+        } else {
+            hash_prefixed(algorithm, NODE_PREFIX, hash, digest_len, sibling, digest_len, hash);
+        }
+        sibling += digest_len;
+        used++;
+    }
+
+    return used == proof_len && !memcmp(hash, root, digest_len) ? 0 : -1;
+}
@@ -0,0 +1,185 @@
+/*
+    ParallelHash tree mode (https://nvlpubs.nist.gov/nistpubs/SpecialPublications/NIST.SP.800-185.pdf).
+
+    The message is cut into leaves of `block_size` bytes. Each leaf is hashed on its own
+    with SHAKE, and the chaining values are absorbed in order into a final cSHAKE named
+    "ParallelHash". Leaves are independent, so they are spread across the worker pool
+    and hashed four at a time in the lanes of `keccak_f1600_x4`.
+
+    The message is processed in windows, so the chaining values of a very large input
+    are never all held in memory at once.
+*/
+
+#include "pool.h"
+#include "sha.h"
+#include "sha_internal.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+/* Bytes of message hashed per pool run, and the most leaves whose chaining values are buffered */
+#define WINDOW_BYTES ((size_t)64 << 20)
+#define MAX_WINDOW_LEAVES ((size_t)1 << 16)
+
+struct leaves {
+    int bits;
+    const uint8_t *data;  /* First leaf of the window */
+    size_t num_leaves;
+    size_t block_size;
+    size_t last_len;      /* Length of the window's last leaf, shorter if it ends the message */
+    uint8_t *cvs;         /* Chaining values of the window, `bits / 4` bytes each */
+};
+
+/* Hash leaves `4 * index` to `4 * index + 3` of the window */
+static void
+leaf_task(void *arg, size_t index) {
+    struct leaves *leaves = arg;
+    size_t cv_len = leaves->bits / 4;
+    size_t first = index * 4;
+    size_t last = first + 4 < leaves->num_leaves ? first + 4 : leaves->num_leaves;
+
+    if (last - first == 4 && (last < leaves->num_leaves || leaves->last_len == leaves->block_size)) {
+        const uint8_t *data[4];
+        uint8_t *out[4];
+
+        for (int k = 0; k < 4; k++) {
+            data[k] = leaves->data + (first + k) * leaves->block_size;
+            out[k] = leaves->cvs + (first + k) * cv_len;
+        }
+        shake_x4(data, leaves->block_size, leaves->bits == 128 ? 168 : 136, out, cv_len);
+        return;
+    }
+
+    for (size_t i = first; i < last; i++) {
+        const uint8_t *data = leaves->data + i * leaves->block_size;
+        size_t len = i + 1 == leaves->num_leaves ? leaves->last_len : leaves->block_size;
+
+        if (leaves->bits == 128) {
+            shake128(data, len, leaves->cvs + i * cv_len, cv_len);
+        } else {
+            shake256(data, len, leaves->cvs + i * cv_len, cv_len);
+        }
+    }
+}
+
+static int
+parallelhash(int bits, const void *data, size_t len, size_t block_size, const void *custom, size_t custom_len,
+             void *out, size_t out_len, unsigned num_threads) {
+    void (*update)(struct shake_ctx *, const void *, size_t) = bits == 128 ? shake128_update : shake256_update;
+    struct leaves leaves = {bits, data, 0, block_size, block_size, NULL};
+    size_t num_leaves, window;
+    struct shake_ctx ctx;
+    uint8_t encoded[9];
+
+    if (!block_size) {
+        return -1;
+    }
+
+    window = WINDOW_BYTES / block_size;
+    window = window < 4 ? 4 : window > MAX_WINDOW_LEAVES ? MAX_WINDOW_LEAVES : window & ~(size_t)3;
+    num_leaves = (len + block_size - 1) / block_size;
+    leaves.cvs = malloc((num_leaves < window ? num_leaves : window) * (bits / 4) + 1);
+    if (!leaves.cvs) {
+        return -1;
+    }
+
+    if (bits == 128) {
+        cshake128_init(&ctx, "ParallelHash", 12, custom, custom_len);
+    } else {
+        cshake256_init(&ctx, "ParallelHash", 12, custom, custom_len);
+    }
+    update(&ctx, encoded, left_encode(encoded, block_size));
+
+    for (size_t done = 0; done < num_leaves; done += leaves.num_leaves) {
+        leaves.data = (const uint8_t *)data + done * block_size;
+        leaves.num_leaves = num_leaves - done < window ? num_leaves - done : window;
+        if (done + leaves.num_leaves == num_leaves) {
+            leaves.last_len = len - (num_leaves - 1) * block_size;
+        }
+
+        if (hash_pool_run((leaves.num_leaves + 3) / 4, 1, num_threads, leaf_task, &leaves)) {
+            free(leaves.cvs);
+            return -1;
+        }
+        update(&ctx, leaves.cvs, leaves.num_leaves * (bits / 4));
+    }
+
+    update(&ctx, encoded, right_encode(encoded, num_leaves));
+    update(&ctx, encoded, right_encode(encoded, (uint64_t)out_len * 8));
+    if (bits == 128) {
+        shake128_squeeze(&ctx, out, out_len);
+    } else {
+        shake256_squeeze(&ctx, out, out_len);
+    }
+
+    free(leaves.cvs);
+    return 0;
+}
+
+/**
+   Compute :c:var:`out_len` bytes of ParallelHash128 output for :c:var:`len` bytes of :c:var:`data`.
+
+   The message is split into blocks of :c:var:`block_size` bytes that are hashed
+   independently across a pool of threads and, within each thread, four at a time in
+   SIMD lanes. Throughput therefore scales with the number of cores on large inputs.
+   The result depends on :c:var:`block_size`, so every party has to agree on it;
+   8192 bytes is a good default.
+
+   :param data: The input message.
+   :type data: const void *
+   :param len: Length of :c:var:`data` in bytes.
+   :type len: size_t
+   :param block_size: Size of the independently hashed blocks in bytes, at least 1.
+   :type block_size: size_t
+   :param custom: The customization string ``S``, may be empty.
+   :type custom: const void *
+   :param custom_len: Length of :c:var:`custom` in bytes.
+   :type custom_len: size_t
+   :param out: Receives :c:var:`out_len` bytes of output.
+   :type out: void *
+   :param out_len: Number of bytes to write.
+   :type out_len: size_t
+   :param num_threads: Number of threads to use including the calling one, 0 uses
+                       one thread per online core.
+   :type num_threads: unsigned
+   :return: 0 on success, -1 if :c:var:`block_size` is 0 or memory could not be allocated.
+   :rtype: int
+*/
+int
+parallelhash128(const void *data, size_t len, size_t block_size, const void *custom, size_t custom_len, void *out,
+                size_t out_len, unsigned num_threads) {
+    return parallelhash(128, data, len, block_size, custom, custom_len, out, out_len, num_threads);
+}
+
+/**
+   Compute :c:var:`out_len` bytes of ParallelHash256 output for :c:var:`len` bytes of :c:var:`data`.
+
+   This is the 256-bit security variant of :c:func:`parallelhash128`, it takes the
+   same parameters.
+
+   :param data: The input message.
+   :type data: const void *
+   :param len: Length of :c:var:`data` in bytes.
+   :type len: size_t
+   :param block_size: Size of the independently hashed blocks in bytes, at least 1.
+   :type block_size: size_t
+   :param custom: The customization string ``S``, may be empty.
+   :type custom: const void *
+   :param custom_len: Length of :c:var:`custom` in bytes.
+   :type custom_len: size_t
+   :param out: Receives :c:var:`out_len` bytes of output.
+   :type out: void *
+   :param out_len: Number of bytes to write.
+   :type out_len: size_t
+   :param num_threads: Number of threads to use including the calling one, 0 uses
+                       one thread per online core.
+   :type num_threads: unsigned
+   :return: 0 on success, -1 if :c:var:`block_size` is 0 or memory could not be allocated.
+   :rtype: int
+*/
+int
+parallelhash256(const void *data, size_t len, size_t block_size, const void *custom, size_t custom_len, void *out,
+                size_t out_len, unsigned num_threads) {
+    return parallelhash(256, data, len, block_size, custom, custom_len, out, out_len, num_threads);
+}
@@ -0,0 +1,182 @@
+/*
+    A small work stealing pool.
+
+    Every worker owns a contiguous range of task indices and takes `grain` tasks at a
+    time from its front. A worker that runs dry steals the back half of the first
+    non-empty range it finds, so a few long tasks cannot leave the other cores idle.
+    No task is ever added after the start, so a worker that finds every range empty
+    can exit.
+*/
+
+#include "pool.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+/* Padded so that two workers never share a cache line */
+struct deque {
+    pthread_mutex_t lock;
+    size_t begin;
+    size_t end;
+    char pad[64];
+};
+
+struct pool {
+    struct deque *deques;
+    unsigned num_workers;
+    size_t grain;
+    void (*task)(void *arg, size_t index);
+    void *arg;
+};
+
+struct worker {
+    struct pool *pool;
+    unsigned id;
+};
+
+/* Take up to `grain` tasks from the front of our own range */
+static int
+pop_front(struct deque *deque, size_t grain, size_t *begin, size_t *end) {
+    int found = 0;
+
+    pthread_mutex_lock(&deque->lock);
+    if (deque->begin < deque->end) {
+        *begin = deque->begin;
+        *end = deque->end - deque->begin < grain ? deque->end : deque->begin + grain;
+        deque->begin = *end;
+        found = 1;
+    }
+    pthread_mutex_unlock(&deque->lock);
+
+    return found;
+}
+
+/* Move the back half of `victim` into `thief`, which is empty and only ever filled by its owner */
+static int
+steal_half(struct deque *victim, struct deque *thief) {
+    size_t begin = 0, end = 0;
+
+    pthread_mutex_lock(&victim->lock);
+    if (victim->begin < victim->end) {
+        end = victim->end;
+        begin = victim->end - (victim->end - victim->begin + 1) / 2;
+        victim->end = begin;
+    }
+    pthread_mutex_unlock(&victim->lock);
+
+    if (begin == end) {
+        return 0;
+    }
+
+    pthread_mutex_lock(&thief->lock);
+    thief->begin = begin;
+    thief->end = end;
+    pthread_mutex_unlock(&thief->lock);
+
+    return 1;
+}
+
+static void *
+work(void *arg) {
+    struct worker *worker = arg;
+    struct pool *pool = worker->pool;
+    struct deque *own = &pool->deques[worker->id];
+    size_t begin, end;
+
+    for (;;) {
+        while (pop_front(own, pool->grain, &begin, &end)) {
+            for (size_t i = begin; i < end; i++) {
+                pool->task(pool->arg, i);
+            }
+        }
+
+        unsigned victim = 1;
+        for (; victim < pool->num_workers; victim++) {
+            if (steal_half(&pool->deques[(worker->id + victim) % pool->num_workers], own)) {
+                break;
+            }
+        }
+        if (victim == pool->num_workers) {
+            return NULL;
+        }
+    }
+}
+
+unsigned
+hash_pool_default_threads(void) {
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+
+    return cores > 0 ? (unsigned)cores : 1;
+}
+
+/*
+    Call `task(arg, i)` once for every `i` in `[0, num_tasks)` using `num_threads`
+    threads, including the calling one. 0 threads means one per online core.
+
+    If a thread cannot be created its share is stolen by the others, so the tasks
+    always complete. Returns -1 only if the pool could not be allocated.
+*/
+int
+hash_pool_run(size_t num_tasks, size_t grain, unsigned num_threads, void (*task)(void *arg, size_t index),
+              void *arg) {
+    if (!num_threads) {
+        num_threads = hash_pool_default_threads();
+    }
+    if (num_threads > num_tasks) {
+        num_threads = num_tasks ? num_tasks : 1;
+    }
+    if (!grain) {
+        grain = 1;
+    }
+
+    if (num_threads == 1) {
+        for (size_t i = 0; i < num_tasks; i++) {
+            task(arg, i);
+        }
+        return 0;
+    }
+
+    struct deque *deques = calloc(num_threads, sizeof *deques);
+    struct worker *workers = calloc(num_threads, sizeof *workers);
+    pthread_t *threads = calloc(num_threads, sizeof *threads);
+    char *started = calloc(num_threads, sizeof *started);
+    struct pool pool = {deques, num_threads, grain, task, arg};
+
+    if (!deques || !workers || !threads || !started) {
+        free(deques);
+        free(workers);
+        free(threads);
+        free(started);
+        return -1;
+    }
+
+    for (unsigned i = 0; i < num_threads; i++) {
+        pthread_mutex_init(&deques[i].lock, NULL);
+        deques[i].begin = num_tasks * i / num_threads;
+        deques[i].end = num_tasks * (i + 1) / num_threads;
+        workers[i].pool = &pool;
+        workers[i].id = i;
+    }
+
+    for (unsigned i = 1; i < num_threads; i++) {
+        started[i] = !pthread_create(&threads[i], NULL, work, &workers[i]);
+    }
+    work(&workers[0]);
+
+    for (unsigned i = 1; i < num_threads; i++) {
+        if (started[i]) {
+            pthread_join(threads[i], NULL);
+        }
+    }
+
+    for (unsigned i = 0; i < num_threads; i++) {
+        pthread_mutex_destroy(&deques[i].lock);
+    }
+    free(deques);
+    free(workers);
+    free(threads);
+    free(started);
+
+    return 0;
+}
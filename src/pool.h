@@ -0,0 +1,15 @@
+/* Internal worker pool shared by the modules that spread independent work across threads. */
+
+#ifndef _POOL
+#define _POOL
+
+#include <stddef.h>
+
+/* Number of online cores, used whenever a caller passes 0 threads */
+unsigned hash_pool_default_threads(void);
+
+int hash_pool_run(size_t num_tasks, size_t grain, unsigned num_threads, void (*task)(void *arg, size_t index),
+                  void *arg);
+
+
+#endif /* _POOL */
@@ -2,18 +2,14 @@
 
 #include "sha.h"
 
-#include <assert.h>
+#include "cpu.h"
+#include "sha_internal.h"
+#include "stats_internal.h"
+
+#include <stddef.h>
 #include <stdint.h>
-#include <stdlib.h>
 #include <string.h>
 
-/* If 128-bit int is supported by the compiler, use that else fallback to 64-bit int for now. */
-#ifdef __SIZEOF_INT128__
-typedef __uint128_t uint128_t;
-#else
-typedef uint64_t uint128_t;
-#endif
-
 /* SHA-1: 4 constant 32-bit words */
 const uint32_t K32_4[] = {0x5a827999, 0x6ed9eba1, 0x8f1bbcdc, 0xca62c1d6};
 
@@ -51,88 +47,373 @@ const uint64_t K64_80[] = {
     0x431d67c49c100d4c, 0x4cc5d4becb3e42b6, 0x597f299cfc657e2a, 0x5fcb6fab3ad6faec, 0x6c44198c4a475817,
 };
 
-/*
-    Calculate the padding required by a message with max length 2^64
+/* Initial hash values from section 5.3 of the paper */
+const uint32_t IV_SHA1[] = {
+    0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476, 0xc3d2e1f0,
+};
 
-    The formula is given by::
+const uint32_t IV_SHA2_224[] = {
+    0xc1059ed8, 0x367cd507, 0x3070dd17, 0xf70e5939, 0xffc00b31, 0x68581511, 0x64f98fa7, 0xbefa4fa4,
+};
 
-        l + 1 + k = 448 mod 512
+const uint32_t IV_SHA2_256[] = {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+};
+
+const uint64_t IV_SHA2_384[] = {
+    0xcbbb9d5dc1059ed8, 0x629a292a367cd507, 0x9159015a3070dd17, 0x152fecd8f70e5939,
+    0x67332667ffc00b31, 0x8eb44a8768581511, 0xdb0c2e0d64f98fa7, 0x47b5481dbefa4fa4,
+};
 
+const uint64_t IV_SHA2_512[] = {
+    0x6a09e667f3bcc908, 0xbb67ae8584caa73b, 0x3c6ef372fe94f82b, 0xa54ff53a5f1d36f1,
+    0x510e527fade682d1, 0x9b05688c2b3e6c1f, 0x1f83d9abfb41bd6b, 0x5be0cd19137e2179,
+};
 
-    To find `k`, we can rewrite as::
+/* Generated by the SHA-512/t IV generation function of section 5.3.6 */
+const uint64_t IV_SHA2_512_224[] = {
+    0x8c3d37c819544da2, 0x73e1996689dcd4d6, 0x1dfab7ae32ff9c82, 0x679dd514582f9fcf,
+    0x0f6d2b697bd44da8, 0x77e36f7304c48942, 0x3f9d85a86a1d36c8, 0x1112e6ad91d692a1,
+};
 
-        k = ( 448 - (l + 1) ) mod 512
-        k = ( 447 - l ) mod 512
+const uint64_t IV_SHA2_512_256[] = {
+    0x22312194fc2bf72c, 0x9f555fa3c84c64c2, 0x2393b86b6f53b151, 0x963877195940eabd,
+    0x96283ee2a88effe3, 0xbe5e1e2553863992, 0x2b0199fc2c85b8aa, 0x0eb72ddc81c52ca2,
+};
 
-    where l is length of message in bits (`msg_bit_len` here) and k is the padding required
+/* Compression functions picked by `sha_set_backend`, the scalar ones are always available */
+static void (*sha1_backend)(uint32_t *, const uint8_t *, size_t) = sha1_compress_scalar;
+static void (*sha256_backend)(uint32_t *, const uint8_t *, size_t) = sha256_compress_scalar;
+static void (*sha256_words_backend)(uint32_t *, const uint32_t *) = sha256_compress_words_scalar;
+static void (*sha256_schedule_backend)(uint32_t *, const uint32_t *) = sha256_compress_schedule_scalar;
+static enum sha_backend active_backend = SHA_BACKEND_SCALAR;
+
+/* Counters of SHA-1, SHA-224 and SHA-256 go to the backend in use */
+#define SHA_STATS_BACKEND (active_backend == SHA_BACKEND_SHANI ? HASH_STATS_SHANI : HASH_STATS_SCALAR)
+
+void
+sha1_compress(uint32_t *state, const uint8_t *blocks, size_t num_blocks) {
+    PROBE2(sha1_compress_start, num_blocks, active_backend);
+    sha1_backend(state, blocks, num_blocks);
+    PROBE1(sha1_compress_done, num_blocks);
+}
+
+void
+sha256_compress(uint32_t *state, const uint8_t *blocks, size_t num_blocks) {
+    PROBE2(sha256_compress_start, num_blocks, active_backend);
+    sha256_backend(state, blocks, num_blocks);
+    PROBE1(sha256_compress_done, num_blocks);
+}
+
+/**
+   Select the implementation of the SHA-1, SHA-224 and SHA-256 compression functions.
+
+   The fastest backend supported by the CPU is selected when the library is loaded,
+   this is only needed to force a particular one, e.g. to compare their outputs.
+   It is not thread-safe and should be called before any hashing starts.
+
+   :param backend: ``SHA_BACKEND_AUTO`` for the fastest supported backend,
+                   ``SHA_BACKEND_SCALAR`` for the portable C code or
+                   ``SHA_BACKEND_SHANI`` for the Intel SHA extensions.
+   :type backend: enum sha_backend
+   :return: 0 on success, -1 if the CPU does not support :c:var:`backend`.
+   :rtype: int
 */
-static inline uint64_t
-pad64_len(const uint64_t msg_bit_len) {
-    return (447 - msg_bit_len) % 512;
+int
+sha_set_backend(enum sha_backend backend) {
+    unsigned features = hash_cpu_features();
+    int has_shani = (features & CPU_SHA) && (features & CPU_SSE41) && (features & CPU_SSSE3);
+
+    if (backend == SHA_BACKEND_AUTO) {
+        backend = has_shani ? SHA_BACKEND_SHANI : SHA_BACKEND_SCALAR;
+    }
+
+    switch (backend) {
+        case SHA_BACKEND_SCALAR:
+            sha1_backend = sha1_compress_scalar;
+            sha256_backend = sha256_compress_scalar;
+            sha256_words_backend = sha256_compress_words_scalar;
+            sha256_schedule_backend = sha256_compress_schedule_scalar;
+            break;
+        case SHA_BACKEND_SHANI:
+            if (!has_shani) {
+                return -1;
+            }
+            sha1_backend = sha1_compress_shani;
+            sha256_backend = sha256_compress_shani;
+            sha256_words_backend = sha256_compress_words_shani;
+            sha256_schedule_backend = sha256_compress_schedule_shani;
+            break;
+        default:
+            return -1;
+    }
+
+    active_backend = backend;
+    return 0;
 }
 
-/* Calculate the total length required to process `msg_bit_len` with required padding and pad-length consideration */
-static inline uint64_t
-block64_len(const uint64_t msg_bit_len) {
-    return msg_bit_len + 1 + pad64_len(msg_bit_len) + 64;
+/**
+   Get the backend currently used for SHA-1, SHA-224 and SHA-256.
+
+   :return: ``SHA_BACKEND_SCALAR`` or ``SHA_BACKEND_SHANI``, never ``SHA_BACKEND_AUTO``.
+   :rtype: enum sha_backend
+*/
+enum sha_backend
+sha_get_backend(void) {
+    return active_backend;
+}
+
+#ifdef __GNUC__
+__attribute__((constructor)) static void
+sha_select_backend(void) {
+    sha_set_backend(SHA_BACKEND_AUTO);
+}
+#endif
+
+/* Clear secrets in a way the compiler cannot drop as a dead store */
+void
+hash_wipe(void *data, size_t len) {
+    volatile uint8_t *bytes = data;
+
+    while (len--) {
+        *bytes++ = 0;
+    }
+}
+
+/* Write the first `len` bytes of the big-endian `words`, whole words first since most callers want whole digests */
+void
+hash_store_words(uint8_t *out, const void *words, size_t word_size, size_t len) {
+    size_t i = 0;
+
+    for (; i + word_size <= len; i += word_size) {
+        for (size_t b = 0; b < word_size; b++) {
+            if (word_size == 4) {
+                out[i + b] = (((const uint32_t *)words)[i / 4] >> (24 - 8 * b)) & 0xff;
+            } else {
+                out[i + b] = (((const uint64_t *)words)[i / 8] >> (56 - 8 * b)) & 0xff;
+            }
+        }
+    }
+    for (; i < len; i++) {
+        if (word_size == 4) {
+            out[i] = (((const uint32_t *)words)[i / 4] >> (24 - 8 * (i % 4))) & 0xff;
+        } else {
+            out[i] = (((const uint64_t *)words)[i / 8] >> (56 - 8 * (i % 8))) & 0xff;
+        }
+    }
 }
 
 /*
-    Prepare the block to be padded in the following format:
+    Pad the final block(s) of a message with max length 2^64 and compress them.
 
     ``1`` is appended to message followed by ``k`` zeros bits,
     where ``k``  is the smallest non-negative solution to::
 
-    l + 1 + k = 448 mod 512
+        l + 1 + k = 448 mod 512
 
     Additional 64-bits are appended to represent the number of bits
     in the message (without padding).
+
+    `block` holds the `used` trailing bytes of the message that have not been
+    compressed yet, if they leave no room for the length a second block is needed.
 */
 static inline void
-pad64(uint8_t **block, const uint64_t msg_bit_len) {
-    uint64_t block_byte_len = block64_len(msg_bit_len) / 8;
-    (*block)[msg_bit_len / 8] = 0x80;
+pad64(uint32_t *state, uint8_t *block, size_t used, const uint64_t msg_bit_len,
+      void (*compress)(uint32_t *, const uint8_t *, size_t)) {
+    block[used++] = 0x80;
+
+    if (used > 56) {
+        memset(block + used, 0, 64 - used);
+        compress(state, block, 1);
+        used = 0;
+    }
+    memset(block + used, 0, 56 - used);
 
     for (int i = 0; i < 8; i++) {
-        (*block)[block_byte_len - 8 + i] = (msg_bit_len >> (56 - 8 * i)) & 0xff;
+        block[56 + i] = (msg_bit_len >> (56 - 8 * i)) & 0xff;
     }
+    compress(state, block, 1);
 }
 
 /*
-    Resize the message to a size that is divisble by 512, capable
-    of storing 64-bit block in the end for encoding the length of the message
+    Hash the whole `len` bytes of `message` into `state`.
+
+    Full blocks are compressed straight from `message`, only the tail is copied to
+    the stack to be padded, so nothing is allocated however large the message is.
 */
 static inline void
-pad64_resize(uint8_t **message, const uint64_t msg_bit_len) {
-    uint64_t block_len = block64_len(msg_bit_len);
+digest64(uint32_t *state, const uint8_t *message, size_t len, void (*compress)(uint32_t *, const uint8_t *, size_t)) {
+    uint8_t block[64];
 
-    uint8_t *padded_msg = calloc(block_len, sizeof *padded_msg);
-    memcpy(padded_msg, *message, msg_bit_len / 8);
-    *message = padded_msg;
+    compress(state, message, len / 64);
+    if (len % 64) {
+        memcpy(block, message + len / 64 * 64, len % 64);  /* An empty message may be NULL */
+    }
+    pad64(state, block, len % 64, (uint64_t)len * 8, compress);
 }
 
-/* Set of logical functions that are to be performed based on value of ``t`` */
 static inline uint32_t
-sha1_round(const int t, const uint32_t x, const uint32_t y, const uint32_t z) {
-    if (t < 20) {
-        return CH(x, y, z);
-    } else if (39 < t && t < 60) {
-        return MAJ(x, y, z);
-    } else {
-        return PARITY(x, y, z);
+load32_be(const uint8_t *p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+/*
+    The compression functions below are fully unrolled. Instead of shifting the working
+    variables after every round, each round is written with their names rotated, so the
+    variables stay in registers and none is copied between rounds. The message schedule only keeps
+    the last 16 words, word ``t`` lives in ``w[t & 15]`` and with every index a constant
+    the compiler keeps most of them in registers too.
+
+    `W` picks the schedule step at compile time: the first 16 words are loaded from the
+    block and the following ones are expanded in place over the word they replace.
+*/
+#define SHA1_LOAD(t) (w[t] = load32_be(block + 4 * (t)))
+#define SHA1_EXPAND(t)                                                                                                 \
+    (w[(t) & 15] = ROTL(w[((t) - 3) & 15] ^ w[((t) - 8) & 15] ^ w[((t) - 14) & 15] ^ w[(t) & 15], 1))
+#define SHA1_W(t) ((t) < 16 ? SHA1_LOAD((t) & 15) : SHA1_EXPAND(t))
+
+/* One SHA-1 round, the new ``a`` is left in `e` and the caller rotates the names */
+#define SHA1_ROUND(a, b, c, d, e, f, k, t)                                                                             \
+    do {                                                                                                               \
+        e += ROTL(a, 5) + f(b, c, d) + (k) + SHA1_W(t);                                                                \
+        b = ROTL(b, 30);                                                                                               \
+    } while (0)
+
+#define SHA1_ROUNDS5(f, k, t)                                                                                          \
+    do {                                                                                                               \
+        SHA1_ROUND(a, b, c, d, e, f, k, (t));                                                                          \
+        SHA1_ROUND(e, a, b, c, d, f, k, (t) + 1);                                                                      \
+        SHA1_ROUND(d, e, a, b, c, f, k, (t) + 2);                                                                      \
+        SHA1_ROUND(c, d, e, a, b, f, k, (t) + 3);                                                                      \
+        SHA1_ROUND(b, c, d, e, a, f, k, (t) + 4);                                                                      \
+    } while (0)
+
+#define SHA1_ROUNDS20(f, k, t)                                                                                         \
+    do {                                                                                                               \
+        SHA1_ROUNDS5(f, k, (t));                                                                                       \
+        SHA1_ROUNDS5(f, k, (t) + 5);                                                                                   \
+        SHA1_ROUNDS5(f, k, (t) + 10);                                                                                  \
+        SHA1_ROUNDS5(f, k, (t) + 15);                                                                                  \
+    } while (0)
+
+/*
+    Run the SHA-1 compression function over `num_blocks` consecutive 64-byte blocks.
+
+    The schedule lives on the stack, so any number of threads may hash at once.
+*/
+void
+sha1_compress_scalar(uint32_t *state, const uint8_t *blocks, size_t num_blocks) {
+    uint32_t w[16];
+
+    for (size_t i = 0; i < num_blocks; i++) {
+        uint32_t a = state[0], b = state[1], c = state[2], d = state[3], e = state[4];
+        const uint8_t *block = blocks + i * 64;
+
+        SHA1_ROUNDS20(CH, K32_4[0], 0);
+        SHA1_ROUNDS20(PARITY, K32_4[1], 20);
+        SHA1_ROUNDS20(MAJ, K32_4[2], 40);
+        SHA1_ROUNDS20(PARITY, K32_4[3], 60);
+
+        state[0] += a;
+        state[1] += b;
+        state[2] += c;
+        state[3] += d;
+        state[4] += e;
     }
 }
 
-/* Message schedule for sha1, uses 80 32-bit words. */
-static inline uint32_t
-sha1_schedule(const uint8_t *message, const int t) {
-    static uint32_t w[80];
-    if (t < 16) {
-        w[t] = (message[t * 4] << 24) | (message[t * 4 + 1] << 16) | (message[t * 4 + 2] << 8) | (message[t * 4 + 3]);
-    } else {
-        w[t] = ROTL(w[t - 3] ^ w[t - 8] ^ w[t - 14] ^ w[t - 16], 1);
+/**
+   Initialize :c:var:`ctx` for computing a SHA-1 hash incrementally.
+
+   :param ctx: The context to initialize.
+   :type ctx: struct sha1_ctx *
+*/
+void
+sha1_init(struct sha1_ctx *ctx) {
+    memcpy(ctx->state, IV_SHA1, sizeof IV_SHA1);
+    ctx->length = 0;
+}
+
+/**
+   Feed the next :c:var:`len` bytes of the message into :c:var:`ctx`.
+
+   Full blocks are compressed as soon as they are available, only the
+   trailing partial block is kept in the context.
+
+   :param ctx: A context initialized by :c:func:`sha1_init`.
+   :type ctx: struct sha1_ctx *
+   :param data: The next chunk of the message, it may contain any byte value.
+   :type data: const void *
+   :param len: Length of :c:var:`data` in bytes.
+   :type len: size_t
+*/
+void
+sha1_update(struct sha1_ctx *ctx, const void *data, size_t len) {
+    const uint8_t *message = data;
+    size_t used = ctx->length % 64;
+
+    STATS_CALL(HASH_SHA1, SHA_STATS_BACKEND, len, (used + len) / 64);
+    if (!len) {
+        return;  /* `data` may be NULL */
+    }
+    ctx->length += len;
+
+    if (used) {
+        size_t fill = 64 - used < len ? 64 - used : len;
+        memcpy(ctx->block + used, message, fill);
+        message += fill;
+        len -= fill;
+
+        if (used + fill < 64) {
+            return;
+        }
+        sha1_compress(ctx->state, ctx->block, 1);
     }
-    return w[t];
+
+    sha1_compress(ctx->state, message, len / 64);
+    memcpy(ctx->block, message + len / 64 * 64, len % 64);
+}
+
+/**
+   Pad the message fed to :c:var:`ctx` and write the SHA-1 hash.
+
+   :param ctx: A context fed by :c:func:`sha1_update`, it has to be initialized
+               again before it can be reused.
+   :type ctx: struct sha1_ctx *
+   :param hash: An array big enough to store 5 `uint32_t` elements. The hash value will
+                be written to it.
+   :type hash: uint32_t *
+*/
+void
+sha1_final(struct sha1_ctx *ctx, uint32_t *hash) {
+    STATS_BLOCKS(HASH_SHA1, SHA_STATS_BACKEND, PADDED_BLOCKS(ctx->length % 64, 64, 8));
+    pad64(ctx->state, ctx->block, ctx->length % 64, ctx->length * 8, sha1_compress);
+    memcpy(hash, ctx->state, 5 * sizeof *hash);
+}
+
+/**
+   Compute the SHA-1 hash of the first :c:var:`len` bytes of :c:var:`data`.
+
+   Unlike :c:func:`sha1` the input is not required to be NUL-terminated and may contain
+   any byte value. Full blocks are compressed in place and only the padded tail is
+   built on the stack, so no memory is allocated.
+
+   :param data: The input message to be hashed.
+   :type data: const void *
+   :param len: Length of :c:var:`data` in bytes.
+   :type len: size_t
+   :param hash: An array big enough to store 5 `uint32_t` elements. The hash value will
+                be written to it.
+   :type hash: uint32_t *
+*/
+void
+sha1_data(const void *data, size_t len, uint32_t *hash) {
+    uint32_t state[5];
+
+    STATS_CALL(HASH_SHA1, SHA_STATS_BACKEND, len, PADDED_BLOCKS(len, 64, 8));
+    memcpy(state, IV_SHA1, sizeof IV_SHA1);
+    digest64(state, data, len, sha1_compress);
+    memcpy(hash, state, 5 * sizeof *hash);
 }
 
 /**
@@ -150,56 +431,190 @@ sha1_schedule(const uint8_t *message, const int t) {
 */
 void
 sha1(const char *message, uint32_t *hash) {
-    uint8_t *padded_msg = (uint8_t *)message;
-    uint64_t message_len = strlen(message);
-    uint64_t msg_bit_len = message_len * 8;
-    uint64_t num_blocks = block64_len(msg_bit_len) / 512;
-
-    /* Max supported for length is 2^64-1 */
-    assert(message_len <= (uint64_t)-1);
-
-    pad64_resize(&padded_msg, msg_bit_len);
-    pad64(&padded_msg, msg_bit_len);
-
-    hash[0] = 0x67452301;
-    hash[1] = 0xefcdab89;
-    hash[2] = 0x98badcfe;
-    hash[3] = 0x10325476;
-    hash[4] = 0xc3d2e1f0;
-
-    for (uint64_t i = 0; i < num_blocks; i++) {
-        uint32_t a = hash[0], b = hash[1], c = hash[2], d = hash[3], e = hash[4];
-        uint8_t *block = padded_msg + i * 64;
-
-        for (int t = 0; t < 80; t++) {
-            uint32_t temp = ROTL(a, 5) + sha1_round(t, b, c, d) + e + K32_4[t / 20] + sha1_schedule(block, t);
-            e = d;
-            d = c;
-            c = ROTL(b, 30);
-            b = a;
-            a = temp;
-        }
+    sha1_data(message, strlen(message), hash);
+}
+
+#define SHA256_LOAD(t) (w[t] = load32_be(block + 4 * (t)))
+#define SHA256_EXPAND(t)                                                                                               \
+    (w[(t) & 15] += SIGMA256_1_SMALL(w[((t) - 2) & 15]) + w[((t) - 7) & 15] + SIGMA256_0_SMALL(w[((t) - 15) & 15]))
+#define SHA256_W(t) ((t) < 16 ? SHA256_LOAD((t) & 15) : SHA256_EXPAND(t))
+
+/* Round constant plus message word, scheduled from the bytes of `block` or the words of `words`, or precomputed */
+#define SHA256_KW_BLOCK(t) (K32_64[t] + SHA256_W(t))
+#define SHA256_KW_WORDS(t) (K32_64[t] + ((t) < 16 ? (w[(t) & 15] = words[(t) & 15]) : SHA256_EXPAND(t)))
+#define SHA256_KW_SCHEDULE(t) (kw[t])
+
+/*
+    One SHA-256 round, the new ``e`` is left in `d` and the new ``a`` in `h`, the caller rotates the names.
+    ``MAJ(a, b, c)`` is ``((a ^ b) & (b ^ c)) ^ b`` and ``b ^ c`` is the ``a ^ b`` of the previous round,
+    so it is carried over in `bc` and this round's value is left in `ab`.
+*/
+#define SHA256_ROUND(a, b, c, d, e, f, g, h, kw_t, ab, bc)                                                             \
+    do {                                                                                                               \
+        uint32_t temp1 = h + SIGMA256_1_BIG(e) + CH(e, f, g) + (kw_t);                                                 \
+        ab = a ^ b;                                                                                                    \
+        d += temp1;                                                                                                    \
+        h = temp1 + SIGMA256_0_BIG(a) + ((ab & bc) ^ b);                                                               \
+    } while (0)
+
+#define SHA256_ROUNDS8(KW, t)                                                                                          \
+    do {                                                                                                               \
+        SHA256_ROUND(a, b, c, d, e, f, g, h, KW(t), x, y);                                                             \
+        SHA256_ROUND(h, a, b, c, d, e, f, g, KW((t) + 1), y, x);                                                       \
+        SHA256_ROUND(g, h, a, b, c, d, e, f, KW((t) + 2), x, y);                                                       \
+        SHA256_ROUND(f, g, h, a, b, c, d, e, KW((t) + 3), y, x);                                                       \
+        SHA256_ROUND(e, f, g, h, a, b, c, d, KW((t) + 4), x, y);                                                       \
+        SHA256_ROUND(d, e, f, g, h, a, b, c, KW((t) + 5), y, x);                                                       \
+        SHA256_ROUND(c, d, e, f, g, h, a, b, KW((t) + 6), x, y);                                                       \
+        SHA256_ROUND(b, c, d, e, f, g, h, a, KW((t) + 7), y, x);                                                       \
+    } while (0)
+
+/* Compress one block into `state`, `KW` names one of the ``SHA256_KW_*`` macros above */
+#define SHA256_BLOCK(KW)                                                                                               \
+    do {                                                                                                               \
+        uint32_t a = state[0], b = state[1], c = state[2], d = state[3], e = state[4], f = state[5], g = state[6],     \
+                 h = state[7];                                                                                         \
+        uint32_t x, y = b ^ c;                                                                                         \
+                                                                                                                       \
+        SHA256_ROUNDS8(KW, 0);                                                                                         \
+        SHA256_ROUNDS8(KW, 8);                                                                                         \
+        SHA256_ROUNDS8(KW, 16);                                                                                        \
+        SHA256_ROUNDS8(KW, 24);                                                                                        \
+        SHA256_ROUNDS8(KW, 32);                                                                                        \
+        SHA256_ROUNDS8(KW, 40);                                                                                        \
+        SHA256_ROUNDS8(KW, 48);                                                                                        \
+        SHA256_ROUNDS8(KW, 56);                                                                                        \
+                                                                                                                       \
+        state[0] += a;                                                                                                 \
+        state[1] += b;                                                                                                 \
+        state[2] += c;                                                                                                 \
+        state[3] += d;                                                                                                 \
+        state[4] += e;                                                                                                 \
+        state[5] += f;                                                                                                 \
+        state[6] += g;                                                                                                 \
+        state[7] += h;                                                                                                 \
+    } while (0)
+
+/* Portable SHA-224/SHA-256 compression function over `num_blocks` consecutive 64-byte blocks */
+void
+sha256_compress_scalar(uint32_t *state, const uint8_t *blocks, size_t num_blocks) {
+    uint32_t w[16];
+
+    for (size_t i = 0; i < num_blocks; i++) {
+        const uint8_t *block = blocks + i * 64;
 
-        hash[0] += a;
-        hash[1] += b;
-        hash[2] += c;
-        hash[3] += d;
-        hash[4] += e;
+        SHA256_BLOCK(SHA256_KW_BLOCK);
     }
+}
+
+/* Portable compression of a block already loaded as 16 host-endian words */
+void
+sha256_compress_words_scalar(uint32_t *state, const uint32_t *words) {
+    uint32_t w[16];
 
-    free(padded_msg);
+    SHA256_BLOCK(SHA256_KW_WORDS);
 }
 
-/* Message schedule for sha256, uses 64 32-bit words */
-static inline uint32_t
-sha256_schedule(const uint8_t *message, const int t) {
-    static uint32_t w[64];
-    if (t < 16) {
-        w[t] = (message[t * 4] << 24) | (message[t * 4 + 1] << 16) | (message[t * 4 + 2] << 8) | (message[t * 4 + 3]);
-    } else {
-        w[t] = SIGMA256_1_SMALL(w[t - 2]) + w[t - 7] + SIGMA256_0_SMALL(w[t - 15]) + w[t - 16];
+/* Portable compression of a block whose round constants plus message schedule `kw` are known in advance */
+void
+sha256_compress_schedule_scalar(uint32_t *state, const uint32_t *kw) {
+    SHA256_BLOCK(SHA256_KW_SCHEDULE);
+}
+
+/* Absorb `len` bytes into a SHA-224 or SHA-256 context */
+static void
+sha256_update(struct sha2_256_ctx *ctx, const void *data, size_t len) {
+    const uint8_t *message = data;
+    size_t used = ctx->length % 64;
+
+    if (!len) {
+        return;  /* `data` may be NULL */
     }
-    return w[t];
+    ctx->length += len;
+
+    if (used) {
+        size_t fill = 64 - used < len ? 64 - used : len;
+        memcpy(ctx->block + used, message, fill);
+        message += fill;
+        len -= fill;
+
+        if (used + fill < 64) {
+            return;
+        }
+        sha256_compress(ctx->state, ctx->block, 1);
+    }
+
+    sha256_compress(ctx->state, message, len / 64);
+    memcpy(ctx->block, message + len / 64 * 64, len % 64);
+}
+
+/**
+   Initialize :c:var:`ctx` for computing a SHA-224 hash incrementally.
+
+   :param ctx: The context to initialize.
+   :type ctx: struct sha2_256_ctx *
+*/
+void
+sha2_224_init(struct sha2_256_ctx *ctx) {
+    memcpy(ctx->state, IV_SHA2_224, sizeof IV_SHA2_224);
+    ctx->length = 0;
+}
+
+/**
+   Feed the next :c:var:`len` bytes of the message into :c:var:`ctx`.
+
+   :param ctx: A context initialized by :c:func:`sha2_224_init`.
+   :type ctx: struct sha2_256_ctx *
+   :param data: The next chunk of the message, it may contain any byte value.
+   :type data: const void *
+   :param len: Length of :c:var:`data` in bytes.
+   :type len: size_t
+*/
+void
+sha2_224_update(struct sha2_256_ctx *ctx, const void *data, size_t len) {
+    STATS_CALL(HASH_SHA2_224, SHA_STATS_BACKEND, len, (ctx->length % 64 + len) / 64);
+    sha256_update(ctx, data, len);
+}
+
+/**
+   Pad the message fed to :c:var:`ctx` and write the SHA-224 hash.
+
+   :param ctx: A context fed by :c:func:`sha2_224_update`.
+   :type ctx: struct sha2_256_ctx *
+   :param hash: An array big enough to store 7 `uint32_t` elements. The hash value will
+                be written to it.
+   :type hash: uint32_t *
+*/
+void
+sha2_224_final(struct sha2_256_ctx *ctx, uint32_t *hash) {
+    STATS_BLOCKS(HASH_SHA2_224, SHA_STATS_BACKEND, PADDED_BLOCKS(ctx->length % 64, 64, 8));
+    pad64(ctx->state, ctx->block, ctx->length % 64, ctx->length * 8, sha256_compress);
+    memcpy(hash, ctx->state, 7 * sizeof *hash);
+}
+
+/**
+   Compute the SHA-224 hash of the first :c:var:`len` bytes of :c:var:`data`.
+
+   Unlike :c:func:`sha2_224` the input is not required to be NUL-terminated and may contain
+   any byte value. Full blocks are compressed in place and only the padded tail is
+   built on the stack, so no memory is allocated.
+
+   :param data: The input message to be hashed.
+   :type data: const void *
+   :param len: Length of :c:var:`data` in bytes.
+   :type len: size_t
+   :param hash: An array big enough to store 7 `uint32_t` elements. The hash value will
+                be written to it.
+   :type hash: uint32_t *
+*/
+void
+sha2_224_data(const void *data, size_t len, uint32_t *hash) {
+    uint32_t state[8];
+
+    STATS_CALL(HASH_SHA2_224, SHA_STATS_BACKEND, len, PADDED_BLOCKS(len, 64, 8));
+    memcpy(state, IV_SHA2_224, sizeof IV_SHA2_224);
+    digest64(state, data, len, sha256_compress);
+    memcpy(hash, state, 7 * sizeof *hash);
 }
 
 /**
@@ -217,54 +632,80 @@ sha256_schedule(const uint8_t *message, const int t) {
 */
 void
 sha2_224(const char *message, uint32_t *hash) {
-    uint8_t *padded_msg = (uint8_t *)message;
-    uint64_t message_len = strlen(message);
-    uint64_t msg_bit_len = message_len * 8;
-    uint64_t num_blocks = block64_len(msg_bit_len) / 512;
-
-    /* Max supported for length is 2^64-1 */
-    assert(message_len <= (uint64_t)-1);
-
-    pad64_resize(&padded_msg, msg_bit_len);
-    pad64(&padded_msg, msg_bit_len);
-
-    hash[0] = 0xc1059ed8;
-    hash[1] = 0x367cd507;
-    hash[2] = 0x3070dd17;
-    hash[3] = 0xf70e5939;
-    hash[4] = 0xffc00b31;
-    hash[5] = 0x68581511;
-    hash[6] = 0x64f98fa7;
-    hash[7] = 0xbefa4fa4;
-
-    for (uint64_t i = 0; i < num_blocks; i++) {
-        uint32_t a = hash[0], b = hash[1], c = hash[2], d = hash[3], e = hash[4], f = hash[5], g = hash[6], h = hash[7];
-        uint8_t *block = padded_msg + i * 64;
-
-        for (int t = 0; t < 64; t++) {
-            uint32_t temp1 = h + SIGMA256_1_BIG(e) + CH(e, f, g) + K32_64[t] + sha256_schedule(block, t);
-            uint32_t temp2 = SIGMA256_0_BIG(a) + MAJ(a, b, c);
-            h = g;
-            g = f;
-            f = e;
-            e = d + temp1;
-            d = c;
-            c = b;
-            b = a;
-            a = temp1 + temp2;
-        }
+    sha2_224_data(message, strlen(message), hash);
+}
 
-        hash[0] += a;
-        hash[1] += b;
-        hash[2] += c;
-        hash[3] += d;
-        hash[4] += e;
-        hash[5] += f;
-        hash[6] += g;
-        hash[7] += h;
-    }
+/**
+   Initialize :c:var:`ctx` for computing a SHA-256 hash incrementally.
+
+   :param ctx: The context to initialize.
+   :type ctx: struct sha2_256_ctx *
+*/
+void
+sha2_256_init(struct sha2_256_ctx *ctx) {
+    memcpy(ctx->state, IV_SHA2_256, sizeof IV_SHA2_256);
+    ctx->length = 0;
+}
+
+/**
+   Feed the next :c:var:`len` bytes of the message into :c:var:`ctx`.
+
+   Full blocks are compressed as soon as they are available, only the
+   trailing partial block is kept in the context.
+
+   :param ctx: A context initialized by :c:func:`sha2_256_init`.
+   :type ctx: struct sha2_256_ctx *
+   :param data: The next chunk of the message, it may contain any byte value.
+   :type data: const void *
+   :param len: Length of :c:var:`data` in bytes.
+   :type len: size_t
+*/
+void
+sha2_256_update(struct sha2_256_ctx *ctx, const void *data, size_t len) {
+    STATS_CALL(HASH_SHA2_256, SHA_STATS_BACKEND, len, (ctx->length % 64 + len) / 64);
+    sha256_update(ctx, data, len);
+}
 
-    free(padded_msg);
+/**
+   Pad the message fed to :c:var:`ctx` and write the SHA-256 hash.
+
+   :param ctx: A context fed by :c:func:`sha2_256_update`, it has to be initialized
+               again before it can be reused.
+   :type ctx: struct sha2_256_ctx *
+   :param hash: An array big enough to store 8 `uint32_t` elements. The hash value will
+                be written to it.
+   :type hash: uint32_t *
+*/
+void
+sha2_256_final(struct sha2_256_ctx *ctx, uint32_t *hash) {
+    STATS_BLOCKS(HASH_SHA2_256, SHA_STATS_BACKEND, PADDED_BLOCKS(ctx->length % 64, 64, 8));
+    pad64(ctx->state, ctx->block, ctx->length % 64, ctx->length * 8, sha256_compress);
+    memcpy(hash, ctx->state, 8 * sizeof *hash);
+}
+
+/**
+   Compute the SHA-256 hash of the first :c:var:`len` bytes of :c:var:`data`.
+
+   Unlike :c:func:`sha2_256` the input is not required to be NUL-terminated and may contain
+   any byte value. Full blocks are compressed in place and only the padded tail is
+   built on the stack, so no memory is allocated.
+
+   :param data: The input message to be hashed.
+   :type data: const void *
+   :param len: Length of :c:var:`data` in bytes.
+   :type len: size_t
+   :param hash: An array big enough to store 8 `uint32_t` elements. The hash value will
+                be written to it.
+   :type hash: uint32_t *
+*/
+void
+sha2_256_data(const void *data, size_t len, uint32_t *hash) {
+    uint32_t state[8];
+
+    STATS_CALL(HASH_SHA2_256, SHA_STATS_BACKEND, len, PADDED_BLOCKS(len, 64, 8));
+    memcpy(state, IV_SHA2_256, sizeof IV_SHA2_256);
+    digest64(state, data, len, sha256_compress);
+    memcpy(hash, state, 8 * sizeof *hash);
 }
 
 /**
@@ -282,132 +723,321 @@ sha2_224(const char *message, uint32_t *hash) {
 */
 void
 sha2_256(const char *message, uint32_t *hash) {
-    uint8_t *padded_msg = (uint8_t *)message;
-    uint64_t message_len = strlen(message);
-    uint64_t msg_bit_len = message_len * 8;
-    uint64_t num_blocks = block64_len(msg_bit_len) / 512;
-
-    /* Max supported for length is 2^64 - 1 */
-    assert(message_len <= (uint64_t)-1);
-
-    pad64_resize(&padded_msg, msg_bit_len);
-    pad64(&padded_msg, msg_bit_len);
-
-    hash[0] = 0x6a09e667;
-    hash[1] = 0xbb67ae85;
-    hash[2] = 0x3c6ef372;
-    hash[3] = 0xa54ff53a;
-    hash[4] = 0x510e527f;
-    hash[5] = 0x9b05688c;
-    hash[6] = 0x1f83d9ab;
-    hash[7] = 0x5be0cd19;
-
-    for (uint64_t i = 0; i < num_blocks; i++) {
-        uint32_t a = hash[0], b = hash[1], c = hash[2], d = hash[3], e = hash[4], f = hash[5], g = hash[6], h = hash[7];
-        uint8_t *block = padded_msg + i * 64;
-
-        for (int t = 0; t < 64; t++) {
-            uint32_t temp1 = h + SIGMA256_1_BIG(e) + CH(e, f, g) + K32_64[t] + sha256_schedule(block, t);
-            uint32_t temp2 = SIGMA256_0_BIG(a) + MAJ(a, b, c);
-            h = g;
-            g = f;
-            f = e;
-            e = d + temp1;
-            d = c;
-            c = b;
-            b = a;
-            a = temp1 + temp2;
-        }
-
-        hash[0] += a;
-        hash[1] += b;
-        hash[2] += c;
-        hash[3] += d;
-        hash[4] += e;
-        hash[5] += f;
-        hash[6] += g;
-        hash[7] += h;
-    }
-
-    free(padded_msg);
+    sha2_256_data(message, strlen(message), hash);
 }
 
 /*
-    Calculate the padding required by a message with max length 2^128
+    K + W of the block padding a 64-byte message: the ``1`` bit, zeros and a bit length of 512.
+    It is the same for every such message so its schedule is computed once, here.
+*/
+static const uint32_t KW_PAD_64[] = {
+    0xc28a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf374,
+    0x649b69c1, 0xf0fe4786, 0x0fe1edc6, 0x240cf254, 0x4fe9346f, 0x6cc984be, 0x61b9411e, 0x16f988fa,
+    0xf2c65152, 0xa88e5a6d, 0xb019fc65, 0xb9d99ec7, 0x9a1231c3, 0xe70eeaa0, 0xfdb1232b, 0xc7353eb0,
+    0x3069bad5, 0xcb976d5f, 0x5a0f118f, 0xdc1eeefd, 0x0a35b689, 0xde0b7a04, 0x58f4ca9d, 0xe15d5b16,
+    0x007f3e86, 0x37088980, 0xa507ea32, 0x6fab9537, 0x17406110, 0x0d8cd6f1, 0xcdaa3b6d, 0xc0bbbe37,
+    0x83613bda, 0xdb48a363, 0x0b02e931, 0x6fd15ca7, 0x521afaca, 0x31338431, 0x6ed41a95, 0x6d437890,
+    0xc39c91f2, 0x9eccabbd, 0xb5c9a0e6, 0x532fb63c, 0xd2c741c6, 0x07237ea3, 0xa4954b68, 0x4c191d76,
+};
 
-    The formula is given by::
+/* The single block of a 32-byte message, the words after the message are its padding and bit length */
+#define BLOCK_32(w0, w1, w2, w3, w4, w5, w6, w7) {w0, w1, w2, w3, w4, w5, w6, w7, 0x80000000, 0, 0, 0, 0, 0, 0, 256}
 
-        l + 1 + k = 896 mod 512
+/**
+   Compute the SHA-256 hash of exactly 32 bytes, e.g. a key or another digest.
 
+   The result is the same as :c:func:`sha2_256_data` with a length of 32, but the
+   message is loaded straight into the words of its only block, whose padding is
+   known in advance.
 
-    To find `k`, we can rewrite as::
+   :param data: The 32 bytes to be hashed.
+   :type data: const void *
+   :param hash: An array big enough to store 8 `uint32_t` elements. The hash value will
+                be written to it.
+   :type hash: uint32_t *
+*/
+void
+sha2_256_32(const void *data, uint32_t *hash) {
+    const uint8_t *p = data;
+    uint32_t block[16] = BLOCK_32(load32_be(p), load32_be(p + 4), load32_be(p + 8), load32_be(p + 12),
+                                  load32_be(p + 16), load32_be(p + 20), load32_be(p + 24), load32_be(p + 28));
+    uint32_t state[8];
+
+    STATS_CALL(HASH_SHA2_256, SHA_STATS_BACKEND, 32, 1);
+    memcpy(state, IV_SHA2_256, sizeof IV_SHA2_256);
+    sha256_words_backend(state, block);
+    memcpy(hash, state, 8 * sizeof *hash);
+}
 
-        k = ( 896 - (l + 1) ) mod 512
-        k = ( 895 - l ) mod 512
+/**
+   Compute the SHA-256 hash of exactly 64 bytes, e.g. the two children of a tree node.
+
+   The result is the same as :c:func:`sha2_256_data` with a length of 64. The second
+   block only holds the padding, its message schedule is precomputed so it costs the
+   rounds alone.
 
-    where l is length of message in bits (`msg_bit_len` here) and k is the padding required
+   :param data: The 64 bytes to be hashed.
+   :type data: const void *
+   :param hash: An array big enough to store 8 `uint32_t` elements. The hash value will
+                be written to it.
+   :type hash: uint32_t *
 */
-static inline uint128_t
-pad128_len(const uint128_t msg_bit_len) {
-    return (895 - msg_bit_len) % 1024;
+void
+sha2_256_64(const void *data, uint32_t *hash) {
+    uint32_t state[8];
+
+    STATS_CALL(HASH_SHA2_256, SHA_STATS_BACKEND, 64, 2);
+    memcpy(state, IV_SHA2_256, sizeof IV_SHA2_256);
+    sha256_compress(state, data, 1);
+    sha256_schedule_backend(state, KW_PAD_64);
+    memcpy(hash, state, 8 * sizeof *hash);
 }
 
-/*
-    Calculate the total length required to process `msg_bit_len` with
-    required padding and pad-length consideration
+/**
+   Compute the double SHA-256 hash, ``SHA-256(SHA-256(data))``, of the first :c:var:`len`
+   bytes of :c:var:`data`.
+
+   The first hash is computed in the first 8 words of the block of the second one,
+   which is then compressed as is: the intermediate digest is never converted to
+   bytes. Messages of 64 bytes take the path of :c:func:`sha2_256_64`.
+
+   :param data: The input message to be hashed.
+   :type data: const void *
+   :param len: Length of :c:var:`data` in bytes.
+   :type len: size_t
+   :param hash: An array big enough to store 8 `uint32_t` elements. The hash value will
+                be written to it.
+   :type hash: uint32_t *
 */
-static inline uint128_t
-block128_len(const uint128_t msg_bit_len) {
-    return msg_bit_len + 1 + pad128_len(msg_bit_len) + 128;
+void
+sha2_256d(const void *data, size_t len, uint32_t *hash) {
+    uint32_t block[16] = BLOCK_32(IV_SHA2_256[0], IV_SHA2_256[1], IV_SHA2_256[2], IV_SHA2_256[3], IV_SHA2_256[4],
+                                  IV_SHA2_256[5], IV_SHA2_256[6], IV_SHA2_256[7]);
+    uint32_t state[8];
+
+    STATS_CALL(HASH_SHA2_256, SHA_STATS_BACKEND, len, PADDED_BLOCKS(len, 64, 8) + 1);
+    if (len == 64) {
+        sha256_compress(block, data, 1);
+        sha256_schedule_backend(block, KW_PAD_64);
+    } else {
+        digest64(block, data, len, sha256_compress);
+    }
+
+    memcpy(state, IV_SHA2_256, sizeof IV_SHA2_256);
+    sha256_words_backend(state, block);
+    memcpy(hash, state, 8 * sizeof *hash);
 }
 
 /*
-    Prepare the block to be padded in the following format:
+    Pad the final block(s) of a message with max length 2^128 and compress them.
 
     ``1`` is appended to message followed by ``k`` zeros bits,
     where ``k``  is the smallest non-negative solution to::
 
-    l + 1 + k = 896 mod 1024
+        l + 1 + k = 896 mod 1024
 
     Additional 128-bits are appended to represent the number of bits
-    in the message (without padding).
+    in the message (without padding), given here as its high and low 64-bit halves.
 */
 static inline void
-pad128(uint8_t **block, const uint128_t msg_bit_len) {
-    uint128_t block_byte_len = block128_len(msg_bit_len) / 8;
-    (*block)[msg_bit_len / 8] = 0x80;
+pad128(uint64_t *state, uint8_t *block, size_t used, const uint64_t msg_bit_len_hi, const uint64_t msg_bit_len_lo,
+       void (*compress)(uint64_t *, const uint8_t *, size_t)) {
+    block[used++] = 0x80;
+
+    if (used > 112) {
+        memset(block + used, 0, 128 - used);
+        compress(state, block, 1);
+        used = 0;
+    }
+    memset(block + used, 0, 112 - used);
 
-    for (int i = 0; i < 16; i++) {
-        (*block)[block_byte_len - 16 + i] = (msg_bit_len >> (120 - 8 * i)) & 0xff;
+    for (int i = 0; i < 8; i++) {
+        block[112 + i] = (msg_bit_len_hi >> (56 - 8 * i)) & 0xff;
+        block[120 + i] = (msg_bit_len_lo >> (56 - 8 * i)) & 0xff;
     }
+    compress(state, block, 1);
 }
 
-/*
-    Resize the message to a size that is divisible by 1024, capable
-    of storing 128-bit block in the end for encoding the length of the message.
-*/
+/* Same as `digest64` for the 128-byte blocks of SHA-384 and SHA-512 */
 static inline void
-pad128_resize(uint8_t **message, const uint128_t msg_bit_len) {
-    uint64_t block_len = block128_len(msg_bit_len);
+digest128(uint64_t *state, const uint8_t *message, size_t len, void (*compress)(uint64_t *, const uint8_t *, size_t)) {
+    uint8_t block[128];
 
-    uint8_t *padded_msg = calloc(block_len, sizeof *padded_msg);
-    memcpy(padded_msg, *message, msg_bit_len / 8);
-    *message = padded_msg;
+    compress(state, message, len / 128);
+    if (len % 128) {
+        memcpy(block, message + len / 128 * 128, len % 128);  /* An empty message may be NULL */
+    }
+    pad128(state, block, len % 128, (uint64_t)len >> 61, (uint64_t)len << 3, compress);
 }
 
-/* Message schedule for sha512, uses 80 64-bit words */
 static inline uint64_t
-sha512_schedule(const uint8_t *message, const int t) {
-    static uint64_t w[80];
-    if (t < 16) {
-        w[t] = ((uint64_t)message[t * 8] << 56) | ((uint64_t)message[t * 8 + 1] << 48) |
-               ((uint64_t)message[t * 8 + 2] << 40) | ((uint64_t)message[t * 8 + 3] << 32) |
-               ((uint64_t)message[t * 8 + 4] << 24) | ((uint64_t)message[t * 8 + 5] << 16) |
-               ((uint64_t)message[t * 8 + 6] << 8) | ((uint64_t)message[t * 8 + 7]);
-    } else {
-        w[t] = SIGMA512_1_SMALL(w[t - 2]) + w[t - 7] + SIGMA512_0_SMALL(w[t - 15]) + w[t - 16];
+load64_be(const uint8_t *p) {
+    return ((uint64_t)load32_be(p) << 32) | load32_be(p + 4);
+}
+
+/* Same unrolled rounds and rolling schedule as SHA-256, over 80 rounds of 64-bit words */
+#define SHA512_LOAD(t) (w[t] = load64_be(block + 8 * (t)))
+#define SHA512_EXPAND(t)                                                                                               \
+    (w[(t) & 15] += SIGMA512_1_SMALL(w[((t) - 2) & 15]) + w[((t) - 7) & 15] + SIGMA512_0_SMALL(w[((t) - 15) & 15]))
+#define SHA512_W(t) ((t) < 16 ? SHA512_LOAD((t) & 15) : SHA512_EXPAND(t))
+
+#define SHA512_ROUND(a, b, c, d, e, f, g, h, t, ab, bc)                                                                \
+    do {                                                                                                               \
+        uint64_t temp1 = h + SIGMA512_1_BIG(e) + CH(e, f, g) + K64_80[t] + SHA512_W(t);                                \
+        ab = a ^ b;                                                                                                    \
+        d += temp1;                                                                                                    \
+        h = temp1 + SIGMA512_0_BIG(a) + ((ab & bc) ^ b);                                                               \
+    } while (0)
+
+#define SHA512_ROUNDS8(t)                                                                                              \
+    do {                                                                                                               \
+        SHA512_ROUND(a, b, c, d, e, f, g, h, (t), x, y);                                                               \
+        SHA512_ROUND(h, a, b, c, d, e, f, g, (t) + 1, y, x);                                                           \
+        SHA512_ROUND(g, h, a, b, c, d, e, f, (t) + 2, x, y);                                                           \
+        SHA512_ROUND(f, g, h, a, b, c, d, e, (t) + 3, y, x);                                                           \
+        SHA512_ROUND(e, f, g, h, a, b, c, d, (t) + 4, x, y);                                                           \
+        SHA512_ROUND(d, e, f, g, h, a, b, c, (t) + 5, y, x);                                                           \
+        SHA512_ROUND(c, d, e, f, g, h, a, b, (t) + 6, x, y);                                                           \
+        SHA512_ROUND(b, c, d, e, f, g, h, a, (t) + 7, y, x);                                                           \
+    } while (0)
+
+/* Run the SHA-384/SHA-512 compression function over `num_blocks` consecutive 128-byte blocks */
+void
+sha512_compress(uint64_t *state, const uint8_t *blocks, size_t num_blocks) {
+    uint64_t w[16];
+
+    PROBE1(sha512_compress_start, num_blocks);
+
+    for (size_t i = 0; i < num_blocks; i++) {
+        uint64_t a = state[0], b = state[1], c = state[2], d = state[3], e = state[4], f = state[5], g = state[6],
+                 h = state[7];
+        uint64_t x, y = b ^ c;
+        const uint8_t *block = blocks + i * 128;
+
+        SHA512_ROUNDS8(0);
+        SHA512_ROUNDS8(8);
+        SHA512_ROUNDS8(16);
+        SHA512_ROUNDS8(24);
+        SHA512_ROUNDS8(32);
+        SHA512_ROUNDS8(40);
+        SHA512_ROUNDS8(48);
+        SHA512_ROUNDS8(56);
+        SHA512_ROUNDS8(64);
+        SHA512_ROUNDS8(72);
+
+        state[0] += a;
+        state[1] += b;
+        state[2] += c;
+        state[3] += d;
+        state[4] += e;
+        state[5] += f;
+        state[6] += g;
+        state[7] += h;
+    }
+    PROBE1(sha512_compress_done, num_blocks);
+}
+
+/* Bytes fed to `ctx` are counted in 64-bits, so the high half of the bit length only holds the carry. */
+static inline void
+sha512_pad(struct sha2_512_ctx *ctx) {
+    pad128(ctx->state, ctx->block, ctx->length % 128, ctx->length >> 61, ctx->length << 3, sha512_compress);
+}
+
+/* Absorb `len` bytes into a context of any function built on SHA-512 */
+static void
+sha512_update(struct sha2_512_ctx *ctx, const void *data, size_t len) {
+    const uint8_t *message = data;
+    size_t used = ctx->length % 128;
+
+    if (!len) {
+        return;  /* `data` may be NULL */
+    }
+    ctx->length += len;
+
+    if (used) {
+        size_t fill = 128 - used < len ? 128 - used : len;
+        memcpy(ctx->block + used, message, fill);
+        message += fill;
+        len -= fill;
+
+        if (used + fill < 128) {
+            return;
+        }
+        sha512_compress(ctx->state, ctx->block, 1);
     }
-    return w[t];
+
+    sha512_compress(ctx->state, message, len / 128);
+    memcpy(ctx->block, message + len / 128 * 128, len % 128);
+}
+
+/**
+   Initialize :c:var:`ctx` for computing a SHA-384 hash incrementally.
+
+   :param ctx: The context to initialize.
+   :type ctx: struct sha2_512_ctx *
+*/
+void
+sha2_384_init(struct sha2_512_ctx *ctx) {
+    memcpy(ctx->state, IV_SHA2_384, sizeof IV_SHA2_384);
+    ctx->length = 0;
+}
+
+/**
+   Feed the next :c:var:`len` bytes of the message into :c:var:`ctx`.
+
+   :param ctx: A context initialized by :c:func:`sha2_384_init`.
+   :type ctx: struct sha2_512_ctx *
+   :param data: The next chunk of the message, it may contain any byte value.
+   :type data: const void *
+   :param len: Length of :c:var:`data` in bytes.
+   :type len: size_t
+*/
+void
+sha2_384_update(struct sha2_512_ctx *ctx, const void *data, size_t len) {
+    STATS_CALL(HASH_SHA2_384, HASH_STATS_SCALAR, len, (ctx->length % 128 + len) / 128);
+    sha512_update(ctx, data, len);
+}
+
+/**
+   Pad the message fed to :c:var:`ctx` and write the SHA-384 hash.
+
+   :param ctx: A context fed by :c:func:`sha2_384_update`.
+   :type ctx: struct sha2_512_ctx *
+   :param hash: An array big enough to store 6 `uint64_t` elements. The hash value will
+                be written to it.
+   :type hash: uint64_t *
+*/
+void
+sha2_384_final(struct sha2_512_ctx *ctx, uint64_t *hash) {
+    STATS_BLOCKS(HASH_SHA2_384, HASH_STATS_SCALAR, PADDED_BLOCKS(ctx->length % 128, 128, 16));
+    sha512_pad(ctx);
+    memcpy(hash, ctx->state, 6 * sizeof *hash);
+}
+
+/**
+   Compute the SHA-384 hash of the first :c:var:`len` bytes of :c:var:`data`.
+
+   Unlike :c:func:`sha2_384` the input is not required to be NUL-terminated and may contain
+   any byte value. Full blocks are compressed in place and only the padded tail is
+   built on the stack, so no memory is allocated.
+
+   :param data: The input message to be hashed.
+   :type data: const void *
+   :param len: Length of :c:var:`data` in bytes.
+   :type len: size_t
+   :param hash: An array big enough to store 6 `uint64_t` elements. The hash value will
+                be written to it.
+   :type hash: uint64_t *
+*/
+void
+sha2_384_data(const void *data, size_t len, uint64_t *hash) {
+    uint64_t state[8];
+
+    STATS_CALL(HASH_SHA2_384, HASH_STATS_SCALAR, len, PADDED_BLOCKS(len, 128, 16));
+    memcpy(state, IV_SHA2_384, sizeof IV_SHA2_384);
+    digest128(state, data, len, sha512_compress);
+    memcpy(hash, state, 6 * sizeof *hash);
 }
 
 /**
@@ -417,7 +1047,7 @@ sha512_schedule(const uint8_t *message, const int t) {
    cryptographic hash functions. It produces a 384-bit (48-byte) hash value.
 
    :param message: The input message to be hashed. It can be an ASCII string up
-                   to 2^128 bits in length.
+                   to 2^64 bytes in length.
    :type message: const char *
    :param hash: An array big enough to store 6 `uint64_t` elements. The hash value will
                 be written to it.
@@ -425,54 +1055,80 @@ sha512_schedule(const uint8_t *message, const int t) {
 */
 void
 sha2_384(const char *message, uint64_t *hash) {
-    uint8_t *padded_msg = (uint8_t *)message;
-    uint128_t message_len = strlen(message);
-    uint128_t msg_bit_len = message_len * 8;
-    uint64_t num_blocks = block128_len(msg_bit_len) / 1024;
-
-    /* Max supported for length is 2^128 - 1 */
-    assert(message_len <= (uint128_t)-1);
-
-    pad128_resize(&padded_msg, msg_bit_len);
-    pad128(&padded_msg, msg_bit_len);
-
-    hash[0] = 0xcbbb9d5dc1059ed8;
-    hash[1] = 0x629a292a367cd507;
-    hash[2] = 0x9159015a3070dd17;
-    hash[3] = 0x152fecd8f70e5939;
-    hash[4] = 0x67332667ffc00b31;
-    hash[5] = 0x8eb44a8768581511;
-    hash[6] = 0xdb0c2e0d64f98fa7;
-    hash[7] = 0x47b5481dbefa4fa4;
-
-    for (uint64_t i = 0; i < num_blocks; i++) {
-        uint64_t a = hash[0], b = hash[1], c = hash[2], d = hash[3], e = hash[4], f = hash[5], g = hash[6], h = hash[7];
-        uint8_t *block = padded_msg + i * 128;
-
-        for (int t = 0; t < 80; t++) {
-            uint64_t temp1 = h + SIGMA512_1_BIG(e) + CH(e, f, g) + K64_80[t] + sha512_schedule(block, t);
-            uint64_t temp2 = SIGMA512_0_BIG(a) + MAJ(a, b, c);
-            h = g;
-            g = f;
-            f = e;
-            e = d + temp1;
-            d = c;
-            c = b;
-            b = a;
-            a = temp1 + temp2;
-        }
+    sha2_384_data(message, strlen(message), hash);
+}
 
-        hash[0] += a;
-        hash[1] += b;
-        hash[2] += c;
-        hash[3] += d;
-        hash[4] += e;
-        hash[5] += f;
-        hash[6] += g;
-        hash[7] += h;
-    }
+/**
+   Initialize :c:var:`ctx` for computing a SHA-512 hash incrementally.
+
+   :param ctx: The context to initialize.
+   :type ctx: struct sha2_512_ctx *
+*/
+void
+sha2_512_init(struct sha2_512_ctx *ctx) {
+    memcpy(ctx->state, IV_SHA2_512, sizeof IV_SHA2_512);
+    ctx->length = 0;
+}
 
-    free(padded_msg);
+/**
+   Feed the next :c:var:`len` bytes of the message into :c:var:`ctx`.
+
+   Full blocks are compressed as soon as they are available, only the
+   trailing partial block is kept in the context.
+
+   :param ctx: A context initialized by :c:func:`sha2_512_init`.
+   :type ctx: struct sha2_512_ctx *
+   :param data: The next chunk of the message, it may contain any byte value.
+   :type data: const void *
+   :param len: Length of :c:var:`data` in bytes.
+   :type len: size_t
+*/
+void
+sha2_512_update(struct sha2_512_ctx *ctx, const void *data, size_t len) {
+    STATS_CALL(HASH_SHA2_512, HASH_STATS_SCALAR, len, (ctx->length % 128 + len) / 128);
+    sha512_update(ctx, data, len);
+}
+
+/**
+   Pad the message fed to :c:var:`ctx` and write the SHA-512 hash.
+
+   :param ctx: A context fed by :c:func:`sha2_512_update`, it has to be initialized
+               again before it can be reused.
+   :type ctx: struct sha2_512_ctx *
+   :param hash: An array big enough to store 8 `uint64_t` elements. The hash value will
+                be written to it.
+   :type hash: uint64_t *
+*/
+void
+sha2_512_final(struct sha2_512_ctx *ctx, uint64_t *hash) {
+    STATS_BLOCKS(HASH_SHA2_512, HASH_STATS_SCALAR, PADDED_BLOCKS(ctx->length % 128, 128, 16));
+    sha512_pad(ctx);
+    memcpy(hash, ctx->state, 8 * sizeof *hash);
+}
+
+/**
+   Compute the SHA-512 hash of the first :c:var:`len` bytes of :c:var:`data`.
+
+   Unlike :c:func:`sha2_512` the input is not required to be NUL-terminated and may contain
+   any byte value. Full blocks are compressed in place and only the padded tail is
+   built on the stack, so no memory is allocated.
+
+   :param data: The input message to be hashed.
+   :type data: const void *
+   :param len: Length of :c:var:`data` in bytes.
+   :type len: size_t
+   :param hash: An array big enough to store 8 `uint64_t` elements. The hash value will
+                be written to it.
+   :type hash: uint64_t *
+*/
+void
+sha2_512_data(const void *data, size_t len, uint64_t *hash) {
+    uint64_t state[8];
+
+    STATS_CALL(HASH_SHA2_512, HASH_STATS_SCALAR, len, PADDED_BLOCKS(len, 128, 16));
+    memcpy(state, IV_SHA2_512, sizeof IV_SHA2_512);
+    digest128(state, data, len, sha512_compress);
+    memcpy(hash, state, 8 * sizeof *hash);
 }
 
 /**
@@ -482,7 +1138,7 @@ sha2_384(const char *message, uint64_t *hash) {
    cryptographic hash functions. It produces a 512-bit (64-byte) hash value.
 
    :param message: The input message to be hashed. It can be an ASCII string up
-                   to 2^128 bits in length.
+                   to 2^64 bytes in length.
    :type message: const char *
    :param hash: An array big enough to store 8 `uint64_t` elements. The hash value will
                 be written to it.
@@ -490,52 +1146,192 @@ sha2_384(const char *message, uint64_t *hash) {
 */
 void
 sha2_512(const char *message, uint64_t *hash) {
-    uint8_t *padded_msg = (uint8_t *)message;
-    uint128_t message_len = strlen(message);
-    uint128_t msg_bit_len = message_len * 8;
-    uint64_t num_blocks = block128_len(msg_bit_len) / 1024;
-
-    /* Max supported for length is 2^128 - 1 */
-    assert(message_len <= (uint128_t)-1);
-
-    pad128_resize(&padded_msg, msg_bit_len);
-    pad128(&padded_msg, msg_bit_len);
-
-    hash[0] = 0x6a09e667f3bcc908;
-    hash[1] = 0xbb67ae8584caa73b;
-    hash[2] = 0x3c6ef372fe94f82b;
-    hash[3] = 0xa54ff53a5f1d36f1;
-    hash[4] = 0x510e527fade682d1;
-    hash[5] = 0x9b05688c2b3e6c1f;
-    hash[6] = 0x1f83d9abfb41bd6b;
-    hash[7] = 0x5be0cd19137e2179;
-
-    for (uint64_t i = 0; i < num_blocks; i++) {
-        uint64_t a = hash[0], b = hash[1], c = hash[2], d = hash[3], e = hash[4], f = hash[5], g = hash[6], h = hash[7];
-        uint8_t *block = padded_msg + i * 128;
-
-        for (int t = 0; t < 80; t++) {
-            uint64_t temp1 = h + SIGMA512_1_BIG(e) + CH(e, f, g) + K64_80[t] + sha512_schedule(block, t);
-            uint64_t temp2 = SIGMA512_0_BIG(a) + MAJ(a, b, c);
-            h = g;
-            g = f;
-            f = e;
-            e = d + temp1;
-            d = c;
-            c = b;
-            b = a;
-            a = temp1 + temp2;
-        }
+    sha2_512_data(message, strlen(message), hash);
+}
 
-        hash[0] += a;
-        hash[1] += b;
-        hash[2] += c;
-        hash[3] += d;
-        hash[4] += e;
-        hash[5] += f;
-        hash[6] += g;
-        hash[7] += h;
-    }
+/* The 224-bit digest ends halfway through the fourth word, which is left-aligned like the last word of SHA3-224 */
+static inline void
+store_512_224(const uint64_t *state, uint64_t *hash) {
+    memcpy(hash, state, 3 * sizeof *hash);
+    hash[3] = state[3] & 0xffffffff00000000;
+}
+
+/**
+   Initialize :c:var:`ctx` for computing a SHA-512/224 hash incrementally.
+
+   :param ctx: The context to initialize.
+   :type ctx: struct sha2_512_ctx *
+*/
+void
+sha2_512_224_init(struct sha2_512_ctx *ctx) {
+    memcpy(ctx->state, IV_SHA2_512_224, sizeof IV_SHA2_512_224);
+    ctx->length = 0;
+}
+
+/**
+   Feed the next :c:var:`len` bytes of the message into :c:var:`ctx`.
+
+   :param ctx: A context initialized by :c:func:`sha2_512_224_init`.
+   :type ctx: struct sha2_512_ctx *
+   :param data: The next chunk of the message, it may contain any byte value.
+   :type data: const void *
+   :param len: Length of :c:var:`data` in bytes.
+   :type len: size_t
+*/
+void
+sha2_512_224_update(struct sha2_512_ctx *ctx, const void *data, size_t len) {
+    STATS_CALL(HASH_SHA2_512_224, HASH_STATS_SCALAR, len, (ctx->length % 128 + len) / 128);
+    sha512_update(ctx, data, len);
+}
+
+/**
+   Pad the message fed to :c:var:`ctx` and write the SHA-512/224 hash.
+
+   :param ctx: A context fed by :c:func:`sha2_512_224_update`.
+   :type ctx: struct sha2_512_ctx *
+   :param hash: An array big enough to store 4 `uint64_t` elements. The hash value will
+                be written to it.
+                Only the upper half of the last element is part of the hash, the lower
+                half is zeroed.
+   :type hash: uint64_t *
+*/
+void
+sha2_512_224_final(struct sha2_512_ctx *ctx, uint64_t *hash) {
+    STATS_BLOCKS(HASH_SHA2_512_224, HASH_STATS_SCALAR, PADDED_BLOCKS(ctx->length % 128, 128, 16));
+    sha512_pad(ctx);
+    store_512_224(ctx->state, hash);
+}
+
+/**
+   Compute the SHA-512/224 hash of the first :c:var:`len` bytes of :c:var:`data`.
+
+   It runs the SHA-512 compression function, which processes twice as many bytes per
+   round as SHA-256's, so on 64-bit hosts without SHA extensions it is the faster way
+   to get a 224-bit digest from long messages.
+
+   :param data: The input message to be hashed.
+   :type data: const void *
+   :param len: Length of :c:var:`data` in bytes.
+   :type len: size_t
+   :param hash: An array big enough to store 4 `uint64_t` elements. The hash value will
+                be written to it.
+                Only the upper half of the last element is part of the hash, the lower
+                half is zeroed.
+   :type hash: uint64_t *
+*/
+void
+sha2_512_224_data(const void *data, size_t len, uint64_t *hash) {
+    uint64_t state[8];
+
+    STATS_CALL(HASH_SHA2_512_224, HASH_STATS_SCALAR, len, PADDED_BLOCKS(len, 128, 16));
+    memcpy(state, IV_SHA2_512_224, sizeof IV_SHA2_512_224);
+    digest128(state, data, len, sha512_compress);
+    store_512_224(state, hash);
+}
+
+/**
+   Compute the SHA-512/224 hash for the given :c:var:`message`.
+
+   SHA-512/224 is SHA-512 with its own initial hash value, truncated to a 224-bit
+   (28-byte) hash value.
+
+   :param message: The input message to be hashed. It can be an ASCII string up
+                   to 2^64 bytes in length.
+   :type message: const char *
+   :param hash: An array big enough to store 4 `uint64_t` elements. The hash value will
+                be written to it.
+                Only the upper half of the last element is part of the hash, the lower
+                half is zeroed.
+   :type hash: uint64_t *
+*/
+void
+sha2_512_224(const char *message, uint64_t *hash) {
+    sha2_512_224_data(message, strlen(message), hash);
+}
+
+/**
+   Initialize :c:var:`ctx` for computing a SHA-512/256 hash incrementally.
+
+   :param ctx: The context to initialize.
+   :type ctx: struct sha2_512_ctx *
+*/
+void
+sha2_512_256_init(struct sha2_512_ctx *ctx) {
+    memcpy(ctx->state, IV_SHA2_512_256, sizeof IV_SHA2_512_256);
+    ctx->length = 0;
+}
+
+/**
+   Feed the next :c:var:`len` bytes of the message into :c:var:`ctx`.
+
+   :param ctx: A context initialized by :c:func:`sha2_512_256_init`.
+   :type ctx: struct sha2_512_ctx *
+   :param data: The next chunk of the message, it may contain any byte value.
+   :type data: const void *
+   :param len: Length of :c:var:`data` in bytes.
+   :type len: size_t
+*/
+void
+sha2_512_256_update(struct sha2_512_ctx *ctx, const void *data, size_t len) {
+    STATS_CALL(HASH_SHA2_512_256, HASH_STATS_SCALAR, len, (ctx->length % 128 + len) / 128);
+    sha512_update(ctx, data, len);
+}
+
+/**
+   Pad the message fed to :c:var:`ctx` and write the SHA-512/256 hash.
+
+   :param ctx: A context fed by :c:func:`sha2_512_256_update`.
+   :type ctx: struct sha2_512_ctx *
+   :param hash: An array big enough to store 4 `uint64_t` elements. The hash value will
+                be written to it.
+   :type hash: uint64_t *
+*/
+void
+sha2_512_256_final(struct sha2_512_ctx *ctx, uint64_t *hash) {
+    STATS_BLOCKS(HASH_SHA2_512_256, HASH_STATS_SCALAR, PADDED_BLOCKS(ctx->length % 128, 128, 16));
+    sha512_pad(ctx);
+    memcpy(hash, ctx->state, 4 * sizeof *hash);
+}
+
+/**
+   Compute the SHA-512/256 hash of the first :c:var:`len` bytes of :c:var:`data`.
+
+   It runs the SHA-512 compression function, which processes twice as many bytes per
+   round as SHA-256's, so on 64-bit hosts without SHA extensions it is the faster way
+   to get a 256-bit digest from long messages.
+
+   :param data: The input message to be hashed.
+   :type data: const void *
+   :param len: Length of :c:var:`data` in bytes.
+   :type len: size_t
+   :param hash: An array big enough to store 4 `uint64_t` elements. The hash value will
+                be written to it.
+   :type hash: uint64_t *
+*/
+void
+sha2_512_256_data(const void *data, size_t len, uint64_t *hash) {
+    uint64_t state[8];
+
+    STATS_CALL(HASH_SHA2_512_256, HASH_STATS_SCALAR, len, PADDED_BLOCKS(len, 128, 16));
+    memcpy(state, IV_SHA2_512_256, sizeof IV_SHA2_512_256);
+    digest128(state, data, len, sha512_compress);
+    memcpy(hash, state, 4 * sizeof *hash);
+}
+
+/**
+   Compute the SHA-512/256 hash for the given :c:var:`message`.
+
+   SHA-512/256 is SHA-512 with its own initial hash value, truncated to a 256-bit
+   (32-byte) hash value.
 
-    free(padded_msg);
+   :param message: The input message to be hashed. It can be an ASCII string up
+                   to 2^64 bytes in length.
+   :type message: const char *
+   :param hash: An array big enough to store 4 `uint64_t` elements. The hash value will
+                be written to it.
+   :type hash: uint64_t *
+*/
+void
+sha2_512_256(const char *message, uint64_t *hash) {
+    sha2_512_256_data(message, strlen(message), hash);
 }
@@ -0,0 +1,944 @@
+/* Implementation details are derived from this paper (https://nvlpubs.nist.gov/nistpubs/FIPS/NIST.FIPS.202.pdf) */
+
+#include "batch.h"
+#include "cpu.h"
+#include "keccak.h"
+#include "sha.h"
+#include "sha_internal.h"
+#include "stats_internal.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+/* SHA-3 domain separation bits ``01`` followed by the first bit of the ``pad10*1`` padding */
+#define SHA3_SUFFIX 0x06
+#define SHAKE_SUFFIX 0x1f
+#define CSHAKE_SUFFIX 0x04
+
+/* States permuted side by side by `keccak_f1600_x4` */
+#define SHA3_LANES 4
+
+struct sha3_lane {
+    struct hash_job *job;
+    const uint8_t *data;  /* Next full block still in the caller's buffer */
+    size_t num_direct;    /* Full blocks left in the caller's buffer, the padded block follows them */
+};
+
+static inline uint64_t
+load64_le(const uint8_t *p) {
+    return (uint64_t)p[0] | ((uint64_t)p[1] << 8) | ((uint64_t)p[2] << 16) | ((uint64_t)p[3] << 24) |
+           ((uint64_t)p[4] << 32) | ((uint64_t)p[5] << 40) | ((uint64_t)p[6] << 48) | ((uint64_t)p[7] << 56);
+}
+
+/* XOR `len` bytes of `data` into the state starting at byte `offset`, lanes are little-endian */
+static inline void
+xor_bytes(uint64_t *state, size_t offset, const uint8_t *data, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        state[(offset + i) / 8] ^= (uint64_t)data[i] << (8 * ((offset + i) % 8));
+    }
+}
+
+/* Absorb `num_blocks` full blocks of `rate` bytes straight from `data` */
+static inline void
+absorb_blocks(uint64_t *state, const uint8_t *data, size_t rate, size_t num_blocks) {
+    PROBE2(keccak_absorb_start, num_blocks, rate);
+    for (size_t i = 0; i < num_blocks; i++, data += rate) {
+        for (size_t j = 0; j < rate / 8; j++) {
+            state[j] ^= load64_le(data + j * 8);
+        }
+        keccak_f1600(state);
+    }
+    PROBE1(keccak_absorb_done, num_blocks);
+}
+
+static inline void
+store64_le(uint8_t *p, uint64_t x) {
+    for (int i = 0; i < 8; i++) {
+        p[i] = (x >> (8 * i)) & 0xff;
+    }
+}
+
+/* Copy `len` bytes of the state starting at byte `offset` to `out` */
+static inline void
+extract_bytes(const uint64_t *state, size_t offset, uint8_t *out, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        out[i] = (state[(offset + i) / 8] >> (8 * ((offset + i) % 8))) & 0xff;
+    }
+}
+
+/* Append the domain bits and ``pad10*1`` to the `used` bytes absorbed into the current block */
+static inline void
+pad(uint64_t *state, size_t rate, size_t used, uint8_t suffix) {
+    state[used / 8] ^= (uint64_t)suffix << (8 * (used % 8));
+    state[(rate - 1) / 8] ^= 0x8000000000000000;
+    keccak_f1600(state);
+}
+
+/*
+    Write the first `digest_len` bytes of the state as big-endian words, the same way as
+    the SHA-2 hashes, so that printing the words in order gives the usual hex digest.
+    A trailing partial word is left-aligned and zero-filled.
+*/
+static inline void
+store_hash(const uint64_t *state, uint64_t *hash, size_t digest_len) {
+    for (size_t i = 0; i < (digest_len + 7) / 8; i++) {
+        uint64_t word = 0;
+
+        for (size_t j = 0; j < 8; j++) {
+            uint64_t byte = i * 8 + j < digest_len ? (state[i] >> (8 * j)) & 0xff : 0;
+            word |= byte << (56 - 8 * j);
+        }
+        hash[i] = word;
+    }
+}
+
+static void
+sha3_init(struct sha3_ctx *ctx, size_t rate) {
+    memset(ctx->state, 0, sizeof ctx->state);
+    ctx->length = 0;
+    ctx->rate = rate;
+    ctx->used = 0;
+}
+
+/* Absorb the next `len` bytes, the partial block is XORed straight into the state so nothing is buffered */
+static void
+sha3_absorb(struct sha3_ctx *ctx, const uint8_t *data, size_t len) {
+    ctx->length += len;
+    if (ctx->used) {
+        size_t fill = ctx->rate - ctx->used < len ? ctx->rate - ctx->used : len;
+        xor_bytes(ctx->state, ctx->used, data, fill);
+        ctx->used += fill;
+        data += fill;
+        len -= fill;
+
+        if (ctx->used < ctx->rate) {
+            return;
+        }
+        keccak_f1600(ctx->state);
+        ctx->used = 0;
+    }
+
+    absorb_blocks(ctx->state, data, ctx->rate, len / ctx->rate);
+    xor_bytes(ctx->state, 0, data + len / ctx->rate * ctx->rate, len % ctx->rate);
+    ctx->used = len % ctx->rate;
+}
+
+static void
+sha3_final(struct sha3_ctx *ctx, uint64_t *hash, size_t digest_len) {
+    pad(ctx->state, ctx->rate, ctx->used, SHA3_SUFFIX);
+    store_hash(ctx->state, hash, digest_len);
+}
+
+/* One-shot hash of `len` bytes of `data`, full blocks are absorbed in place and nothing is allocated */
+static void
+sha3_digest(const uint8_t *data, size_t len, size_t rate, uint64_t *hash, size_t digest_len) {
+    uint64_t state[25] = {0};
+
+    absorb_blocks(state, data, rate, len / rate);
+    xor_bytes(state, 0, data + len / rate * rate, len % rate);
+    pad(state, rate, len % rate, SHA3_SUFFIX);
+    store_hash(state, hash, digest_len);
+}
+
+/* XOR one block of `rate` bytes into lane `k` of the interleaved `states` */
+static inline void
+absorb_lane(uint64_t *states, unsigned k, const uint8_t *block, size_t rate) {
+    for (size_t j = 0; j < rate / 8; j++) {
+        states[j * SHA3_LANES + k] ^= load64_le(block + j * 8);
+    }
+}
+
+/*
+    Hash every job with the SHA-3 function of the given `rate` four messages at a time,
+    one per lane of `keccak_f1600_x4`. A lane whose message is done is refilled with the
+    next job at once, and the last message is finished on its own.
+*/
+void
+sha3_mb(struct hash_job *jobs, size_t num_jobs, size_t rate, size_t digest_len) {
+    uint64_t states[25 * SHA3_LANES] = {0};  /* Idle lanes permute zeros, not indeterminate words */
+    struct sha3_lane lanes[SHA3_LANES] = {{0}};
+    size_t next = 0;
+    unsigned active = 0;
+
+    PROBE2(sha3_mb_start, num_jobs, rate);
+    if (STATS_ON()) {
+        enum hash_algorithm algorithm = digest_len == 28   ? HASH_SHA3_224
+                                        : digest_len == 32 ? HASH_SHA3_256
+                                        : digest_len == 48 ? HASH_SHA3_384
+                                                           : HASH_SHA3_512;
+        enum hash_stats_backend backend = hash_cpu_features() & CPU_AVX2 ? HASH_STATS_AVX2 : HASH_STATS_SCALAR;
+
+        for (size_t i = 0; i < num_jobs; i++) {
+            hash_stats_record(algorithm, backend, jobs[i].len, jobs[i].len / rate + 1, 1);
+        }
+    }
+
+    for (;;) {
+        for (unsigned k = 0; k < SHA3_LANES; k++) {
+            if (!lanes[k].job && next < num_jobs) {
+                lanes[k].job = &jobs[next++];
+                lanes[k].data = lanes[k].job->data;
+                lanes[k].num_direct = lanes[k].job->len / rate;
+                for (int i = 0; i < 25; i++) {
+                    states[i * SHA3_LANES + k] = 0;
+                }
+                active++;
+            }
+        }
+
+        if (active <= 1 && next == num_jobs) {
+            break;
+        }
+
+        for (unsigned k = 0; k < SHA3_LANES; k++) {
+            if (!lanes[k].job) {
+                continue;
+            }
+
+            if (lanes[k].num_direct) {
+                absorb_lane(states, k, lanes[k].data, rate);
+            } else {
+                uint8_t block[144] = {0};
+                size_t rest = lanes[k].job->len % rate;
+
+                if (rest) {
+                    memcpy(block, lanes[k].data, rest);  /* An empty message may be NULL */
+                }
+                block[rest] ^= SHA3_SUFFIX;
+                block[rate - 1] ^= 0x80;
+                absorb_lane(states, k, block, rate);
+            }
+        }
+
+        keccak_f1600_x4(states);
+
+        for (unsigned k = 0; k < SHA3_LANES; k++) {
+            if (!lanes[k].job) {
+                continue;
+            }
+
+            if (lanes[k].num_direct) {
+                lanes[k].data += rate;
+                lanes[k].num_direct--;
+            } else {
+                uint64_t state[25];
+
+                for (int i = 0; i < 25; i++) {
+                    state[i] = states[i * SHA3_LANES + k];
+                }
+                store_hash(state, lanes[k].job->hash, digest_len);
+                lanes[k].job = NULL;
+                active--;
+            }
+        }
+    }
+
+    for (unsigned k = 0; k < SHA3_LANES; k++) {
+        if (lanes[k].job) {
+            uint64_t state[25];
+            size_t rest = lanes[k].job->len % rate;
+
+            for (int i = 0; i < 25; i++) {
+                state[i] = states[i * SHA3_LANES + k];
+            }
+            absorb_blocks(state, lanes[k].data, rate, lanes[k].num_direct);
+            xor_bytes(state, 0, lanes[k].data + lanes[k].num_direct * rate, rest);
+            pad(state, rate, rest, SHA3_SUFFIX);
+            store_hash(state, lanes[k].job->hash, digest_len);
+        }
+    }
+    PROBE1(sha3_mb_done, num_jobs);
+}
+
+/*
+    SHAKE of four messages of the same length in the lanes of `keccak_f1600_x4`, used for
+    the leaves of tree hashes. `out_len` may not exceed the rate.
+*/
+void
+shake_x4(const uint8_t *const *data, size_t len, size_t rate, uint8_t *const *out, size_t out_len) {
+    uint64_t states[25 * SHA3_LANES] = {0};
+    size_t rest = len % rate;
+
+    for (size_t i = 0; i < len / rate; i++) {
+        for (unsigned k = 0; k < SHA3_LANES; k++) {
+            absorb_lane(states, k, data[k] + i * rate, rate);
+        }
+        keccak_f1600_x4(states);
+    }
+
+    for (unsigned k = 0; k < SHA3_LANES; k++) {
+        uint8_t block[168] = {0};
+
+        memcpy(block, data[k] + len - rest, rest);
+        block[rest] ^= SHAKE_SUFFIX;
+        block[rate - 1] ^= 0x80;
+        absorb_lane(states, k, block, rate);
+    }
+    keccak_f1600_x4(states);
+
+    for (unsigned k = 0; k < SHA3_LANES; k++) {
+        for (size_t i = 0; i < out_len; i++) {
+            out[k][i] = (states[i / 8 * SHA3_LANES + k] >> (8 * (i % 8))) & 0xff;
+        }
+    }
+}
+
+/**
+   Initialize :c:var:`ctx` for computing a SHA3-224 hash incrementally.
+
+   :param ctx: The context to initialize.
+   :type ctx: struct sha3_ctx *
+*/
+void
+sha3_224_init(struct sha3_ctx *ctx) {
+    sha3_init(ctx, 144);
+}
+
+/**
+   Feed the next :c:var:`len` bytes of the message into :c:var:`ctx`.
+
+   :param ctx: A context initialized by :c:func:`sha3_224_init`.
+   :type ctx: struct sha3_ctx *
+   :param data: The next chunk of the message, it may contain any byte value.
+   :type data: const void *
+   :param len: Length of :c:var:`data` in bytes.
+   :type len: size_t
+*/
+void
+sha3_224_update(struct sha3_ctx *ctx, const void *data, size_t len) {
+    STATS_CALL(HASH_SHA3_224, HASH_STATS_SCALAR, len, (ctx->used + len) / 144);
+    sha3_absorb(ctx, data, len);
+}
+
+/**
+   Pad the message fed to :c:var:`ctx` and write the SHA3-224 hash.
+
+   :param ctx: A context fed by :c:func:`sha3_224_update`, it has to be initialized
+               again before it can be reused.
+   :type ctx: struct sha3_ctx *
+   :param hash: An array big enough to store 4 `uint64_t` elements. The hash value will
+                be written to it. The last
+                word only holds 32 bits in its upper half.
+   :type hash: uint64_t *
+*/
+void
+sha3_224_final(struct sha3_ctx *ctx, uint64_t *hash) {
+    STATS_BLOCKS(HASH_SHA3_224, HASH_STATS_SCALAR, 1);
+    sha3_final(ctx, hash, 28);
+}
+
+/**
+   Compute the SHA3-224 hash of the first :c:var:`len` bytes of :c:var:`data`.
+
+   :param data: The input message to be hashed.
+   :type data: const void *
+   :param len: Length of :c:var:`data` in bytes.
+   :type len: size_t
+   :param hash: An array big enough to store 4 `uint64_t` elements. The hash value will
+                be written to it. The last
+                word only holds 32 bits in its upper half.
+   :type hash: uint64_t *
+*/
+void
+sha3_224_data(const void *data, size_t len, uint64_t *hash) {
+    STATS_CALL(HASH_SHA3_224, HASH_STATS_SCALAR, len, len / 144 + 1);
+    sha3_digest(data, len, 144, hash, 28);
+}
+
+/**
+   Compute the SHA3-224 hash for the given :c:var:`message`.
+
+   SHA3-224 is a member of the SHA-3 family, built on the Keccak sponge. It
+   produces a 224-bit (28-byte) hash value.
+
+   :param message: The input message to be hashed.
+   :type message: const char *
+   :param hash: An array big enough to store 4 `uint64_t` elements. The hash value will
+                be written to it. The last
+                word only holds 32 bits in its upper half.
+   :type hash: uint64_t *
+*/
+void
+sha3_224(const char *message, uint64_t *hash) {
+    sha3_224_data(message, strlen(message), hash);
+}
+
+/**
+   Initialize :c:var:`ctx` for computing a SHA3-256 hash incrementally.
+
+   :param ctx: The context to initialize.
+   :type ctx: struct sha3_ctx *
+*/
+void
+sha3_256_init(struct sha3_ctx *ctx) {
+    sha3_init(ctx, 136);
+}
+
+/**
+   Feed the next :c:var:`len` bytes of the message into :c:var:`ctx`.
+
+   :param ctx: A context initialized by :c:func:`sha3_256_init`.
+   :type ctx: struct sha3_ctx *
+   :param data: The next chunk of the message, it may contain any byte value.
+   :type data: const void *
+   :param len: Length of :c:var:`data` in bytes.
+   :type len: size_t
+*/
+void
+sha3_256_update(struct sha3_ctx *ctx, const void *data, size_t len) {
+    STATS_CALL(HASH_SHA3_256, HASH_STATS_SCALAR, len, (ctx->used + len) / 136);
+    sha3_absorb(ctx, data, len);
+}
+
+/**
+   Pad the message fed to :c:var:`ctx` and write the SHA3-256 hash.
+
+   :param ctx: A context fed by :c:func:`sha3_256_update`, it has to be initialized
+               again before it can be reused.
+   :type ctx: struct sha3_ctx *
+   :param hash: An array big enough to store 4 `uint64_t` elements. The hash value will
+                be written to it.
+   :type hash: uint64_t *
+*/
+void
+sha3_256_final(struct sha3_ctx *ctx, uint64_t *hash) {
+    STATS_BLOCKS(HASH_SHA3_256, HASH_STATS_SCALAR, 1);
+    sha3_final(ctx, hash, 32);
+}
+
+/**
+   Compute the SHA3-256 hash of the first :c:var:`len` bytes of :c:var:`data`.
+
+   :param data: The input message to be hashed.
+   :type data: const void *
+   :param len: Length of :c:var:`data` in bytes.
+   :type len: size_t
+   :param hash: An array big enough to store 4 `uint64_t` elements. The hash value will
+                be written to it.
+   :type hash: uint64_t *
+*/
+void
+sha3_256_data(const void *data, size_t len, uint64_t *hash) {
+    STATS_CALL(HASH_SHA3_256, HASH_STATS_SCALAR, len, len / 136 + 1);
+    sha3_digest(data, len, 136, hash, 32);
+}
+
+/**
+   Compute the SHA3-256 hash for the given :c:var:`message`.
+
+   SHA3-256 is a member of the SHA-3 family, built on the Keccak sponge. It
+   produces a 256-bit (32-byte) hash value.
+
+   :param message: The input message to be hashed.
+   :type message: const char *
+   :param hash: An array big enough to store 4 `uint64_t` elements. The hash value will
+                be written to it.
+   :type hash: uint64_t *
+*/
+void
+sha3_256(const char *message, uint64_t *hash) {
+    sha3_256_data(message, strlen(message), hash);
+}
+
+/**
+   Initialize :c:var:`ctx` for computing a SHA3-384 hash incrementally.
+
+   :param ctx: The context to initialize.
+   :type ctx: struct sha3_ctx *
+*/
+void
+sha3_384_init(struct sha3_ctx *ctx) {
+    sha3_init(ctx, 104);
+}
+
+/**
+   Feed the next :c:var:`len` bytes of the message into :c:var:`ctx`.
+
+   :param ctx: A context initialized by :c:func:`sha3_384_init`.
+   :type ctx: struct sha3_ctx *
+   :param data: The next chunk of the message, it may contain any byte value.
+   :type data: const void *
+   :param len: Length of :c:var:`data` in bytes.
+   :type len: size_t
+*/
+void
+sha3_384_update(struct sha3_ctx *ctx, const void *data, size_t len) {
+    STATS_CALL(HASH_SHA3_384, HASH_STATS_SCALAR, len, (ctx->used + len) / 104);
+    sha3_absorb(ctx, data, len);
+}
+
+/**
+   Pad the message fed to :c:var:`ctx` and write the SHA3-384 hash.
+
+   :param ctx: A context fed by :c:func:`sha3_384_update`, it has to be initialized
+               again before it can be reused.
+   :type ctx: struct sha3_ctx *
+   :param hash: An array big enough to store 6 `uint64_t` elements. The hash value will
+                be written to it.
+   :type hash: uint64_t *
+*/
+void
+sha3_384_final(struct sha3_ctx *ctx, uint64_t *hash) {
+    STATS_BLOCKS(HASH_SHA3_384, HASH_STATS_SCALAR, 1);
+    sha3_final(ctx, hash, 48);
+}
+
+/**
+   Compute the SHA3-384 hash of the first :c:var:`len` bytes of :c:var:`data`.
+
+   :param data: The input message to be hashed.
+   :type data: const void *
+   :param len: Length of :c:var:`data` in bytes.
+   :type len: size_t
+   :param hash: An array big enough to store 6 `uint64_t` elements. The hash value will
+                be written to it.
+   :type hash: uint64_t *
+*/
+void
+sha3_384_data(const void *data, size_t len, uint64_t *hash) {
+    STATS_CALL(HASH_SHA3_384, HASH_STATS_SCALAR, len, len / 104 + 1);
+    sha3_digest(data, len, 104, hash, 48);
+}
+
+/**
+   Compute the SHA3-384 hash for the given :c:var:`message`.
+
+   SHA3-384 is a member of the SHA-3 family, built on the Keccak sponge. It
+   produces a 384-bit (48-byte) hash value.
+
+   :param message: The input message to be hashed.
+   :type message: const char *
+   :param hash: An array big enough to store 6 `uint64_t` elements. The hash value will
+                be written to it.
+   :type hash: uint64_t *
+*/
+void
+sha3_384(const char *message, uint64_t *hash) {
+    sha3_384_data(message, strlen(message), hash);
+}
+
+/**
+   Initialize :c:var:`ctx` for computing a SHA3-512 hash incrementally.
+
+   :param ctx: The context to initialize.
+   :type ctx: struct sha3_ctx *
+*/
+void
+sha3_512_init(struct sha3_ctx *ctx) {
+    sha3_init(ctx, 72);
+}
+
+/**
+   Feed the next :c:var:`len` bytes of the message into :c:var:`ctx`.
+
+   :param ctx: A context initialized by :c:func:`sha3_512_init`.
+   :type ctx: struct sha3_ctx *
+   :param data: The next chunk of the message, it may contain any byte value.
+   :type data: const void *
+   :param len: Length of :c:var:`data` in bytes.
+   :type len: size_t
+*/
+void
+sha3_512_update(struct sha3_ctx *ctx, const void *data, size_t len) {
+    STATS_CALL(HASH_SHA3_512, HASH_STATS_SCALAR, len, (ctx->used + len) / 72);
+    sha3_absorb(ctx, data, len);
+}
+
+/**
+   Pad the message fed to :c:var:`ctx` and write the SHA3-512 hash.
+
+   :param ctx: A context fed by :c:func:`sha3_512_update`, it has to be initialized
+               again before it can be reused.
+   :type ctx: struct sha3_ctx *
+   :param hash: An array big enough to store 8 `uint64_t` elements. The hash value will
+                be written to it.
+   :type hash: uint64_t *
+*/
+void
+sha3_512_final(struct sha3_ctx *ctx, uint64_t *hash) {
+    STATS_BLOCKS(HASH_SHA3_512, HASH_STATS_SCALAR, 1);
+    sha3_final(ctx, hash, 64);
+}
+
+/**
+   Compute the SHA3-512 hash of the first :c:var:`len` bytes of :c:var:`data`.
+
+   :param data: The input message to be hashed.
+   :type data: const void *
+   :param len: Length of :c:var:`data` in bytes.
+   :type len: size_t
+   :param hash: An array big enough to store 8 `uint64_t` elements. The hash value will
+                be written to it.
+   :type hash: uint64_t *
+*/
+void
+sha3_512_data(const void *data, size_t len, uint64_t *hash) {
+    STATS_CALL(HASH_SHA3_512, HASH_STATS_SCALAR, len, len / 72 + 1);
+    sha3_digest(data, len, 72, hash, 64);
+}
+
+/**
+   Compute the SHA3-512 hash for the given :c:var:`message`.
+
+   SHA3-512 is a member of the SHA-3 family, built on the Keccak sponge. It
+   produces a 512-bit (64-byte) hash value.
+
+   :param message: The input message to be hashed.
+   :type message: const char *
+   :param hash: An array big enough to store 8 `uint64_t` elements. The hash value will
+                be written to it.
+   :type hash: uint64_t *
+*/
+void
+sha3_512(const char *message, uint64_t *hash) {
+    sha3_512_data(message, strlen(message), hash);
+}
+
+/*
+    Squeeze `len` bytes into `out`, `ctx->used` counts the bytes of the current output block
+    already handed out. Whole blocks are written from the lanes straight into `out`.
+*/
+static void
+sha3_squeeze(struct sha3_ctx *ctx, uint8_t *out, size_t len) {
+    size_t n = ctx->rate - ctx->used < len ? ctx->rate - ctx->used : len;
+
+    extract_bytes(ctx->state, ctx->used, out, n);
+    ctx->used += n;
+    out += n;
+    len -= n;
+
+    for (; len >= ctx->rate; out += ctx->rate, len -= ctx->rate) {
+        keccak_f1600(ctx->state);
+        for (size_t j = 0; j < ctx->rate / 8; j++) {
+            store64_le(out + j * 8, ctx->state[j]);
+        }
+    }
+
+    if (len) {
+        keccak_f1600(ctx->state);
+        extract_bytes(ctx->state, 0, out, len);
+        ctx->used = len;
+    }
+}
+
+/* ``left_encode`` of SP 800-185, returns the number of bytes written to `out` */
+size_t
+left_encode(uint8_t *out, uint64_t x) {
+    size_t n = 1;
+
+    while (n < 8 && x >> (8 * n)) {
+        n++;
+    }
+    out[0] = (uint8_t)n;
+    for (size_t i = 0; i < n; i++) {
+        out[1 + i] = (x >> (8 * (n - 1 - i))) & 0xff;
+    }
+    return n + 1;
+}
+
+/* ``right_encode`` of SP 800-185, the length byte follows the value */
+size_t
+right_encode(uint8_t *out, uint64_t x) {
+    size_t n = 1;
+
+    while (n < 8 && x >> (8 * n)) {
+        n++;
+    }
+    for (size_t i = 0; i < n; i++) {
+        out[i] = (x >> (8 * (n - 1 - i))) & 0xff;
+    }
+    out[n] = (uint8_t)n;
+    return n + 1;
+}
+
+/* Absorb ``encode_string(data)``, the bit length followed by the bytes */
+static void
+absorb_string(struct sha3_ctx *ctx, const void *data, size_t len) {
+    uint8_t prefix[9];
+
+    sha3_absorb(ctx, prefix, left_encode(prefix, (uint64_t)len * 8));
+    if (len) {
+        sha3_absorb(ctx, data, len);
+    }
+}
+
+static void
+cshake_init(struct shake_ctx *ctx, size_t rate, const void *name, size_t name_len, const void *custom,
+            size_t custom_len) {
+    uint8_t prefix[9];
+
+    sha3_init(&ctx->sponge, rate);
+    ctx->squeezing = 0;
+
+    /* Without a name and a customization string cSHAKE is defined to be plain SHAKE */
+    if (!name_len && !custom_len) {
+        ctx->suffix = SHAKE_SUFFIX;
+        return;
+    }
+
+    /* ``bytepad(encode_string(N) || encode_string(S), rate)``, the zero padding needs no XOR */
+    ctx->suffix = CSHAKE_SUFFIX;
+    sha3_absorb(&ctx->sponge, prefix, left_encode(prefix, rate));
+    absorb_string(&ctx->sponge, name, name_len);
+    absorb_string(&ctx->sponge, custom, custom_len);
+    if (ctx->sponge.used) {
+        keccak_f1600(ctx->sponge.state);
+        ctx->sponge.used = 0;
+    }
+}
+
+static void
+shake_update(struct shake_ctx *ctx, const void *data, size_t len) {
+    sha3_absorb(&ctx->sponge, data, len);
+}
+
+static void
+shake_squeeze(struct shake_ctx *ctx, void *out, size_t len) {
+    if (!ctx->squeezing) {
+        pad(ctx->sponge.state, ctx->sponge.rate, ctx->sponge.used, ctx->suffix);
+        ctx->sponge.used = 0;
+        ctx->squeezing = 1;
+    }
+    sha3_squeeze(&ctx->sponge, out, len);
+}
+
+/**
+   Initialize :c:var:`ctx` for absorbing a message into SHAKE128.
+
+   :param ctx: The context to initialize.
+   :type ctx: struct shake_ctx *
+*/
+void
+shake128_init(struct shake_ctx *ctx) {
+    cshake_init(ctx, 168, NULL, 0, NULL, 0);
+}
+
+/**
+   Initialize :c:var:`ctx` for cSHAKE128 with a function name and a customization string.
+
+   Contexts set up this way are fed with :c:func:`shake128_update` and read with
+   :c:func:`shake128_squeeze`. If both strings are empty the result is SHAKE128.
+
+   :param ctx: The context to initialize.
+   :type ctx: struct shake_ctx *
+   :param name: The function name ``N``, reserved for functions defined by NIST.
+   :type name: const void *
+   :param name_len: Length of :c:var:`name` in bytes.
+   :type name_len: size_t
+   :param custom: The customization string ``S`` that separates different uses of the function.
+   :type custom: const void *
+   :param custom_len: Length of :c:var:`custom` in bytes.
+   :type custom_len: size_t
+*/
+void
+cshake128_init(struct shake_ctx *ctx, const void *name, size_t name_len, const void *custom, size_t custom_len) {
+    cshake_init(ctx, 168, name, name_len, custom, custom_len);
+}
+
+/**
+   Absorb the next :c:var:`len` bytes of the message into :c:var:`ctx`.
+
+   :param ctx: A context initialized by :c:func:`shake128_init` or :c:func:`cshake128_init`
+               that has not been squeezed yet.
+   :type ctx: struct shake_ctx *
+   :param data: The next chunk of the message, it may contain any byte value.
+   :type data: const void *
+   :param len: Length of :c:var:`data` in bytes.
+   :type len: size_t
+*/
+void
+shake128_update(struct shake_ctx *ctx, const void *data, size_t len) {
+    shake_update(ctx, data, len);
+}
+
+/**
+   Write the next :c:var:`len` bytes of output to :c:var:`out`.
+
+   The first call finishes the message, after that no more data can be absorbed.
+   Consecutive calls continue the same output stream, so squeezing in several
+   chunks yields the same bytes as squeezing all at once. Whole blocks are
+   written straight from the Keccak state to :c:var:`out`.
+
+   :param ctx: A context fed by :c:func:`shake128_update`.
+   :type ctx: struct shake_ctx *
+   :param out: Receives :c:var:`len` bytes of output.
+   :type out: void *
+   :param len: Number of bytes to write.
+   :type len: size_t
+*/
+void
+shake128_squeeze(struct shake_ctx *ctx, void *out, size_t len) {
+    shake_squeeze(ctx, out, len);
+}
+
+/**
+   Compute :c:var:`out_len` bytes of SHAKE128 output for :c:var:`len` bytes of :c:var:`data`.
+
+   :param data: The input message.
+   :type data: const void *
+   :param len: Length of :c:var:`data` in bytes.
+   :type len: size_t
+   :param out: Receives :c:var:`out_len` bytes of output.
+   :type out: void *
+   :param out_len: Number of bytes to write.
+   :type out_len: size_t
+*/
+void
+shake128(const void *data, size_t len, void *out, size_t out_len) {
+    struct shake_ctx ctx;
+
+    shake128_init(&ctx);
+    shake_update(&ctx, data, len);
+    shake_squeeze(&ctx, out, out_len);
+}
+
+/**
+   Compute :c:var:`out_len` bytes of cSHAKE128 output for :c:var:`len` bytes of :c:var:`data`.
+
+   :param data: The input message.
+   :type data: const void *
+   :param len: Length of :c:var:`data` in bytes.
+   :type len: size_t
+   :param name: The function name ``N``, reserved for functions defined by NIST.
+   :type name: const void *
+   :param name_len: Length of :c:var:`name` in bytes.
+   :type name_len: size_t
+   :param custom: The customization string ``S``.
+   :type custom: const void *
+   :param custom_len: Length of :c:var:`custom` in bytes.
+   :type custom_len: size_t
+   :param out: Receives :c:var:`out_len` bytes of output.
+   :type out: void *
+   :param out_len: Number of bytes to write.
+   :type out_len: size_t
+*/
+void
+cshake128(const void *data, size_t len, const void *name, size_t name_len, const void *custom, size_t custom_len,
+           void *out, size_t out_len) {
+    struct shake_ctx ctx;
+
+    cshake_init(&ctx, 168, name, name_len, custom, custom_len);
+    shake_update(&ctx, data, len);
+    shake_squeeze(&ctx, out, out_len);
+}
+
+/**
+   Initialize :c:var:`ctx` for absorbing a message into SHAKE256.
+
+   :param ctx: The context to initialize.
+   :type ctx: struct shake_ctx *
+*/
+void
+shake256_init(struct shake_ctx *ctx) {
+    cshake_init(ctx, 136, NULL, 0, NULL, 0);
+}
+
+/**
+   Initialize :c:var:`ctx` for cSHAKE256 with a function name and a customization string.
+
+   Contexts set up this way are fed with :c:func:`shake256_update` and read with
+   :c:func:`shake256_squeeze`. If both strings are empty the result is SHAKE256.
+
+   :param ctx: The context to initialize.
+   :type ctx: struct shake_ctx *
+   :param name: The function name ``N``, reserved for functions defined by NIST.
+   :type name: const void *
+   :param name_len: Length of :c:var:`name` in bytes.
+   :type name_len: size_t
+   :param custom: The customization string ``S`` that separates different uses of the function.
+   :type custom: const void *
+   :param custom_len: Length of :c:var:`custom` in bytes.
+   :type custom_len: size_t
+*/
+void
+cshake256_init(struct shake_ctx *ctx, const void *name, size_t name_len, const void *custom, size_t custom_len) {
+    cshake_init(ctx, 136, name, name_len, custom, custom_len);
+}
+
+/**
+   Absorb the next :c:var:`len` bytes of the message into :c:var:`ctx`.
+
+   :param ctx: A context initialized by :c:func:`shake256_init` or :c:func:`cshake256_init`
+               that has not been squeezed yet.
+   :type ctx: struct shake_ctx *
+   :param data: The next chunk of the message, it may contain any byte value.
+   :type data: const void *
+   :param len: Length of :c:var:`data` in bytes.
+   :type len: size_t
+*/
+void
+shake256_update(struct shake_ctx *ctx, const void *data, size_t len) {
+    shake_update(ctx, data, len);
+}
+
+/**
+   Write the next :c:var:`len` bytes of output to :c:var:`out`.
+
+   The first call finishes the message, after that no more data can be absorbed.
+   Consecutive calls continue the same output stream, so squeezing in several
+   chunks yields the same bytes as squeezing all at once. Whole blocks are
+   written straight from the Keccak state to :c:var:`out`.
+
+   :param ctx: A context fed by :c:func:`shake256_update`.
+   :type ctx: struct shake_ctx *
+   :param out: Receives :c:var:`len` bytes of output.
+   :type out: void *
+   :param len: Number of bytes to write.
+   :type len: size_t
+*/
+void
+shake256_squeeze(struct shake_ctx *ctx, void *out, size_t len) {
+    shake_squeeze(ctx, out, len);
+}
+
+/**
+   Compute :c:var:`out_len` bytes of SHAKE256 output for :c:var:`len` bytes of :c:var:`data`.
+
+   :param data: The input message.
+   :type data: const void *
+   :param len: Length of :c:var:`data` in bytes.
+   :type len: size_t
+   :param out: Receives :c:var:`out_len` bytes of output.
+   :type out: void *
+   :param out_len: Number of bytes to write.
+   :type out_len: size_t
+*/
+void
+shake256(const void *data, size_t len, void *out, size_t out_len) {
+    struct shake_ctx ctx;
+
+    shake256_init(&ctx);
+    shake_update(&ctx, data, len);
+    shake_squeeze(&ctx, out, out_len);
+}
+
+/**
+   Compute :c:var:`out_len` bytes of cSHAKE256 output for :c:var:`len` bytes of :c:var:`data`.
+
+   :param data: The input message.
+   :type data: const void *
+   :param len: Length of :c:var:`data` in bytes.
+   :type len: size_t
+   :param name: The function name ``N``, reserved for functions defined by NIST.
+   :type name: const void *
+   :param name_len: Length of :c:var:`name` in bytes.
+   :type name_len: size_t
+   :param custom: The customization string ``S``.
+   :type custom: const void *
+   :param custom_len: Length of :c:var:`custom` in bytes.
+   :type custom_len: size_t
+   :param out: Receives :c:var:`out_len` bytes of output.
+   :type out: void *
+   :param out_len: Number of bytes to write.
+   :type out_len: size_t
+*/
+void
+cshake256(const void *data, size_t len, const void *name, size_t name_len, const void *custom, size_t custom_len,
+           void *out, size_t out_len) {
+    struct shake_ctx ctx;
+
+    cshake_init(&ctx, 136, name, name_len, custom, custom_len);
+    shake_update(&ctx, data, len);
+    shake_squeeze(&ctx, out, out_len);
+}
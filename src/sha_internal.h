@@ -0,0 +1,54 @@
+/* Declarations shared between the SHA translation units, these are not installed. */
+
+#ifndef _SHA_INTERNAL
+#define _SHA_INTERNAL
+
+#include <stddef.h>
+#include <stdint.h>
+
+extern const uint32_t K32_4[];
+extern const uint32_t K32_64[];
+extern const uint64_t K64_80[];
+
+extern const uint32_t IV_SHA1[];
+extern const uint32_t IV_SHA2_224[];
+extern const uint32_t IV_SHA2_256[];
+extern const uint64_t IV_SHA2_384[];
+extern const uint64_t IV_SHA2_512[];
+extern const uint64_t IV_SHA2_512_224[];
+extern const uint64_t IV_SHA2_512_256[];
+
+/* Compression functions of the selected backend, `blocks` holds `num_blocks` full blocks */
+void sha1_compress(uint32_t *state, const uint8_t *blocks, size_t num_blocks);
+void sha256_compress(uint32_t *state, const uint8_t *blocks, size_t num_blocks);
+void sha512_compress(uint64_t *state, const uint8_t *blocks, size_t num_blocks);
+
+/* Portable backend, the single block variants take the block as 16 host-endian words or its precomputed K + W */
+void sha1_compress_scalar(uint32_t *state, const uint8_t *blocks, size_t num_blocks);
+void sha256_compress_scalar(uint32_t *state, const uint8_t *blocks, size_t num_blocks);
+void sha256_compress_words_scalar(uint32_t *state, const uint32_t *words);
+void sha256_compress_schedule_scalar(uint32_t *state, const uint32_t *kw);
+
+/* Intel SHA extensions backend, only callable when `CPU_SHA` is set */
+void sha1_compress_shani(uint32_t *state, const uint8_t *blocks, size_t num_blocks);
+void sha256_compress_shani(uint32_t *state, const uint8_t *blocks, size_t num_blocks);
+void sha256_compress_words_shani(uint32_t *state, const uint32_t *words);
+void sha256_compress_schedule_shani(uint32_t *state, const uint32_t *kw);
+
+/* Helpers of the constructions built on the hash functions */
+void hash_wipe(void *data, size_t len);
+void hash_store_words(uint8_t *out, const void *words, size_t word_size, size_t len);
+
+/* SHA-3 of every job, four at a time, `rate` and `digest_len` are in bytes */
+struct hash_job;
+void sha3_mb(struct hash_job *jobs, size_t num_jobs, size_t rate, size_t digest_len);
+
+/* Integer encodings of SP 800-185, return the number of bytes written to `out`, at most 9 */
+size_t left_encode(uint8_t *out, uint64_t x);
+size_t right_encode(uint8_t *out, uint64_t x);
+
+/* SHAKE of four equally long messages at once, `out_len` is at most `rate` bytes */
+void shake_x4(const uint8_t *const *data, size_t len, size_t rate, uint8_t *const *out, size_t out_len);
+
+
+#endif /* _SHA_INTERNAL */
@@ -0,0 +1,475 @@
+/*
+    Multi-buffer SHA-256.
+
+    Independent messages are hashed side by side, one per 32-bit lane of an AVX2
+    (8 lanes) or AVX-512 (16 lanes) register. Short messages are too short to hide
+    the latency of a single compression, but every lane runs the same round
+    sequence, so the throughput is that of the vector units instead.
+
+    A scheduler keeps the lanes busy: whenever a message runs out of blocks its
+    lane is refilled with the next job, so messages of different lengths mix
+    freely. Once the queue is empty and only a few lanes are left, those are
+    finished with the single-stream compression function instead of running
+    mostly idle vectors.
+*/
+
+#include "batch.h"
+
+#include "cpu.h"
+#include "sha.h"
+#include "sha_internal.h"
+#include "stats_internal.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#define MAX_LANES 16
+
+/* Compress one block for each lane, `state` is transposed: word `i` of lane `l` is at `state[i * lanes + l]` */
+typedef void (*compress_lanes_fn)(uint32_t *state, const uint8_t *const *blocks);
+
+struct lane {
+    struct hash_job *job;
+    const uint8_t *data;  /* Next full block still in the caller's buffer */
+    size_t num_direct;    /* Full blocks left in the caller's buffer */
+    size_t num_tail;      /* Padded blocks left in `tail` */
+    size_t tail_used;     /* Padded blocks of `tail` already compressed */
+    uint8_t tail[128];
+};
+
+static enum hash_mb_backend mb_backend = HASH_MB_SERIAL;
+
+#ifdef HASH_X86
+
+# include <immintrin.h>
+
+# define ROR256(x, n) _mm256_or_si256(_mm256_srli_epi32(x, n), _mm256_slli_epi32(x, 32 - (n)))
+# define XOR3_256(x, y, z) _mm256_xor_si256(_mm256_xor_si256(x, y), z)
+# define ADD3_256(x, y, z) _mm256_add_epi32(_mm256_add_epi32(x, y), z)
+# define SIGMA0_BIG256(x) XOR3_256(ROR256(x, 2), ROR256(x, 13), ROR256(x, 22))
+# define SIGMA1_BIG256(x) XOR3_256(ROR256(x, 6), ROR256(x, 11), ROR256(x, 25))
+# define SIGMA0_SMALL256(x) XOR3_256(ROR256(x, 7), ROR256(x, 18), _mm256_srli_epi32(x, 3))
+# define SIGMA1_SMALL256(x) XOR3_256(ROR256(x, 17), ROR256(x, 19), _mm256_srli_epi32(x, 10))
+# define CH256(x, y, z) _mm256_xor_si256(_mm256_and_si256(x, y), _mm256_andnot_si256(x, z))
+# define MAJ256(x, y, z) _mm256_or_si256(_mm256_and_si256(_mm256_or_si256(x, y), z), _mm256_and_si256(x, y))
+
+# define SCHEDULE256(t)                                                                                                \
+    w[(t) & 15] = _mm256_add_epi32(ADD3_256(SIGMA1_SMALL256(w[((t) - 2) & 15]), w[((t) - 7) & 15], w[(t) & 15]),     \
+                                   SIGMA0_SMALL256(w[((t) - 15) & 15]))
+
+/* Round `t` with the working variables renamed instead of shifted, so 8 calls bring them back in place */
+# define ROUND256(a, b, c, d, e, f, g, h, t)                                                                           \
+    do {                                                                                                               \
+        __m256i temp1 = ADD3_256(ADD3_256(h, SIGMA1_BIG256(e), CH256(e, f, g)), _mm256_set1_epi32(K32_64[t]),       \
+                                 w[(t) & 15]);                                                                         \
+        __m256i temp2 = _mm256_add_epi32(SIGMA0_BIG256(a), MAJ256(a, b, c));                                           \
+        d = _mm256_add_epi32(d, temp1);                                                                                \
+        h = _mm256_add_epi32(temp1, temp2);                                                                            \
+    } while (0)
+
+# define ADD_STATE256(i, x)                                                                                            \
+    _mm256_storeu_si256((__m256i *)(state + (i) * 8),                                                                  \
+                        _mm256_add_epi32(x, _mm256_loadu_si256((const __m256i *)(state + (i) * 8))))
+
+/*
+    Load 8 words from each of the 8 blocks at `offset` and transpose them, so that `w[t]`
+    holds big-endian word `t` of every lane. Three rounds of shuffles replace 64 scalar loads.
+*/
+__attribute__((target("avx2"))) static inline void
+load_words_x8(__m256i *w, const uint8_t *const *blocks, size_t offset) {
+    const __m256i bswap = _mm256_set_epi8(12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3, 12, 13, 14, 15, 8, 9,
+                                          10, 11, 4, 5, 6, 7, 0, 1, 2, 3);
+    __m256i r[8], t[8], u[8];
+
+    for (int l = 0; l < 8; l++) {
+        r[l] = _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i *)(blocks[l] + offset)), bswap);
+    }
+    for (int l = 0; l < 8; l += 2) {
+        t[l] = _mm256_unpacklo_epi32(r[l], r[l + 1]);
+        t[l + 1] = _mm256_unpackhi_epi32(r[l], r[l + 1]);
+    }
+    for (int l = 0; l < 8; l += 4) {
+        u[l] = _mm256_unpacklo_epi64(t[l], t[l + 2]);
+        u[l + 1] = _mm256_unpackhi_epi64(t[l], t[l + 2]);
+        u[l + 2] = _mm256_unpacklo_epi64(t[l + 1], t[l + 3]);
+        u[l + 3] = _mm256_unpackhi_epi64(t[l + 1], t[l + 3]);
+    }
+    for (int j = 0; j < 4; j++) {
+        w[j] = _mm256_permute2x128_si256(u[j], u[j + 4], 0x20);
+        w[j + 4] = _mm256_permute2x128_si256(u[j], u[j + 4], 0x31);
+    }
+}
+
+__attribute__((target("avx2"))) static void
+sha256_compress_x8_avx2(uint32_t *state, const uint8_t *const *blocks) {
+    __m256i w[16];
+    __m256i a = _mm256_loadu_si256((const __m256i *)(state + 0 * 8));
+    __m256i b = _mm256_loadu_si256((const __m256i *)(state + 1 * 8));
+    __m256i c = _mm256_loadu_si256((const __m256i *)(state + 2 * 8));
+    __m256i d = _mm256_loadu_si256((const __m256i *)(state + 3 * 8));
+    __m256i e = _mm256_loadu_si256((const __m256i *)(state + 4 * 8));
+    __m256i f = _mm256_loadu_si256((const __m256i *)(state + 5 * 8));
+    __m256i g = _mm256_loadu_si256((const __m256i *)(state + 6 * 8));
+    __m256i h = _mm256_loadu_si256((const __m256i *)(state + 7 * 8));
+
+    load_words_x8(w, blocks, 0);
+    load_words_x8(w + 8, blocks, 32);
+
+    for (int t = 0; t < 64; t += 8) {
+        if (t >= 16) {
+            for (int i = 0; i < 8; i++) {
+                SCHEDULE256(t + i);
+            }
+        }
+
+        ROUND256(a, b, c, d, e, f, g, h, t + 0);
+        ROUND256(h, a, b, c, d, e, f, g, t + 1);
+        ROUND256(g, h, a, b, c, d, e, f, t + 2);
+        ROUND256(f, g, h, a, b, c, d, e, t + 3);
+        ROUND256(e, f, g, h, a, b, c, d, t + 4);
+        ROUND256(d, e, f, g, h, a, b, c, t + 5);
+        ROUND256(c, d, e, f, g, h, a, b, t + 6);
+        ROUND256(b, c, d, e, f, g, h, a, t + 7);
+    }
+
+    ADD_STATE256(0, a);
+    ADD_STATE256(1, b);
+    ADD_STATE256(2, c);
+    ADD_STATE256(3, d);
+    ADD_STATE256(4, e);
+    ADD_STATE256(5, f);
+    ADD_STATE256(6, g);
+    ADD_STATE256(7, h);
+}
+
+/* AVX-512 has rotates and three-input logic, which removes most of the instructions of a round */
+# define XOR3_512(x, y, z) _mm512_ternarylogic_epi32(x, y, z, 0x96)
+# define ADD3_512(x, y, z) _mm512_add_epi32(_mm512_add_epi32(x, y), z)
+# define SIGMA0_BIG512(x) XOR3_512(_mm512_ror_epi32(x, 2), _mm512_ror_epi32(x, 13), _mm512_ror_epi32(x, 22))
+# define SIGMA1_BIG512(x) XOR3_512(_mm512_ror_epi32(x, 6), _mm512_ror_epi32(x, 11), _mm512_ror_epi32(x, 25))
+# define SIGMA0_SMALL512(x) XOR3_512(_mm512_ror_epi32(x, 7), _mm512_ror_epi32(x, 18), _mm512_srli_epi32(x, 3))
+# define SIGMA1_SMALL512(x) XOR3_512(_mm512_ror_epi32(x, 17), _mm512_ror_epi32(x, 19), _mm512_srli_epi32(x, 10))
+# define CH512(x, y, z) _mm512_ternarylogic_epi32(x, y, z, 0xca)
+# define MAJ512(x, y, z) _mm512_ternarylogic_epi32(x, y, z, 0xe8)
+
+# define SCHEDULE512(t)                                                                                                \
+    w[(t) & 15] = _mm512_add_epi32(ADD3_512(SIGMA1_SMALL512(w[((t) - 2) & 15]), w[((t) - 7) & 15], w[(t) & 15]),     \
+                                   SIGMA0_SMALL512(w[((t) - 15) & 15]))
+
+# define ROUND512(a, b, c, d, e, f, g, h, t)                                                                           \
+    do {                                                                                                               \
+        __m512i temp1 = ADD3_512(ADD3_512(h, SIGMA1_BIG512(e), CH512(e, f, g)), _mm512_set1_epi32(K32_64[t]),       \
+                                 w[(t) & 15]);                                                                         \
+        __m512i temp2 = _mm512_add_epi32(SIGMA0_BIG512(a), MAJ512(a, b, c));                                           \
+        d = _mm512_add_epi32(d, temp1);                                                                                \
+        h = _mm512_add_epi32(temp1, temp2);                                                                            \
+    } while (0)
+
+# define ADD_STATE512(i, x)                                                                                            \
+    _mm512_storeu_si512(state + (i) * 16, _mm512_add_epi32(x, _mm512_loadu_si512(state + (i) * 16)))
+
+/*
+    Load the 16 words of each of the 16 blocks and transpose them, so that `w[t]` holds
+    big-endian word `t` of every lane. The byte swap is done with rotates, as byte
+    shuffles on 512-bit registers need AVX-512BW.
+*/
+__attribute__((target("avx512f"))) static inline void
+load_words_x16(__m512i *w, const uint8_t *const *blocks) {
+    const __m512i odd_bytes = _mm512_set1_epi32(0xff00ff00);
+    __m512i r[16], t[16], u[16];
+
+    for (int l = 0; l < 16; l++) {
+        __m512i x = _mm512_loadu_si512(blocks[l]);
+        r[l] = _mm512_ternarylogic_epi32(odd_bytes, _mm512_ror_epi32(x, 8), _mm512_rol_epi32(x, 8), 0xca);
+    }
+    for (int l = 0; l < 16; l += 2) {
+        t[l] = _mm512_unpacklo_epi32(r[l], r[l + 1]);
+        t[l + 1] = _mm512_unpackhi_epi32(r[l], r[l + 1]);
+    }
+    /* `u[4 * m + j]` holds word `4 * c + j` of lanes `4 * m` to `4 * m + 3` in its 128-bit chunk `c` */
+    for (int l = 0; l < 16; l += 4) {
+        u[l] = _mm512_unpacklo_epi64(t[l], t[l + 2]);
+        u[l + 1] = _mm512_unpackhi_epi64(t[l], t[l + 2]);
+        u[l + 2] = _mm512_unpacklo_epi64(t[l + 1], t[l + 3]);
+        u[l + 3] = _mm512_unpackhi_epi64(t[l + 1], t[l + 3]);
+    }
+    /* What is left is a 4x4 transpose of 128-bit chunks for each `j` */
+    for (int j = 0; j < 4; j++) {
+        __m512i v0 = _mm512_shuffle_i32x4(u[j], u[j + 4], 0x44);
+        __m512i v1 = _mm512_shuffle_i32x4(u[j], u[j + 4], 0xee);
+        __m512i v2 = _mm512_shuffle_i32x4(u[j + 8], u[j + 12], 0x44);
+        __m512i v3 = _mm512_shuffle_i32x4(u[j + 8], u[j + 12], 0xee);
+
+        w[j] = _mm512_shuffle_i32x4(v0, v2, 0x88);
+        w[j + 4] = _mm512_shuffle_i32x4(v0, v2, 0xdd);
+        w[j + 8] = _mm512_shuffle_i32x4(v1, v3, 0x88);
+        w[j + 12] = _mm512_shuffle_i32x4(v1, v3, 0xdd);
+    }
+}
+
+__attribute__((target("avx512f"))) static void
+sha256_compress_x16_avx512(uint32_t *state, const uint8_t *const *blocks) {
+    __m512i w[16];
+    __m512i a = _mm512_loadu_si512(state + 0 * 16);
+    __m512i b = _mm512_loadu_si512(state + 1 * 16);
+    __m512i c = _mm512_loadu_si512(state + 2 * 16);
+    __m512i d = _mm512_loadu_si512(state + 3 * 16);
+    __m512i e = _mm512_loadu_si512(state + 4 * 16);
+    __m512i f = _mm512_loadu_si512(state + 5 * 16);
+    __m512i g = _mm512_loadu_si512(state + 6 * 16);
+    __m512i h = _mm512_loadu_si512(state + 7 * 16);
+
+    load_words_x16(w, blocks);
+
+    for (int t = 0; t < 64; t += 8) {
+        if (t >= 16) {
+            for (int i = 0; i < 8; i++) {
+                SCHEDULE512(t + i);
+            }
+        }
+
+        ROUND512(a, b, c, d, e, f, g, h, t + 0);
+        ROUND512(h, a, b, c, d, e, f, g, t + 1);
+        ROUND512(g, h, a, b, c, d, e, f, t + 2);
+        ROUND512(f, g, h, a, b, c, d, e, t + 3);
+        ROUND512(e, f, g, h, a, b, c, d, t + 4);
+        ROUND512(d, e, f, g, h, a, b, c, t + 5);
+        ROUND512(c, d, e, f, g, h, a, b, t + 6);
+        ROUND512(b, c, d, e, f, g, h, a, t + 7);
+    }
+
+    ADD_STATE512(0, a);
+    ADD_STATE512(1, b);
+    ADD_STATE512(2, c);
+    ADD_STATE512(3, d);
+    ADD_STATE512(4, e);
+    ADD_STATE512(5, f);
+    ADD_STATE512(6, g);
+    ADD_STATE512(7, h);
+}
+
+#endif /* HASH_X86 */
+
+/* Point `lane` at `job`, everything past the last full block is padded into the lane's own tail */
+static void
+lane_load(struct lane *lane, struct hash_job *job, uint32_t *state, unsigned lanes, unsigned index) {
+    size_t rest = job->len % 64;
+    uint64_t msg_bit_len = (uint64_t)job->len * 8;
+
+    lane->job = job;
+    lane->data = job->data;
+    lane->num_direct = job->len / 64;
+    lane->num_tail = rest + 9 > 64 ? 2 : 1;
+    lane->tail_used = 0;
+
+    if (rest) {
+        memcpy(lane->tail, lane->data + lane->num_direct * 64, rest);
+    }
+    lane->tail[rest] = 0x80;
+    memset(lane->tail + rest + 1, 0, lane->num_tail * 64 - rest - 1);
+    for (int i = 0; i < 8; i++) {
+        lane->tail[lane->num_tail * 64 - 8 + i] = (msg_bit_len >> (56 - 8 * i)) & 0xff;
+    }
+
+    for (int i = 0; i < 8; i++) {
+        state[i * lanes + index] = IV_SHA2_256[i];
+    }
+}
+
+static inline const uint8_t *
+lane_block(const struct lane *lane) {
+    return lane->num_direct ? lane->data : lane->tail + lane->tail_used * 64;
+}
+
+/* Step past the block that was just compressed, returns 0 once the lane has no blocks left */
+static inline int
+lane_advance(struct lane *lane) {
+    if (lane->num_direct) {
+        lane->data += 64;
+        lane->num_direct--;
+    } else {
+        lane->tail_used++;
+        lane->num_tail--;
+    }
+    return lane->num_direct || lane->num_tail;
+}
+
+static inline void
+lane_store(const struct lane *lane, const uint32_t *state, unsigned lanes, unsigned index) {
+    uint32_t *hash = lane->job->hash;
+
+    for (int i = 0; i < 8; i++) {
+        hash[i] = state[i * lanes + index];
+    }
+}
+
+/* Finish a lane with the single-stream compression function */
+static void
+lane_finish(struct lane *lane, const uint32_t *state, unsigned lanes, unsigned index) {
+    uint32_t single[8];
+
+    for (int i = 0; i < 8; i++) {
+        single[i] = state[i * lanes + index];
+    }
+    sha256_compress(single, lane->data, lane->num_direct);
+    sha256_compress(single, lane->tail + lane->tail_used * 64, lane->num_tail);
+    memcpy(lane->job->hash, single, sizeof single);
+}
+
+static void
+sha256_mb_lanes(struct hash_job *jobs, size_t num_jobs, unsigned lanes, compress_lanes_fn compress) {
+    static const uint8_t idle_block[64];
+    struct lane lane[MAX_LANES];
+    uint32_t state[8 * MAX_LANES] = {0};  /* Lanes that never get a job compress zeros, not indeterminate words */
+    const uint8_t *blocks[MAX_LANES];
+    char busy[MAX_LANES] = {0};
+    size_t next = 0;
+    unsigned active = 0;
+
+    for (unsigned l = 0; l < lanes && next < num_jobs; l++, active++) {
+        lane_load(&lane[l], &jobs[next++], state, lanes, l);
+        busy[l] = 1;
+    }
+
+    while (active) {
+        if (next == num_jobs && active <= lanes / 4) {
+            for (unsigned l = 0; l < lanes; l++) {
+                if (busy[l]) {
+                    lane_finish(&lane[l], state, lanes, l);
+                }
+            }
+            return;
+        }
+
+        for (unsigned l = 0; l < lanes; l++) {
+            blocks[l] = busy[l] ? lane_block(&lane[l]) : idle_block;
+        }
+        compress(state, blocks);
+
+        for (unsigned l = 0; l < lanes; l++) {
+            if (!busy[l] || lane_advance(&lane[l])) {
+                continue;
+            }
+
+            lane_store(&lane[l], state, lanes, l);
+            if (next < num_jobs) {
+                lane_load(&lane[l], &jobs[next++], state, lanes, l);
+            } else {
+                busy[l] = 0;
+                active--;
+            }
+        }
+    }
+}
+
+/**
+   Select the engine used by :c:func:`sha2_256_mb`.
+
+   The fastest engine supported by the CPU is selected when the library is loaded,
+   this is only needed to force a particular one. It is not thread-safe.
+
+   :param backend: ``HASH_MB_AUTO`` for the fastest supported engine,
+                   ``HASH_MB_SERIAL`` to hash the jobs one after another with
+                   :c:func:`sha2_256_data`, ``HASH_MB_AVX2`` for 8 lanes or
+                   ``HASH_MB_AVX512`` for 16 lanes.
+   :type backend: enum hash_mb_backend
+   :return: 0 on success, -1 if the CPU does not support :c:var:`backend`.
+   :rtype: int
+*/
+int
+hash_mb_set_backend(enum hash_mb_backend backend) {
+    unsigned features = hash_cpu_features();
+
+    /* A single SHA-NI stream outruns 8 AVX2 lanes, but not 16 AVX-512 ones */
+    if (backend == HASH_MB_AUTO) {
+        if (features & CPU_AVX512F) {
+            backend = HASH_MB_AVX512;
+        } else if ((features & CPU_AVX2) && !(features & CPU_SHA)) {
+            backend = HASH_MB_AVX2;
+        } else {
+            backend = HASH_MB_SERIAL;
+        }
+    }
+
+    switch (backend) {
+        case HASH_MB_SERIAL:
+            break;
+        case HASH_MB_AVX2:
+            if (!(features & CPU_AVX2)) {
+                return -1;
+            }
+            break;
+        case HASH_MB_AVX512:
+            if (!(features & CPU_AVX512F)) {
+                return -1;
+            }
+            break;
+        default:
+            return -1;
+    }
+
+    mb_backend = backend;
+    return 0;
+}
+
+/**
+   Get the engine currently used by :c:func:`sha2_256_mb`.
+
+   :return: ``HASH_MB_SERIAL``, ``HASH_MB_AVX2`` or ``HASH_MB_AVX512``.
+   :rtype: enum hash_mb_backend
+*/
+enum hash_mb_backend
+hash_mb_get_backend(void) {
+    return mb_backend;
+}
+
+#ifdef __GNUC__
+__attribute__((constructor)) static void
+hash_mb_select_backend(void) {
+    hash_mb_set_backend(HASH_MB_AUTO);
+}
+#endif
+
+/**
+   Compute the SHA-256 hash of every job, several messages at a time.
+
+   The hash of each job is the same as :c:func:`sha2_256_data` would write, but
+   independent messages share the SIMD registers, which gives several times the
+   aggregate throughput for large numbers of short messages.
+
+   :param jobs: The messages to hash, each job's `hash` has to point to 8 `uint32_t` elements.
+   :type jobs: struct hash_job *
+   :param num_jobs: Number of elements in :c:var:`jobs`.
+   :type num_jobs: size_t
+*/
+void
+sha2_256_mb(struct hash_job *jobs, size_t num_jobs) {
+    /* The serial engine goes through `sha2_256_data`, which counts for itself */
+    if (STATS_ON() && mb_backend != HASH_MB_SERIAL) {
+        enum hash_stats_backend backend = mb_backend == HASH_MB_AVX512 ? HASH_STATS_AVX512 : HASH_STATS_AVX2;
+
+        for (size_t i = 0; i < num_jobs; i++) {
+            hash_stats_record(HASH_SHA2_256, backend, jobs[i].len, PADDED_BLOCKS(jobs[i].len, 64, 8), 1);
+        }
+    }
+
+    switch (mb_backend) {
+#ifdef HASH_X86
+        case HASH_MB_AVX2:
+            PROBE2(sha256_mb_start, num_jobs, 8);
+            sha256_mb_lanes(jobs, num_jobs, 8, sha256_compress_x8_avx2);
+            PROBE1(sha256_mb_done, num_jobs);
+            return;
+        case HASH_MB_AVX512:
+            PROBE2(sha256_mb_start, num_jobs, 16);
+            sha256_mb_lanes(jobs, num_jobs, 16, sha256_compress_x16_avx512);
+            PROBE1(sha256_mb_done, num_jobs);
+            return;
+#endif
+        default:
+            for (size_t i = 0; i < num_jobs; i++) {
+                sha2_256_data(jobs[i].data, jobs[i].len, jobs[i].hash);
+            }
+    }
+}
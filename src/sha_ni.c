@@ -0,0 +1,437 @@
+/*
+    SHA-1 and SHA-256 compression using the Intel SHA extensions.
+
+    The round instructions keep the working variables packed in two registers,
+    ``ABEF``/``CDGH`` for SHA-256 and ``ABCD`` plus ``E`` for SHA-1, so the state is
+    shuffled into that layout once per call rather than once per block.
+*/
+
+#include "cpu.h"
+#include "sha_internal.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef HASH_X86
+
+# include <immintrin.h>
+
+__attribute__((target("sha,sse4.1,ssse3"))) void
+sha1_compress_shani(uint32_t *state, const uint8_t *blocks, size_t num_blocks) {
+    /* Reverse all 16 bytes, which swaps both the word order and the byte order of each word */
+    const __m128i mask = _mm_set_epi64x(0x0001020304050607, 0x08090a0b0c0d0e0f);
+    __m128i abcd, abcd_save, e0, e0_save, e1;
+    __m128i msg0, msg1, msg2, msg3;
+
+    abcd = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)state), 0x1b);
+    e0 = _mm_set_epi32(state[4], 0, 0, 0);
+
+    for (size_t i = 0; i < num_blocks; i++) {
+        const uint8_t *block = blocks + i * 64;
+
+        abcd_save = abcd;
+        e0_save = e0;
+
+        /* Rounds 0-3 */
+        msg0 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(block + 0)), mask);
+        e0 = _mm_add_epi32(e0, msg0);
+        e1 = abcd;
+        abcd = _mm_sha1rnds4_epu32(abcd, e0, 0);
+
+        /* Rounds 4-7 */
+        msg1 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(block + 16)), mask);
+        e1 = _mm_sha1nexte_epu32(e1, msg1);
+        e0 = abcd;
+        abcd = _mm_sha1rnds4_epu32(abcd, e1, 0);
+        msg0 = _mm_sha1msg1_epu32(msg0, msg1);
+
+        /* Rounds 8-11 */
+        msg2 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(block + 32)), mask);
+        e0 = _mm_sha1nexte_epu32(e0, msg2);
+        e1 = abcd;
+        abcd = _mm_sha1rnds4_epu32(abcd, e0, 0);
+        msg1 = _mm_sha1msg1_epu32(msg1, msg2);
+        msg0 = _mm_xor_si128(msg0, msg2);
+
+        /* Rounds 12-15 */
+        msg3 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(block + 48)), mask);
+        e1 = _mm_sha1nexte_epu32(e1, msg3);
+        e0 = abcd;
+        msg0 = _mm_sha1msg2_epu32(msg0, msg3);
+        abcd = _mm_sha1rnds4_epu32(abcd, e1, 0);
+        msg2 = _mm_sha1msg1_epu32(msg2, msg3);
+        msg1 = _mm_xor_si128(msg1, msg3);
+
+        /* Rounds 16-19 */
+        e0 = _mm_sha1nexte_epu32(e0, msg0);
+        e1 = abcd;
+        msg1 = _mm_sha1msg2_epu32(msg1, msg0);
+        abcd = _mm_sha1rnds4_epu32(abcd, e0, 0);
+        msg3 = _mm_sha1msg1_epu32(msg3, msg0);
+        msg2 = _mm_xor_si128(msg2, msg0);
+
+        /* Rounds 20-23 */
+        e1 = _mm_sha1nexte_epu32(e1, msg1);
+        e0 = abcd;
+        msg2 = _mm_sha1msg2_epu32(msg2, msg1);
+        abcd = _mm_sha1rnds4_epu32(abcd, e1, 1);
+        msg0 = _mm_sha1msg1_epu32(msg0, msg1);
+        msg3 = _mm_xor_si128(msg3, msg1);
+
+        /* Rounds 24-27 */
+        e0 = _mm_sha1nexte_epu32(e0, msg2);
+        e1 = abcd;
+        msg3 = _mm_sha1msg2_epu32(msg3, msg2);
+        abcd = _mm_sha1rnds4_epu32(abcd, e0, 1);
+        msg1 = _mm_sha1msg1_epu32(msg1, msg2);
+        msg0 = _mm_xor_si128(msg0, msg2);
+
+        /* Rounds 28-31 */
+        e1 = _mm_sha1nexte_epu32(e1, msg3);
+        e0 = abcd;
+        msg0 = _mm_sha1msg2_epu32(msg0, msg3);
+        abcd = _mm_sha1rnds4_epu32(abcd, e1, 1);
+        msg2 = _mm_sha1msg1_epu32(msg2, msg3);
+        msg1 = _mm_xor_si128(msg1, msg3);
+
+        /* Rounds 32-35 */
+        e0 = _mm_sha1nexte_epu32(e0, msg0);
+        e1 = abcd;
+        msg1 = _mm_sha1msg2_epu32(msg1, msg0);
+        abcd = _mm_sha1rnds4_epu32(abcd, e0, 1);
+        msg3 = _mm_sha1msg1_epu32(msg3, msg0);
+        msg2 = _mm_xor_si128(msg2, msg0);
+
+        /* Rounds 36-39 */
+        e1 = _mm_sha1nexte_epu32(e1, msg1);
+        e0 = abcd;
+        msg2 = _mm_sha1msg2_epu32(msg2, msg1);
+        abcd = _mm_sha1rnds4_epu32(abcd, e1, 1);
+        msg0 = _mm_sha1msg1_epu32(msg0, msg1);
+        msg3 = _mm_xor_si128(msg3, msg1);
+
+        /* Rounds 40-43 */
+        e0 = _mm_sha1nexte_epu32(e0, msg2);
+        e1 = abcd;
+        msg3 = _mm_sha1msg2_epu32(msg3, msg2);
+        abcd = _mm_sha1rnds4_epu32(abcd, e0, 2);
+        msg1 = _mm_sha1msg1_epu32(msg1, msg2);
+        msg0 = _mm_xor_si128(msg0, msg2);
+
+        /* Rounds 44-47 */
+        e1 = _mm_sha1nexte_epu32(e1, msg3);
+        e0 = abcd;
+        msg0 = _mm_sha1msg2_epu32(msg0, msg3);
+        abcd = _mm_sha1rnds4_epu32(abcd, e1, 2);
+        msg2 = _mm_sha1msg1_epu32(msg2, msg3);
+        msg1 = _mm_xor_si128(msg1, msg3);
+
+        /* Rounds 48-51 */
+        e0 = _mm_sha1nexte_epu32(e0, msg0);
+        e1 = abcd;
+        msg1 = _mm_sha1msg2_epu32(msg1, msg0);
+        abcd = _mm_sha1rnds4_epu32(abcd, e0, 2);
+        msg3 = _mm_sha1msg1_epu32(msg3, msg0);
+        msg2 = _mm_xor_si128(msg2, msg0);
+
+        /* Rounds 52-55 */
+        e1 = _mm_sha1nexte_epu32(e1, msg1);
+        e0 = abcd;
+        msg2 = _mm_sha1msg2_epu32(msg2, msg1);
+        abcd = _mm_sha1rnds4_epu32(abcd, e1, 2);
+        msg0 = _mm_sha1msg1_epu32(msg0, msg1);
+        msg3 = _mm_xor_si128(msg3, msg1);
+
+        /* Rounds 56-59 */
+        e0 = _mm_sha1nexte_epu32(e0, msg2);
+        e1 = abcd;
+        msg3 = _mm_sha1msg2_epu32(msg3, msg2);
+        abcd = _mm_sha1rnds4_epu32(abcd, e0, 2);
+        msg1 = _mm_sha1msg1_epu32(msg1, msg2);
+        msg0 = _mm_xor_si128(msg0, msg2);
+
+        /* Rounds 60-63 */
+        e1 = _mm_sha1nexte_epu32(e1, msg3);
+        e0 = abcd;
+        msg0 = _mm_sha1msg2_epu32(msg0, msg3);
+        abcd = _mm_sha1rnds4_epu32(abcd, e1, 3);
+        msg2 = _mm_sha1msg1_epu32(msg2, msg3);
+        msg1 = _mm_xor_si128(msg1, msg3);
+
+        /* Rounds 64-67 */
+        e0 = _mm_sha1nexte_epu32(e0, msg0);
+        e1 = abcd;
+        msg1 = _mm_sha1msg2_epu32(msg1, msg0);
+        abcd = _mm_sha1rnds4_epu32(abcd, e0, 3);
+        msg3 = _mm_sha1msg1_epu32(msg3, msg0);
+        msg2 = _mm_xor_si128(msg2, msg0);
+
+        /* Rounds 68-71 */
+        e1 = _mm_sha1nexte_epu32(e1, msg1);
+        e0 = abcd;
+        msg2 = _mm_sha1msg2_epu32(msg2, msg1);
+        abcd = _mm_sha1rnds4_epu32(abcd, e1, 3);
+        msg3 = _mm_xor_si128(msg3, msg1);
+
+        /* Rounds 72-75 */
+        e0 = _mm_sha1nexte_epu32(e0, msg2);
+        e1 = abcd;
+        msg3 = _mm_sha1msg2_epu32(msg3, msg2);
+        abcd = _mm_sha1rnds4_epu32(abcd, e0, 3);
+
+        /* Rounds 76-79 */
+        e1 = _mm_sha1nexte_epu32(e1, msg3);
+        e0 = abcd;
+        abcd = _mm_sha1rnds4_epu32(abcd, e1, 3);
+
+        e0 = _mm_sha1nexte_epu32(e0, e0_save);
+        abcd = _mm_add_epi32(abcd, abcd_save);
+    }
+
+    _mm_storeu_si128((__m128i *)state, _mm_shuffle_epi32(abcd, 0x1b));
+    state[4] = _mm_extract_epi32(e0, 3);
+}
+
+/* Load the state in the ``ABEF``/``CDGH`` layout of the round instructions */
+static inline __attribute__((target("sha,sse4.1,ssse3"))) void
+sha256_load_state(const uint32_t *state, __m128i *abef, __m128i *cdgh) {
+    __m128i tmp = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)&state[0]), 0xb1);  /* CDAB */
+    __m128i efgh = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)&state[4]), 0x1b);  /* EFGH */
+
+    *abef = _mm_alignr_epi8(tmp, efgh, 8);
+    *cdgh = _mm_blend_epi16(efgh, tmp, 0xf0);
+}
+
+static inline __attribute__((target("sha,sse4.1,ssse3"))) void
+sha256_store_state(uint32_t *state, __m128i abef, __m128i cdgh) {
+    __m128i tmp = _mm_shuffle_epi32(abef, 0x1b);  /* FEBA */
+    cdgh = _mm_shuffle_epi32(cdgh, 0xb1);  /* DCHG */
+
+    _mm_storeu_si128((__m128i *)&state[0], _mm_blend_epi16(tmp, cdgh, 0xf0));  /* DCBA */
+    _mm_storeu_si128((__m128i *)&state[4], _mm_alignr_epi8(cdgh, tmp, 8));  /* HGFE */
+}
+
+/* The 64 rounds of one block given as its first 16 message words, in host order */
+static inline __attribute__((target("sha,sse4.1,ssse3"))) void
+sha256_rounds_shani(__m128i *abef, __m128i *cdgh, __m128i msg0, __m128i msg1, __m128i msg2, __m128i msg3) {
+    __m128i state0 = *abef, state1 = *cdgh;
+    __m128i msg, tmp;
+
+    /* Rounds 0-3 */
+    msg = _mm_add_epi32(msg0, _mm_loadu_si128((const __m128i *)&K32_64[0]));
+    state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+    msg = _mm_shuffle_epi32(msg, 0x0e);
+    state0 = _mm_sha256rnds2_epu32(state0, state1, msg);
+
+    /* Rounds 4-7 */
+    msg = _mm_add_epi32(msg1, _mm_loadu_si128((const __m128i *)&K32_64[4]));
+    state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+    msg = _mm_shuffle_epi32(msg, 0x0e);
+    state0 = _mm_sha256rnds2_epu32(state0, state1, msg);
+    msg0 = _mm_sha256msg1_epu32(msg0, msg1);
+
+    /* Rounds 8-11 */
+    msg = _mm_add_epi32(msg2, _mm_loadu_si128((const __m128i *)&K32_64[8]));
+    state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+    msg = _mm_shuffle_epi32(msg, 0x0e);
+    state0 = _mm_sha256rnds2_epu32(state0, state1, msg);
+    msg1 = _mm_sha256msg1_epu32(msg1, msg2);
+
+    /* Rounds 12-15 */
+    msg = _mm_add_epi32(msg3, _mm_loadu_si128((const __m128i *)&K32_64[12]));
+    state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+    tmp = _mm_alignr_epi8(msg3, msg2, 4);
+    msg0 = _mm_add_epi32(msg0, tmp);
+    msg0 = _mm_sha256msg2_epu32(msg0, msg3);
+    msg = _mm_shuffle_epi32(msg, 0x0e);
+    state0 = _mm_sha256rnds2_epu32(state0, state1, msg);
+    msg2 = _mm_sha256msg1_epu32(msg2, msg3);
+
+    /* Rounds 16-19 */
+    msg = _mm_add_epi32(msg0, _mm_loadu_si128((const __m128i *)&K32_64[16]));
+    state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+    tmp = _mm_alignr_epi8(msg0, msg3, 4);
+    msg1 = _mm_add_epi32(msg1, tmp);
+    msg1 = _mm_sha256msg2_epu32(msg1, msg0);
+    msg = _mm_shuffle_epi32(msg, 0x0e);
+    state0 = _mm_sha256rnds2_epu32(state0, state1, msg);
+    msg3 = _mm_sha256msg1_epu32(msg3, msg0);
+
+    /* Rounds 20-23 */
+    msg = _mm_add_epi32(msg1, _mm_loadu_si128((const __m128i *)&K32_64[20]));
+    state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+    tmp = _mm_alignr_epi8(msg1, msg0, 4);
+    msg2 = _mm_add_epi32(msg2, tmp);
+    msg2 = _mm_sha256msg2_epu32(msg2, msg1);
+    msg = _mm_shuffle_epi32(msg, 0x0e);
+    state0 = _mm_sha256rnds2_epu32(state0, state1, msg);
+    msg0 = _mm_sha256msg1_epu32(msg0, msg1);
+
+    /* Rounds 24-27 */
+    msg = _mm_add_epi32(msg2, _mm_loadu_si128((const __m128i *)&K32_64[24]));
+    state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+    tmp = _mm_alignr_epi8(msg2, msg1, 4);
+    msg3 = _mm_add_epi32(msg3, tmp);
+    msg3 = _mm_sha256msg2_epu32(msg3, msg2);
+    msg = _mm_shuffle_epi32(msg, 0x0e);
+    state0 = _mm_sha256rnds2_epu32(state0, state1, msg);
+    msg1 = _mm_sha256msg1_epu32(msg1, msg2);
+
+    /* Rounds 28-31 */
+    msg = _mm_add_epi32(msg3, _mm_loadu_si128((const __m128i *)&K32_64[28]));
+    state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+    tmp = _mm_alignr_epi8(msg3, msg2, 4);
+    msg0 = _mm_add_epi32(msg0, tmp);
+    msg0 = _mm_sha256msg2_epu32(msg0, msg3);
+    msg = _mm_shuffle_epi32(msg, 0x0e);
+    state0 = _mm_sha256rnds2_epu32(state0, state1, msg);
+    msg2 = _mm_sha256msg1_epu32(msg2, msg3);
+
+    /* Rounds 32-35 */
+    msg = _mm_add_epi32(msg0, _mm_loadu_si128((const __m128i *)&K32_64[32]));
+    state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+    tmp = _mm_alignr_epi8(msg0, msg3, 4);
+    msg1 = _mm_add_epi32(msg1, tmp);
+    msg1 = _mm_sha256msg2_epu32(msg1, msg0);
+    msg = _mm_shuffle_epi32(msg, 0x0e);
+    state0 = _mm_sha256rnds2_epu32(state0, state1, msg);
+    msg3 = _mm_sha256msg1_epu32(msg3, msg0);
+
+    /* Rounds 36-39 */
+    msg = _mm_add_epi32(msg1, _mm_loadu_si128((const __m128i *)&K32_64[36]));
+    state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+    tmp = _mm_alignr_epi8(msg1, msg0, 4);
+    msg2 = _mm_add_epi32(msg2, tmp);
+    msg2 = _mm_sha256msg2_epu32(msg2, msg1);
+    msg = _mm_shuffle_epi32(msg, 0x0e);
+    state0 = _mm_sha256rnds2_epu32(state0, state1, msg);
+    msg0 = _mm_sha256msg1_epu32(msg0, msg1);
+
+    /* Rounds 40-43 */
+    msg = _mm_add_epi32(msg2, _mm_loadu_si128((const __m128i *)&K32_64[40]));
+    state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+    tmp = _mm_alignr_epi8(msg2, msg1, 4);
+    msg3 = _mm_add_epi32(msg3, tmp);
+    msg3 = _mm_sha256msg2_epu32(msg3, msg2);
+    msg = _mm_shuffle_epi32(msg, 0x0e);
+    state0 = _mm_sha256rnds2_epu32(state0, state1, msg);
+    msg1 = _mm_sha256msg1_epu32(msg1, msg2);
+
+    /* Rounds 44-47 */
+    msg = _mm_add_epi32(msg3, _mm_loadu_si128((const __m128i *)&K32_64[44]));
+    state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+    tmp = _mm_alignr_epi8(msg3, msg2, 4);
+    msg0 = _mm_add_epi32(msg0, tmp);
+    msg0 = _mm_sha256msg2_epu32(msg0, msg3);
+    msg = _mm_shuffle_epi32(msg, 0x0e);
+    state0 = _mm_sha256rnds2_epu32(state0, state1, msg);
+    msg2 = _mm_sha256msg1_epu32(msg2, msg3);
+
+    /* Rounds 48-51 */
+    msg = _mm_add_epi32(msg0, _mm_loadu_si128((const __m128i *)&K32_64[48]));
+    state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+    tmp = _mm_alignr_epi8(msg0, msg3, 4);
+    msg1 = _mm_add_epi32(msg1, tmp);
+    msg1 = _mm_sha256msg2_epu32(msg1, msg0);
+    msg = _mm_shuffle_epi32(msg, 0x0e);
+    state0 = _mm_sha256rnds2_epu32(state0, state1, msg);
+    msg3 = _mm_sha256msg1_epu32(msg3, msg0);
+
+    /* Rounds 52-55 */
+    msg = _mm_add_epi32(msg1, _mm_loadu_si128((const __m128i *)&K32_64[52]));
+    state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+    tmp = _mm_alignr_epi8(msg1, msg0, 4);
+    msg2 = _mm_add_epi32(msg2, tmp);
+    msg2 = _mm_sha256msg2_epu32(msg2, msg1);
+    msg = _mm_shuffle_epi32(msg, 0x0e);
+    state0 = _mm_sha256rnds2_epu32(state0, state1, msg);
+
+    /* Rounds 56-59 */
+    msg = _mm_add_epi32(msg2, _mm_loadu_si128((const __m128i *)&K32_64[56]));
+    state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+    tmp = _mm_alignr_epi8(msg2, msg1, 4);
+    msg3 = _mm_add_epi32(msg3, tmp);
+    msg3 = _mm_sha256msg2_epu32(msg3, msg2);
+    msg = _mm_shuffle_epi32(msg, 0x0e);
+    state0 = _mm_sha256rnds2_epu32(state0, state1, msg);
+
+    /* Rounds 60-63 */
+    msg = _mm_add_epi32(msg3, _mm_loadu_si128((const __m128i *)&K32_64[60]));
+    state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+    msg = _mm_shuffle_epi32(msg, 0x0e);
+    state0 = _mm_sha256rnds2_epu32(state0, state1, msg);
+
+    *abef = _mm_add_epi32(state0, *abef);
+    *cdgh = _mm_add_epi32(state1, *cdgh);
+}
+
+__attribute__((target("sha,sse4.1,ssse3"))) void
+sha256_compress_shani(uint32_t *state, const uint8_t *blocks, size_t num_blocks) {
+    /* Swap the byte order of each word */
+    const __m128i mask = _mm_set_epi64x(0x0c0d0e0f08090a0b, 0x0405060700010203);
+    __m128i abef, cdgh;
+
+    sha256_load_state(state, &abef, &cdgh);
+    for (size_t i = 0; i < num_blocks; i++) {
+        const __m128i *block = (const __m128i *)(blocks + i * 64);
+
+        sha256_rounds_shani(&abef, &cdgh, _mm_shuffle_epi8(_mm_loadu_si128(block + 0), mask),
+                            _mm_shuffle_epi8(_mm_loadu_si128(block + 1), mask),
+                            _mm_shuffle_epi8(_mm_loadu_si128(block + 2), mask),
+                            _mm_shuffle_epi8(_mm_loadu_si128(block + 3), mask));
+    }
+    sha256_store_state(state, abef, cdgh);
+}
+
+__attribute__((target("sha,sse4.1,ssse3"))) void
+sha256_compress_words_shani(uint32_t *state, const uint32_t *words) {
+    __m128i abef, cdgh;
+
+    sha256_load_state(state, &abef, &cdgh);
+    sha256_rounds_shani(&abef, &cdgh, _mm_loadu_si128((const __m128i *)&words[0]),
+                        _mm_loadu_si128((const __m128i *)&words[4]), _mm_loadu_si128((const __m128i *)&words[8]),
+                        _mm_loadu_si128((const __m128i *)&words[12]));
+    sha256_store_state(state, abef, cdgh);
+}
+
+/* Without a message schedule to compute only the round instructions are left */
+__attribute__((target("sha,sse4.1,ssse3"))) void
+sha256_compress_schedule_shani(uint32_t *state, const uint32_t *kw) {
+    __m128i abef, cdgh, state0, state1, msg;
+
+    sha256_load_state(state, &abef, &cdgh);
+    state0 = abef;
+    state1 = cdgh;
+    for (int t = 0; t < 64; t += 4) {
+        msg = _mm_loadu_si128((const __m128i *)&kw[t]);
+        state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+        msg = _mm_shuffle_epi32(msg, 0x0e);
+        state0 = _mm_sha256rnds2_epu32(state0, state1, msg);
+    }
+    sha256_store_state(state, _mm_add_epi32(state0, abef), _mm_add_epi32(state1, cdgh));
+}
+
+#else
+
+/* Never selected on other architectures, defined so the dispatch table links everywhere */
+void
+sha1_compress_shani(uint32_t *state, const uint8_t *blocks, size_t num_blocks) {
+    sha1_compress_scalar(state, blocks, num_blocks);
+}
+
+void
+sha256_compress_shani(uint32_t *state, const uint8_t *blocks, size_t num_blocks) {
+    sha256_compress_scalar(state, blocks, num_blocks);
+}
+
+void
+sha256_compress_words_shani(uint32_t *state, const uint32_t *words) {
+    sha256_compress_words_scalar(state, words);
+}
+
+void
+sha256_compress_schedule_shani(uint32_t *state, const uint32_t *kw) {
+    sha256_compress_schedule_scalar(state, kw);
+}
+
+#endif /* HASH_X86 */
@@ -0,0 +1,658 @@
+/*
+    SipHash and HalfSipHash by J.-P. Aumasson and D. J. Bernstein (https://www.aumasson.jp/siphash/siphash.pdf).
+
+    Keyed hashes for hash tables that take untrusted keys: without the 128-bit secret an
+    attacker cannot find inputs that collide, so the table cannot be flooded. SipHash-c-d
+    absorbs the message in 64-bit words with c rounds each and finishes with d rounds,
+    HalfSipHash is the same construction on 32-bit words with a 64-bit key, for 32-bit
+    targets. SipHash-2-4 is the conservative choice, SipHash-1-3 the faster one used by
+    many hash table implementations.
+
+    Most keys are short, so the bytes after the last full word are read with at most two
+    overlapping loads instead of one at a time. The batch functions hash the messages of
+    several jobs at once in the lanes of AVX2 or AVX-512 registers, lanes whose message
+    is shorter than the others keep their state while the others absorb theirs.
+*/
+
+#include "siphash.h"
+
+#include "batch.h"
+#include "cpu.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+static enum siphash_backend active_backend = SIPHASH_BACKEND_SCALAR;
+
+static inline uint32_t
+load32_le(const uint8_t *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline uint64_t
+load64_le(const uint8_t *p) {
+    return (uint64_t)p[0] | ((uint64_t)p[1] << 8) | ((uint64_t)p[2] << 16) | ((uint64_t)p[3] << 24) |
+           ((uint64_t)p[4] << 32) | ((uint64_t)p[5] << 40) | ((uint64_t)p[6] << 48) | ((uint64_t)p[7] << 56);
+}
+
+#define ROTL64(x, n) (((x) << (n)) | ((x) >> (64 - (n))))
+#define ROTL32(x, n) (((x) << (n)) | ((x) >> (32 - (n))))
+
+#define SIPROUND(v)                                                                                                    \
+    do {                                                                                                               \
+        v[0] += v[1];                                                                                                  \
+        v[1] = ROTL64(v[1], 13);                                                                                       \
+        v[1] ^= v[0];                                                                                                  \
+        v[0] = ROTL64(v[0], 32);                                                                                       \
+        v[2] += v[3];                                                                                                  \
+        v[3] = ROTL64(v[3], 16);                                                                                       \
+        v[3] ^= v[2];                                                                                                  \
+        v[0] += v[3];                                                                                                  \
+        v[3] = ROTL64(v[3], 21);                                                                                       \
+        v[3] ^= v[0];                                                                                                  \
+        v[2] += v[1];                                                                                                  \
+        v[1] = ROTL64(v[1], 17);                                                                                       \
+        v[1] ^= v[2];                                                                                                  \
+        v[2] = ROTL64(v[2], 32);                                                                                       \
+    } while (0)
+
+#define HALFSIPROUND(v)                                                                                                \
+    do {                                                                                                               \
+        v[0] += v[1];                                                                                                  \
+        v[1] = ROTL32(v[1], 5);                                                                                        \
+        v[1] ^= v[0];                                                                                                  \
+        v[0] = ROTL32(v[0], 16);                                                                                       \
+        v[2] += v[3];                                                                                                  \
+        v[3] = ROTL32(v[3], 8);                                                                                        \
+        v[3] ^= v[2];                                                                                                  \
+        v[0] += v[3];                                                                                                  \
+        v[3] = ROTL32(v[3], 7);                                                                                        \
+        v[3] ^= v[0];                                                                                                  \
+        v[2] += v[1];                                                                                                  \
+        v[1] = ROTL32(v[1], 13);                                                                                       \
+        v[1] ^= v[2];                                                                                                  \
+        v[2] = ROTL32(v[2], 16);                                                                                       \
+    } while (0)
+
+/*
+    The last word of a message of `len` bytes ending at `end`: its `len % 8` trailing bytes
+    and the length in the top byte. Messages of at least 8 bytes read the 8 bytes that end
+    them and shift out the ones already absorbed, shorter ones take two overlapping loads.
+*/
+static inline uint64_t
+last_word64(const uint8_t *end, size_t len) {
+    size_t rem = len % 8;
+    uint64_t b = (uint64_t)len << 56;
+
+    if (!rem) {
+        return b;
+    }
+    if (len >= 8) {
+        return b | load64_le(end - 8) >> (64 - 8 * rem);
+    }
+    if (rem >= 4) {
+        return b | load32_le(end - rem) | (uint64_t)load32_le(end - 4) << (8 * (rem - 4));
+    }
+    return b | end[-(ptrdiff_t)rem] | (uint64_t)end[(ptrdiff_t)(rem / 2) - (ptrdiff_t)rem] << (8 * (rem / 2)) |
+           (uint64_t)end[-1] << (8 * (rem - 1));
+}
+
+/* The same for the 32-bit words of HalfSipHash */
+static inline uint32_t
+last_word32(const uint8_t *end, size_t len) {
+    size_t rem = len % 4;
+    uint32_t b = (uint32_t)len << 24;
+
+    if (!rem) {
+        return b;
+    }
+    if (len >= 4) {
+        return b | load32_le(end - 4) >> (32 - 8 * rem);
+    }
+    return b | end[-(ptrdiff_t)rem] | (uint32_t)end[(ptrdiff_t)(rem / 2) - (ptrdiff_t)rem] << (8 * (rem / 2)) |
+           (uint32_t)end[-1] << (8 * (rem - 1));
+}
+
+static inline void
+absorb64(uint64_t *v, uint64_t m, int c_rounds) {
+    v[3] ^= m;
+    for (int i = 0; i < c_rounds; i++) {
+        SIPROUND(v);
+    }
+    v[0] ^= m;
+}
+
+static inline uint64_t
+finish64(uint64_t *v, int d_rounds) {
+    for (int i = 0; i < d_rounds; i++) {
+        SIPROUND(v);
+    }
+    return v[0] ^ v[1] ^ v[2] ^ v[3];
+}
+
+/*
+    SipHash-c-d of `len` bytes of `in`. With `high` set the output is 128 bits, its second
+    half is written to `high`; the first half is returned either way.
+*/
+static inline uint64_t
+siphash(const struct siphash_key *key, const uint8_t *in, size_t len, int c_rounds, int d_rounds, uint64_t *high) {
+    uint64_t v[4] = {key->v[0], key->v[1] ^ (high ? 0xee : 0), key->v[2], key->v[3]};
+    const uint8_t *end = in + len;
+    uint64_t low;
+
+    for (; end - in >= 8; in += 8) {
+        absorb64(v, load64_le(in), c_rounds);
+    }
+    absorb64(v, last_word64(end, len), c_rounds);
+
+    v[2] ^= high ? 0xee : 0xff;
+    low = finish64(v, d_rounds);
+    if (high) {
+        v[1] ^= 0xdd;
+        *high = finish64(v, d_rounds);
+    }
+    return low;
+}
+
+/* HalfSipHash-2-4, the output is 32 bits or, with `high` set, 64 */
+static inline uint32_t
+halfsiphash(const struct halfsiphash_key *key, const uint8_t *in, size_t len, uint32_t *high) {
+    uint32_t v[4] = {key->v[0], key->v[1] ^ (high ? 0xee : 0), key->v[2], key->v[3]};
+    const uint8_t *end = in + len;
+    uint32_t m, low;
+
+    for (; end - in >= 4; in += 4) {
+        m = load32_le(in);
+        v[3] ^= m;
+        HALFSIPROUND(v);
+        HALFSIPROUND(v);
+        v[0] ^= m;
+    }
+    m = last_word32(end, len);
+    v[3] ^= m;
+    HALFSIPROUND(v);
+    HALFSIPROUND(v);
+    v[0] ^= m;
+
+    v[2] ^= high ? 0xee : 0xff;
+    for (int i = 0; i < 4; i++) {
+        HALFSIPROUND(v);
+    }
+    low = v[1] ^ v[3];
+    if (high) {
+        v[1] ^= 0xdd;
+        for (int i = 0; i < 4; i++) {
+            HALFSIPROUND(v);
+        }
+        *high = v[1] ^ v[3];
+    }
+    return low;
+}
+
+/**
+   Derive the initial state of SipHash from a secret key. The state can be shared by any
+   number of threads and messages.
+
+   :param schedule: The state to initialize.
+   :type schedule: struct siphash_key *
+   :param key: ``SIPHASH_KEY_LEN`` secret bytes, drawn from a random source.
+   :type key: const void *
+*/
+void
+siphash_key_init(struct siphash_key *schedule, const void *key) {
+    uint64_t k0 = load64_le(key), k1 = load64_le((const uint8_t *)key + 8);
+
+    schedule->v[0] = k0 ^ 0x736f6d6570736575;
+    schedule->v[1] = k1 ^ 0x646f72616e646f6d;
+    schedule->v[2] = k0 ^ 0x6c7967656e657261;
+    schedule->v[3] = k1 ^ 0x7465646279746573;
+}
+
+/**
+   Derive the initial state of HalfSipHash from a secret key.
+
+   :param schedule: The state to initialize.
+   :type schedule: struct halfsiphash_key *
+   :param key: ``HALFSIPHASH_KEY_LEN`` secret bytes, drawn from a random source.
+   :type key: const void *
+*/
+void
+halfsiphash_key_init(struct halfsiphash_key *schedule, const void *key) {
+    uint32_t k0 = load32_le(key), k1 = load32_le((const uint8_t *)key + 4);
+
+    schedule->v[0] = k0;
+    schedule->v[1] = k1;
+    schedule->v[2] = k0 ^ 0x6c796765;
+    schedule->v[3] = k1 ^ 0x74656462;
+}
+
+/**
+   Compute SipHash-2-4 of :c:var:`data` under :c:var:`key`.
+
+   The result is the little-endian reading of the 8 output bytes of the reference
+   implementation.
+
+   :param key: A key schedule set up by :c:func:`siphash_key_init`.
+   :type key: const struct siphash_key *
+   :param data: The message, e.g. a hash table key.
+   :type data: const void *
+   :param len: Length of :c:var:`data` in bytes.
+   :type len: size_t
+   :return: The 64-bit hash.
+   :rtype: uint64_t
+*/
+uint64_t
+siphash24(const struct siphash_key *key, const void *data, size_t len) {
+    return siphash(key, data, len, 2, 4, NULL);
+}
+
+/**
+   Compute the 128-bit output variant of SipHash-2-4 of :c:var:`data` under :c:var:`key`.
+
+   :param key: A key schedule set up by :c:func:`siphash_key_init`.
+   :type key: const struct siphash_key *
+   :param data: The message.
+   :type data: const void *
+   :param len: Length of :c:var:`data` in bytes.
+   :type len: size_t
+   :return: The first 8 output bytes in ``low`` and the last 8 in ``high``, both read as
+            little-endian.
+   :rtype: struct siphash128
+*/
+struct siphash128
+siphash24_128(const struct siphash_key *key, const void *data, size_t len) {
+    struct siphash128 h;
+
+    h.low = siphash(key, data, len, 2, 4, &h.high);
+    return h;
+}
+
+/**
+   Compute SipHash-1-3 of :c:var:`data` under :c:var:`key`.
+
+   One round per word and three to finish instead of two and four, about twice as fast
+   on short keys with a smaller security margin.
+
+   :param key: A key schedule set up by :c:func:`siphash_key_init`.
+   :type key: const struct siphash_key *
+   :param data: The message.
+   :type data: const void *
+   :param len: Length of :c:var:`data` in bytes.
+   :type len: size_t
+   :return: The 64-bit hash.
+   :rtype: uint64_t
+*/
+uint64_t
+siphash13(const struct siphash_key *key, const void *data, size_t len) {
+    return siphash(key, data, len, 1, 3, NULL);
+}
+
+/**
+   Compute the 128-bit output variant of SipHash-1-3 of :c:var:`data` under :c:var:`key`.
+
+   :param key: A key schedule set up by :c:func:`siphash_key_init`.
+   :type key: const struct siphash_key *
+   :param data: The message.
+   :type data: const void *
+   :param len: Length of :c:var:`data` in bytes.
+   :type len: size_t
+   :return: The two halves of the hash, as in :c:func:`siphash24_128`.
+   :rtype: struct siphash128
+*/
+struct siphash128
+siphash13_128(const struct siphash_key *key, const void *data, size_t len) {
+    struct siphash128 h;
+
+    h.low = siphash(key, data, len, 1, 3, &h.high);
+    return h;
+}
+
+/**
+   Compute HalfSipHash-2-4 of :c:var:`data` under :c:var:`key`.
+
+   It works on 32-bit words, which suits 32-bit targets; on 64-bit ones SipHash is faster
+   and stronger.
+
+   :param key: A key schedule set up by :c:func:`halfsiphash_key_init`.
+   :type key: const struct halfsiphash_key *
+   :param data: The message.
+   :type data: const void *
+   :param len: Length of :c:var:`data` in bytes.
+   :type len: size_t
+   :return: The 32-bit hash.
+   :rtype: uint32_t
+*/
+uint32_t
+halfsiphash24(const struct halfsiphash_key *key, const void *data, size_t len) {
+    return halfsiphash(key, data, len, NULL);
+}
+
+/**
+   Compute the 64-bit output variant of HalfSipHash-2-4 of :c:var:`data` under :c:var:`key`.
+
+   :param key: A key schedule set up by :c:func:`halfsiphash_key_init`.
+   :type key: const struct halfsiphash_key *
+   :param data: The message.
+   :type data: const void *
+   :param len: Length of :c:var:`data` in bytes.
+   :type len: size_t
+   :return: The 8 output bytes read as little-endian.
+   :rtype: uint64_t
+*/
+uint64_t
+halfsiphash24_64(const struct halfsiphash_key *key, const void *data, size_t len) {
+    uint32_t high;
+    uint32_t low = halfsiphash(key, data, len, &high);
+
+    return low | (uint64_t)high << 32;
+}
+
+#ifdef HASH_X86
+
+# include <immintrin.h>
+
+# define ROTL_256(x, n) _mm256_or_si256(_mm256_slli_epi64(x, n), _mm256_srli_epi64(x, 64 - (n)))
+# define ROT16_256(x)                                                                                                  \
+    _mm256_shuffle_epi8(x, _mm256_setr_epi8(6, 7, 0, 1, 2, 3, 4, 5, 14, 15, 8, 9, 10, 11, 12, 13, 6, 7, 0, 1, 2, 3, 4, \
+                                            5, 14, 15, 8, 9, 10, 11, 12, 13))
+# define ROT32_256(x) _mm256_shuffle_epi32(x, 0xb1)
+
+# define SIPROUND256(v0, v1, v2, v3)                                                                                   \
+    do {                                                                                                               \
+        v0 = _mm256_add_epi64(v0, v1);                                                                                 \
+        v1 = _mm256_xor_si256(ROTL_256(v1, 13), v0);                                                                   \
+        v0 = ROT32_256(v0);                                                                                            \
+        v2 = _mm256_add_epi64(v2, v3);                                                                                 \
+        v3 = _mm256_xor_si256(ROT16_256(v3), v2);                                                                      \
+        v0 = _mm256_add_epi64(v0, v3);                                                                                 \
+        v3 = _mm256_xor_si256(ROTL_256(v3, 21), v0);                                                                   \
+        v2 = _mm256_add_epi64(v2, v1);                                                                                 \
+        v1 = _mm256_xor_si256(ROTL_256(v1, 17), v2);                                                                   \
+        v2 = ROT32_256(v2);                                                                                            \
+    } while (0)
+
+# define SIPROUND512(v0, v1, v2, v3)                                                                                   \
+    do {                                                                                                               \
+        v0 = _mm512_add_epi64(v0, v1);                                                                                 \
+        v1 = _mm512_xor_si512(_mm512_rol_epi64(v1, 13), v0);                                                           \
+        v0 = _mm512_rol_epi64(v0, 32);                                                                                 \
+        v2 = _mm512_add_epi64(v2, v3);                                                                                 \
+        v3 = _mm512_xor_si512(_mm512_rol_epi64(v3, 16), v2);                                                           \
+        v0 = _mm512_add_epi64(v0, v3);                                                                                 \
+        v3 = _mm512_xor_si512(_mm512_rol_epi64(v3, 21), v0);                                                           \
+        v2 = _mm512_add_epi64(v2, v1);                                                                                 \
+        v1 = _mm512_xor_si512(_mm512_rol_epi64(v1, 17), v2);                                                           \
+        v2 = _mm512_rol_epi64(v2, 32);                                                                                 \
+    } while (0)
+
+/*
+    Word `w` of the message of `job` as it is absorbed: a full word, the last word with the
+    length, or nothing once the message of `num_words` words is over.
+*/
+static inline uint64_t
+job_word(const struct hash_job *job, size_t w, size_t num_words) {
+    const uint8_t *data = job->data;
+
+    if (w + 1 < num_words) {
+        return load64_le(data + 8 * w);
+    }
+    return w + 1 == num_words ? last_word64(data + job->len, job->len) : 0;
+}
+
+/* SipHash-c-d of the jobs 4 at a time, returns the number of jobs done */
+__attribute__((target("avx2"))) static inline size_t
+batch_avx2(const struct siphash_key *key, struct hash_job *jobs, size_t num_jobs, int c_rounds, int d_rounds) {
+    size_t j;
+
+    for (j = 0; j + 4 <= num_jobs; j += 4) {
+        struct hash_job *group = jobs + j;
+        size_t num_words[4], min_words = SIZE_MAX, max_words = 0;
+        uint64_t out[4];
+        __m256i v0 = _mm256_set1_epi64x((int64_t)key->v[0]), v1 = _mm256_set1_epi64x((int64_t)key->v[1]);
+        __m256i v2 = _mm256_set1_epi64x((int64_t)key->v[2]), v3 = _mm256_set1_epi64x((int64_t)key->v[3]);
+
+        for (int l = 0; l < 4; l++) {
+            num_words[l] = group[l].len / 8 + 1;
+            min_words = num_words[l] < min_words ? num_words[l] : min_words;
+            max_words = num_words[l] > max_words ? num_words[l] : max_words;
+        }
+
+        for (size_t w = 0; w < max_words; w++) {
+            __m256i s0 = v0, s1 = v1, s2 = v2, s3 = v3;
+            __m256i mv = _mm256_set_epi64x((int64_t)job_word(&group[3], w, num_words[3]),
+                                           (int64_t)job_word(&group[2], w, num_words[2]),
+                                           (int64_t)job_word(&group[1], w, num_words[1]),
+                                           (int64_t)job_word(&group[0], w, num_words[0]));
+            v3 = _mm256_xor_si256(v3, mv);
+            for (int i = 0; i < c_rounds; i++) {
+                SIPROUND256(v0, v1, v2, v3);
+            }
+            v0 = _mm256_xor_si256(v0, mv);
+
+            /* Lanes whose message is over keep their state */
+            if (w >= min_words) {
+                __m256i mask = _mm256_set_epi64x(-(int64_t)(w < num_words[3]), -(int64_t)(w < num_words[2]),
+                                                 -(int64_t)(w < num_words[1]), -(int64_t)(w < num_words[0]));
+
+                v0 = _mm256_blendv_epi8(s0, v0, mask);
+                v1 = _mm256_blendv_epi8(s1, v1, mask);
+                v2 = _mm256_blendv_epi8(s2, v2, mask);
+                v3 = _mm256_blendv_epi8(s3, v3, mask);
+            }
+        }
+
+        v2 = _mm256_xor_si256(v2, _mm256_set1_epi64x(0xff));
+        for (int i = 0; i < d_rounds; i++) {
+            SIPROUND256(v0, v1, v2, v3);
+        }
+        _mm256_storeu_si256((__m256i *)out, _mm256_xor_si256(_mm256_xor_si256(v0, v1), _mm256_xor_si256(v2, v3)));
+        for (int l = 0; l < 4; l++) {
+            *(uint64_t *)group[l].hash = out[l];
+        }
+    }
+    return j;
+}
+
+/* SipHash-c-d of the jobs 8 at a time, returns the number of jobs done */
+__attribute__((target("avx512f"))) static inline size_t
+batch_avx512(const struct siphash_key *key, struct hash_job *jobs, size_t num_jobs, int c_rounds, int d_rounds) {
+    size_t j;
+
+    for (j = 0; j + 8 <= num_jobs; j += 8) {
+        struct hash_job *group = jobs + j;
+        size_t num_words[8], min_words = SIZE_MAX, max_words = 0;
+        uint64_t out[8];
+        __m512i v0 = _mm512_set1_epi64((int64_t)key->v[0]), v1 = _mm512_set1_epi64((int64_t)key->v[1]);
+        __m512i v2 = _mm512_set1_epi64((int64_t)key->v[2]), v3 = _mm512_set1_epi64((int64_t)key->v[3]);
+
+        for (int l = 0; l < 8; l++) {
+            num_words[l] = group[l].len / 8 + 1;
+            min_words = num_words[l] < min_words ? num_words[l] : min_words;
+            max_words = num_words[l] > max_words ? num_words[l] : max_words;
+        }
+
+        for (size_t w = 0; w < max_words; w++) {
+            __m512i s0 = v0, s1 = v1, s2 = v2, s3 = v3;
+            __m512i mv = _mm512_set_epi64(
+                (int64_t)job_word(&group[7], w, num_words[7]), (int64_t)job_word(&group[6], w, num_words[6]),
+                (int64_t)job_word(&group[5], w, num_words[5]), (int64_t)job_word(&group[4], w, num_words[4]),
+                (int64_t)job_word(&group[3], w, num_words[3]), (int64_t)job_word(&group[2], w, num_words[2]),
+                (int64_t)job_word(&group[1], w, num_words[1]), (int64_t)job_word(&group[0], w, num_words[0]));
+            v3 = _mm512_xor_si512(v3, mv);
+            for (int i = 0; i < c_rounds; i++) {
+                SIPROUND512(v0, v1, v2, v3);
+            }
+            v0 = _mm512_xor_si512(v0, mv);
+
+            /* Lanes whose message is over keep their state */
+            if (w >= min_words) {
+                __mmask8 active = 0;
+
+                for (int l = 0; l < 8; l++) {
+                    active |= (__mmask8)((w < num_words[l]) << l);
+                }
+                v0 = _mm512_mask_mov_epi64(s0, active, v0);
+                v1 = _mm512_mask_mov_epi64(s1, active, v1);
+                v2 = _mm512_mask_mov_epi64(s2, active, v2);
+                v3 = _mm512_mask_mov_epi64(s3, active, v3);
+            }
+        }
+
+        v2 = _mm512_xor_si512(v2, _mm512_set1_epi64(0xff));
+        for (int i = 0; i < d_rounds; i++) {
+            SIPROUND512(v0, v1, v2, v3);
+        }
+        _mm512_storeu_si512(out, _mm512_xor_si512(_mm512_xor_si512(v0, v1), _mm512_xor_si512(v2, v3)));
+        for (int l = 0; l < 8; l++) {
+            *(uint64_t *)group[l].hash = out[l];
+        }
+    }
+    return j;
+}
+
+/* Kernels with the round counts known at compile time */
+__attribute__((target("avx2"))) static size_t
+batch24_avx2(const struct siphash_key *key, struct hash_job *jobs, size_t num_jobs) {
+    return batch_avx2(key, jobs, num_jobs, 2, 4);
+}
+
+__attribute__((target("avx2"))) static size_t
+batch13_avx2(const struct siphash_key *key, struct hash_job *jobs, size_t num_jobs) {
+    return batch_avx2(key, jobs, num_jobs, 1, 3);
+}
+
+__attribute__((target("avx512f"))) static size_t
+batch24_avx512(const struct siphash_key *key, struct hash_job *jobs, size_t num_jobs) {
+    return batch_avx512(key, jobs, num_jobs, 2, 4);
+}
+
+__attribute__((target("avx512f"))) static size_t
+batch13_avx512(const struct siphash_key *key, struct hash_job *jobs, size_t num_jobs) {
+    return batch_avx512(key, jobs, num_jobs, 1, 3);
+}
+
+#endif /* HASH_X86 */
+
+/* The jobs left over by the SIMD kernels, or all of them, are hashed one by one */
+static void
+siphash_batch(const struct siphash_key *key, struct hash_job *jobs, size_t num_jobs, int c_rounds, int d_rounds) {
+    size_t done = 0;
+
+#ifdef HASH_X86
+    if (active_backend == SIPHASH_BACKEND_AVX512) {
+        done = c_rounds == 2 ? batch24_avx512(key, jobs, num_jobs) : batch13_avx512(key, jobs, num_jobs);
+    } else if (active_backend == SIPHASH_BACKEND_AVX2) {
+        done = c_rounds == 2 ? batch24_avx2(key, jobs, num_jobs) : batch13_avx2(key, jobs, num_jobs);
+    }
+#endif
+
+    for (size_t j = done; j < num_jobs; j++) {
+        *(uint64_t *)jobs[j].hash = siphash(key, jobs[j].data, jobs[j].len, c_rounds, d_rounds, NULL);
+    }
+}
+
+/**
+   Compute SipHash-2-4 of many messages under one key, e.g. to hash a batch of keys
+   before probing a table.
+
+   Messages are hashed 4 or 8 at a time with the AVX2 and AVX-512 backends, a group
+   costs as much as its longest message, so messages of similar lengths are best kept
+   next to each other.
+
+   :param key: A key schedule set up by :c:func:`siphash_key_init`.
+   :type key: const struct siphash_key *
+   :param jobs: The messages, the ``hash`` of each job points to a `uint64_t` that
+                receives what :c:func:`siphash24` returns.
+   :type jobs: struct hash_job *
+   :param num_jobs: Number of jobs.
+   :type num_jobs: size_t
+*/
+void
+siphash24_batch(const struct siphash_key *key, struct hash_job *jobs, size_t num_jobs) {
+    siphash_batch(key, jobs, num_jobs, 2, 4);
+}
+
+/**
+   Compute SipHash-1-3 of many messages under one key, see :c:func:`siphash24_batch`.
+
+   :param key: A key schedule set up by :c:func:`siphash_key_init`.
+   :type key: const struct siphash_key *
+   :param jobs: The messages, the ``hash`` of each job points to a `uint64_t` that
+                receives what :c:func:`siphash13` returns.
+   :type jobs: struct hash_job *
+   :param num_jobs: Number of jobs.
+   :type num_jobs: size_t
+*/
+void
+siphash13_batch(const struct siphash_key *key, struct hash_job *jobs, size_t num_jobs) {
+    siphash_batch(key, jobs, num_jobs, 1, 3);
+}
+
+/**
+   Select the implementation of :c:func:`siphash24_batch` and :c:func:`siphash13_batch`.
+   Every backend gives the same hashes.
+
+   The fastest backend supported by the CPU is selected when the library is loaded,
+   this is only needed to force a particular one, e.g. to compare their outputs.
+   It is not thread-safe and should be called before any hashing starts.
+
+   :param backend: ``SIPHASH_BACKEND_AUTO`` for the fastest supported backend,
+                   ``SIPHASH_BACKEND_SCALAR`` for the portable C code,
+                   ``SIPHASH_BACKEND_AVX2`` for 4 or ``SIPHASH_BACKEND_AVX512`` for
+                   8 messages at a time.
+   :type backend: enum siphash_backend
+   :return: 0 on success, -1 if the CPU does not support :c:var:`backend`.
+   :rtype: int
+*/
+int
+siphash_set_backend(enum siphash_backend backend) {
+    unsigned features = hash_cpu_features();
+
+    if (backend == SIPHASH_BACKEND_AUTO) {
+        if (features & CPU_AVX512F) {
+            backend = SIPHASH_BACKEND_AVX512;
+        } else if (features & CPU_AVX2) {
+            backend = SIPHASH_BACKEND_AVX2;
+        } else {
+            backend = SIPHASH_BACKEND_SCALAR;
+        }
+    }
+
+    switch (backend) {
+        case SIPHASH_BACKEND_SCALAR:
+            break;
+        case SIPHASH_BACKEND_AVX2:
+            if (!(features & CPU_AVX2)) {
+                return -1;
+            }
+            break;
+        case SIPHASH_BACKEND_AVX512:
+            if (!(features & CPU_AVX512F)) {
+                return -1;
+            }
+            break;
+        default:
+            return -1;
+    }
+
+    active_backend = backend;
+    return 0;
+}
+
+/**
+   Get the backend currently used by the batch functions.
+
+   :return: ``SIPHASH_BACKEND_SCALAR``, ``SIPHASH_BACKEND_AVX2`` or ``SIPHASH_BACKEND_AVX512``.
+   :rtype: enum siphash_backend
+*/
+enum siphash_backend
+siphash_get_backend(void) {
+    return active_backend;
+}
+
+#ifdef __GNUC__
+__attribute__((constructor)) static void
+siphash_select_backend(void) {
+    siphash_set_backend(SIPHASH_BACKEND_AUTO);
+}
+#endif
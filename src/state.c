@@ -0,0 +1,303 @@
+/*
+    Export and import of streaming contexts, so a long running hash can be checkpointed
+    and finished later, possibly by another process on another host. The layout of the
+    exported bytes is described in `state.h`.
+*/
+
+#include "state.h"
+
+#include "sha.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#define HEADER_SIZE 16
+#define CHECKSUM_SIZE 8
+
+static const uint8_t MAGIC[4] = {'L', 'H', 'S', 'T'};
+
+/* What is exported for each algorithm */
+struct layout {
+    size_t word_size;   /* Bytes per chaining value, 8 for the lanes of the Keccak state */
+    size_t num_words;
+    size_t block_size;  /* Size of the partial block buffer, 0 when the context has none */
+    size_t rate;        /* SHA-3 only, bytes absorbed per permutation */
+};
+
+static const struct layout LAYOUTS[] = {
+    [HASH_SHA1] = {4, 5, 64, 0},
+    [HASH_SHA2_224] = {4, 8, 64, 0},
+    [HASH_SHA2_256] = {4, 8, 64, 0},
+    [HASH_SHA2_384] = {8, 8, 128, 0},
+    [HASH_SHA2_512] = {8, 8, 128, 0},
+    [HASH_SHA3_224] = {8, 25, 0, 144},
+    [HASH_SHA3_256] = {8, 25, 0, 136},
+    [HASH_SHA3_384] = {8, 25, 0, 104},
+    [HASH_SHA3_512] = {8, 25, 0, 72},
+    [HASH_SHA2_512_224] = {8, 8, 128, 0},
+    [HASH_SHA2_512_256] = {8, 8, 128, 0},
+};
+
+/* Fields of a context, `words` points to `uint32_t` or `uint64_t` elements depending on the layout */
+struct fields {
+    void *words;
+    uint64_t *length;
+    uint8_t *block;
+};
+
+static const struct layout *
+get_layout(enum hash_algorithm algorithm) {
+    return (unsigned)algorithm < sizeof LAYOUTS / sizeof *LAYOUTS ? &LAYOUTS[algorithm] : NULL;
+}
+
+static size_t
+layout_size(const struct layout *layout) {
+    return HEADER_SIZE + layout->word_size * layout->num_words + layout->block_size + CHECKSUM_SIZE;
+}
+
+static struct fields
+get_fields(enum hash_algorithm algorithm, void *ctx) {
+    switch (algorithm) {
+        case HASH_SHA1: {
+            struct sha1_ctx *sha1 = ctx;
+            return (struct fields){sha1->state, &sha1->length, sha1->block};
+        }
+        case HASH_SHA2_224:
+        case HASH_SHA2_256: {
+            struct sha2_256_ctx *sha2 = ctx;
+            return (struct fields){sha2->state, &sha2->length, sha2->block};
+        }
+        case HASH_SHA2_384:
+        case HASH_SHA2_512:
+        case HASH_SHA2_512_224:
+        case HASH_SHA2_512_256: {
+            struct sha2_512_ctx *sha2 = ctx;
+            return (struct fields){sha2->state, &sha2->length, sha2->block};
+        }
+        default: {
+            struct sha3_ctx *sha3 = ctx;
+            return (struct fields){sha3->state, &sha3->length, NULL};
+        }
+    }
+}
+
+static void
+store_be(uint8_t *p, uint64_t x, size_t size) {
+    for (size_t i = 0; i < size; i++) {
+        p[i] = (x >> (8 * (size - 1 - i))) & 0xff;
+    }
+}
+
+static uint64_t
+load_be(const uint8_t *p, size_t size) {
+    uint64_t x = 0;
+
+    for (size_t i = 0; i < size; i++) {
+        x = (x << 8) | p[i];
+    }
+    return x;
+}
+
+/* First bytes of the SHA-256 of `data`, to catch truncated or damaged checkpoints */
+static void
+checksum(const uint8_t *data, size_t len, uint8_t *out) {
+    uint32_t hash[8];
+
+    sha2_256_data(data, len, hash);
+    store_be(out, hash[0], 4);
+    store_be(out + 4, hash[1], 4);
+}
+
+/* Check everything but the chaining values and return the layout of the exported algorithm */
+static const struct layout *
+validate(const uint8_t *buf, size_t len) {
+    const struct layout *layout;
+    uint8_t sum[CHECKSUM_SIZE];
+    uint64_t length;
+    size_t tail_start;
+
+    if (len < HEADER_SIZE || memcmp(buf, MAGIC, sizeof MAGIC) || buf[4] != HASH_STATE_VERSION || buf[6] || buf[7]) {
+        return NULL;
+    }
+    layout = get_layout(buf[5]);
+    if (!layout || len != layout_size(layout)) {
+        return NULL;
+    }
+
+    checksum(buf, len - CHECKSUM_SIZE, sum);
+    if (memcmp(sum, buf + len - CHECKSUM_SIZE, CHECKSUM_SIZE)) {
+        return NULL;
+    }
+
+    /* Bytes past the partial block are always written as zeros */
+    length = load_be(buf + 8, 8);
+    tail_start = HEADER_SIZE + layout->word_size * layout->num_words;
+    for (size_t i = layout->block_size ? length % layout->block_size : 0; i < layout->block_size; i++) {
+        if (buf[tail_start + i]) {
+            return NULL;
+        }
+    }
+    return layout;
+}
+
+/**
+   Size in bytes of the state exported for :c:var:`algorithm`, at most
+   `HASH_STATE_MAX_SIZE`.
+
+   :param algorithm: Function of the context to export.
+   :type algorithm: enum hash_algorithm
+   :return: The exported size, or 0 if :c:var:`algorithm` is not supported.
+   :rtype: size_t
+*/
+size_t
+hash_state_size(enum hash_algorithm algorithm) {
+    const struct layout *layout = get_layout(algorithm);
+
+    return layout ? layout_size(layout) : 0;
+}
+
+/**
+   Serialize a streaming context, the hash can then be resumed by :c:func:`hash_state_import`
+   in this or any other process. The context itself is left untouched and can still be
+   updated.
+
+   :param algorithm: Function the context was initialized for. SHA-224 and SHA-256, and
+                     SHA-384 and SHA-512, share their context types but not their states.
+   :type algorithm: enum hash_algorithm
+   :param ctx: A `struct sha1_ctx`, `struct sha2_256_ctx`, `struct sha2_512_ctx` or
+               `struct sha3_ctx` matching :c:var:`algorithm`, which has not been finalized.
+   :type ctx: const void *
+   :param buf: Receives :c:func:`hash_state_size` bytes.
+   :type buf: void *
+   :param buf_len: Size of :c:var:`buf` in bytes.
+   :type buf_len: size_t
+   :return: 0 on success, -1 if :c:var:`algorithm` is not supported or :c:var:`buf` is
+            too small.
+   :rtype: int
+*/
+int
+hash_state_export(enum hash_algorithm algorithm, const void *ctx, void *buf, size_t buf_len) {
+    const struct layout *layout = get_layout(algorithm);
+    struct fields fields;
+    uint8_t *out = buf;
+    size_t used;
+
+    if (!layout || buf_len < layout_size(layout)) {
+        return -1;
+    }
+    fields = get_fields(algorithm, (void *)ctx);
+
+    memcpy(out, MAGIC, sizeof MAGIC);
+    out[4] = HASH_STATE_VERSION;
+    out[5] = algorithm;
+    out[6] = out[7] = 0;
+    store_be(out + 8, *fields.length, 8);
+    out += HEADER_SIZE;
+
+    for (size_t i = 0; i < layout->num_words; i++, out += layout->word_size) {
+        if (layout->word_size == 4) {
+            store_be(out, ((const uint32_t *)fields.words)[i], 4);
+        } else if (layout->block_size) {
+            store_be(out, ((const uint64_t *)fields.words)[i], 8);
+        } else {
+            uint64_t lane = ((const uint64_t *)fields.words)[i];
+            for (size_t j = 0; j < 8; j++) {
+                out[j] = (lane >> (8 * j)) & 0xff;
+            }
+        }
+    }
+
+    if (layout->block_size) {
+        used = *fields.length % layout->block_size;
+        memcpy(out, fields.block, used);
+        memset(out + used, 0, layout->block_size - used);
+        out += layout->block_size;
+    }
+
+    checksum(buf, out - (uint8_t *)buf, out);
+    return 0;
+}
+
+/**
+   Restore a context serialized by :c:func:`hash_state_export`. Updating and finalizing
+   it gives the same hash as if the original context had been fed the whole message.
+
+   :param algorithm: Function the exported context was initialized for, a state of any other
+                     function is rejected.
+   :type algorithm: enum hash_algorithm
+   :param ctx: The context of :c:var:`algorithm` to overwrite, it does not have to be
+               initialized.
+   :type ctx: void *
+   :param buf: The exported state.
+   :type buf: const void *
+   :param len: Length of :c:var:`buf` in bytes.
+   :type len: size_t
+   :return: 0 on success, -1 if :c:var:`buf` is not a valid state of :c:var:`algorithm`
+            for this version, in which case :c:var:`ctx` is not modified.
+   :rtype: int
+*/
+int
+hash_state_import(enum hash_algorithm algorithm, void *ctx, const void *buf, size_t len) {
+    const uint8_t *in = buf;
+    const struct layout *layout = validate(in, len);
+    struct fields fields;
+
+    if (!layout || in[5] != algorithm) {
+        return -1;
+    }
+    fields = get_fields(algorithm, ctx);
+
+    *fields.length = load_be(in + 8, 8);
+    in += HEADER_SIZE;
+
+    for (size_t i = 0; i < layout->num_words; i++, in += layout->word_size) {
+        if (layout->word_size == 4) {
+            ((uint32_t *)fields.words)[i] = load_be(in, 4);
+        } else if (layout->block_size) {
+            ((uint64_t *)fields.words)[i] = load_be(in, 8);
+        } else {
+            uint64_t lane = 0;
+            for (size_t j = 0; j < 8; j++) {
+                lane |= (uint64_t)in[j] << (8 * j);
+            }
+            ((uint64_t *)fields.words)[i] = lane;
+        }
+    }
+
+    if (layout->block_size) {
+        memcpy(fields.block, in, *fields.length % layout->block_size);
+    } else {
+        struct sha3_ctx *sha3 = ctx;
+        sha3->rate = layout->rate;
+        sha3->used = sha3->length % layout->rate;
+    }
+    return 0;
+}
+
+/**
+   Read the algorithm and message length of an exported state, for instance to find the
+   function to resume with and the offset of the first byte still to be hashed.
+
+   :param buf: The exported state.
+   :type buf: const void *
+   :param len: Length of :c:var:`buf` in bytes.
+   :type len: size_t
+   :param algorithm: Receives the function the state was exported for.
+   :type algorithm: enum hash_algorithm *
+   :param length: Receives the number of message bytes already hashed.
+   :type length: uint64_t *
+   :return: 0 on success, -1 if :c:var:`buf` is not a valid state for this version.
+   :rtype: int
+*/
+int
+hash_state_info(const void *buf, size_t len, enum hash_algorithm *algorithm, uint64_t *length) {
+    const uint8_t *in = buf;
+
+    if (!validate(in, len)) {
+        return -1;
+    }
+    *algorithm = in[5];
+    *length = load_be(in + 8, 8);
+    return 0;
+}
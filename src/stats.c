@@ -0,0 +1,220 @@
+/*
+    Usage counters of the hashing functions.
+
+    Every thread counts into its own block, so recording is a few plain additions with
+    no shared cache line and no atomic read-modify-write. The blocks are linked into a
+    list that `hash_stats_get` sums under a lock. When a thread exits its counts move to
+    `retired` and its block is freed. The owner stores each counter with a relaxed atomic
+    store so readers never see a torn value.
+*/
+
+#include "stats.h"
+
+#include "stats_internal.h"
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct thread_stats {
+    struct hash_stats stats[HASH_STATS_NUM_ALGORITHMS];
+    struct thread_stats *prev;
+    struct thread_stats *next;
+};
+
+int hash_stats_active;
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t key_once = PTHREAD_ONCE_INIT;
+static pthread_key_t key;
+static struct thread_stats *threads;                          /* Threads that have recorded something */
+static struct hash_stats retired[HASH_STATS_NUM_ALGORITHMS];   /* Counts of the threads that have exited */
+static struct hash_stats baseline[HASH_STATS_NUM_ALGORITHMS];  /* Totals at the last `hash_stats_reset` */
+
+static _Thread_local struct thread_stats *local;
+
+/* The counters are plain `uint64_t` fields, this sums or subtracts every one of them */
+#define NUM_COUNTERS (sizeof(struct hash_stats) / sizeof(uint64_t))
+
+static void
+accumulate(struct hash_stats *total, const struct hash_stats *stats, int sign) {
+    uint64_t *out = (uint64_t *)total;
+    const uint64_t *in = (const uint64_t *)stats;
+
+    for (size_t i = 0; i < NUM_COUNTERS; i++) {
+        uint64_t x = __atomic_load_n(&in[i], __ATOMIC_RELAXED);
+        out[i] += sign > 0 ? x : 0 - x;
+    }
+}
+
+static void
+thread_exit(void *arg) {
+    struct thread_stats *t = arg;
+
+    pthread_mutex_lock(&lock);
+    for (size_t i = 0; i < HASH_STATS_NUM_ALGORITHMS; i++) {
+        accumulate(&retired[i], &t->stats[i], 1);
+    }
+    if (t->prev) {
+        t->prev->next = t->next;
+    } else {
+        threads = t->next;
+    }
+    if (t->next) {
+        t->next->prev = t->prev;
+    }
+    pthread_mutex_unlock(&lock);
+
+    free(t);
+    /* A later destructor that hashes on this thread attaches a new block instead of using the freed one */
+    local = NULL;
+}
+
+static void
+create_key(void) {
+    pthread_key_create(&key, thread_exit);
+}
+
+/* Give the calling thread its block of counters, NULL if it cannot be allocated */
+static struct thread_stats *
+attach(void) {
+    struct thread_stats *t = calloc(1, sizeof *t);
+
+    if (!t || pthread_once(&key_once, create_key)) {
+        free(t);
+        return NULL;
+    }
+
+    pthread_mutex_lock(&lock);
+    t->next = threads;
+    if (threads) {
+        threads->prev = t;
+    }
+    threads = t;
+    pthread_mutex_unlock(&lock);
+
+    pthread_setspecific(key, t);
+    return local = t;
+}
+
+static inline void
+add(uint64_t *counter, uint64_t x) {
+    __atomic_store_n(counter, __atomic_load_n(counter, __ATOMIC_RELAXED) + x, __ATOMIC_RELAXED);
+}
+
+static inline size_t
+size_bucket(size_t len) {
+    size_t bucket = 0;
+
+    for (len >>= 6; len && bucket < HASH_STATS_NUM_BUCKETS - 1; len >>= 2) {
+        bucket++;
+    }
+    return bucket;
+}
+
+/* Add a call or the blocks of a finalization to the calling thread's counters, used by `STATS_CALL` */
+void
+hash_stats_record(enum hash_algorithm algorithm, enum hash_stats_backend backend, size_t len, uint64_t blocks,
+                  int call) {
+    struct thread_stats *t = local ? local : attach();
+    struct hash_stats *stats;
+
+    if (!t || (unsigned)algorithm >= HASH_STATS_NUM_ALGORITHMS) {
+        return;
+    }
+    stats = &t->stats[algorithm];
+
+    add(&stats->bytes, len);
+    add(&stats->blocks, blocks);
+    add(&stats->blocks_by_backend[backend], blocks);
+    if (call) {
+        add(&stats->calls, 1);
+        add(&stats->calls_by_size[size_bucket(len)], 1);
+    }
+}
+
+/**
+   Start or stop counting. Counting is off unless the ``LIBHASH_STATS`` environment
+   variable is set to a non-zero value when the library is loaded. While it is off
+   every hashing call pays a single predictable branch.
+
+   :param enabled: Non-zero to count, 0 to stop. Counts gathered so far are kept.
+   :type enabled: int
+*/
+void
+hash_stats_enable(int enabled) {
+    __atomic_store_n(&hash_stats_active, !!enabled, __ATOMIC_RELAXED);
+}
+
+/**
+   Tell whether counting is on.
+
+   :return: 1 if calls are being counted, 0 otherwise.
+   :rtype: int
+*/
+int
+hash_stats_enabled(void) {
+    return __atomic_load_n(&hash_stats_active, __ATOMIC_RELAXED);
+}
+
+/**
+   Read the counters of :c:var:`algorithm`, summed over every thread that has ever hashed
+   with it since the last :c:func:`hash_stats_reset`. Threads keep counting while this
+   runs and every counter is read on its own, so the fields are not a snapshot taken at
+   one instant: a call in flight may show up in ``blocks`` but not yet in ``calls``.
+
+   The counters are those of the SHA-1, SHA-2 and SHA-3 functions, including calls made
+   through :c:func:`hash_batch`, HMAC and the other constructions built on them. The
+   iterations of :c:func:`pbkdf2` after the first compress cached midstates directly,
+   they are counted as blocks but not as calls or bytes.
+
+   :param algorithm: Function to report.
+   :type algorithm: enum hash_algorithm
+   :param stats: Receives the totals.
+   :type stats: struct hash_stats *
+   :return: 0 on success, -1 if :c:var:`algorithm` is not supported.
+   :rtype: int
+*/
+int
+hash_stats_get(enum hash_algorithm algorithm, struct hash_stats *stats) {
+    if ((unsigned)algorithm >= HASH_STATS_NUM_ALGORITHMS) {
+        return -1;
+    }
+
+    memset(stats, 0, sizeof *stats);
+    pthread_mutex_lock(&lock);
+    accumulate(stats, &retired[algorithm], 1);
+    for (struct thread_stats *t = threads; t; t = t->next) {
+        accumulate(stats, &t->stats[algorithm], 1);
+    }
+    accumulate(stats, &baseline[algorithm], -1);
+    pthread_mutex_unlock(&lock);
+    return 0;
+}
+
+/**
+   Start counting from zero again. Other threads' counters cannot be cleared under their
+   feet, so the current totals are remembered and subtracted by :c:func:`hash_stats_get`.
+*/
+void
+hash_stats_reset(void) {
+    pthread_mutex_lock(&lock);
+    memcpy(baseline, retired, sizeof baseline);
+    for (struct thread_stats *t = threads; t; t = t->next) {
+        for (size_t i = 0; i < HASH_STATS_NUM_ALGORITHMS; i++) {
+            accumulate(&baseline[i], &t->stats[i], 1);
+        }
+    }
+    pthread_mutex_unlock(&lock);
+}
+
+#ifdef __GNUC__
+__attribute__((constructor)) static void
+hash_stats_from_environment(void) {
+    const char *value = getenv("LIBHASH_STATS");
+
+    hash_stats_enable(value && strcmp(value, "") && strcmp(value, "0"));
+}
+#endif
@@ -0,0 +1,65 @@
+/* Counters and trace points of the hashing functions, these are not installed. */
+
+#ifndef _STATS_INTERNAL
+#define _STATS_INTERNAL
+
+#include "batch.h"
+#include "stats.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+    USDT probes in the ``libhash`` provider, they cost a NOP until a tracer such as perf,
+    bpftrace or SystemTap attaches to them. Without <sys/sdt.h> they compile to nothing.
+*/
+#if defined(__has_include)
+# if __has_include(<sys/sdt.h>)
+#  include <sys/sdt.h>
+#  define HASH_PROBES 1
+# endif
+#endif
+
+#ifdef HASH_PROBES
+# define PROBE1(name, a) DTRACE_PROBE1(libhash, name, a)
+# define PROBE2(name, a, b) DTRACE_PROBE2(libhash, name, a, b)
+# define PROBE3(name, a, b, c) DTRACE_PROBE3(libhash, name, a, b, c)
+#else
+# define PROBE1(name, a) ((void)0)
+# define PROBE2(name, a, b) ((void)0)
+# define PROBE3(name, a, b, c) ((void)0)
+#endif
+
+/* Set by `hash_stats_enable`, the counters are not touched while it is 0 */
+extern int hash_stats_active;
+
+#define STATS_ON() __builtin_expect(__atomic_load_n(&hash_stats_active, __ATOMIC_RELAXED), 0)
+
+void hash_stats_record(enum hash_algorithm algorithm, enum hash_stats_backend backend, size_t len, uint64_t blocks,
+                       int call);
+
+/*
+    Count a call hashing `len` bytes through `blocks` blocks. The arguments are only
+    evaluated while the counters are enabled.
+*/
+#define STATS_CALL(algorithm, backend, len, blocks)                                                                    \
+    do {                                                                                                               \
+        if (STATS_ON()) {                                                                                              \
+            hash_stats_record(algorithm, backend, len, blocks, 1);                                                     \
+        }                                                                                                              \
+    } while (0)
+
+/* Count the blocks of a `*_final` call, which is not a call of its own */
+#define STATS_BLOCKS(algorithm, backend, blocks)                                                                       \
+    do {                                                                                                               \
+        if (STATS_ON()) {                                                                                              \
+            hash_stats_record(algorithm, backend, 0, blocks, 0);                                                       \
+        }                                                                                                              \
+    } while (0)
+
+/* Blocks compressed to hash `len` bytes, the length field needs a second padded block when it does not fit */
+#define PADDED_BLOCKS(len, block_size, length_size)                                                                    \
+    ((len) / (block_size) + ((len) % (block_size) + 1 + (length_size) > (block_size) ? 2 : 1))
+
+
+#endif /* _STATS_INTERNAL */
@@ -0,0 +1,126 @@
+#include "batch.h"
+#include "sha.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+#define NUM_JOBS 5000
+
+static uint8_t DATA[1 << 16];
+
+size_t num_tests = 0;
+size_t num_passed = 0;
+
+/* Compare every job's hash against a single-threaded `*_data` call */
+#define TEST_BATCH(fn, algorithm, word_type, hash_size, num_threads)                                                   \
+    do {                                                                                                               \
+        struct hash_job *jobs = malloc(NUM_JOBS * sizeof *jobs);                                                       \
+        word_type(*hashes)[hash_size] = malloc(NUM_JOBS * sizeof *hashes);                                             \
+        size_t failed = 0;                                                                                             \
+                                                                                                                       \
+        printf("Testing hash_batch(" #algorithm ") with %u threads\n", num_threads);                                   \
+        for (size_t i = 0; i < NUM_JOBS; i++) {                                                                        \
+            /* Mostly short records with the odd large one, to give the workers uneven loads */                       \
+            jobs[i].len = i % 97 == 0 ? sizeof DATA - i : i % 300;                                                     \
+            jobs[i].data = DATA + i % 64;                                                                              \
+            if (jobs[i].len > sizeof DATA - i % 64) {                                                                  \
+                jobs[i].len = sizeof DATA - i % 64;                                                                    \
+            }                                                                                                          \
+            jobs[i].hash = hashes[i];                                                                                  \
+        }                                                                                                              \
+                                                                                                                       \
+        num_tests++;                                                                                                   \
+        if (hash_batch(algorithm, jobs, NUM_JOBS, num_threads)) {                                                      \
+            failed = NUM_JOBS;                                                                                         \
+        }                                                                                                              \
+        for (size_t i = 0; i < NUM_JOBS && !failed; i++) {                                                             \
+            word_type expected[hash_size];                                                                             \
+            fn##_data(jobs[i].data, jobs[i].len, expected);                                                            \
+            failed += memcmp(expected, hashes[i], sizeof expected) != 0;                                               \
+        }                                                                                                              \
+                                                                                                                       \
+        if (failed) {                                                                                                  \
+            printf("\t[FAILED] %zu of %d jobs differ\n", failed, NUM_JOBS);                                            \
+        } else {                                                                                                       \
+            printf("\t[PASSED]: %d jobs\n", NUM_JOBS);                                                                 \
+            num_passed++;                                                                                              \
+        }                                                                                                              \
+                                                                                                                       \
+        free(jobs);                                                                                                    \
+        free(hashes);                                                                                                  \
+    } while (0)
+
+/* Every multi-buffer engine has to agree with `sha2_256_data` for lengths around every padding boundary */
+void
+test_mb(enum hash_mb_backend backend, const char *name) {
+    size_t num_jobs = 1500;
+    struct hash_job *jobs = malloc(num_jobs * sizeof *jobs);
+    uint32_t(*hashes)[8] = malloc(num_jobs * sizeof *hashes);
+    size_t failed = 0;
+
+    if (hash_mb_set_backend(backend)) {
+        printf("Skipping sha2_256_mb with the %s engine, it is not supported by this CPU\n", name);
+        free(jobs);
+        free(hashes);
+        return;
+    }
+
+    printf("Testing sha2_256_mb with the %s engine\n", name);
+    for (size_t i = 0; i < num_jobs; i++) {
+        /* Lengths 0 to 1024 in order, then a few long messages that outlive the short ones */
+        jobs[i].len = i <= 1024 ? i : 4096 * (i % 13) + i;
+        jobs[i].data = DATA + i % 251;
+        jobs[i].hash = hashes[i];
+    }
+
+    num_tests++;
+    sha2_256_mb(jobs, num_jobs);
+    for (size_t i = 0; i < num_jobs; i++) {
+        uint32_t expected[8];
+        sha2_256_data(jobs[i].data, jobs[i].len, expected);
+        failed += memcmp(expected, hashes[i], sizeof expected) != 0;
+    }
+
+    if (failed) {
+        printf("\t[FAILED] %zu of %zu jobs differ\n", failed, num_jobs);
+    } else {
+        printf("\t[PASSED]: %zu jobs\n", num_jobs);
+        num_passed++;
+    }
+
+    free(jobs);
+    free(hashes);
+}
+
+int
+main(void) {
+    for (size_t i = 0; i < sizeof DATA; i++) {
+        DATA[i] = (uint8_t)(i * 31 + (i >> 8));
+    }
+
+    TEST_BATCH(sha1, HASH_SHA1, uint32_t, 5, 4);
+    TEST_BATCH(sha2_224, HASH_SHA2_224, uint32_t, 7, 4);
+    TEST_BATCH(sha2_256, HASH_SHA2_256, uint32_t, 8, 1);
+    TEST_BATCH(sha2_256, HASH_SHA2_256, uint32_t, 8, 4);
+    TEST_BATCH(sha2_256, HASH_SHA2_256, uint32_t, 8, 0);
+    TEST_BATCH(sha2_384, HASH_SHA2_384, uint64_t, 6, 3);
+    TEST_BATCH(sha2_512, HASH_SHA2_512, uint64_t, 8, 8);
+    TEST_BATCH(sha2_512_224, HASH_SHA2_512_224, uint64_t, 4, 2);
+    TEST_BATCH(sha2_512_256, HASH_SHA2_512_256, uint64_t, 4, 0);
+    TEST_BATCH(sha3_224, HASH_SHA3_224, uint64_t, 4, 1);
+    TEST_BATCH(sha3_256, HASH_SHA3_256, uint64_t, 4, 4);
+    TEST_BATCH(sha3_384, HASH_SHA3_384, uint64_t, 6, 2);
+    TEST_BATCH(sha3_512, HASH_SHA3_512, uint64_t, 8, 0);
+
+    test_mb(HASH_MB_SERIAL, "serial");
+    test_mb(HASH_MB_AVX2, "AVX2");
+    test_mb(HASH_MB_AVX512, "AVX-512");
+
+    fprintf(stderr, "%zu/%zu test cases passed\n", num_passed, num_tests);
+
+    return num_passed != num_tests;
+}
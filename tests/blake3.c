@@ -0,0 +1,323 @@
+#include "blake3.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+#define LARGE_SIZE ((size_t)5 << 20)
+
+static const char KEY[] = "whats the Elvish word for friend";
+static const char CONTEXT[] = "BLAKE3 2019-12-27 16:29:52 test vectors context";
+
+/* The official test vectors, inputs of bytes 0 to 250 repeated */
+static uint8_t *INPUT;
+
+/* Hashes of the first `len` bytes of INPUT, plain, keyed with KEY and derived with CONTEXT */
+static const struct {
+    size_t len;
+    char *hash;
+    char *keyed;
+    char *derived;
+} KNOWN[] = {
+    {0,
+     "af1349b9f5f9a1a6a0404dea36dcc9499bcb25c9adc112b7cc9a93cae41f3262",
+     "92b2b75604ed3c761f9d6f62392c8a9227ad0ea3f09573e783f1498a4ed60d26",
+     "2cc39783c223154fea8dfb7c1b1660f2ac2dcbd1c1de8277b0b0dd39b7e50d7d"},
+    {1,
+     "2d3adedff11b61f14c886e35afa036736dcd87a74d27b5c1510225d0f592e213",
+     "6d7878dfff2f485635d39013278ae14f1454b8c0a3a2d34bc1ab38228a80c95b",
+     "b3e2e340a117a499c6cf2398a19ee0d29cca2bb7404c73063382693bf66cb06c"},
+    {63,
+     "e9bc37a594daad83be9470df7f7b3798297c3d834ce80ba85d6e207627b7db7b",
+     "bb1eb5d4afa793c1ebdd9fb08def6c36d10096986ae0cfe148cd101170ce37ae",
+     "b6451e30b953c206e34644c6803724e9d2725e0893039cfc49584f991f451af3"},
+    {64,
+     "4eed7141ea4a5cd4b788606bd23f46e212af9cacebacdc7d1f4c6dc7f2511b98",
+     "ba8ced36f327700d213f120b1a207a3b8c04330528586f414d09f2f7d9ccb7e6",
+     "a5c4a7053fa86b64746d4bb688d06ad1f02a18fce9afd3e818fefaa7126bf73e"},
+    {65,
+     "de1e5fa0be70df6d2be8fffd0e99ceaa8eb6e8c93a63f2d8d1c30ecb6b263dee",
+     "c0a4edefa2d2accb9277c371ac12fcdbb52988a86edc54f0716e1591b4326e72",
+     "51fd05c3c1cfbc8ed67d139ad76f5cf8236cd2acd26627a30c104dfd9d3ff8a8"},
+    {1023,
+     "10108970eeda3eb932baac1428c7a2163b0e924c9a9e25b35bba72b28f70bd11",
+     "c951ecdf03288d0fcc96ee3413563d8a6d3589547f2c2fb36d9786470f1b9d6e",
+     "74a16c1c3d44368a86e1ca6df64be6a2f64cce8f09220787450722d85725dea5"},
+    {1024,
+     "42214739f095a406f3fc83deb889744ac00df831c10daa55189b5d121c855af7",
+     "75c46f6f3d9eb4f55ecaaee480db732e6c2105546f1e675003687c31719c7ba4",
+     "7356cd7720d5b66b6d0697eb3177d9f8d73a4a5c5e968896eb6a689684302706"},
+    {1025,
+     "d00278ae47eb27b34faecf67b4fe263f82d5412916c1ffd97c8cb7fb814b8444",
+     "357dc55de0c7e382c900fd6e320acc04146be01db6a8ce7210b7189bd664ea69",
+     "effaa245f065fbf82ac186839a249707c3bddf6d3fdda22d1b95a3c970379bcb"},
+    {2048,
+     "e776b6028c7cd22a4d0ba182a8bf62205d2ef576467e838ed6f2529b85fba24a",
+     "879cf1fa2ea0e79126cb1063617a05b6ad9d0b696d0d757cf053439f60a99dd1",
+     "7b2945cb4fef70885cc5d78a87bf6f6207dd901ff239201351ffac04e1088a23"},
+    {2049,
+     "5f4d72f40d7a5f82b15ca2b2e44b1de3c2ef86c426c95c1af0b6879522563030",
+     "9f29700902f7c86e514ddc4df1e3049f258b2472b6dd5267f61bf13983b78dd5",
+     "2ea477c5515cc3dd606512ee72bb3e0e758cfae7232826f35fb98ca1bcbdf273"},
+    {3072,
+     "b98cb0ff3623be03326b373de6b9095218513e64f1ee2edd2525c7ad1e5cffd2",
+     "044a0e7b172a312dc02a4c9a818c036ffa2776368d7f528268d2e6b5df191770",
+     "050df97f8c2ead654d9bb3ab8c9178edcd902a32f8495949feadcc1e0480c46b"},
+    {3073,
+     "7124b49501012f81cc7f11ca069ec9226cecb8a2c850cfe644e327d22d3e1cd3",
+     "68dede9bef00ba89e43f31a6825f4cf433389fedae75c04ee9f0cf16a427c95a",
+     "72613c9ec9ff7e40f8f5c173784c532ad852e827dba2bf85b2ab4b76f7079081"},
+    {4096,
+     "015094013f57a5277b59d8475c0501042c0b642e531b0a1c8f58d2163229e969",
+     "befc660aea2f1718884cd8deb9902811d332f4fc4a38cf7c7300d597a081bfc0",
+     "1e0d7f3db8c414c97c6307cbda6cd27ac3b030949da8e23be1a1a924ad2f25b9"},
+    {4097,
+     "9b4052b38f1c5fc8b1f9ff7ac7b27cd242487b3d890d15c96a1c25b8aa0fb995",
+     "00df940cd36bb9fa7cbbc3556744e0dbc8191401afe70520ba292ee3ca80abbc",
+     "aca51029626b55fda7117b42a7c211f8c6e9ba4fe5b7a8ca922f34299500ead8"},
+    {8192,
+     "aae792484c8efe4f19e2ca7d371d8c467ffb10748d8a5a1ae579948f718a2a63",
+     "dc9637c8845a770b4cbf76b8daec0eebf7dc2eac11498517f08d44c8fc00d58a",
+     "ad01d7ae4ad059b0d33baa3c01319dcf8088094d0359e5fd45d6aeaa8b2d0c3d"},
+    {8193,
+     "bab6c09cb8ce8cf459261398d2e7aef35700bf488116ceb94a36d0f5f1b7bc3b",
+     "954a2a75420c8d6547e3ba5b98d963e6fa6491addc8c023189cc519821b4a1f5",
+     "af1e0346e389b17c23200270a64aa4e1ead98c61695d917de7d5b00491c9b0f1"},
+    {16384,
+     "f875d6646de28985646f34ee13be9a576fd515f76b5b0a26bb324735041ddde4",
+     "9e9fc4eb7cf081ea7c47d1807790ed211bfec56aa25bb7037784c13c4b707b0d",
+     "160e18b5878cd0df1c3af85eb25a0db5344d43a6fbd7a8ef4ed98d0714c3f7e1"},
+    {31744,
+     "62b6960e1a44bcc1eb1a611a8d6235b6b4b78f32e7abc4fb4c6cdcce94895c47",
+     "efa53b389ab67c593dba624d898d0f7353ab99e4ac9d42302ee64cbf9939a419",
+     "39772aef80e0ebe60596361e45b061e8f417429d529171b6764468c22928e28e"},
+    {102400,
+     "bc3e3d41a1146b069abffad3c0d44860cf664390afce4d9661f7902e7943e085",
+     "1c35d1a5811083fd7119f5d5d1ba027b4d01c0c6c49fb6ff2cf75393ea5db4a7",
+     "4652cff7a3f385a6103b5c260fc1593e13c778dbe608efb092fe7ee69df6e9c6"},
+};
+
+/* 131 bytes of output for 1025 bytes of INPUT */
+static const char XOF[] =
+     "d00278ae47eb27b34faecf67b4fe263f82d5412916c1ffd97c8cb7fb814b8444f4c4a22b4b399155358a994e52bf255d"
+     "e60035742ec71bd08ac275a1b51cc6bfe332b0ef84b409108cda080e6269ed4b3e2c3f7d722aa4cdc98d16deb554e562"
+     "7be8f955c98e1d5f9565a9194cad0c4285f93700062d9595adb992ae68ff12800ab67a";
+static const char KEYED_XOF[] =
+     "357dc55de0c7e382c900fd6e320acc04146be01db6a8ce7210b7189bd664ea69362396b77fdc0d2634a5529708437220"
+     "66c3c15902ae5097e00ff53f1e116f1cd5352720113a837ab2452cafbde4d54085d9cf5d21ca613071551b25d52e69d6"
+     "c81123872b6f19cd3bc1333edf0c52b94de23ba772cf82636cff4542540a7738d5b930";
+
+size_t num_tests = 0;
+size_t num_passed = 0;
+
+#define ARRAY_LEN(array) ((sizeof(array)) / (sizeof *(array)))
+
+static void
+check(int passed, const char *name) {
+    num_tests++;
+    if (passed) {
+        printf("\t[PASSED]: %s\n", name);
+        num_passed++;
+    } else {
+        printf("\t[FAILED] %s\n", name);
+    }
+}
+
+static uint64_t
+next_random(uint64_t *state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return *state;
+}
+
+static int
+equal_hex(const uint8_t *out, size_t len, const char *expected) {
+    char hex[3];
+
+    for (size_t i = 0; i < len; i++) {
+        sprintf(hex, "%02x", out[i]);
+        if (memcmp(hex, expected + 2 * i, 2)) {
+            return 0;
+        }
+    }
+    return strlen(expected) == 2 * len;
+}
+
+void
+test_known(void) {
+    size_t wrong[3] = {0};
+    uint8_t out[131];
+    char name[64];
+
+    puts("Testing the test vectors");
+    for (size_t i = 0; i < ARRAY_LEN(KNOWN); i++) {
+        blake3(INPUT, KNOWN[i].len, out, 32);
+        wrong[0] += !equal_hex(out, 32, KNOWN[i].hash);
+        blake3_keyed(KEY, INPUT, KNOWN[i].len, out, 32);
+        wrong[1] += !equal_hex(out, 32, KNOWN[i].keyed);
+        blake3_derive_key(CONTEXT, strlen(CONTEXT), INPUT, KNOWN[i].len, out, 32);
+        wrong[2] += !equal_hex(out, 32, KNOWN[i].derived);
+    }
+    snprintf(name, sizeof name, "%zu hashes of 0 to 102400 bytes", ARRAY_LEN(KNOWN));
+    check(!wrong[0], name);
+    check(!wrong[1], "keyed hashes");
+    check(!wrong[2], "derived keys");
+
+    blake3(INPUT, 300000, out, 32);
+    check(equal_hex(out, 32, "6cc9dce05d4cff8c5bef5c5a24681e42b13f03e34a0bc5e66f65a91d48c944fa"), "300000 bytes");
+    blake3("abc", 3, out, 32);
+    check(equal_hex(out, 32, "6437b3ac38465133ffb63b75273a8db548c558465d79db03fd359c6cd5bd9d85"), "\"abc\"");
+}
+
+/* The output stream read at once, block by block from any offset, and as a prefix of a longer one */
+void
+test_xof(void) {
+    struct blake3_ctx ctx;
+    uint8_t out[131], piece[131];
+    size_t wrong = 0;
+
+    puts("Testing the extended output");
+    blake3(INPUT, 1025, out, sizeof out);
+    check(equal_hex(out, sizeof out, XOF), "131 bytes");
+    blake3_keyed(KEY, INPUT, 1025, out, sizeof out);
+    check(equal_hex(out, sizeof out, KEYED_XOF), "131 keyed bytes");
+
+    blake3_init(&ctx);
+    blake3_update(&ctx, INPUT, 1025);
+    blake3_final(&ctx, out, sizeof out);
+    for (size_t seek = 0; seek < sizeof out; seek++) {
+        for (size_t len = 0; seek + len <= sizeof out; len += 7) {
+            blake3_final_seek(&ctx, seek, piece, len);
+            wrong += memcmp(piece, out + seek, len) != 0;
+        }
+    }
+    check(!wrong, "seeking");
+
+    blake3_final(&ctx, piece, 20);
+    check(!memcmp(piece, out, 20), "shorter outputs are prefixes");
+}
+
+/* Pieces of every size give the hash of the whole message, across blocks, chunks and subtrees */
+void
+test_streaming(void) {
+    static const size_t pieces[] = {1, 63, 64, 65, 1000, 1024, 1025, 4096, 10000};
+    uint8_t expected[32], out[32];
+    uint64_t state = 3;
+    size_t wrong = 0;
+
+    puts("Testing streaming");
+    for (size_t p = 0; p < ARRAY_LEN(pieces); p++) {
+        for (size_t len = 0; len <= 20000; len += len < 2100 ? 97 : 1531) {
+            struct blake3_ctx ctx;
+
+            blake3_init_keyed(&ctx, KEY);
+            for (size_t offset = 0; offset < len; offset += pieces[p]) {
+                blake3_update(&ctx, INPUT + offset, len - offset < pieces[p] ? len - offset : pieces[p]);
+            }
+            blake3_final(&ctx, out, 32);
+            blake3_keyed(KEY, INPUT, len, expected, 32);
+            wrong += memcmp(out, expected, 32) != 0;
+        }
+    }
+    check(!wrong, "pieces of 1 to 10000 bytes");
+
+    blake3(INPUT, LARGE_SIZE, expected, 32);
+    for (int i = 0; i < 5; i++) {
+        struct blake3_ctx ctx;
+
+        blake3_init(&ctx);
+        for (size_t offset = 0, len; offset < LARGE_SIZE; offset += len) {
+            len = next_random(&state) % (i * 100000 + 3000);
+            len = len < LARGE_SIZE - offset ? len : LARGE_SIZE - offset;
+            blake3_update(&ctx, INPUT + offset, len);
+        }
+        blake3_final(&ctx, out, 32);
+        wrong += memcmp(out, expected, 32) != 0;
+    }
+    check(!wrong, "5 MiB in pieces of random lengths");
+}
+
+void
+test_backends(void) {
+    static const char *names[] = {"auto", "scalar", "SSE4.1", "AVX2", "AVX-512"};
+    static uint8_t expected[40][32];
+    uint8_t out[32];
+
+    blake3_set_backend(BLAKE3_BACKEND_SCALAR);
+    for (size_t i = 0; i < ARRAY_LEN(expected); i++) {
+        blake3(INPUT + i, i * i * 331 + i, expected[i], 32);
+    }
+
+    for (int backend = BLAKE3_BACKEND_SSE41; backend <= BLAKE3_BACKEND_AVX512; backend++) {
+        size_t wrong = 0;
+
+        if (blake3_set_backend(backend)) {
+            printf("Skipping the %s backend, not supported by the CPU\n", names[backend]);
+            continue;
+        }
+        printf("Testing the %s backend\n", names[backend]);
+
+        for (size_t i = 0; i < ARRAY_LEN(expected); i++) {
+            blake3(INPUT + i, i * i * 331 + i, out, 32);
+            wrong += memcmp(out, expected[i], 32) != 0;
+        }
+        check(!wrong, "same hashes as the scalar code");
+
+        blake3(INPUT, 102400, out, 32);
+        check(equal_hex(out, 32, KNOWN[ARRAY_LEN(KNOWN) - 1].hash), "test vector of 102400 bytes");
+    }
+    blake3_set_backend(BLAKE3_BACKEND_AUTO);
+}
+
+/* The tree does not depend on the threads, including when a partial chunk comes first */
+void
+test_parallel(void) {
+    static const unsigned threads[] = {1, 3, 0};
+    static const size_t first[] = {0, 1000, 1024, 5 * 1024 + 7, 200000};
+    uint8_t expected[32], out[32];
+    size_t wrong = 0;
+
+    puts("Testing threads");
+    blake3_derive_key(CONTEXT, strlen(CONTEXT), INPUT, LARGE_SIZE, expected, 32);
+    for (size_t t = 0; t < ARRAY_LEN(threads); t++) {
+        for (size_t f = 0; f < ARRAY_LEN(first); f++) {
+            struct blake3_ctx ctx;
+
+            blake3_init_derive_key(&ctx, CONTEXT, strlen(CONTEXT));
+            blake3_update(&ctx, INPUT, first[f]);
+            blake3_update_parallel(&ctx, INPUT + first[f], LARGE_SIZE - first[f], threads[t]);
+            blake3_final(&ctx, out, 32);
+            wrong += memcmp(out, expected, 32) != 0;
+        }
+    }
+    check(!wrong, "1, 3 and all threads");
+
+    struct blake3_ctx ctx;
+    blake3_init(&ctx);
+    blake3_update_parallel(&ctx, INPUT, 300000, 4);
+    blake3_final(&ctx, out, 32);
+    check(equal_hex(out, 32, "6cc9dce05d4cff8c5bef5c5a24681e42b13f03e34a0bc5e66f65a91d48c944fa"), "300000 bytes");
+}
+
+int
+main(void) {
+    INPUT = malloc(LARGE_SIZE + 64);
+    for (size_t i = 0; i < LARGE_SIZE + 64; i++) {
+        INPUT[i] = (uint8_t)(i % 251);
+    }
+
+    test_known();
+    test_xof();
+    test_streaming();
+    test_backends();
+    test_parallel();
+
+    fprintf(stderr, "%zu/%zu test cases passed\n", num_passed, num_tests);
+
+    free(INPUT);
+    return num_passed != num_tests;
+}
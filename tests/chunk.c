@@ -0,0 +1,283 @@
+#include "chunk.h"
+
+#include "encode.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+#define DATA_SIZE (4 << 20)
+#define MAX_CHUNKS (DATA_SIZE / 64 + 1)
+
+struct chunks {
+    struct chunk *list;
+    size_t count;
+};
+
+static uint8_t *DATA;
+static uint32_t GEAR[256];
+
+size_t num_tests = 0;
+size_t num_passed = 0;
+
+static void
+check(int passed, const char *name) {
+    num_tests++;
+    if (passed) {
+        printf("\t[PASSED]: %s\n", name);
+        num_passed++;
+    } else {
+        printf("\t[FAILED] %s\n", name);
+    }
+}
+
+static uint64_t
+next_random(uint64_t *state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return *state;
+}
+
+static void
+collect(const struct chunk *chunk, void *arg) {
+    struct chunks *chunks = arg;
+
+    if (chunks->count < MAX_CHUNKS) {
+        chunks->list[chunks->count++] = *chunk;
+    }
+}
+
+static void
+chunk_buffer(const uint8_t *data, size_t len, size_t min_size, size_t avg_size, size_t max_size,
+             struct chunks *chunks) {
+    struct chunker chunker;
+
+    chunks->count = 0;
+    chunker_init(&chunker, min_size, avg_size, max_size);
+    chunker_update(&chunker, data, len, collect, chunks);
+    chunker_final(&chunker, collect, chunks);
+}
+
+/* Cut points found one byte at a time, as described in src/chunk.c */
+static size_t
+reference_lengths(const uint8_t *data, size_t len, size_t min_size, size_t avg_size, size_t max_size,
+                  size_t *lengths) {
+    unsigned bits = 0;
+    uint32_t hash = 0, mask_small, mask_large;
+    size_t count = 0, chunk_len = 0;
+
+    while ((size_t)1 << bits < avg_size) {
+        bits++;
+    }
+    mask_small = ~(uint32_t)0 << (30 - bits);
+    mask_large = ~(uint32_t)0 << (34 - bits);
+
+    for (size_t i = 0; i < len; i++) {
+        hash = (hash << 1) + GEAR[data[i]];
+        chunk_len++;
+        if ((chunk_len >= min_size && chunk_len < avg_size && !(hash & mask_small)) ||
+            (chunk_len >= avg_size && !(hash & mask_large)) || chunk_len == max_size) {
+            lengths[count++] = chunk_len;
+            chunk_len = 0;
+        }
+    }
+    if (chunk_len) {
+        lengths[count++] = chunk_len;
+    }
+    return count;
+}
+
+static int
+same_chunks(const struct chunks *a, const struct chunks *b) {
+    return a->count == b->count && !memcmp(a->list, b->list, a->count * sizeof *a->list);
+}
+
+/* The chunks tile the data, stay within the sizes and carry the digests of their bytes */
+static int
+valid_chunks(const struct chunks *chunks, const uint8_t *data, size_t len, size_t min_size, size_t max_size) {
+    uint64_t offset = 0;
+    uint8_t digest[32];
+
+    for (size_t i = 0; i < chunks->count; i++) {
+        const struct chunk *chunk = &chunks->list[i];
+
+        hash_digest(HASH_SHA2_256, data + chunk->offset, chunk->len, digest);
+        if (chunk->offset != offset || chunk->len > max_size || (chunk->len < min_size && i + 1 < chunks->count) ||
+            memcmp(digest, chunk->digest, 32)) {
+            return 0;
+        }
+        offset += chunk->len;
+    }
+    return offset == len;
+}
+
+void
+test_chunks(void) {
+    static const size_t sizes[][3] = {{2048, 8192, 65536}, {64, 64, 64}, {64, 256, 100000}, {16384, 65536, 65536}};
+    static size_t lengths[MAX_CHUNKS];
+    struct chunks chunks = {calloc(MAX_CHUNKS, sizeof(struct chunk)), 0};
+    char name[128];
+
+    puts("Testing the cut points");
+    for (size_t i = 0; i < sizeof sizes / sizeof *sizes; i++) {
+        size_t count = reference_lengths(DATA, DATA_SIZE, sizes[i][0], sizes[i][1], sizes[i][2], lengths);
+        size_t wrong = 0;
+
+        chunk_buffer(DATA, DATA_SIZE, sizes[i][0], sizes[i][1], sizes[i][2], &chunks);
+        for (size_t j = 0; j < count && j < chunks.count; j++) {
+            wrong += chunks.list[j].len != lengths[j];
+        }
+        snprintf(name, sizeof name, "sizes %zu/%zu/%zu match the reference", sizes[i][0], sizes[i][1], sizes[i][2]);
+        check(count == chunks.count && !wrong, name);
+        snprintf(name, sizeof name, "sizes %zu/%zu/%zu tile the data with their digests", sizes[i][0], sizes[i][1],
+                 sizes[i][2]);
+        check(valid_chunks(&chunks, DATA, DATA_SIZE, sizes[i][0], sizes[i][2]), name);
+    }
+
+    chunk_buffer(DATA, DATA_SIZE, 2048, 8192, 65536, &chunks);
+    snprintf(name, sizeof name, "average of %zu chunks is near 8192 bytes", chunks.count);
+    check(DATA_SIZE / chunks.count > 6144 && DATA_SIZE / chunks.count < 12288, name);
+
+    /* The hash of a run of zeros is constant and misses the masks, so it is cut at the largest size */
+    uint8_t *zeros = calloc(1, 300000);
+    chunk_buffer(zeros, 300000, 1024, 4096, 16384, &chunks);
+    check(chunks.count == 19 && chunks.list[0].len == 16384 && chunks.list[18].len == 300000 - 18 * 16384 &&
+              valid_chunks(&chunks, zeros, 300000, 1024, 16384),
+          "zeros are cut at the largest size");
+    free(zeros);
+
+    chunk_buffer(DATA, 0, 2048, 8192, 65536, &chunks);
+    check(chunks.count == 0, "empty stream has no chunks");
+    chunk_buffer(DATA, 10, 2048, 8192, 65536, &chunks);
+    check(chunks.count == 1 && chunks.list[0].len == 10, "short stream is one chunk");
+
+    free(chunks.list);
+}
+
+/* An insertion only changes the chunks around it */
+void
+test_insertion(void) {
+    struct chunks before = {calloc(MAX_CHUNKS, sizeof(struct chunk)), 0};
+    struct chunks after = {calloc(MAX_CHUNKS, sizeof(struct chunk)), 0};
+    uint8_t *edited = malloc(DATA_SIZE + 100);
+    size_t shared = 0;
+
+    puts("Testing an insertion");
+    memcpy(edited, DATA, DATA_SIZE / 2);
+    memset(edited + DATA_SIZE / 2, 'x', 100);
+    memcpy(edited + DATA_SIZE / 2 + 100, DATA + DATA_SIZE / 2, DATA_SIZE / 2);
+
+    chunk_buffer(DATA, DATA_SIZE, 2048, 8192, 65536, &before);
+    chunk_buffer(edited, DATA_SIZE + 100, 2048, 8192, 65536, &after);
+    for (size_t i = 0; i < before.count; i++) {
+        for (size_t j = 0; j < after.count; j++) {
+            if (!memcmp(before.list[i].digest, after.list[j].digest, 32)) {
+                shared++;
+                break;
+            }
+        }
+    }
+    check(shared + 3 >= before.count, "all but the chunks at the insertion are kept");
+
+    free(before.list);
+    free(after.list);
+    free(edited);
+}
+
+/* Every backend and every way of splitting the stream gives the same chunks */
+void
+test_backends(void) {
+    static const char *names[] = {"auto", "scalar", "AVX2"};
+    struct chunks expected = {calloc(MAX_CHUNKS, sizeof(struct chunk)), 0};
+    struct chunks chunks = {calloc(MAX_CHUNKS, sizeof(struct chunk)), 0};
+    char name[64];
+
+    chunk_set_backend(CHUNK_BACKEND_SCALAR);
+    chunk_buffer(DATA, DATA_SIZE, 256, 1024, 8192, &expected);
+
+    for (int backend = CHUNK_BACKEND_SCALAR; backend <= CHUNK_BACKEND_AVX2; backend++) {
+        struct chunker chunker;
+        uint64_t state = 42;
+        size_t different = 0;
+
+        if (chunk_set_backend(backend)) {
+            printf("Skipping the %s backend, not supported by the CPU\n", names[backend]);
+            continue;
+        }
+        printf("Testing the %s backend\n", names[backend]);
+
+        chunk_buffer(DATA, DATA_SIZE, 256, 1024, 8192, &chunks);
+        snprintf(name, sizeof name, "%zu chunks of the whole buffer", chunks.count);
+        check(same_chunks(&chunks, &expected), name);
+
+        chunks.count = 0;
+        chunker_init(&chunker, 256, 1024, 8192);
+        for (size_t offset = 0, len; offset < DATA_SIZE; offset += len) {
+            len = next_random(&state) % 40000;
+            len = len < DATA_SIZE - offset ? len : DATA_SIZE - offset;
+            chunker_update(&chunker, DATA + offset, len, collect, &chunks);
+        }
+        chunker_final(&chunker, collect, &chunks);
+        check(same_chunks(&chunks, &expected), "pieces of random lengths");
+
+        /* Segments of every length around the AVX2 stripes, compared with the scalar code */
+        for (size_t len = 200; len < 600; len += 7) {
+            struct chunks scalar = {calloc(MAX_CHUNKS, sizeof(struct chunk)), 0};
+
+            chunk_buffer(DATA + len, 16384 + len, 64, 64, 128, &chunks);
+            chunk_set_backend(CHUNK_BACKEND_SCALAR);
+            chunk_buffer(DATA + len, 16384 + len, 64, 64, 128, &scalar);
+            chunk_set_backend(backend);
+            different += !same_chunks(&chunks, &scalar);
+            free(scalar.list);
+        }
+        check(!different, "segment lengths");
+    }
+    chunk_set_backend(CHUNK_BACKEND_AUTO);
+
+    free(expected.list);
+    free(chunks.list);
+}
+
+void
+test_init(void) {
+    struct chunker chunker;
+
+    puts("Testing chunker_init");
+    check(!chunker_init(&chunker, 64, 64, 64) && !chunker_init(&chunker, 100, CHUNK_MAX_AVG_SIZE, SIZE_MAX),
+          "valid sizes");
+    check(chunker_init(&chunker, 32, 64, 128) == -1 && chunker_init(&chunker, 4096, 2048, 8192) == -1 &&
+              chunker_init(&chunker, 1024, 4096, 2048) == -1 && chunker_init(&chunker, 1024, 3000, 8192) == -1 &&
+              chunker_init(&chunker, 1024, 2 * CHUNK_MAX_AVG_SIZE, SIZE_MAX) == -1,
+          "invalid sizes are rejected");
+}
+
+int
+main(void) {
+    uint64_t state = 0x9e3779b97f4a7c15;
+
+    DATA = malloc(DATA_SIZE);
+    for (size_t i = 0; i < DATA_SIZE; i++) {
+        DATA[i] = (uint8_t)next_random(&state);
+    }
+    for (size_t i = 0; i < 256; i++) {
+        uint8_t byte = (uint8_t)i, digest[32];
+
+        hash_digest(HASH_SHA2_256, &byte, 1, digest);
+        GEAR[i] = (uint32_t)digest[0] << 24 | (uint32_t)digest[1] << 16 | (uint32_t)digest[2] << 8 | digest[3];
+    }
+
+    test_init();
+    test_chunks();
+    test_insertion();
+    test_backends();
+
+    fprintf(stderr, "%zu/%zu test cases passed\n", num_passed, num_tests);
+
+    free(DATA);
+    return num_passed != num_tests;
+}
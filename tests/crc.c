@@ -0,0 +1,176 @@
+#include "crc.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+#define DATA_SIZE 100000
+
+static uint8_t DATA[DATA_SIZE];
+
+size_t num_tests = 0;
+size_t num_passed = 0;
+
+static void
+check(int passed, const char *name) {
+    num_tests++;
+    if (passed) {
+        printf("\t[PASSED]: %s\n", name);
+        num_passed++;
+    } else {
+        printf("\t[FAILED] %s\n", name);
+    }
+}
+
+static uint64_t
+next_random(uint64_t *state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return *state;
+}
+
+/* One bit at a time, straight from the definition */
+static uint64_t
+reference(uint64_t poly, unsigned width, const uint8_t *data, size_t len) {
+    uint64_t mask = width == 64 ? ~(uint64_t)0 : ((uint64_t)1 << width) - 1, crc = mask;
+
+    for (size_t i = 0; i < len; i++) {
+        crc ^= data[i];
+        for (int bit = 0; bit < 8; bit++) {
+            crc = crc & 1 ? (crc >> 1) ^ poly : crc >> 1;
+        }
+    }
+    return crc ^ mask;
+}
+
+void
+test_check_values(void) {
+    static const char check_string[] = "123456789";
+
+    puts("Testing the check values");
+    check(crc32c(0, check_string, 9) == 0xe3069283, "CRC-32C of \"123456789\"");
+    check(crc32_ieee(0, check_string, 9) == 0xcbf43926, "CRC-32 of \"123456789\"");
+    check(crc64_xz(0, check_string, 9) == 0x995dc9bbdf1939fa, "CRC-64/XZ of \"123456789\"");
+    check(!crc32c(0, NULL, 0) && !crc32_ieee(0, NULL, 0) && !crc64_xz(0, NULL, 0), "empty input");
+
+    uint8_t bytes[1024];
+    for (size_t i = 0; i < sizeof bytes; i++) {
+        bytes[i] = (uint8_t)i;
+    }
+    /* zlib.crc32(bytes(range(256)) * 4) */
+    check(crc32_ieee(0, bytes, sizeof bytes) == 0xb70b4c26, "same CRC-32 as zlib");
+}
+
+/* Every backend matches the definition for lengths and offsets around the blocks of each kernel */
+void
+test_backends(void) {
+    static const char *names[] = {"auto", "scalar", "SSE4.2", "PCLMUL"};
+    static const size_t lengths[] = {3 * 256 - 1, 3 * 256, 3 * 8192 + 777, 7 * 8192 + 3, DATA_SIZE - 3};
+
+    for (int backend = CRC_BACKEND_SCALAR; backend <= CRC_BACKEND_PCLMUL; backend++) {
+        size_t wrong = 0;
+
+        if (crc_set_backend(backend)) {
+            printf("Skipping the %s backend, not supported by the CPU\n", names[backend]);
+            continue;
+        }
+        printf("Testing the %s backend\n", names[backend]);
+
+        for (size_t offset = 0; offset < 4; offset++) {
+            for (size_t len = 0; len <= 1000; len++) {
+                const uint8_t *data = DATA + offset;
+
+                wrong += crc32c(0, data, len) != reference(0x82f63b78, 32, data, len);
+                wrong += crc32_ieee(0, data, len) != reference(0xedb88320, 32, data, len);
+                wrong += crc64_xz(0, data, len) != reference(0xc96c5795d7870f42, 64, data, len);
+            }
+        }
+        check(!wrong, "lengths of 0 to 1000 bytes at unaligned offsets");
+
+        for (size_t i = 0; i < sizeof lengths / sizeof *lengths; i++) {
+            wrong += crc32c(0, DATA + 3, lengths[i]) != reference(0x82f63b78, 32, DATA + 3, lengths[i]);
+            wrong += crc32_ieee(0, DATA + 3, lengths[i]) != reference(0xedb88320, 32, DATA + 3, lengths[i]);
+            wrong += crc64_xz(0, DATA + 3, lengths[i]) != reference(0xc96c5795d7870f42, 64, DATA + 3, lengths[i]);
+        }
+        check(!wrong, "long buffers");
+    }
+    crc_set_backend(CRC_BACKEND_AUTO);
+}
+
+void
+test_streaming(void) {
+    static const size_t pieces[] = {1, 13, 64, 255, 4096, 30000};
+    size_t wrong = 0;
+
+    puts("Testing streaming");
+    for (size_t p = 0; p < sizeof pieces / sizeof *pieces; p++) {
+        uint32_t c32c = 0, c32 = 0;
+        uint64_t c64 = 0;
+
+        for (size_t offset = 0; offset < DATA_SIZE; offset += pieces[p]) {
+            size_t len = DATA_SIZE - offset < pieces[p] ? DATA_SIZE - offset : pieces[p];
+
+            c32c = crc32c(c32c, DATA + offset, len);
+            c32 = crc32_ieee(c32, DATA + offset, len);
+            c64 = crc64_xz(c64, DATA + offset, len);
+        }
+        wrong += c32c != crc32c(0, DATA, DATA_SIZE);
+        wrong += c32 != crc32_ieee(0, DATA, DATA_SIZE);
+        wrong += c64 != crc64_xz(0, DATA, DATA_SIZE);
+    }
+    check(!wrong, "pieces of 1 to 30000 bytes");
+}
+
+void
+test_combine(void) {
+    uint64_t state = 7;
+    size_t wrong = 0;
+
+    puts("Testing combine");
+    for (size_t i = 0; i < 200; i++) {
+        size_t len = next_random(&state) % (DATA_SIZE + 1), split = next_random(&state) % (len + 1);
+        const uint8_t *second = DATA + split;
+
+        if (i < 10) {
+            split = i % 2 ? 0 : len;
+            second = DATA + split;
+        }
+        wrong += crc32c_combine(crc32c(0, DATA, split), crc32c(0, second, len - split), len - split) !=
+                 crc32c(0, DATA, len);
+        wrong += crc32_ieee_combine(crc32_ieee(0, DATA, split), crc32_ieee(0, second, len - split), len - split) !=
+                 crc32_ieee(0, DATA, len);
+        wrong += crc64_xz_combine(crc64_xz(0, DATA, split), crc64_xz(0, second, len - split), len - split) !=
+                 crc64_xz(0, DATA, len);
+    }
+    check(!wrong, "random splits");
+
+    /* 2^32 zero bytes by doubling a single one, then "abcde", as zlib.crc32 */
+    uint32_t zeros = crc32_ieee(0, "", 1);
+    for (int i = 0; i < 32; i++) {
+        zeros = crc32_ieee_combine(zeros, zeros, 1ull << i);
+    }
+    check(zeros == 0xd202ef8d && crc32_ieee_combine(zeros, crc32_ieee(0, "abcde", 5), 5) == 0xf2678edb,
+          "lengths above 4 GiB");
+}
+
+int
+main(void) {
+    uint64_t state = 0x9e3779b97f4a7c15;
+
+    for (size_t i = 0; i < DATA_SIZE; i++) {
+        DATA[i] = (uint8_t)next_random(&state);
+    }
+
+    test_check_values();
+    test_backends();
+    test_streaming();
+    test_combine();
+
+    fprintf(stderr, "%zu/%zu test cases passed\n", num_passed, num_tests);
+
+    return num_passed != num_tests;
+}
@@ -0,0 +1,298 @@
+#include "drbg.h"
+
+#include "batch.h"
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+#define ARRAY_LEN(array) ((sizeof(array)) / (sizeof *(array)))
+#define NUM_THREADS 4
+
+/* Inputs of the vectors, each is a run of consecutive bytes starting at the given one */
+static uint8_t ENTROPY[32];           /* 00 01 ... 1f */
+static uint8_t NONCE[8];              /* 20 21 ... 27 */
+static uint8_t PERSONALIZATION[16];   /* 40 41 ... 4f */
+static uint8_t ADDITIONAL_1[16];      /* 60 61 ... 6f */
+static uint8_t ADDITIONAL_2[16];      /* a0 a1 ... af */
+static uint8_t RESEED_ENTROPY[32];    /* 80 81 ... 9f */
+static uint8_t RESEED_ADDITIONAL[4];  /* c0 c1 c2 c3 */
+
+size_t num_tests = 0;
+size_t num_passed = 0;
+
+/*
+    Cases generated with OpenSSL's HASH-DRBG and HMAC-DRBG: instantiate, optionally reseed,
+    generate 64 bytes twice with the first and the second additional input, the second
+    output is expected.
+*/
+struct drbg_case {
+    char *name;
+    enum drbg_mechanism mechanism;
+    enum hash_algorithm algorithm;
+    int personalization;  /* Use PERSONALIZATION and the additional inputs */
+    int reseed;
+    char *expected;
+};
+
+static struct drbg_case test_case_drbg[] = {
+    {"Hash_DRBG SHA-256", DRBG_HASH, HASH_SHA2_256, 0, 0,
+     "e482702b528a40c269528a0f43e192bac90314c702c29b5e647bc3b32b95dcb3"
+     "07432ca74464432d696da1fd26cdff4e6cb0fc7432f26d6e22f9d7e6bff48c94"},
+    {"Hash_DRBG SHA-256 personalized", DRBG_HASH, HASH_SHA2_256, 1, 0,
+     "81e035b1fc25c827118058dccc77074b4366c87c894c04e31ec17c0087adcbb9"
+     "a77e9a92107c8d560ad97a758e60f90c02ee0f4fd584080d28f32cbaacaf9438"},
+    {"Hash_DRBG SHA-256 reseeded", DRBG_HASH, HASH_SHA2_256, 1, 1,
+     "c751e5633beebc3a68645ec8df67679d8616c191060c8c606cf219dd7546291c"
+     "639080d03ea3e466eb6f0fb2bb28a806f873a71570913d2e1545a72f11bd7186"},
+    {"Hash_DRBG SHA-512", DRBG_HASH, HASH_SHA2_512, 0, 0,
+     "1f4587410b9f8d3e905f80b87e29313f0e4f77f7afc60e582fb01c47db4f16c2"
+     "e425d20eefd6b6d5dd90d9452afab55a749c31b91e62d5cabdb7b391e4f79f87"},
+    {"Hash_DRBG SHA-512 personalized", DRBG_HASH, HASH_SHA2_512, 1, 0,
+     "b9c53169f5e5fe56282f0d328b7b4ab595a7f63b3fef349dba5812a025bf4534"
+     "51e903ba86e12f884724d4d6a4ac444c93537a7a83acedc75bd59942a8847119"},
+    {"Hash_DRBG SHA-512 reseeded", DRBG_HASH, HASH_SHA2_512, 1, 1,
+     "e0236c31bb49eb78c6a86dc148a3dc713393b195a283d614b16f273b821704c8"
+     "40b1f07409dbc3d658c499f49b574c01e90bfe2ae0ece915b24a24390eef675d"},
+    {"HMAC_DRBG SHA-256", DRBG_HMAC, HASH_SHA2_256, 0, 0,
+     "d3f5f34239b276586fa3d74a84d2f84cc355a60e133c577e8d1bb63ab563440c"
+     "69a0a0e8d124ac7f45acdc71ab270cdf15589c0b0b39b14ff19f5828de755fad"},
+    {"HMAC_DRBG SHA-256 personalized", DRBG_HMAC, HASH_SHA2_256, 1, 0,
+     "9a2c50fb500a87d27f4fe744dacca925b2105c101923f4301b214ada2aed448e"
+     "eb65c2884dfc5f1d7d5a96693e845963ee1e08e4a614163431c8b369696a8f4e"},
+    {"HMAC_DRBG SHA-256 reseeded", DRBG_HMAC, HASH_SHA2_256, 1, 1,
+     "9260b18e59db5f075be36e9b1b98c27513eb19ca133d8c90332c5a9529d8ebf0"
+     "8f6a7572d34d7333a6301e9ddf6dc25c966291bd7c0e1bb735d0b59210c7c52b"},
+    {"HMAC_DRBG SHA-512", DRBG_HMAC, HASH_SHA2_512, 0, 0,
+     "ca65831dd9f40d710c98b8a4e09d2d98d05880a589c47bb8039e042d0c5ec9c9"
+     "d922279f6b3e39a0079920cae814483424b21fde054fb99ef85793b17ccd0786"},
+    {"HMAC_DRBG SHA-512 personalized", DRBG_HMAC, HASH_SHA2_512, 1, 0,
+     "f6b7faedac46f19178d2b99a5fd532a6fea74ec6d20242d86bb4f1e0b21ce86d"
+     "95085e3fbdfdb67f5b4de494ed1d567fc7636d8acfd90ec237629d8b6f933cd8"},
+    {"HMAC_DRBG SHA-512 reseeded", DRBG_HMAC, HASH_SHA2_512, 1, 1,
+     "e80a7ba11ee8137dfc3ccfbcb4426e5d5a179dab11926ce8eef90e6ff59ba230"
+     "38f26d7eca1e46dfc38616a05897ef94a92bfd9da05b7023db2f9c75e7174d78"},
+};
+
+/* The last 32 bytes of the second 3000-byte output, without personalization */
+static struct drbg_case test_case_long[] = {
+    {"Hash_DRBG SHA-256", DRBG_HASH, HASH_SHA2_256, 0, 0,
+     "2c163b2bedd71be1c763a183ef5701eb8d69032237649b3105f7690810768b87"},
+    {"Hash_DRBG SHA-512", DRBG_HASH, HASH_SHA2_512, 0, 0,
+     "4425163c8a8f6202d37686f62d21ce55044978d3ff79747956adc3fccfc57a2b"},
+    {"HMAC_DRBG SHA-256", DRBG_HMAC, HASH_SHA2_256, 0, 0,
+     "4662e9e7812a729dcb92e435124e78d2815b5744684324bdbfb7d728c6f49a02"},
+    {"HMAC_DRBG SHA-512", DRBG_HMAC, HASH_SHA2_512, 0, 0,
+     "28c34538b6f1608f334453dc262ccbda64c4c6d70a7e55023fdf618a7e2abdb3"},
+};
+
+static void
+check(int passed, const char *name) {
+    num_tests++;
+    if (passed) {
+        printf("\t[PASSED]: %s\n", name);
+        num_passed++;
+    } else {
+        printf("\t[FAILED] %s\n", name);
+    }
+}
+
+/* Format `out` as hex and compare */
+static void
+check_bytes(const char *name, const uint8_t *out, size_t len, const char *expected) {
+    char hex[129];
+
+    num_tests++;
+    for (size_t i = 0; i < len; i++) {
+        sprintf(hex + 2 * i, "%02x", out[i]);
+    }
+    hex[2 * len] = '\0';
+
+    if (strcmp(hex, expected)) {
+        printf("\t[FAILED] %s: expected '%s' got '%s'\n", name, expected, hex);
+    } else {
+        printf("\t[PASSED]: %s\n", name);
+        num_passed++;
+    }
+}
+
+static void
+fill(uint8_t *data, size_t len, uint8_t first) {
+    for (size_t i = 0; i < len; i++) {
+        data[i] = (uint8_t)(first + i);
+    }
+}
+
+/* Run the two requests of a case, `out` receives the second */
+static void
+run_case(const struct drbg_case *_case, uint8_t *out, size_t len) {
+    struct drbg drbg;
+
+    drbg_init(&drbg, _case->mechanism, _case->algorithm, ENTROPY, sizeof ENTROPY, NONCE, sizeof NONCE,
+              PERSONALIZATION, _case->personalization ? sizeof PERSONALIZATION : 0);
+    if (_case->reseed) {
+        drbg_reseed(&drbg, RESEED_ENTROPY, sizeof RESEED_ENTROPY, RESEED_ADDITIONAL, sizeof RESEED_ADDITIONAL);
+    }
+    drbg_generate(&drbg, out, len, ADDITIONAL_1, _case->personalization ? sizeof ADDITIONAL_1 : 0);
+    drbg_generate(&drbg, out, len, ADDITIONAL_2, _case->personalization ? sizeof ADDITIONAL_2 : 0);
+    drbg_clear(&drbg);
+}
+
+/* The SHA-256 Hash_DRBG is run on every multi-buffer engine the CPU has */
+void
+test_vectors(void) {
+    static const enum hash_mb_backend backends[] = {HASH_MB_SERIAL, HASH_MB_AVX2, HASH_MB_AVX512};
+    static const char *names[] = {"serial", "AVX2", "AVX-512"};
+    enum hash_mb_backend saved = hash_mb_get_backend();
+    uint8_t out[3000];
+
+    for (size_t b = 0; b < ARRAY_LEN(backends); b++) {
+        if (hash_mb_set_backend(backends[b])) {
+            printf("Skipping the %s backend, not supported by the CPU\n", names[b]);
+            continue;
+        }
+
+        printf("Testing drbg with the %s backend\n", names[b]);
+        for (size_t i = 0; i < ARRAY_LEN(test_case_drbg); i++) {
+            run_case(&test_case_drbg[i], out, 64);
+            check_bytes(test_case_drbg[i].name, out, 64, test_case_drbg[i].expected);
+        }
+        for (size_t i = 0; i < ARRAY_LEN(test_case_long); i++) {
+            run_case(&test_case_long[i], out, sizeof out);
+            check_bytes(test_case_long[i].name, out + sizeof out - 32, 32, test_case_long[i].expected);
+        }
+    }
+    hash_mb_set_backend(saved);
+}
+
+void
+test_errors(void) {
+    static uint8_t out[DRBG_MAX_REQUEST + 1];
+    struct drbg drbg;
+
+    puts("Testing errors");
+    check(drbg_init(&drbg, DRBG_HASH, HASH_SHA1, ENTROPY, sizeof ENTROPY, NULL, 0, NULL, 0) == -1,
+          "unsupported hash function");
+    check(drbg_init(&drbg, (enum drbg_mechanism)2, HASH_SHA2_256, ENTROPY, sizeof ENTROPY, NULL, 0, NULL, 0) == -1,
+          "unsupported mechanism");
+
+    drbg_init(&drbg, DRBG_HASH, HASH_SHA2_256, ENTROPY, sizeof ENTROPY, NULL, 0, NULL, 0);
+    check(drbg_generate(&drbg, out, DRBG_MAX_REQUEST, NULL, 0) == 0, "largest request");
+    check(drbg_generate(&drbg, out, DRBG_MAX_REQUEST + 1, NULL, 0) == -1, "too large request is rejected");
+    drbg.reseed_counter = DRBG_RESEED_INTERVAL + 1;
+    check(drbg_generate(&drbg, out, 1, NULL, 0) == -1, "reseed is required");
+    drbg_reseed(&drbg, RESEED_ENTROPY, sizeof RESEED_ENTROPY, NULL, 0);
+    check(drbg_generate(&drbg, out, 1, NULL, 0) == 0, "reseed resets the counter");
+    drbg_clear(&drbg);
+
+    drbg_thread_clear();
+    check(drbg_thread_bytes(out, 1) == -1, "thread without a generator");
+}
+
+/*
+    Reads of the per-thread generator in pieces of varied sizes, some larger than the buffer,
+    give the stream of plain requests of DRBG_MAX_REQUEST bytes.
+*/
+static int
+thread_stream_matches(enum drbg_mechanism mechanism, const void *personalization, size_t personalization_len) {
+    static const size_t pieces[] = {1, 7, 64, 1000, DRBG_MAX_REQUEST - 1, 3 * DRBG_MAX_REQUEST + 5, 33};
+    size_t total = 0;
+    uint8_t *expected, *actual;
+    struct drbg drbg;
+    int passed = 1;
+
+    for (size_t i = 0; i < ARRAY_LEN(pieces); i++) {
+        total += pieces[i];
+    }
+    total = (total + DRBG_MAX_REQUEST - 1) / DRBG_MAX_REQUEST * DRBG_MAX_REQUEST;
+    expected = malloc(total);
+    actual = malloc(total);
+
+    drbg_init(&drbg, mechanism, HASH_SHA2_256, ENTROPY, sizeof ENTROPY, NULL, 0, personalization,
+              personalization_len);
+    for (size_t done = 0; done < total; done += DRBG_MAX_REQUEST) {
+        drbg_generate(&drbg, expected + done, DRBG_MAX_REQUEST, NULL, 0);
+    }
+
+    if (drbg_thread_init(mechanism, HASH_SHA2_256, ENTROPY, sizeof ENTROPY, personalization, personalization_len)) {
+        passed = 0;
+    }
+    total = 0;
+    for (size_t i = 0; i < ARRAY_LEN(pieces) && passed; i++) {
+        passed = !drbg_thread_bytes(actual + total, pieces[i]) && !memcmp(actual + total, expected + total, pieces[i]);
+        total += pieces[i];
+    }
+
+    drbg_clear(&drbg);
+    free(expected);
+    free(actual);
+    return passed;
+}
+
+static void *
+worker(void *arg) {
+    int id = (int)(intptr_t)arg;
+
+    return (void *)(intptr_t)thread_stream_matches(DRBG_HASH, &id, sizeof id);
+}
+
+void
+test_threads(void) {
+    static uint8_t expected[DRBG_MAX_REQUEST];
+    pthread_t threads[NUM_THREADS];
+    uint8_t first[16], second[16];
+    struct drbg drbg;
+    int passed = 1;
+
+    puts("Testing per-thread generators");
+    check(thread_stream_matches(DRBG_HASH, NULL, 0), "Hash_DRBG stream is independent of the read sizes");
+    check(thread_stream_matches(DRBG_HMAC, NULL, 0), "HMAC_DRBG stream is independent of the read sizes");
+
+    drbg_init(&drbg, DRBG_HMAC, HASH_SHA2_512, ENTROPY, sizeof ENTROPY, NULL, 0, NULL, 0);
+    drbg_generate(&drbg, expected, sizeof expected, NULL, 0);
+    drbg_clear(&drbg);
+
+    drbg_thread_init(DRBG_HMAC, HASH_SHA2_512, ENTROPY, sizeof ENTROPY, NULL, 0);
+    drbg_thread_bytes(first, sizeof first);
+    drbg_thread_init(DRBG_HMAC, HASH_SHA2_512, ENTROPY, sizeof ENTROPY, NULL, 0);
+    drbg_thread_bytes(first, sizeof first);
+    check(!memcmp(first, expected, sizeof first), "init restarts the stream");
+
+    for (int i = 0; i < NUM_THREADS; i++) {
+        pthread_create(&threads[i], NULL, worker, (void *)(intptr_t)i);
+    }
+    for (int i = 0; i < NUM_THREADS; i++) {
+        void *result;
+
+        pthread_join(threads[i], &result);
+        passed &= (int)(intptr_t)result;
+    }
+    check(passed, "threads read their own streams concurrently");
+
+    drbg_thread_bytes(second, sizeof second);
+    check(!memcmp(second, expected + sizeof first, sizeof second), "other threads leave the stream alone");
+    drbg_thread_clear();
+}
+
+int
+main(void) {
+    fill(ENTROPY, sizeof ENTROPY, 0x00);
+    fill(NONCE, sizeof NONCE, 0x20);
+    fill(PERSONALIZATION, sizeof PERSONALIZATION, 0x40);
+    fill(ADDITIONAL_1, sizeof ADDITIONAL_1, 0x60);
+    fill(ADDITIONAL_2, sizeof ADDITIONAL_2, 0xa0);
+    fill(RESEED_ENTROPY, sizeof RESEED_ENTROPY, 0x80);
+    fill(RESEED_ADDITIONAL, sizeof RESEED_ADDITIONAL, 0xc0);
+
+    test_vectors();
+    test_errors();
+    test_threads();
+
+    fprintf(stderr, "%zu/%zu test cases passed\n", num_passed, num_tests);
+
+    return num_passed != num_tests;
+}
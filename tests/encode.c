@@ -0,0 +1,234 @@
+#include "encode.h"
+
+#include "sha.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+
+static uint8_t DATA[300];
+
+static const char *ABC_DIGESTS[] = {
+    [HASH_SHA1] = "a9993e364706816aba3e25717850c26c9cd0d89d",
+    [HASH_SHA2_224] = "23097d223405d8228642a477bda255b32aadbce4bda0b3f7e36c9da7",
+    [HASH_SHA2_256] = "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad",
+    [HASH_SHA2_384] = "cb00753f45a35e8bb5a03d699ac65007272c32ab0eded1631a8b605a43ff5bed"
+                      "8086072ba1e7cc2358baeca134c825a7",
+    [HASH_SHA2_512] = "ddaf35a193617abacc417349ae20413112e6fa4e89a97ea20a9eeee64b55d39a"
+                      "2192992a274fc1a836ba3c23a3feebbd454d4423643ce80e2a9ac94fa54ca49f",
+    [HASH_SHA3_224] = "e642824c3f8cf24ad09234ee7d3c766fc9a3a5168d0c94ad73b46fdf",
+    [HASH_SHA3_256] = "3a985da74fe225b2045c172d6bd390bd855f086e3e9d525b46bfe24511431532",
+    [HASH_SHA3_384] = "ec01498288516fc926459f58e2c6ad8df9b473cb0fc08c2596da7cf0e49be4b2"
+                      "98d88cea927ac7f539f1edf228376d25",
+    [HASH_SHA3_512] = "b751850b1a57168a5693cd924b6b096e08f621827444f70d884f5d0240d2712e"
+                      "10e116e9192af3c91a7ec57647e3934057340b4cf408d5a56592f8274eec53f0",
+    [HASH_SHA2_512_224] = "4634270f707b6a54daae7530460842e20e37ed265ceee9a43e8924aa",
+    [HASH_SHA2_512_256] = "53048e2681941ef99b2e29b76b4c7dabe4c2d0c634fc6d46e0e2f13107e7af23",
+};
+
+size_t num_tests = 0;
+size_t num_passed = 0;
+
+static void
+check(int passed, const char *name) {
+    num_tests++;
+    if (passed) {
+        printf("\t[PASSED]: %s\n", name);
+        num_passed++;
+    } else {
+        printf("\t[FAILED] %s\n", name);
+    }
+}
+
+/* Straightforward encoders to compare the library against */
+static void
+reference_hex(const uint8_t *data, size_t len, char *hex) {
+    for (size_t i = 0; i < len; i++) {
+        sprintf(hex + 2 * i, "%02x", data[i]);
+    }
+    hex[2 * len] = '\0';
+}
+
+static void
+reference_base64(const uint8_t *data, size_t len, char *base64) {
+    static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    size_t out = 0;
+
+    for (size_t i = 0; i < len; i += 3) {
+        uint32_t x = (uint32_t)data[i] << 16;
+        x |= i + 1 < len ? (uint32_t)data[i + 1] << 8 : 0;
+        x |= i + 2 < len ? data[i + 2] : 0;
+        base64[out++] = alphabet[x >> 18];
+        base64[out++] = alphabet[(x >> 12) & 0x3f];
+        base64[out++] = i + 1 < len ? alphabet[(x >> 6) & 0x3f] : '=';
+        base64[out++] = i + 2 < len ? alphabet[x & 0x3f] : '=';
+    }
+    base64[out] = '\0';
+}
+
+void
+test_digests(void) {
+    static const char *names[] = {"SHA-1",    "SHA-224",  "SHA-256",  "SHA-384",     "SHA-512",    "SHA3-224",
+                                  "SHA3-256", "SHA3-384", "SHA3-512", "SHA-512/224", "SHA-512/256"};
+    uint8_t digest[HASH_MAX_DIGEST_SIZE];
+    char hex[HEX_ENCODED_LEN(HASH_MAX_DIGEST_SIZE) + 1];
+    char name[64];
+
+    puts("Testing hash_digest");
+    for (int algorithm = HASH_SHA1; algorithm <= HASH_SHA2_512_256; algorithm++) {
+        size_t size = hash_digest_size(algorithm);
+
+        hash_digest(algorithm, "abc", 3, digest);
+        hex_encode(digest, size, hex);
+        snprintf(name, sizeof name, "%s digest of \"abc\"", names[algorithm]);
+        check(size == strlen(ABC_DIGESTS[algorithm]) / 2 && !strcmp(hex, ABC_DIGESTS[algorithm]), name);
+    }
+
+    check(hash_digest_size((enum hash_algorithm)255) == 0, "unknown algorithm has no size");
+    check(hash_digest((enum hash_algorithm)255, "abc", 3, digest) == -1, "unknown algorithm is rejected");
+
+    uint32_t words[8];
+    sha2_256_data("abc", 3, words);
+    hash_digest_bytes(HASH_SHA2_256, words, digest);
+    hex_encode(digest, 32, hex);
+    check(!strcmp(hex, ABC_DIGESTS[HASH_SHA2_256]), "hash_digest_bytes of sha2_256_data words");
+}
+
+/* Every backend has to give the output of the reference, and reject what the scalar code rejects */
+void
+test_backends(void) {
+    static const char *names[] = {"auto", "scalar", "SSSE3", "AVX2"};
+    char expected[2 * sizeof DATA + 1], encoded[2 * sizeof DATA + 1], name[64];
+    uint8_t decoded[sizeof DATA + 16];
+
+    for (int backend = ENCODE_BACKEND_SCALAR; backend <= ENCODE_BACKEND_AVX2; backend++) {
+        size_t hex_errors = 0, base64_errors = 0, accepted = 0;
+
+        if (encode_set_backend(backend)) {
+            printf("Skipping the %s backend, not supported by the CPU\n", names[backend]);
+            continue;
+        }
+        printf("Testing the %s backend\n", names[backend]);
+
+        for (size_t len = 0; len <= sizeof DATA; len++) {
+            size_t decoded_len = 0;
+
+            reference_hex(DATA, len, expected);
+            hex_encode(DATA, len, encoded);
+            hex_errors += strcmp(encoded, expected) != 0;
+            memset(decoded, 0, sizeof decoded);
+            hex_errors += hex_decode(encoded, 2 * len, decoded) || memcmp(decoded, DATA, len);
+
+            reference_base64(DATA, len, expected);
+            base64_errors += base64_encode(DATA, len, encoded) != strlen(expected) || strcmp(encoded, expected);
+            memset(decoded, 0, sizeof decoded);
+            base64_errors += base64_decode(encoded, strlen(encoded), decoded, &decoded_len) || decoded_len != len ||
+                             memcmp(decoded, DATA, len);
+        }
+        snprintf(name, sizeof name, "hex of 0 to %zu bytes", sizeof DATA);
+        check(!hex_errors, name);
+        snprintf(name, sizeof name, "base64 of 0 to %zu bytes", sizeof DATA);
+        check(!base64_errors, name);
+
+        /* Upper case digits decode to the same bytes */
+        reference_hex(DATA, 100, expected);
+        for (size_t i = 0; i < 200; i++) {
+            encoded[i] = expected[i] >= 'a' ? expected[i] - 32 : expected[i];
+        }
+        check(!hex_decode(encoded, 200, decoded) && !memcmp(decoded, DATA, 100), "upper case hex");
+
+        /* A bad character anywhere in a long input, inside or past the SIMD blocks */
+        for (size_t i = 0; i < 200; i++) {
+            static const char bad[] = {'g', 'G', '/', ':', '@', '`', ' ', '\0', (char)0xb0};
+            memcpy(encoded, expected, 200);
+            encoded[i] = bad[i % sizeof bad];
+            accepted += !hex_decode(encoded, 200, decoded);
+        }
+        check(!accepted && hex_decode(expected, 199, decoded) == -1, "invalid hex is rejected");
+
+        reference_base64(DATA, 150, expected);
+        accepted = 0;
+        for (size_t i = 0; i < 200; i++) {
+            static const char bad[] = {'-', '_', '=', '.', ' ', '\0', (char)0xc3, '*', '[', '{'};
+            size_t decoded_len;
+            memcpy(encoded, expected, 200);
+            encoded[i] = bad[i % sizeof bad];
+            accepted += !base64_decode(encoded, 200, decoded, &decoded_len);
+        }
+        check(!accepted, "invalid base64 is rejected");
+    }
+    encode_set_backend(ENCODE_BACKEND_AUTO);
+}
+
+void
+test_base64(void) {
+    static const char *vectors[][2] = {
+        {"", ""}, {"f", "Zg=="}, {"fo", "Zm8="}, {"foo", "Zm9v"}, {"foob", "Zm9vYg=="}, {"fooba", "Zm9vYmE="},
+        {"foobar", "Zm9vYmFy"},
+    };
+    static const char *invalid[] = {"Zg=", "Zh==", "Zm9=", "Zg=a", "=Zg=", "Z===", "Zg==Zg==", "Zm9v\n"};
+    char encoded[16];
+    uint8_t decoded[16];
+    size_t decoded_len, failures = 0, accepted = 0;
+
+    puts("Testing base64 against RFC 4648");
+    for (size_t i = 0; i < sizeof vectors / sizeof *vectors; i++) {
+        size_t len = strlen(vectors[i][0]);
+        failures += base64_encode(vectors[i][0], len, encoded) != strlen(vectors[i][1]);
+        failures += strcmp(encoded, vectors[i][1]) != 0;
+        failures += base64_decode(vectors[i][1], strlen(vectors[i][1]), decoded, &decoded_len) != 0;
+        failures += decoded_len != len || memcmp(decoded, vectors[i][0], len);
+    }
+    check(!failures, "test vectors");
+
+    for (size_t i = 0; i < sizeof invalid / sizeof *invalid; i++) {
+        accepted += !base64_decode(invalid[i], strlen(invalid[i]), decoded, &decoded_len);
+    }
+    check(!accepted, "bad padding and non-canonical encodings are rejected");
+}
+
+void
+test_compare(void) {
+    uint8_t a[100 * 32], b[100 * 32], equal[100];
+    size_t wrong = 0;
+
+    puts("Testing hash_digest_compare");
+    for (size_t i = 0; i < 100; i++) {
+        hash_digest(HASH_SHA2_256, &i, sizeof i, a + 32 * i);
+    }
+    memcpy(b, a, sizeof a);
+    for (size_t i = 0; i < 100; i += 7) {
+        b[32 * i + i % 32] ^= 1 << (i % 8);
+    }
+
+    check(hash_digest_compare(a, b, 32, 100, equal) == 15, "counts the mismatches");
+    for (size_t i = 0; i < 100; i++) {
+        wrong += equal[i] != (i % 7 != 0);
+    }
+    check(!wrong, "flags each pair");
+    check(hash_digest_compare(a, a, 32, 100, NULL) == 0, "equal arrays");
+    check(hash_digest_compare(a, b, 20, 0, NULL) == 0, "empty arrays");
+
+    check(hash_digest_equal(a + 32, b + 32, 32) && !hash_digest_equal(a, b, 32), "hash_digest_equal");
+    check(hash_digest_equal(a, b, 0), "empty digests are equal");
+    check(!hash_digest_equal(a + 32 * 7, b + 32 * 7, 13) && hash_digest_equal(a + 32 * 7, b + 32 * 7, 7),
+          "odd lengths");
+}
+
+int
+main(void) {
+    for (size_t i = 0; i < sizeof DATA; i++) {
+        DATA[i] = (uint8_t)(i * 151 + (i >> 3));
+    }
+
+    test_digests();
+    test_backends();
+    test_base64();
+    test_compare();
+
+    fprintf(stderr, "%zu/%zu test cases passed\n", num_passed, num_tests);
+
+    return num_passed != num_tests;
+}
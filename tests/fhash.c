@@ -0,0 +1,243 @@
+#include "fhash.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+#define NUM_KEYS 1000000
+
+static uint8_t DATA[3000];
+
+/* Hashes of the first `len` bytes of DATA, the definition of the functions must not change */
+static const struct {
+    size_t len;
+    uint64_t seed;
+    uint64_t hash64;
+    struct fhash128 hash128;
+} KNOWN[] = {
+    {0, 0, 0x54591c848288725d, {0xc810c49f53303c75, 0x1b29989b6afce31c}},
+    {1, 0, 0xbac8e2a51a253297, {0xbac8e2a51a253297, 0xfca5feafbe94aacf}},
+    {3, 0, 0xc03a65338a727890, {0xc03a65338a727890, 0x4bfbbe0cbe2635f3}},
+    {4, 0, 0xf03641d6f53f92dc, {0x25d16436145b5878, 0xe202a33863e6007d}},
+    {8, 0, 0x29f4f046863ca845, {0x24394e1c13c7cdaf, 0x11631501042667c9}},
+    {9, 0, 0x4f09b73107ada25f, {0xad902dbf4f36590f, 0xe96406a4f35e5c1d}},
+    {16, 0, 0xf8dcd7bb2e754d45, {0x8e0bde315872fcfa, 0x8f4ed08260b01035}},
+    {17, 0, 0x183d4f53cf58f541, {0x19020430ba734b4b, 0x3439ceb780d20ced}},
+    {33, 0, 0xbbd428907a3f248e, {0xcda1f9c696dfce90, 0x718a657735bdcfcf}},
+    {65, 0, 0x301be72002a6563b, {0x19f0390bd8392f23, 0xee1a630e11383904}},
+    {97, 0, 0x03c88ee57a028834, {0x2330aab2f9d3efa1, 0x0cf6befed98904a0}},
+    {128, 0, 0xc04c73b45e6c3b74, {0xbc630ddbc72196b4, 0x0623b060e6bce7c2}},
+    {129, 0, 0x207ee3365be58d9b, {0x2d615497d2739912, 0x57efb77cfd35ac41}},
+    {200, 0, 0xcce551b9a74afe80, {0xfcfede4e142ce03a, 0xd9848fb0ac2a0e15}},
+    {240, 0, 0x34851477e08ef9fa, {0x7b5d987c53593423, 0x2e911f215b563369}},
+    {241, 0, 0xc036dacf25ca3d1f, {0xc036dacf25ca3d1f, 0x9429eae377a72d8c}},
+    {1024, 0, 0xbe676e623ed1fc17, {0xbe676e623ed1fc17, 0x75bbb6149457d81d}},
+    {1087, 0, 0xe39dda515a6a803c, {0xe39dda515a6a803c, 0x88369f9878137f1c}},
+    {3000, 0, 0x372de20de2505d36, {0x372de20de2505d36, 0x420c756dcffa46c1}},
+    {0, 0x9e3779b97f4a7c15, 0x2b51c4360e9f89ff, {0xa62146931882de67, 0x56221c8fc4c04c9b}},
+    {2, 0x9e3779b97f4a7c15, 0xbc3df6a1a1f5e3af, {0xbc3df6a1a1f5e3af, 0xcc2d51866fd1fa8b}},
+    {7, 0x9e3779b97f4a7c15, 0x5f270034a95727b6, {0x09fd59e8cc6bf6bb, 0xc356a3680f70a887}},
+    {12, 0x9e3779b97f4a7c15, 0xe5fb3b1bcaea2395, {0x0a63280a77b8c01e, 0x9cc0f35c3e162db6}},
+    {50, 0x9e3779b97f4a7c15, 0x337ad08af510d7ee, {0x1b6468e93fd1a548, 0x164ceac22fe7dd7a}},
+    {150, 0x9e3779b97f4a7c15, 0xe77eb9d4d228cb06, {0x900a8b4c9064f3d2, 0xb5c5cdb8fbb3fbef}},
+    {3000, 0x9e3779b97f4a7c15, 0xdfe0df10776b7f44, {0xdfe0df10776b7f44, 0x7060047705e941c6}},
+};
+
+size_t num_tests = 0;
+size_t num_passed = 0;
+
+static void
+check(int passed, const char *name) {
+    num_tests++;
+    if (passed) {
+        printf("\t[PASSED]: %s\n", name);
+        num_passed++;
+    } else {
+        printf("\t[FAILED] %s\n", name);
+    }
+}
+
+static uint64_t
+next_random(uint64_t *state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return *state;
+}
+
+static int
+equal128(struct fhash128 a, struct fhash128 b) {
+    return a.low == b.low && a.high == b.high;
+}
+
+static int
+compare_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+void
+test_known(void) {
+    size_t wrong = 0;
+
+    puts("Testing known hashes");
+    for (size_t i = 0; i < sizeof KNOWN / sizeof *KNOWN; i++) {
+        wrong += fhash64(DATA, KNOWN[i].len, KNOWN[i].seed) != KNOWN[i].hash64;
+        wrong += !equal128(fhash128(DATA, KNOWN[i].len, KNOWN[i].seed), KNOWN[i].hash128);
+    }
+    check(!wrong, "hashes of 0 to 3000 bytes");
+}
+
+/* Pieces of every size give the hash of the whole message, across the buffer and the blocks */
+void
+test_streaming(void) {
+    static const size_t pieces[] = {1, 7, 64, 100, 255, 256, 257, 1000};
+    size_t wrong = 0;
+
+    puts("Testing streaming");
+    for (size_t p = 0; p < sizeof pieces / sizeof *pieces; p++) {
+        for (size_t len = 0; len <= 2100; len += len < 300 ? 1 : 13) {
+            uint64_t seed = len % 3 ? 0 : 0x1234567890abcdef * len;
+            struct fhash_ctx ctx;
+
+            fhash_init(&ctx, seed);
+            for (size_t offset = 0; offset < len; offset += pieces[p]) {
+                fhash_update(&ctx, DATA + offset, len - offset < pieces[p] ? len - offset : pieces[p]);
+            }
+            wrong += fhash64_final(&ctx) != fhash64(DATA, len, seed);
+            wrong += !equal128(fhash128_final(&ctx), fhash128(DATA, len, seed));
+        }
+    }
+    check(!wrong, "pieces of 1 to 1000 bytes");
+
+    struct fhash_ctx ctx;
+    fhash_init(&ctx, 99);
+    fhash_update(&ctx, DATA, 1000);
+    wrong += fhash64_final(&ctx) != fhash64(DATA, 1000, 99);
+    fhash_update(&ctx, DATA + 1000, 2000);
+    wrong += fhash64_final(&ctx) != fhash64(DATA, 3000, 99);
+    check(!wrong, "final leaves the context as it is");
+}
+
+void
+test_backends(void) {
+    static const char *names[] = {"auto", "scalar", "SSE2", "AVX2"};
+    uint64_t expected64[sizeof DATA + 1];
+    struct fhash128 expected128[sizeof DATA + 1];
+
+    fhash_set_backend(FHASH_BACKEND_SCALAR);
+    for (size_t len = 0; len <= sizeof DATA; len++) {
+        expected64[len] = fhash64(DATA, len, len);
+        expected128[len] = fhash128(DATA, len, len);
+    }
+
+    for (int backend = FHASH_BACKEND_SSE2; backend <= FHASH_BACKEND_AVX2; backend++) {
+        size_t wrong = 0;
+
+        if (fhash_set_backend(backend)) {
+            printf("Skipping the %s backend, not supported by the CPU\n", names[backend]);
+            continue;
+        }
+        printf("Testing the %s backend\n", names[backend]);
+
+        for (size_t len = 0; len <= sizeof DATA; len++) {
+            wrong += fhash64(DATA, len, len) != expected64[len];
+            wrong += !equal128(fhash128(DATA, len, len), expected128[len]);
+        }
+        check(!wrong, "same hashes as the scalar code");
+    }
+    fhash_set_backend(FHASH_BACKEND_AUTO);
+}
+
+/* Flipping any input bit flips every output bit with a probability close to 1/2 */
+void
+test_avalanche(void) {
+    static const size_t lengths[] = {1, 3, 4, 8, 9, 16, 17, 100, 128, 129, 240, 241, 1000};
+    uint64_t state = 1;
+    char name[64];
+
+    puts("Testing the avalanche");
+    for (size_t l = 0; l < sizeof lengths / sizeof *lengths; l++) {
+        size_t len = lengths[l], flips = 0, trials = 0, worst = 0;
+        size_t counts[192] = {0};
+        uint8_t key[1000];
+
+        for (size_t t = 0; t < 20000 / len + 20; t++) {
+            for (size_t i = 0; i < len; i++) {
+                key[i] = (uint8_t)next_random(&state);
+            }
+            uint64_t seed = next_random(&state);
+            uint64_t h = fhash64(key, len, seed);
+            struct fhash128 h128 = fhash128(key, len, seed);
+
+            for (size_t bit = 0; bit < 8 * len; bit++) {
+                key[bit / 8] ^= 1 << (bit % 8);
+                uint64_t d = fhash64(key, len, seed) ^ h;
+                struct fhash128 d128 = fhash128(key, len, seed);
+                key[bit / 8] ^= 1 << (bit % 8);
+
+                d128.low ^= h128.low;
+                d128.high ^= h128.high;
+                for (size_t j = 0; j < 64; j++) {
+                    counts[j] += (d >> j) & 1;
+                    counts[64 + j] += (d128.low >> j) & 1;
+                    counts[128 + j] += (d128.high >> j) & 1;
+                }
+                flips += (size_t)__builtin_popcountll(d);
+                trials++;
+            }
+        }
+        for (size_t j = 0; j < 192; j++) {
+            size_t bias = counts[j] > trials / 2 ? counts[j] - trials / 2 : trials / 2 - counts[j];
+            worst = bias > worst ? bias : worst;
+        }
+        snprintf(name, sizeof name, "%zu bytes, %.2f bits flip, worst bias %.3f", len, (double)flips / trials,
+                 (double)worst / trials);
+        check(flips > 31 * trials && flips < 33 * trials && worst < trials / 20, name);
+    }
+}
+
+void
+test_keys(void) {
+    uint64_t *hashes = malloc(NUM_KEYS * sizeof *hashes);
+    size_t collisions = 0, equal = 0;
+
+    puts("Testing keys");
+    for (uint64_t i = 0; i < NUM_KEYS; i++) {
+        hashes[i] = fhash64(&i, sizeof i, 0);
+    }
+    qsort(hashes, NUM_KEYS, sizeof *hashes, compare_u64);
+    for (size_t i = 1; i < NUM_KEYS; i++) {
+        collisions += hashes[i] == hashes[i - 1];
+    }
+    check(!collisions, "no collisions between a million integer keys");
+
+    for (size_t len = 0; len <= 1000; len++) {
+        equal += fhash64(DATA, len, 0) == fhash64(DATA, len, 1);
+        equal += fhash64(DATA, len, 1) == fhash64(DATA, len, 1ull << 63);
+        equal += fhash128(DATA, len, 0).high == fhash128(DATA, len, 1).high;
+        equal += fhash64(DATA, len, 0) == fhash64(DATA, len + 1, 0);
+    }
+    check(!equal, "seeds and lengths change the hash");
+    free(hashes);
+}
+
+int
+main(void) {
+    for (size_t i = 0; i < sizeof DATA; i++) {
+        DATA[i] = (uint8_t)(i * 131 + (i >> 5));
+    }
+
+    test_known();
+    test_streaming();
+    test_backends();
+    test_avalanche();
+    test_keys();
+
+    fprintf(stderr, "%zu/%zu test cases passed\n", num_passed, num_tests);
+
+    return num_passed != num_tests;
+}
@@ -0,0 +1,140 @@
+#include "libhash.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <span>
+#include <string>
+#include <string_view>
+
+
+/* Compared at compile time, a wrong constexpr implementation does not build */
+static_assert(libhash::hasher<libhash::sha2_256>::hash("abc") ==
+              std::array<std::uint8_t, 32>{0xba, 0x78, 0x16, 0xbf, 0x8f, 0x01, 0xcf, 0xea, 0x41, 0x41, 0x40,
+                                           0xde, 0x5d, 0xae, 0x22, 0x23, 0xb0, 0x03, 0x61, 0xa3, 0x96, 0x17,
+                                           0x7a, 0x9c, 0xb4, 0x10, 0xff, 0x61, 0xf2, 0x00, 0x15, 0xad});
+static_assert(libhash::hasher<libhash::sha1>::hash("abc") ==
+              std::array<std::uint8_t, 20>{0xa9, 0x99, 0x3e, 0x36, 0x47, 0x06, 0x81, 0x6a, 0xba, 0x3e,
+                                           0x25, 0x71, 0x78, 0x50, 0xc2, 0x6c, 0x9c, 0xd0, 0xd8, 0x9d});
+
+static std::uint8_t DATA[1000];
+
+size_t num_tests = 0;
+size_t num_passed = 0;
+
+static void
+check(bool passed, const char *name) {
+    num_tests++;
+    if (passed) {
+        printf("\t[PASSED]: %s\n", name);
+        num_passed++;
+    } else {
+        printf("\t[FAILED] %s\n", name);
+    }
+}
+
+template <std::size_t N>
+static std::string
+to_hex(const std::array<std::uint8_t, N> &digest) {
+    std::string hex;
+    char byte[3];
+
+    for (std::uint8_t x : digest) {
+        snprintf(byte, sizeof byte, "%02x", x);
+        hex += byte;
+    }
+    return hex;
+}
+
+template <class Algorithm>
+static void
+test_abc(const char *name, const char *expected) {
+    libhash::hasher<Algorithm> hasher;
+
+    check(to_hex(hasher.update("a").update("bc").finish()) == expected, name);
+}
+
+void
+test_algorithms(void) {
+    puts("Testing hasher on \"abc\"");
+    test_abc<libhash::sha1>("SHA-1", "a9993e364706816aba3e25717850c26c9cd0d89d");
+    test_abc<libhash::sha2_224>("SHA-224", "23097d223405d8228642a477bda255b32aadbce4bda0b3f7e36c9da7");
+    test_abc<libhash::sha2_256>("SHA-256", "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad");
+    test_abc<libhash::sha2_384>("SHA-384",
+                                "cb00753f45a35e8bb5a03d699ac65007272c32ab0eded1631a8b605a43ff5bed"
+                                "8086072ba1e7cc2358baeca134c825a7");
+    test_abc<libhash::sha2_512>("SHA-512",
+                                "ddaf35a193617abacc417349ae20413112e6fa4e89a97ea20a9eeee64b55d39a"
+                                "2192992a274fc1a836ba3c23a3feebbd454d4423643ce80e2a9ac94fa54ca49f");
+    test_abc<libhash::sha2_512_224>("SHA-512/224", "4634270f707b6a54daae7530460842e20e37ed265ceee9a43e8924aa");
+    test_abc<libhash::sha2_512_256>("SHA-512/256",
+                                    "53048e2681941ef99b2e29b76b4c7dabe4c2d0c634fc6d46e0e2f13107e7af23");
+    test_abc<libhash::sha3_224>("SHA3-224", "e642824c3f8cf24ad09234ee7d3c766fc9a3a5168d0c94ad73b46fdf");
+    test_abc<libhash::sha3_256>("SHA3-256", "3a985da74fe225b2045c172d6bd390bd855f086e3e9d525b46bfe24511431532");
+    test_abc<libhash::sha3_384>("SHA3-384",
+                                "ec01498288516fc926459f58e2c6ad8df9b473cb0fc08c2596da7cf0e49be4b2"
+                                "98d88cea927ac7f539f1edf228376d25");
+    test_abc<libhash::sha3_512>("SHA3-512",
+                                "b751850b1a57168a5693cd924b6b096e08f621827444f70d884f5d0240d2712e"
+                                "10e116e9192af3c91a7ec57647e3934057340b4cf408d5a56592f8274eec53f0");
+}
+
+/* The constexpr implementations are called directly, at run time, to cover every padding case */
+void
+test_constexpr(void) {
+    std::size_t sha1_mismatches = 0, sha256_mismatches = 0;
+
+    puts("Testing the constexpr implementations");
+    for (std::size_t len = 0; len <= 300; len++) {
+        std::span<const std::uint8_t> data(DATA, len);
+
+        sha1_mismatches += libhash::detail::sha1(DATA, len) != libhash::hasher<libhash::sha1>::hash(data);
+        sha256_mismatches += libhash::detail::sha256(DATA, len) != libhash::hasher<libhash::sha2_256>::hash(data);
+    }
+    check(!sha1_mismatches, "SHA-1 matches the runtime backend for 0 to 300 bytes");
+    check(!sha256_mismatches, "SHA-256 matches the runtime backend for 0 to 300 bytes");
+}
+
+void
+test_streaming(void) {
+    libhash::hasher<libhash::sha2_512> hasher;
+    std::size_t mismatches = 0;
+
+    puts("Testing streaming");
+    auto expected = libhash::hasher<libhash::sha2_512>::hash(std::span<const std::uint8_t>(DATA));
+    for (std::size_t step = 1; step < 200; step += 13) {
+        for (std::size_t i = 0; i < sizeof DATA; i += step) {
+            hasher.update(std::span<const std::uint8_t>(DATA + i, std::min(step, sizeof DATA - i)));
+        }
+        mismatches += hasher.finish() != expected;
+    }
+    check(!mismatches, "split updates match the one-shot digest");
+
+    hasher.update(std::as_bytes(std::span<const std::uint8_t>(DATA)));
+    check(hasher.finish() == expected, "std::byte spans");
+
+    libhash::hasher<libhash::sha2_512> prefix;
+    prefix.update(std::span<const std::uint8_t>(DATA, 500));
+    libhash::hasher<libhash::sha2_512> fork = prefix;
+    prefix.update(std::span<const std::uint8_t>(DATA + 500, 500));
+    fork.update(std::string_view("x"));
+    check(prefix.finish() == expected && fork.finish() != expected, "copies are independent");
+    check(to_hex(fork.finish()) == to_hex(libhash::hasher<libhash::sha2_512>::hash("")), "finish starts over");
+}
+
+int
+main(void) {
+    for (std::size_t i = 0; i < sizeof DATA; i++) {
+        DATA[i] = static_cast<std::uint8_t>(i * 31);
+    }
+
+    test_algorithms();
+    test_constexpr();
+    test_streaming();
+
+    fprintf(stderr, "%zu/%zu test cases passed\n", num_passed, num_tests);
+
+    return num_passed != num_tests;
+}
@@ -0,0 +1,238 @@
+#include "hmac.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+/* RFC 4231 and, for SHA-1, RFC 2202 keys and messages, plus keys at and above the block size */
+#define LONG_KEY_MESSAGE "Test Using Larger Than Block-Size Key - Hash Key First"
+
+static uint8_t KEY_0B[20];
+static uint8_t KEY_AA[131];
+static uint8_t KEY_01[128];
+static uint8_t DATA_X[200];
+
+struct hmac_case {
+    char *name;
+    enum hash_algorithm algorithm;
+    const void *key;
+    size_t key_len;
+    const void *data;
+    size_t data_len;
+    char *expected;
+};
+
+size_t num_tests = 0;
+size_t num_passed = 0;
+
+#define ARRAY_LEN(array) ((sizeof(array)) / (sizeof *(array)))
+
+static struct hmac_case test_case_hmac[] = {
+    {"Case 1 SHA-1", HASH_SHA1, KEY_0B, sizeof KEY_0B, "Hi There", 8, "b617318655057264e28bc0b6fb378c8ef146be00"},
+    {"Case 1 SHA-224", HASH_SHA2_224, KEY_0B, sizeof KEY_0B, "Hi There", 8,
+     "896fb1128abbdf196832107cd49df33f47b4b1169912ba4f53684b22"},
+    {"Case 1 SHA-256", HASH_SHA2_256, KEY_0B, sizeof KEY_0B, "Hi There", 8,
+     "b0344c61d8db38535ca8afceaf0bf12b881dc200c9833da726e9376c2e32cff7"},
+    {"Case 1 SHA-384", HASH_SHA2_384, KEY_0B, sizeof KEY_0B, "Hi There", 8,
+     "afd03944d84895626b0825f4ab46907f15f9dadbe4101ec682aa034c7cebc59c"
+     "faea9ea9076ede7f4af152e8b2fa9cb6"},
+    {"Case 1 SHA-512", HASH_SHA2_512, KEY_0B, sizeof KEY_0B, "Hi There", 8,
+     "87aa7cdea5ef619d4ff0b4241a1d6cb02379f4e2ce4ec2787ad0b30545e17cde"
+     "daa833b7d6b8a702038b274eaea3f4e4be9d914eeb61f1702e696c203a126854"},
+    {"Case 2 SHA-1", HASH_SHA1, "Jefe", 4, "what do ya want for nothing?", 28,
+     "effcdf6ae5eb2fa2d27416d5f184df9c259a7c79"},
+    {"Case 2 SHA-224", HASH_SHA2_224, "Jefe", 4, "what do ya want for nothing?", 28,
+     "a30e01098bc6dbbf45690f3a7e9e6d0f8bbea2a39e6148008fd05e44"},
+    {"Case 2 SHA-256", HASH_SHA2_256, "Jefe", 4, "what do ya want for nothing?", 28,
+     "5bdcc146bf60754e6a042426089575c75a003f089d2739839dec58b964ec3843"},
+    {"Case 2 SHA-384", HASH_SHA2_384, "Jefe", 4, "what do ya want for nothing?", 28,
+     "af45d2e376484031617f78d2b58a6b1b9c7ef464f5a01b47e42ec3736322445e"
+     "8e2240ca5e69e2c78b3239ecfab21649"},
+    {"Case 2 SHA-512", HASH_SHA2_512, "Jefe", 4, "what do ya want for nothing?", 28,
+     "164b7a7bfcf819e2e395fbe73b56e0a387bd64222e831fd610270cd7ea250554"
+     "9758bf75c05a994a6d034f65f8f0e6fdcaeab1a34d4a6b4b636e070a38bce737"},
+    {"Case 6 SHA-1", HASH_SHA1, KEY_AA, sizeof KEY_AA, LONG_KEY_MESSAGE, 54,
+     "90d0dace1c1bdc957339307803160335bde6df2b"},
+    {"Case 6 SHA-224", HASH_SHA2_224, KEY_AA, sizeof KEY_AA, LONG_KEY_MESSAGE, 54,
+     "95e9a0db962095adaebe9b2d6f0dbce2d499f112f2d2b7273fa6870e"},
+    {"Case 6 SHA-256", HASH_SHA2_256, KEY_AA, sizeof KEY_AA, LONG_KEY_MESSAGE, 54,
+     "60e431591ee0b67f0d8a26aacbf5b77f8e0bc6213728c5140546040f0ee37f54"},
+    {"Case 6 SHA-384", HASH_SHA2_384, KEY_AA, sizeof KEY_AA, LONG_KEY_MESSAGE, 54,
+     "4ece084485813e9088d2c63a041bc5b44f9ef1012a2b588f3cd11f05033ac4c6"
+     "0c2ef6ab4030fe8296248df163f44952"},
+    {"Case 6 SHA-512", HASH_SHA2_512, KEY_AA, sizeof KEY_AA, LONG_KEY_MESSAGE, 54,
+     "80b24263c7c1a3ebb71493c1dd7be8b49b46d1f41b4aeec1121b013783f8f352"
+     "6b56d037e05f2598bd0fd2215d6a1e5295e64f73f63f0aec8b915a985d786598"},
+    {"Block-size key SHA-1", HASH_SHA1, KEY_01, 64, DATA_X, sizeof DATA_X, "94409f9a0ac3ca9460c4f13574660df86b32d8da"},
+    {"Block-size key SHA-224", HASH_SHA2_224, KEY_01, 64, DATA_X, sizeof DATA_X,
+     "a5d1a054748bd10949c456f48f8e0cfded62ef66e9d5346e69c83bc7"},
+    {"Block-size key SHA-256", HASH_SHA2_256, KEY_01, 64, DATA_X, sizeof DATA_X,
+     "0a101b0106386d6b3d084004134bd1df1f8916e50aa0f3516dff291d710f53b9"},
+    {"Block-size key SHA-384", HASH_SHA2_384, KEY_01, 64, DATA_X, sizeof DATA_X,
+     "d2d6c0c35daffd193bcb1e2a8198894e0f4ed739e0a9a47a49ffdda414406600"
+     "123191d85423af3b723926e920fb115a"},
+    {"Block-size key SHA-512", HASH_SHA2_512, KEY_01, 64, DATA_X, sizeof DATA_X,
+     "4ef59e1260391a89c5d4e5d1a850829782594c00cabb6782bd8fe03955f2c4e9"
+     "287b271a64312b15a401ded3db98ec2c50d54717e57867ed60c63ae68f92cd07"},
+    {"Two-block key SHA-1", HASH_SHA1, KEY_01, sizeof KEY_01, DATA_X, sizeof DATA_X,
+     "b6e1da823fe572638a2acae8ddec6e09f99b69a2"},
+    {"Two-block key SHA-224", HASH_SHA2_224, KEY_01, sizeof KEY_01, DATA_X, sizeof DATA_X,
+     "ff56e6f53f9cf8e5db661f0d06a6b24dec3fab1c7d7ddcc7cb13a740"},
+    {"Two-block key SHA-256", HASH_SHA2_256, KEY_01, sizeof KEY_01, DATA_X, sizeof DATA_X,
+     "3dbd30056493ec012ecac726fb2b5283768c4d9820e77d6fd16da6e82b0f2db1"},
+    {"Two-block key SHA-384", HASH_SHA2_384, KEY_01, sizeof KEY_01, DATA_X, sizeof DATA_X,
+     "29aceffc6f357befcfc53f0752e91bf4c38d0036115f559338c79b53b6fcb044"
+     "03f47b365869722e6fa930775bb20a9d"},
+    {"Two-block key SHA-512", HASH_SHA2_512, KEY_01, sizeof KEY_01, DATA_X, sizeof DATA_X,
+     "531b73db56b35b35eca2e92f128b0b4a0b850a2111a8caf27e5a306f8f852abf"
+     "14d5e99a5bfe3f67f0db90a24913c0ad1411b34bc833ed496534325ae4221e6f"},
+    {"Case 2 SHA-512/224", HASH_SHA2_512_224, "Jefe", 4, "what do ya want for nothing?", 28,
+     "4a530b31a79ebcce36916546317c45f247d83241dfb818fd37254bde"},
+    {"Case 2 SHA-512/256", HASH_SHA2_512_256, "Jefe", 4, "what do ya want for nothing?", 28,
+     "6df7b24630d5ccb2ee335407081a87188c221489768fa2020513b2d593359456"},
+    {"Case 6 SHA-512/224", HASH_SHA2_512_224, KEY_AA, sizeof KEY_AA, LONG_KEY_MESSAGE, 54,
+     "29bef8ce88b54d4226c3c7718ea9e32ace2429026f089e38cea9aeda"},
+    {"Case 6 SHA-512/256", HASH_SHA2_512_256, KEY_AA, sizeof KEY_AA, LONG_KEY_MESSAGE, 54,
+     "87123c45f7c537a404f8f47cdbedda1fc9bec60eeb971982ce7ef10e774e6539"},
+};
+
+/* Format `out` as hex and compare */
+void
+check_bytes(const char *name, const char *how, const uint8_t *out, size_t len, const char *expected) {
+    char *hex = malloc(2 * len + 1);
+
+    num_tests++;
+    for (size_t i = 0; i < len; i++) {
+        sprintf(hex + 2 * i, "%02x", out[i]);
+    }
+    hex[2 * len] = '\0';
+
+    if (strcmp(hex, expected)) {
+        printf("\t[FAILED] %s (%s): expected '%s' got '%s'\n", name, how, expected, hex);
+    } else {
+        printf("\t[PASSED]: %s (%s)\n", name, how);
+        num_passed++;
+    }
+
+    free(hex);
+}
+
+/* One-shot, with a precomputed key used twice, and streamed one byte at a time */
+void
+test_hmac(const struct hmac_case *_case) {
+    uint8_t mac[HMAC_MAX_SIZE];
+    size_t mac_len = hmac_size(_case->algorithm);
+    struct hmac_key key;
+    struct hmac_ctx ctx;
+
+    hmac(_case->algorithm, _case->key, _case->key_len, _case->data, _case->data_len, mac);
+    check_bytes(_case->name, "one-shot", mac, mac_len, _case->expected);
+
+    hmac_key_init(&key, _case->algorithm, _case->key, _case->key_len);
+    for (int pass = 0; pass < 2; pass++) {
+        memset(mac, 0, sizeof mac);
+        hmac_keyed(&key, _case->data, _case->data_len, mac);
+        check_bytes(_case->name, pass ? "key reused" : "precomputed key", mac, mac_len, _case->expected);
+    }
+
+    memset(mac, 0, sizeof mac);
+    hmac_init(&ctx, &key);
+    for (size_t i = 0; i < _case->data_len; i++) {
+        hmac_update(&ctx, (const uint8_t *)_case->data + i, 1);
+    }
+    hmac_final(&ctx, mac);
+    check_bytes(_case->name, "streaming", mac, mac_len, _case->expected);
+
+    hmac_key_clear(&key);
+}
+
+/* RFC 5869 test cases 1 and 4 for SHA-256 and SHA-1, and an output spanning many blocks */
+void
+test_hkdf(void) {
+    static uint8_t ikm[22], salt[13], info[10], okm[300];
+
+    memset(ikm, 0x0b, sizeof ikm);
+    for (size_t i = 0; i < sizeof salt; i++) {
+        salt[i] = (uint8_t)i;
+    }
+    for (size_t i = 0; i < sizeof info; i++) {
+        info[i] = (uint8_t)(0xf0 + i);
+    }
+
+    puts("Testing hkdf");
+    hkdf(HASH_SHA2_256, salt, sizeof salt, ikm, sizeof ikm, info, sizeof info, okm, 42);
+    check_bytes("RFC 5869 #1", "SHA-256", okm, 42,
+                "3cb25f25faacd57a90434f64d0362f2a2d2d0a90cf1a5a4c5db02d56ecc4c5bf34007208d5b887185865");
+    hkdf(HASH_SHA1, NULL, 0, ikm, sizeof ikm, NULL, 0, okm, 42);
+    check_bytes("RFC 5869 #7", "SHA-1, no salt", okm, 42,
+                "0ac1af7002b3d761d1e55298da9d0506b9ae52057220a306e07b6b87e8df21d0ea00033de03984d34918");
+    hkdf(HASH_SHA2_512, "salt", 4, "ikm", 3, "info", 4, okm, 300);
+    check_bytes("300 bytes", "SHA-512", okm, 300,
+                "f8666bd3fdd88840c947614272dd065c71c541b0de03ff738644dffc3facec646317f3819f453c7f0c4b4fb70680b07f"
+                "020c3e26ce190895b104a4f8d4770f076ab726fd6ad78fc6cfd7a5faa507fb5f45a3b0594b286d665b4d31fe8b1325a2"
+                "010263e36d7f430c7d8d84da9fda0066cada0cf9a5eb41f5a39ed909331d30ad74d985b5d8e87bf642defea8b8bce252"
+                "6b7d2d8e842b7df1928fd8dffa2b053393e20e1ee9587cded484ce27b36393824df6fce17f4c5cd632da20f615a79393"
+                "1025a1f3eb97aded5bfb8870faec63f2797873ad3abe7e8a162f36f1eb9152c7a39dda2347b21cc1199c279b6d59105d"
+                "1ea469df3f5c730f64a668423bf6a1211291a2751f5616cc05c12c41735883ecd0e23d94444961c5ca17882cecee4045"
+                "d8b512e63c8479fa9fd24c86");
+
+    num_tests++;
+    if (hkdf(HASH_SHA2_256, NULL, 0, ikm, sizeof ikm, NULL, 0, okm, 255 * 32 + 1) == -1) {
+        puts("\t[PASSED]: too long output is rejected");
+        num_passed++;
+    } else {
+        puts("\t[FAILED] too long output is rejected");
+    }
+}
+
+/* RFC 6070 for SHA-1, the SHA-2 cases cover few iterations and outputs longer than one digest */
+void
+test_pbkdf2(void) {
+    uint8_t out[100];
+
+    puts("Testing pbkdf2");
+    pbkdf2(HASH_SHA1, "password", 8, "salt", 4, 4096, out, 20);
+    check_bytes("RFC 6070 #3", "SHA-1", out, 20, "4b007901b765489abead49d926f721d065a429c1");
+    pbkdf2(HASH_SHA2_256, "passwordPASSWORDpassword", 24, "saltSALTsaltSALTsaltSALTsaltSALTsalt", 36, 4096, out, 40);
+    check_bytes("40 bytes", "SHA-256", out, 40,
+                "348c89dbcbd32b2f32d814b8116e84cf2b17347ebc1800181c4e2a1fb8dd53e1c635518c7dac47e9");
+    pbkdf2(HASH_SHA2_512, "password", 8, "salt", 4, 1000, out, 100);
+    check_bytes("100 bytes", "SHA-512", out, 100,
+                "afe6c5530785b6cc6b1c6453384731bd5ee432ee549fd42fb6695779ad8a1c5bf59de69c48f774efc4007d5298f9033c"
+                "0241d5ab69305e7b64eceeb8d834cfec6afdec3c1c23982a121f2d4be008889378a49a0dfb104f0d2856e38f44271cda"
+                "f6de4341");
+    pbkdf2(HASH_SHA2_224, "p", 1, "s", 1, 3, out, 28);
+    check_bytes("3 iterations", "SHA-224", out, 28, "8f507423dab1c15149346f3a21ead6b4464d0ae1848d29230af0668a");
+    pbkdf2(HASH_SHA2_384, "pass", 4, "salt", 4, 2, out, 48);
+    check_bytes("2 iterations", "SHA-384", out, 48,
+                "277dcf194959bfc7ec056d9685fcfd2435fbe41fdcdaee9eda827f3d6fb944c32816771b2498a7f0f9c31d66b75a2a7f");
+    pbkdf2(HASH_SHA2_512_224, "password", 8, "salt", 4, 1000, out, 40);
+    check_bytes("40 bytes", "SHA-512/224", out, 40,
+                "2f7dd7172b0324e8234fb87a2a789b8ca20f613fb043be228e1edbfc159a909f4b9d36ec651e5b05");
+    pbkdf2(HASH_SHA2_512_256, "password", 8, "salt", 4, 1000, out, 40);
+    check_bytes("40 bytes", "SHA-512/256", out, 40,
+                "f7e4fb1d98c78b615f585f974af8cd97651a244f4c5004189d136fed65652fa00e3e2060276cbcea");
+}
+
+int
+main(void) {
+    memset(KEY_0B, 0x0b, sizeof KEY_0B);
+    memset(KEY_AA, 0xaa, sizeof KEY_AA);
+    memset(KEY_01, 0x01, sizeof KEY_01);
+    memset(DATA_X, 'x', sizeof DATA_X);
+
+    puts("Testing hmac");
+    for (size_t i = 0; i < ARRAY_LEN(test_case_hmac); i++) {
+        test_hmac(&test_case_hmac[i]);
+    }
+
+    test_hkdf();
+    test_pbkdf2();
+
+    fprintf(stderr, "%zu/%zu test cases passed\n", num_passed, num_tests);
+
+    return num_passed != num_tests;
+}
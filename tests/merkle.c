@@ -0,0 +1,183 @@
+#include "merkle.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+static uint8_t DATA[1000003];
+
+size_t num_tests = 0;
+size_t num_passed = 0;
+
+static void
+check(int passed, const char *name) {
+    num_tests++;
+    if (passed) {
+        printf("\t[PASSED]: %s\n", name);
+        num_passed++;
+    } else {
+        printf("\t[FAILED] %s\n", name);
+    }
+}
+
+/* Compare the root of `tree` with a hex string */
+static void
+check_root(const struct merkle_tree *tree, const char *expected, const char *name) {
+    uint8_t root[64];
+    char hex[129];
+
+    merkle_root(tree, root);
+    for (size_t i = 0; i < tree->digest_len; i++) {
+        sprintf(hex + 2 * i, "%02x", root[i]);
+    }
+    if (strcmp(hex, expected)) {
+        printf("\t       expected '%s' got '%s'\n", expected, hex);
+    }
+    check(!strcmp(hex, expected), name);
+}
+
+/* The leaves of the RFC 6962 reference tests */
+void
+test_rfc6962(void) {
+    static const struct merkle_leaf leaves[] = {
+        {"", 0},
+        {"\x00", 1},
+        {"\x10", 1},
+        {"\x20\x21", 2},
+        {"\x30\x31", 2},
+        {"\x40\x41\x42\x43", 4},
+        {"\x50\x51\x52\x53\x54\x55\x56\x57", 8},
+        {"\x60\x61\x62\x63\x64\x65\x66\x67\x68\x69\x6a\x6b\x6c\x6d\x6e\x6f", 16},
+    };
+    struct merkle_tree tree;
+
+    puts("Testing merkle_build_leaves");
+    check(!merkle_build_leaves(&tree, HASH_SHA2_256, leaves, 8, 1), "RFC 6962 tree builds");
+    check_root(&tree, "5dc9da79a70659a9ad559cb701ded9a2ab9d823aad2f4960cfe370eff4604328", "RFC 6962 root");
+    merkle_free(&tree);
+
+    check(merkle_build_leaves(&tree, HASH_SHA2_256, leaves, 0, 1) == -1, "empty leaf list is rejected");
+    check(merkle_build_leaves(&tree, HASH_SHA1, leaves, 8, 1) == -1, "SHA-1 is rejected");
+}
+
+void
+test_build(void) {
+    struct merkle_tree tree, other;
+    struct merkle_leaf *leaves = malloc(245 * sizeof *leaves);
+
+    puts("Testing merkle_build");
+    check(!merkle_build(&tree, HASH_SHA2_256, DATA, sizeof DATA, 4096, 0), "SHA-256 tree builds");
+    check(tree.num_leaves == 245 && tree.num_levels == 9, "245 leaves on 9 levels");
+    check_root(&tree, "6e4fbbdb010fb5416743980d47fa1a966c8c2078cf554c3192a062698b52a139", "SHA-256 root");
+    merkle_free(&tree);
+
+    check(!merkle_build(&tree, HASH_SHA2_512, DATA, sizeof DATA, 4096, 3), "SHA-512 tree builds");
+    check_root(&tree,
+               "ac8c58c93a3d56886e63130ee0122fd33bea227f4a185d13df570bde3196e578"
+               "f40d84fa3f7e409d9a87f21eaa08e6de8e5888a3059fbbf9cccd4597484fe8c0",
+               "SHA-512 root");
+    merkle_free(&tree);
+
+    check(!merkle_build(&tree, HASH_SHA2_256, DATA, 1, 4096, 1), "single leaf tree builds");
+    check_root(&tree, "96a296d224f285c67bee93c30f8a309157f0daa35dc5b87e410b78630a09cfc7", "single leaf root");
+    merkle_free(&tree);
+
+    /* Small chunks give levels big enough for the pool, the root must not depend on the thread count */
+    check(!merkle_build(&tree, HASH_SHA2_256, DATA, sizeof DATA, 16, 1), "62501 leaf tree builds");
+    check(!merkle_build(&other, HASH_SHA2_256, DATA, sizeof DATA, 16, 0), "62501 leaf tree builds on all cores");
+    check(!memcmp(tree.nodes, other.nodes, tree.level_start[tree.num_levels] * tree.digest_len),
+          "every node matches across thread counts");
+    merkle_free(&tree);
+    merkle_free(&other);
+
+    for (size_t i = 0; i < 245; i++) {
+        leaves[i].data = DATA + i * 4096;
+        leaves[i].len = i < 244 ? 4096 : sizeof DATA - 244 * 4096;
+    }
+    check(!merkle_build_leaves(&tree, HASH_SHA2_256, leaves, 245, 2), "chunk list builds");
+    check_root(&tree, "6e4fbbdb010fb5416743980d47fa1a966c8c2078cf554c3192a062698b52a139", "chunk list matches buffer");
+    merkle_free(&tree);
+
+    free(leaves);
+}
+
+/* Updating a leaf has to give the same tree as building from the changed data */
+void
+test_update(void) {
+    static uint8_t changed[sizeof DATA];
+    struct merkle_tree tree, expected;
+    size_t mismatches = 0;
+
+    puts("Testing merkle_update");
+    memcpy(changed, DATA, sizeof DATA);
+    merkle_build(&tree, HASH_SHA2_256, DATA, sizeof DATA, 1000, 1);
+
+    for (size_t index = 0; index < tree.num_leaves; index += 97) {
+        size_t len = index + 1 < tree.num_leaves ? 1000 : sizeof DATA - index * 1000;
+
+        changed[index * 1000] ^= 0xff;
+        merkle_update(&tree, index, changed + index * 1000, len);
+        merkle_build(&expected, HASH_SHA2_256, changed, sizeof DATA, 1000, 1);
+        mismatches += memcmp(tree.nodes, expected.nodes, tree.level_start[tree.num_levels] * tree.digest_len) != 0;
+        merkle_free(&expected);
+    }
+    check(!mismatches, "every updated tree matches a rebuilt one");
+    check(merkle_update(&tree, tree.num_leaves, DATA, 1) == -1, "out of range leaf is rejected");
+
+    merkle_free(&tree);
+}
+
+/* Every leaf of trees of every size up to 33 leaves has to verify, and no tampered proof may */
+void
+test_proofs(void) {
+    size_t failures = 0, forgeries = 0;
+
+    puts("Testing merkle_proof and merkle_verify");
+    for (size_t num_leaves = 1; num_leaves <= 33; num_leaves++) {
+        for (int algorithm = HASH_SHA2_256; algorithm <= HASH_SHA2_512; algorithm += HASH_SHA2_512 - HASH_SHA2_256) {
+            struct merkle_tree tree;
+            uint8_t root[64], proof[MERKLE_MAX_LEVELS * 64];
+
+            merkle_build(&tree, algorithm, DATA, num_leaves * 10, 10, 1);
+            merkle_root(&tree, root);
+
+            for (size_t index = 0; index < num_leaves; index++) {
+                const uint8_t *leaf = DATA + index * 10;
+                size_t proof_len = merkle_proof(&tree, index, proof);
+
+                failures += merkle_verify(algorithm, root, num_leaves, index, leaf, 10, proof, proof_len) != 0;
+                forgeries += !merkle_verify(algorithm, root, num_leaves, index, leaf, 9, proof, proof_len);
+                forgeries += num_leaves > 1 &&
+                             !merkle_verify(algorithm, root, num_leaves, index ^ 1, leaf, 10, proof, proof_len);
+                if (proof_len) {
+                    proof[0] ^= 1;
+                    forgeries += !merkle_verify(algorithm, root, num_leaves, index, leaf, 10, proof, proof_len);
+                    forgeries += !merkle_verify(algorithm, root, num_leaves, index, leaf, 10, proof, proof_len - 1);
+                }
+            }
+            merkle_free(&tree);
+        }
+    }
+
+    check(!failures, "every proof verifies");
+    check(!forgeries, "no tampered proof verifies");
+}
+
+int
+main(void) {
+    for (size_t i = 0; i < sizeof DATA; i++) {
+        DATA[i] = (uint8_t)(i * 31 + (i >> 8));
+    }
+
+    test_rfc6962();
+    test_build();
+    test_update();
+    test_proofs();
+
+    fprintf(stderr, "%zu/%zu test cases passed\n", num_passed, num_tests);
+
+    return num_passed != num_tests;
+}
@@ -8,6 +8,7 @@
 
 
 static char MILLION_A[1000001];
+static char BINARY[1000];
 
 struct test_case {
     char *name;
@@ -31,56 +32,95 @@ size_t num_passed = 0;
         test_case_64(fn, hash_size, cases, ARRAY_LEN(cases));                                                          \
     } while (0)
 
-void
-test_case_32(void (*hash_fn)(const char *, uint32_t *), size_t hash_size, struct test_case *cases, size_t num_cases) {
-    uint32_t *hash = malloc(hash_size * (sizeof *hash));
+/* Hash every case with the length-explicit entry point */
+#define TEST_DATA(fn, word_type, hash_size, cases)                                                                     \
+    do {                                                                                                               \
+        puts("Testing " #fn "_data");                                                                                  \
+        for (size_t i = 0; i < ARRAY_LEN(cases); i++) {                                                                \
+            word_type hash[hash_size];                                                                                 \
+            fn##_data(cases[i].input_str, case_len(&cases[i]), hash);                                                  \
+            check_case(&cases[i], hash, hash_size, sizeof *hash);                                                      \
+        }                                                                                                              \
+    } while (0)
 
-    for (size_t i = 0; i < num_cases; i++) {
-        num_tests++;
+/* Feed every case through the streaming API in chunks of growing size, so the tail block is hit at every offset */
+#define TEST_STREAM(fn, ctx_type, word_type, hash_size, cases)                                                         \
+    do {                                                                                                               \
+        puts("Testing " #fn " (streaming)");                                                                           \
+        for (size_t i = 0; i < ARRAY_LEN(cases); i++) {                                                                \
+            ctx_type ctx;                                                                                              \
+            word_type hash[hash_size];                                                                                 \
+            const char *input = cases[i].input_str;                                                                    \
+            size_t len = case_len(&cases[i]);                                                                          \
+                                                                                                                       \
+            fn##_init(&ctx);                                                                                           \
+            for (size_t offset = 0, chunk = 0; offset < len; offset += chunk) {                                        \
+                chunk = offset % 131 + 1 < len - offset ? offset % 131 + 1 : len - offset;                             \
+                fn##_update(&ctx, input + offset, chunk);                                                              \
+            }                                                                                                          \
+            fn##_final(&ctx, hash);                                                                                    \
+            check_case(&cases[i], hash, hash_size, sizeof *hash);                                                      \
+        }                                                                                                              \
+    } while (0)
 
-        struct test_case _case = cases[i];
+/* `BINARY` is the only input that is not a NUL-terminated string */
+static size_t
+case_len(const struct test_case *_case) {
+    return _case->input_str == BINARY ? sizeof BINARY : strlen(_case->input_str);
+}
 
-        hash_fn(_case.input_str, hash);
+/* Format `hash` the way the expected digests are written and compare, `word_size` is 4 or 8 */
+void
+check_case(const struct test_case *_case, const void *hash, size_t hash_size, size_t word_size) {
+    char *digest = malloc((hash_size * word_size * 2 + 1) * (sizeof *digest));
 
-        char *digest = malloc((strlen(_case.expected) + 1) * (sizeof *digest));
-        for (size_t j = 0; j < hash_size; j++) {
-            sprintf(digest + j * 8, "%08x", hash[j]);
-        }
+    num_tests++;
 
-        if (strcmp(digest, _case.expected)) {
-            printf("\t[FAILED] %s: expected '%s' got '%s'\n", _case.name, _case.expected, digest);
+    for (size_t j = 0; j < hash_size; j++) {
+        if (word_size == 4) {
+            sprintf(digest + j * 8, "%08x", ((const uint32_t *)hash)[j]);
         } else {
-            printf("\t[PASSED]: %s\n", _case.name);
-            num_passed++;
+            sprintf(digest + j * 16, "%016lx", ((const uint64_t *)hash)[j]);
         }
+    }
+
+    /* SHA3-224 and SHA-512/224 only fill the upper half of their last word */
+    if (strlen(_case->expected) < hash_size * word_size * 2) {
+        digest[strlen(_case->expected)] = '\0';
+    }
 
-        free(digest);
+    if (strcmp(digest, _case->expected)) {
+        printf("\t[FAILED] %s: expected '%s' got '%s'\n", _case->name, _case->expected, digest);
+    } else {
+        printf("\t[PASSED]: %s\n", _case->name);
+        num_passed++;
     }
+
+    free(digest);
 }
 
 void
-test_case_64(void (*hash_fn)(const char *, uint64_t *), size_t hash_size, struct test_case *cases, size_t num_cases) {
-    uint64_t *hash = malloc(hash_size * (sizeof *hash));
+test_case_32(void (*hash_fn)(const char *, uint32_t *), size_t hash_size, struct test_case *cases, size_t num_cases) {
+    uint32_t *hash = malloc(hash_size * (sizeof *hash));
 
     for (size_t i = 0; i < num_cases; i++) {
-        num_tests++;
-
-        struct test_case _case = cases[i];
+        hash_fn(cases[i].input_str, hash);
+        check_case(&cases[i], hash, hash_size, sizeof *hash);
+    }
 
-        hash_fn(_case.input_str, hash);
+    free(hash);
+}
 
-        char *digest = malloc((strlen(_case.expected) + 1) * (sizeof *digest));
-        for (size_t j = 0; j < hash_size; j++) {
-            sprintf(digest + j * 16, "%016lx", hash[j]);
-        }
+void
+test_case_64(void (*hash_fn)(const char *, uint64_t *), size_t hash_size, struct test_case *cases, size_t num_cases) {
+    uint64_t *hash = malloc(hash_size * (sizeof *hash));
 
-        if (strcmp(digest, _case.expected)) {
-            printf("\t[FAILED] %s: expected '%s' got '%s'\n", _case.name, _case.expected, digest);
-        } else {
-            printf("\t[PASSED]: %s\n", _case.name);
-            num_passed++;
-        }
+    for (size_t i = 0; i < num_cases; i++) {
+        hash_fn(cases[i].input_str, hash);
+        check_case(&cases[i], hash, hash_size, sizeof *hash);
     }
+
+    free(hash);
 }
 
 static struct test_case test_case_sha1[] = {
@@ -91,6 +131,10 @@ static struct test_case test_case_sha1[] = {
     {"Large String", MILLION_A, "34aa973cd4c4daa4f61eeb2bdbad27316534016f"},
 };
 
+static struct test_case test_case_sha1_binary[] = {
+    {"Binary", BINARY, "38f3aa587f4aa04965a359f9151092759b3a4c2a"},
+};
+
 static struct test_case test_case_sha2_224[] = {
     {"Empty String", "", "d14a028c2a3a2bc9476102bb288234c415a2b01f828ea62ac5b3e42f"},
     {"Short String", "abc", "23097d223405d8228642a477bda255b32aadbce4bda0b3f7e36c9da7"},
@@ -99,6 +143,10 @@ static struct test_case test_case_sha2_224[] = {
     {"Large String", MILLION_A, "20794655980c91d8bbb4c1ea97618a4bf03f42581948b2ee4ee7ad67"},
 };
 
+static struct test_case test_case_sha2_224_binary[] = {
+    {"Binary", BINARY, "4c334cc5a66546204312043478bd53c4df7129020e5dbb418d8f088f"},
+};
+
 static struct test_case test_case_sha2_256[] = {
     {"Empty String", "", "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855"},
     {"Short String", "abc", "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad"},
@@ -107,6 +155,10 @@ static struct test_case test_case_sha2_256[] = {
     {"Large String", MILLION_A, "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0"},
 };
 
+static struct test_case test_case_sha2_256_binary[] = {
+    {"Binary", BINARY, "89f4ff56a25dd1db06a4ce6033603775d705fb96f30f8693733fef602a1ca532"},
+};
+
 static struct test_case test_case_sha2_384[] = {
     {"Empty String", "",
      "38b060a751ac96384cd9327eb1b1e36a21fdb71114be07434c0cc7bf63f6e1da274edebfe76f65fbd51ad2f14898b95b"},
@@ -120,6 +172,11 @@ static struct test_case test_case_sha2_384[] = {
      "9d0e1809716474cb086e834e310a4a1ced149e9c00f248527972cec5704c2a5b07b8b3dc38ecc4ebae97ddd87f3d8985"},
 };
 
+static struct test_case test_case_sha2_384_binary[] = {
+    {"Binary", BINARY, "81003a03bf67b8523ba96128e711facaac9f7a01ac065d3a2a83832eef6a2378"
+     "14d36ba50696e09a31424a2eaedd9e57"},
+};
+
 static struct test_case test_case_sha2_512[] = {
     {"Empty String", "",
      "cf83e1357eefb8bdf1542850d66d8007d620e4050b5715dc83f4a921d36ce9ce"
@@ -136,17 +193,279 @@ static struct test_case test_case_sha2_512[] = {
      "de0ff244877ea60a4cb0432ce577c31beb009c5c2c49aa2e4eadb217ad8cc09b"},
 };
 
-int
-main(void) {
-    memset(MILLION_A, 'a', 1000000);
-    MILLION_A[1000000] = '\0';
+static struct test_case test_case_sha2_512_binary[] = {
+    {"Binary", BINARY, "5c3d2be85b82f8ace3dbd4cf34e814cf68201a9f3e5730253ee42fd46fbe6db2"
+     "e68ab158e76a103df431f3ad279d8fa3ff6b148e21ced56feb321a6d28d101f1"},
+};
+
+static struct test_case test_case_sha2_512_224[] = {
+    {"Empty String", "", "6ed0dd02806fa89e25de060c19d3ac86cabb87d6a0ddd05c333b84f4"},
+    {"Short String", "abc", "4634270f707b6a54daae7530460842e20e37ed265ceee9a43e8924aa"},
+    {"Long String",
+     "abcdefghbcdefghicdefghijdefghijkefghijklfghijklmghijklmnhijklmnoijklmnopjklmnopqklmnopqrlmnopqrsmnopqrstnopqrstu",
+     "23fec5bb94d60b23308192640b0c453335d664734fe40e7268674af9"},
+    {"Large String", MILLION_A, "37ab331d76f0d36de422bd0edeb22a28accd487b7a8453ae965dd287"},
+};
+
+static struct test_case test_case_sha2_512_224_binary[] = {
+    {"Binary", BINARY, "40df3daea578b911804af7409f23950ccc60402de249a7e37ba270a2"},
+};
+
+static struct test_case test_case_sha2_512_256[] = {
+    {"Empty String", "", "c672b8d1ef56ed28ab87c3622c5114069bdd3ad7b8f9737498d0c01ecef0967a"},
+    {"Short String", "abc", "53048e2681941ef99b2e29b76b4c7dabe4c2d0c634fc6d46e0e2f13107e7af23"},
+    {"Long String",
+     "abcdefghbcdefghicdefghijdefghijkefghijklfghijklmghijklmnhijklmnoijklmnopjklmnopqklmnopqrlmnopqrsmnopqrstnopqrstu",
+     "3928e184fb8690f840da3988121d31be65cb9d3ef83ee6146feac861e19b563a"},
+    {"Large String", MILLION_A, "9a59a052930187a97038cae692f30708aa6491923ef5194394dc68d56c74fb21"},
+};
+
+static struct test_case test_case_sha2_512_256_binary[] = {
+    {"Binary", BINARY, "9fcc4b1db1bb5edafdad4c6c54a1e6a5552ab30a7d5fbf82a6597ed3292c6290"},
+};
+
+static struct test_case test_case_sha3_224[] = {
+    {"Empty String", "", "6b4e03423667dbb73b6e15454f0eb1abd4597f9a1b078e3f5b5a6bc7"},
+    {"Short String", "abc", "e642824c3f8cf24ad09234ee7d3c766fc9a3a5168d0c94ad73b46fdf"},
+    {"Long String", "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq",
+     "8a24108b154ada21c9fd5574494479ba5c7e7ab76ef264ead0fcce33"},
+    {"Large String", MILLION_A, "d69335b93325192e516a912e6d19a15cb51c6ed5c15243e7a7fd653c"},
+};
+
+static struct test_case test_case_sha3_224_binary[] = {
+    {"Binary", BINARY, "1b955f13c2a41415091ca0d4b1c6c9459518dd75101222c8d896c9a3"},
+};
+
+static struct test_case test_case_sha3_256[] = {
+    {"Empty String", "", "a7ffc6f8bf1ed76651c14756a061d662f580ff4de43b49fa82d80a4b80f8434a"},
+    {"Short String", "abc", "3a985da74fe225b2045c172d6bd390bd855f086e3e9d525b46bfe24511431532"},
+    {"Long String", "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq",
+     "41c0dba2a9d6240849100376a8235e2c82e1b9998a999e21db32dd97496d3376"},
+    {"Large String", MILLION_A, "5c8875ae474a3634ba4fd55ec85bffd661f32aca75c6d699d0cdcb6c115891c1"},
+};
+
+static struct test_case test_case_sha3_256_binary[] = {
+    {"Binary", BINARY, "dff46ff5ed9e8d28b7048f3a3e3adba1d3c5c73ac196b0de15d8081937376279"},
+};
+
+static struct test_case test_case_sha3_384[] = {
+    {"Empty String", "",
+     "0c63a75b845e4f7d01107d852e4c2485c51a50aaaa94fc61995e71bbee983a2a"
+     "c3713831264adb47fb6bd1e058d5f004"},
+    {"Short String", "abc",
+     "ec01498288516fc926459f58e2c6ad8df9b473cb0fc08c2596da7cf0e49be4b2"
+     "98d88cea927ac7f539f1edf228376d25"},
+    {"Long String", "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq",
+     "991c665755eb3a4b6bbdfb75c78a492e8c56a22c5c4d7e429bfdbc32b9d4ad5a"
+     "a04a1f076e62fea19eef51acd0657c22"},
+    {"Large String", MILLION_A,
+     "eee9e24d78c1855337983451df97c8ad9eedf256c6334f8e948d252d5e0e7684"
+     "7aa0774ddb90a842190d2c558b4b8340"},
+};
+
+static struct test_case test_case_sha3_384_binary[] = {
+    {"Binary", BINARY, "0ab68ee19c5445b266bb913ab3c58189115f2430b1b63ae57105b144b2054848"
+     "5bd210ef3447c7fc1f50692f629e255e"},
+};
+
+static struct test_case test_case_sha3_512[] = {
+    {"Empty String", "",
+     "a69f73cca23a9ac5c8b567dc185a756e97c982164fe25859e0d1dcc1475c80a6"
+     "15b2123af1f5f94c11e3e9402c3ac558f500199d95b6d3e301758586281dcd26"},
+    {"Short String", "abc",
+     "b751850b1a57168a5693cd924b6b096e08f621827444f70d884f5d0240d2712e"
+     "10e116e9192af3c91a7ec57647e3934057340b4cf408d5a56592f8274eec53f0"},
+    {"Long String", "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq",
+     "04a371e84ecfb5b8b77cb48610fca8182dd457ce6f326a0fd3d7ec2f1e91636d"
+     "ee691fbe0c985302ba1b0d8dc78c086346b533b49c030d99a27daf1139d6e75e"},
+    {"Large String", MILLION_A,
+     "3c3a876da14034ab60627c077bb98f7e120a2a5370212dffb3385a18d4f38859"
+     "ed311d0a9d5141ce9cc5c66ee689b266a8aa18ace8282a0e0db596c90b0a7b87"},
+};
+
+static struct test_case test_case_sha3_512_binary[] = {
+    {"Binary", BINARY, "fc789f726d84fa28ae1b295d75e5c7f4c6120fd47c2d655b1ce95d1a98d0408d"
+     "eb8d2ebbc2fc41daf4da7488d16f8becf1a2e4040e9527f476bc344185b385c6"},
+};
+
+static struct test_case test_case_sha2_256d[] = {
+    {"Double Empty String", "", "5df6e0e2761359d30a8275058e299fcc0381534545f55cf43e41983f5d4c9456"},
+    {"Double Short String", "hello", "9595c9df90075148eb06860365df33584b75bff782a510c6cd4883a419833d50"},
+};
+
+/* The fixed-length entry points hash like `sha2_256_data`, at every offset so the input is also misaligned */
+void
+test_fixed_length(void) {
+    size_t mismatches = 0;
+
+    puts("Testing sha2_256_32, sha2_256_64 and sha2_256d");
+    for (size_t i = 0; i < ARRAY_LEN(test_case_sha2_256d); i++) {
+        uint32_t hash[8];
+        sha2_256d(test_case_sha2_256d[i].input_str, strlen(test_case_sha2_256d[i].input_str), hash);
+        check_case(&test_case_sha2_256d[i], hash, 8, sizeof *hash);
+    }
+
+    for (size_t offset = 0; offset + 64 <= sizeof BINARY; offset += 13) {
+        uint32_t expected[8], hash[8];
+
+        sha2_256_data(BINARY + offset, 32, expected);
+        sha2_256_32(BINARY + offset, hash);
+        mismatches += memcmp(expected, hash, sizeof hash) != 0;
+
+        sha2_256_data(BINARY + offset, 64, expected);
+        sha2_256_64(BINARY + offset, hash);
+        mismatches += memcmp(expected, hash, sizeof hash) != 0;
+    }
+    num_tests++;
+    if (mismatches) {
+        printf("\t[FAILED] %zu fixed-length hashes differ from sha2_256_data\n", mismatches);
+    } else {
+        printf("\t[PASSED]: 32 and 64 bytes at every offset\n");
+        num_passed++;
+    }
+
+    mismatches = 0;
+    for (size_t len = 0; len <= 300; len++) {
+        uint32_t expected[8], hash[8];
+        uint8_t digest[32];
+
+        sha2_256_data(BINARY, len, expected);
+        for (int j = 0; j < 32; j++) {
+            digest[j] = (uint8_t)(expected[j / 4] >> (24 - 8 * (j % 4)));
+        }
+        sha2_256_data(digest, sizeof digest, expected);
+        sha2_256d(BINARY, len, hash);
+        mismatches += memcmp(expected, hash, sizeof hash) != 0;
+    }
+    num_tests++;
+    if (mismatches) {
+        printf("\t[FAILED] sha2_256d: %zu lengths differ from hashing twice\n", mismatches);
+    } else {
+        printf("\t[PASSED]: sha2_256d of 0 to 300 bytes\n");
+        num_passed++;
+    }
+}
 
+/* Every backend the CPU supports has to produce the same hash as the scalar one for every length */
+void
+test_backends_agree(enum sha_backend backend) {
+    static const char *names[] = {"sha1", "sha2_224", "sha2_256"};
+
+    for (int fn = 0; fn < 3; fn++) {
+        size_t mismatches = 0;
+
+        num_tests++;
+        for (size_t len = 0; len <= sizeof BINARY; len++) {
+            uint32_t expected[8], hash[8];
+
+            for (int pass = 0; pass < 2; pass++) {
+                uint32_t *out = pass ? hash : expected;
+                sha_set_backend(pass ? backend : SHA_BACKEND_SCALAR);
+                if (fn == 0) {
+                    sha1_data(BINARY, len, out);
+                } else if (fn == 1) {
+                    sha2_224_data(BINARY, len, out);
+                } else {
+                    sha2_256_data(BINARY, len, out);
+                }
+            }
+            mismatches += memcmp(expected, hash, (fn == 0 ? 5 : fn == 1 ? 7 : 8) * sizeof *hash) != 0;
+        }
+
+        if (mismatches) {
+            printf("\t[FAILED] %s: %zu lengths differ from the scalar backend\n", names[fn], mismatches);
+        } else {
+            printf("\t[PASSED]: %s matches the scalar backend\n", names[fn]);
+            num_passed++;
+        }
+    }
+}
+
+void
+run_suite(void) {
     TEST32(sha1, 5, test_case_sha1);
     TEST32(sha2_224, 7, test_case_sha2_224);
     TEST32(sha2_256, 8, test_case_sha2_256);
 
     TEST64(sha2_384, 6, test_case_sha2_384);
     TEST64(sha2_512, 8, test_case_sha2_512);
+    TEST64(sha2_512_224, 4, test_case_sha2_512_224);
+    TEST64(sha2_512_256, 4, test_case_sha2_512_256);
+
+    TEST_DATA(sha1, uint32_t, 5, test_case_sha1);
+    TEST_DATA(sha1, uint32_t, 5, test_case_sha1_binary);
+    TEST_DATA(sha2_224, uint32_t, 7, test_case_sha2_224);
+    TEST_DATA(sha2_224, uint32_t, 7, test_case_sha2_224_binary);
+    TEST_DATA(sha2_256, uint32_t, 8, test_case_sha2_256);
+    TEST_DATA(sha2_256, uint32_t, 8, test_case_sha2_256_binary);
+    TEST_DATA(sha2_384, uint64_t, 6, test_case_sha2_384);
+    TEST_DATA(sha2_384, uint64_t, 6, test_case_sha2_384_binary);
+    TEST_DATA(sha2_512, uint64_t, 8, test_case_sha2_512);
+    TEST_DATA(sha2_512, uint64_t, 8, test_case_sha2_512_binary);
+    TEST_DATA(sha2_512_224, uint64_t, 4, test_case_sha2_512_224_binary);
+    TEST_DATA(sha2_512_256, uint64_t, 4, test_case_sha2_512_256_binary);
+
+    TEST_STREAM(sha1, struct sha1_ctx, uint32_t, 5, test_case_sha1);
+    TEST_STREAM(sha2_224, struct sha2_256_ctx, uint32_t, 7, test_case_sha2_224);
+    TEST_STREAM(sha2_256, struct sha2_256_ctx, uint32_t, 8, test_case_sha2_256);
+    TEST_STREAM(sha2_384, struct sha2_512_ctx, uint64_t, 6, test_case_sha2_384);
+    TEST_STREAM(sha2_512, struct sha2_512_ctx, uint64_t, 8, test_case_sha2_512);
+    TEST_STREAM(sha1, struct sha1_ctx, uint32_t, 5, test_case_sha1_binary);
+    TEST_STREAM(sha2_256, struct sha2_256_ctx, uint32_t, 8, test_case_sha2_256_binary);
+    TEST_STREAM(sha2_512, struct sha2_512_ctx, uint64_t, 8, test_case_sha2_512_binary);
+    TEST_STREAM(sha2_512_224, struct sha2_512_ctx, uint64_t, 4, test_case_sha2_512_224);
+    TEST_STREAM(sha2_512_256, struct sha2_512_ctx, uint64_t, 4, test_case_sha2_512_256);
+
+    test_fixed_length();
+
+    TEST64(sha3_224, 4, test_case_sha3_224);
+    TEST64(sha3_256, 4, test_case_sha3_256);
+    TEST64(sha3_384, 6, test_case_sha3_384);
+    TEST64(sha3_512, 8, test_case_sha3_512);
+
+    TEST_DATA(sha3_224, uint64_t, 4, test_case_sha3_224_binary);
+    TEST_DATA(sha3_256, uint64_t, 4, test_case_sha3_256_binary);
+    TEST_DATA(sha3_384, uint64_t, 6, test_case_sha3_384_binary);
+    TEST_DATA(sha3_512, uint64_t, 8, test_case_sha3_512_binary);
+
+    TEST_STREAM(sha3_224, struct sha3_ctx, uint64_t, 4, test_case_sha3_224);
+    TEST_STREAM(sha3_256, struct sha3_ctx, uint64_t, 4, test_case_sha3_256);
+    TEST_STREAM(sha3_384, struct sha3_ctx, uint64_t, 6, test_case_sha3_384);
+    TEST_STREAM(sha3_512, struct sha3_ctx, uint64_t, 8, test_case_sha3_512);
+    TEST_STREAM(sha3_256, struct sha3_ctx, uint64_t, 4, test_case_sha3_256_binary);
+    TEST_STREAM(sha3_512, struct sha3_ctx, uint64_t, 8, test_case_sha3_512_binary);
+}
+
+int
+main(void) {
+    static const struct {
+        enum sha_backend backend;
+        const char *name;
+    } backends[] = {
+        {SHA_BACKEND_SCALAR, "scalar"},
+        {SHA_BACKEND_SHANI, "SHA-NI"},
+    };
+
+    memset(MILLION_A, 'a', 1000000);
+    MILLION_A[1000000] = '\0';
+    for (size_t i = 0; i < sizeof BINARY; i++) {
+        BINARY[i] = (char)(i * 7);
+    }
+
+    for (size_t i = 0; i < ARRAY_LEN(backends); i++) {
+        if (sha_set_backend(backends[i].backend)) {
+            printf("Skipping the %s backend, it is not supported by this CPU\n", backends[i].name);
+            continue;
+        }
+
+        printf("Using the %s backend\n", backends[i].name);
+        run_suite();
+
+        if (backends[i].backend != SHA_BACKEND_SCALAR) {
+            puts("Comparing against the scalar backend");
+            test_backends_agree(backends[i].backend);
+        }
+    }
 
     fprintf(stderr, "%zu/%zu test cases passed\n", num_passed, num_tests);
 
@@ -0,0 +1,260 @@
+#include "siphash.h"
+
+#include "batch.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+
+#define ARRAY_LEN(array) ((sizeof(array)) / (sizeof *(array)))
+
+/* Lengths of the messages 00 01 02 ... of the vectors of every variant but SipHash-2-4 */
+static const size_t LENGTHS[] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 63};
+
+/* Reference implementation vectors: key 00 01 ... 0f, message 00 01 ... of 0 to 63 bytes */
+static const uint64_t SIPHASH24[] = {
+    0x726fdb47dd0e0e31, 0x74f839c593dc67fd, 0x0d6c8009d9a94f5a, 0x85676696d7fb7e2d,
+    0xcf2794e0277187b7, 0x18765564cd99a68d, 0xcbc9466e58fee3ce, 0xab0200f58b01d137,
+    0x93f5f5799a932462, 0x9e0082df0ba9e4b0, 0x7a5dbbc594ddb9f3, 0xf4b32f46226bada7,
+    0x751e8fbc860ee5fb, 0x14ea5627c0843d90, 0xf723ca908e7af2ee, 0xa129ca6149be45e5,
+    0x3f2acc7f57c29bdb, 0x699ae9f52cbe4794, 0x4bc1b3f0968dd39c, 0xbb6dc91da77961bd,
+    0xbed65cf21aa2ee98, 0xd0f2cbb02e3b67c7, 0x93536795e3a33e88, 0xa80c038ccd5ccec8,
+    0xb8ad50c6f649af94, 0xbce192de8a85b8ea, 0x17d835b85bbb15f3, 0x2f2e6163076bcfad,
+    0xde4daaaca71dc9a5, 0xa6a2506687956571, 0xad87a3535c49ef28, 0x32d892fad841c342,
+    0x7127512f72f27cce, 0xa7f32346f95978e3, 0x12e0b01abb051238, 0x15e034d40fa197ae,
+    0x314dffbe0815a3b4, 0x027990f029623981, 0xcadcd4e59ef40c4d, 0x9abfd8766a33735c,
+    0x0e3ea96b5304a7d0, 0xad0c42d6fc585992, 0x187306c89bc215a9, 0xd4a60abcf3792b95,
+    0xf935451de4f21df2, 0xa9538f0419755787, 0xdb9acddff56ca510, 0xd06c98cd5c0975eb,
+    0xe612a3cb9ecba951, 0xc766e62cfcadaf96, 0xee64435a9752fe72, 0xa192d576b245165a,
+    0x0a8787bf8ecb74b2, 0x81b3e73d20b49b6f, 0x7fa8220ba3b2ecea, 0x245731c13ca42499,
+    0xb78dbfaf3a8d83bd, 0xea1ad565322a1a0b, 0x60e61c23a3795013, 0x6606d7e446282b93,
+    0x6ca4ecb15c5f91e1, 0x9f626da15c9625f3, 0xe51b38608ef25f57, 0x958a324ceb064572,
+};
+
+static const struct siphash128 SIPHASH24_128[] = {
+    {0xe6a825ba047f81a3, 0x930255c71472f66d},
+    {0x44af996bd8c187da, 0x45fc229b11597634},
+    {0xc75da4a48d227781, 0xe4ff0af6de8ba3fc},
+    {0x4ea967520cb6709c, 0x51ed8529b0b6335f},
+    {0xaf8f9c2dc16481f8, 0x7955cd7b7c6e0f7d},
+    {0x886f778059876813, 0x27960e69077a5254},
+    {0x1386208b33caee14, 0x5ea1d78f30a05e48},
+    {0x53c1dbd8beebf1a1, 0x3982f01fa64ab8c0},
+    {0x61f55862baa9623b, 0xb49714f364e2830f},
+    {0xabbad90a06994426, 0xed716dbb028b7fc4},
+    {0x56691478c30d1100, 0xbafbd0f3d34754c9},
+    {0x77666b3868c55101, 0x18dce5816fdcb4a2},
+    {0x58f35e9066b226d6, 0x25c13285f64d6382},
+    {0x108bc0e947e26998, 0xf752b9c44f9329d0},
+    {0x9cded766aceffc31, 0x024949e45f48c77e},
+    {0x11a8b03399e99354, 0xd9c3cf970fec087e},
+    {0x4a83502f77d15051, 0x7cbd3f979a063e50},
+};
+
+static const uint64_t SIPHASH13[] = {
+    0xabac0158050fc4dc, 0xc9f49bf37d57ca93, 0x82cb9b024dc7d44d, 0x8bf80ab8e7ddf7fb,
+    0xcf75576088d38328, 0xdef9d52f49533b67, 0xc50d2b50c59f22a7, 0xd3927d989bb11140,
+    0x369095118d299a8e, 0x25a48eb36c063de4, 0x79de85ee92ff097f, 0x70c118c1f94dc352,
+    0x78a384b157b4d9a2, 0x306f760c1229ffa7, 0x605aa111c0f95d34, 0xd320d86d2a519956,
+    0x9d199062b7bbb3a8,
+};
+
+static const struct siphash128 SIPHASH13_128[] = {
+    {0xbea58827b2bc7ee7, 0x013030dd6adb62fd},
+    {0xa8edd36004376ffc, 0x63f02f2bcc73055e},
+    {0x9b836905097f7875, 0x95ea6a8c54c95b85},
+    {0x9ff7dc1efaccc56b, 0x43d7eb1277182348},
+    {0x5a282bac714e780c, 0x252cbf8fe7928e9f},
+    {0x0c625b3489db28f3, 0x3e849526a4295279},
+    {0x10e743f7293dd0dc, 0xf8a68539e8b05109},
+    {0xc3e0aaf223b98410, 0x77ab4808c82e2fa6},
+    {0xb4dae3d5e1fe12aa, 0x99c7f935ab164f72},
+    {0x9439f32c04b8dd81, 0x427c1394000e72f4},
+    {0x898e495d1d54aa4f, 0xb42fb287c3a40eba},
+    {0xdb914455f39a3b72, 0x4e0c6efc3d63d6b1},
+    {0xa819489e85923fe5, 0x658cea9f739506dc},
+    {0x1d80eac9c758f8b2, 0x4478656d5903d653},
+    {0x7222c9db6862e787, 0x78e3645f66cab026},
+    {0x6c52bdb205557ec1, 0x09017e1eeccd2129},
+    {0x6f42fe4ee300584c, 0xad6052a70a6b9f07},
+};
+
+/* The key is 00 01 ... 07 */
+static const uint32_t HALFSIPHASH24[] = {
+    0x5b9f35a9, 0xb85a4727, 0x03a662fa, 0x04e7fe8a, 0x89466e2a, 0x69b6fac5, 0x23fc6358, 0xc563cf8b,
+    0x8f84b8d0, 0x79e706f8, 0x3479b094, 0x50300808, 0x2f87f057, 0xff63e677, 0x7cf8ffd6, 0x972bfe74,
+    0x744aea59,
+};
+
+static const uint64_t HALFSIPHASH24_64[] = {
+    0xc83cb8b9591f8d21, 0x157338f8122455be, 0x57eb507cef394f06, 0x790606f7451a0fce,
+    0xa12ee55b178ae7d5, 0x80b53d2f3f7c9dcb, 0x25bca28a35913ece, 0x84c67bb0282720ff,
+    0x8c85e4bc20e8feed, 0x07838813cccc515b, 0xeef2a6069f46b095, 0x48cddd94393326ae,
+    0x99c7f5ae9f1fc77b, 0x44370c5ad752235a, 0x58e6e8ea70a8b13b, 0x02c9814ecb0b7d21,
+    0x876032bf713ca62e,
+};
+
+static uint8_t MESSAGE[256];
+
+size_t num_tests = 0;
+size_t num_passed = 0;
+
+static void
+check(int passed, const char *name) {
+    num_tests++;
+    if (passed) {
+        printf("\t[PASSED]: %s\n", name);
+        num_passed++;
+    } else {
+        printf("\t[FAILED] %s\n", name);
+    }
+}
+
+static uint64_t
+next_random(uint64_t *state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return *state;
+}
+
+static int
+equal128(struct siphash128 a, struct siphash128 b) {
+    return a.low == b.low && a.high == b.high;
+}
+
+void
+test_vectors(const struct siphash_key *key, const struct halfsiphash_key *half_key) {
+    size_t wrong = 0;
+
+    puts("Testing the reference vectors");
+    for (size_t len = 0; len < ARRAY_LEN(SIPHASH24); len++) {
+        wrong += siphash24(key, MESSAGE, len) != SIPHASH24[len];
+    }
+    check(!wrong, "SipHash-2-4 of 0 to 63 bytes");
+
+    wrong = 0;
+    for (size_t i = 0; i < ARRAY_LEN(LENGTHS); i++) {
+        wrong += !equal128(siphash24_128(key, MESSAGE, LENGTHS[i]), SIPHASH24_128[i]);
+    }
+    check(!wrong, "SipHash-2-4 with 128-bit output");
+
+    wrong = 0;
+    for (size_t i = 0; i < ARRAY_LEN(LENGTHS); i++) {
+        wrong += siphash13(key, MESSAGE, LENGTHS[i]) != SIPHASH13[i];
+        wrong += !equal128(siphash13_128(key, MESSAGE, LENGTHS[i]), SIPHASH13_128[i]);
+    }
+    check(!wrong, "SipHash-1-3 with 64 and 128-bit outputs");
+
+    wrong = 0;
+    for (size_t i = 0; i < ARRAY_LEN(LENGTHS); i++) {
+        wrong += halfsiphash24(half_key, MESSAGE, LENGTHS[i]) != HALFSIPHASH24[i];
+        wrong += halfsiphash24_64(half_key, MESSAGE, LENGTHS[i]) != HALFSIPHASH24_64[i];
+    }
+    check(!wrong, "HalfSipHash-2-4 with 32 and 64-bit outputs");
+}
+
+/* The tail is read with loads that overlap the rest of the message, never past its end */
+void
+test_messages(const struct siphash_key *key, const struct halfsiphash_key *half_key) {
+    uint8_t copy[64];
+    size_t wrong = 0;
+
+    puts("Testing messages");
+    for (size_t offset = 1; offset < 16; offset++) {
+        for (size_t len = 0; len < sizeof copy; len++) {
+            memcpy(copy, MESSAGE + offset, len);
+            wrong += siphash24(key, MESSAGE + offset, len) != siphash24(key, copy, len);
+            wrong += halfsiphash24(half_key, MESSAGE + offset, len) != halfsiphash24(half_key, copy, len);
+        }
+    }
+    check(!wrong, "every offset and length");
+
+    /* Only the low byte of the length is absorbed */
+    wrong = siphash24(key, MESSAGE, 255) != 0xa9c169fec74db21a;
+    wrong += siphash24(key, MESSAGE, 256) != 0x999d0526d2a7bfd7;
+    check(!wrong, "255 and 256 bytes");
+}
+
+void
+test_keys(void) {
+    uint8_t bytes[SIPHASH_KEY_LEN] = {0};
+    struct siphash_key a, b;
+    size_t equal = 0;
+
+    puts("Testing keys");
+    siphash_key_init(&a, bytes);
+    for (size_t bit = 0; bit < 8 * sizeof bytes; bit++) {
+        bytes[bit / 8] ^= 1 << (bit % 8);
+        siphash_key_init(&b, bytes);
+        bytes[bit / 8] ^= 1 << (bit % 8);
+
+        for (size_t len = 0; len <= 16; len++) {
+            equal += siphash24(&a, MESSAGE, len) == siphash24(&b, MESSAGE, len);
+            equal += siphash13(&a, MESSAGE, len) == siphash13(&b, MESSAGE, len);
+        }
+    }
+    check(!equal, "every bit of the key changes the hash");
+}
+
+/* Groups of messages of mixed lengths, and a number of jobs that leaves some to the scalar code */
+void
+test_batch(const struct siphash_key *key) {
+    static const char *names[] = {"auto", "scalar", "AVX2", "AVX-512"};
+    struct hash_job jobs[37];
+    uint64_t hashes[37];
+    uint64_t state = 1;
+
+    for (size_t j = 0; j < ARRAY_LEN(jobs); j++) {
+        jobs[j].len = next_random(&state) % (j < 16 ? 9 : 100);
+        jobs[j].data = MESSAGE + next_random(&state) % (sizeof MESSAGE - jobs[j].len + 1);
+        jobs[j].hash = &hashes[j];
+    }
+
+    for (int backend = SIPHASH_BACKEND_SCALAR; backend <= SIPHASH_BACKEND_AVX512; backend++) {
+        size_t wrong = 0;
+
+        if (siphash_set_backend(backend)) {
+            printf("Skipping the %s backend, not supported by the CPU\n", names[backend]);
+            continue;
+        }
+        printf("Testing the %s backend\n", names[backend]);
+
+        for (size_t n = 0; n <= ARRAY_LEN(jobs); n++) {
+            memset(hashes, 0, sizeof hashes);
+            siphash24_batch(key, jobs, n);
+            for (size_t j = 0; j < ARRAY_LEN(jobs); j++) {
+                wrong += hashes[j] != (j < n ? siphash24(key, jobs[j].data, jobs[j].len) : 0);
+            }
+            siphash13_batch(key, jobs, n);
+            for (size_t j = 0; j < n; j++) {
+                wrong += hashes[j] != siphash13(key, jobs[j].data, jobs[j].len);
+            }
+        }
+        check(!wrong, "same hashes as one message at a time");
+    }
+    siphash_set_backend(SIPHASH_BACKEND_AUTO);
+}
+
+int
+main(void) {
+    struct siphash_key key;
+    struct halfsiphash_key half_key;
+
+    for (size_t i = 0; i < sizeof MESSAGE; i++) {
+        MESSAGE[i] = (uint8_t)i;
+    }
+    siphash_key_init(&key, MESSAGE);
+    halfsiphash_key_init(&half_key, MESSAGE);
+
+    test_vectors(&key, &half_key);
+    test_messages(&key, &half_key);
+    test_keys();
+    test_batch(&key);
+
+    fprintf(stderr, "%zu/%zu test cases passed\n", num_passed, num_tests);
+
+    return num_passed != num_tests;
+}
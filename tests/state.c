@@ -0,0 +1,282 @@
+#include "state.h"
+
+#include "sha.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+static uint8_t DATA[5000];
+
+/* SHA-256 state after the 100 first bytes of DATA, produced by an independent implementation */
+static const char *SHA2_256_STATE =
+    "4c485354010200000000000000000064a858fd187c80f7deadaeef9a17ea07e2"
+    "3dad94dfac6f147ffb78164130a1ac8cc0dffe1d3c5b7a99b8d7f61534537291"
+    "b0cfee0d2c4b6a89a8c7e60524436281a0bfdefd000000000000000000000000"
+    "000000000000000000000000000000004d6b2ae9df91b432";
+
+union any_ctx {
+    struct sha1_ctx sha1;
+    struct sha2_256_ctx sha2_256;
+    struct sha2_512_ctx sha2_512;
+    struct sha3_ctx sha3;
+};
+
+size_t num_tests = 0;
+size_t num_passed = 0;
+
+static void
+check(int passed, const char *name) {
+    num_tests++;
+    if (passed) {
+        printf("\t[PASSED]: %s\n", name);
+        num_passed++;
+    } else {
+        printf("\t[FAILED] %s\n", name);
+    }
+}
+
+static void
+ctx_init(enum hash_algorithm algorithm, union any_ctx *ctx) {
+    switch (algorithm) {
+        case HASH_SHA1:
+            sha1_init(&ctx->sha1);
+            break;
+        case HASH_SHA2_224:
+            sha2_224_init(&ctx->sha2_256);
+            break;
+        case HASH_SHA2_256:
+            sha2_256_init(&ctx->sha2_256);
+            break;
+        case HASH_SHA2_384:
+            sha2_384_init(&ctx->sha2_512);
+            break;
+        case HASH_SHA2_512:
+            sha2_512_init(&ctx->sha2_512);
+            break;
+        case HASH_SHA3_224:
+            sha3_224_init(&ctx->sha3);
+            break;
+        case HASH_SHA3_256:
+            sha3_256_init(&ctx->sha3);
+            break;
+        case HASH_SHA3_384:
+            sha3_384_init(&ctx->sha3);
+            break;
+        case HASH_SHA3_512:
+            sha3_512_init(&ctx->sha3);
+            break;
+        case HASH_SHA2_512_224:
+            sha2_512_224_init(&ctx->sha2_512);
+            break;
+        case HASH_SHA2_512_256:
+            sha2_512_256_init(&ctx->sha2_512);
+            break;
+    }
+}
+
+static void
+ctx_update(enum hash_algorithm algorithm, union any_ctx *ctx, const void *data, size_t len) {
+    switch (algorithm) {
+        case HASH_SHA1:
+            sha1_update(&ctx->sha1, data, len);
+            break;
+        case HASH_SHA2_224:
+            sha2_224_update(&ctx->sha2_256, data, len);
+            break;
+        case HASH_SHA2_256:
+            sha2_256_update(&ctx->sha2_256, data, len);
+            break;
+        case HASH_SHA2_384:
+            sha2_384_update(&ctx->sha2_512, data, len);
+            break;
+        case HASH_SHA2_512:
+            sha2_512_update(&ctx->sha2_512, data, len);
+            break;
+        case HASH_SHA3_224:
+            sha3_224_update(&ctx->sha3, data, len);
+            break;
+        case HASH_SHA3_256:
+            sha3_256_update(&ctx->sha3, data, len);
+            break;
+        case HASH_SHA3_384:
+            sha3_384_update(&ctx->sha3, data, len);
+            break;
+        case HASH_SHA3_512:
+            sha3_512_update(&ctx->sha3, data, len);
+            break;
+        case HASH_SHA2_512_224:
+            sha2_512_224_update(&ctx->sha2_512, data, len);
+            break;
+        case HASH_SHA2_512_256:
+            sha2_512_256_update(&ctx->sha2_512, data, len);
+            break;
+    }
+}
+
+/* `hash` is 64 bytes, only the words of the digest are written */
+static void
+ctx_final(enum hash_algorithm algorithm, union any_ctx *ctx, uint64_t *hash) {
+    memset(hash, 0, 64);
+    switch (algorithm) {
+        case HASH_SHA1:
+            sha1_final(&ctx->sha1, (uint32_t *)hash);
+            break;
+        case HASH_SHA2_224:
+            sha2_224_final(&ctx->sha2_256, (uint32_t *)hash);
+            break;
+        case HASH_SHA2_256:
+            sha2_256_final(&ctx->sha2_256, (uint32_t *)hash);
+            break;
+        case HASH_SHA2_384:
+            sha2_384_final(&ctx->sha2_512, hash);
+            break;
+        case HASH_SHA2_512:
+            sha2_512_final(&ctx->sha2_512, hash);
+            break;
+        case HASH_SHA3_224:
+            sha3_224_final(&ctx->sha3, hash);
+            break;
+        case HASH_SHA3_256:
+            sha3_256_final(&ctx->sha3, hash);
+            break;
+        case HASH_SHA3_384:
+            sha3_384_final(&ctx->sha3, hash);
+            break;
+        case HASH_SHA3_512:
+            sha3_512_final(&ctx->sha3, hash);
+            break;
+        case HASH_SHA2_512_224:
+            sha2_512_224_final(&ctx->sha2_512, hash);
+            break;
+        case HASH_SHA2_512_256:
+            sha2_512_256_final(&ctx->sha2_512, hash);
+            break;
+    }
+}
+
+/* Split the message at offsets around every block size, the resumed hash has to match an uninterrupted one */
+void
+test_resume(void) {
+    static const char *names[] = {"SHA-1",    "SHA-224",  "SHA-256",  "SHA-384",     "SHA-512",    "SHA3-224",
+                                  "SHA3-256", "SHA3-384", "SHA3-512", "SHA-512/224", "SHA-512/256"};
+    static const size_t splits[] = {0, 1, 63, 64, 65, 71, 72, 100, 104, 127, 128, 129, 136, 144, 1000, 4097};
+    char name[64];
+
+    puts("Testing hash_state_export and hash_state_import");
+    for (int algorithm = HASH_SHA1; algorithm <= HASH_SHA2_512_256; algorithm++) {
+        size_t mismatches = 0, failures = 0;
+
+        for (size_t i = 0; i < sizeof splits / sizeof *splits; i++) {
+            union any_ctx whole, first, resumed;
+            uint64_t expected[8], hash[8];
+            uint8_t state[HASH_STATE_MAX_SIZE];
+            enum hash_algorithm info_algorithm;
+            uint64_t info_length;
+
+            ctx_init(algorithm, &whole);
+            ctx_update(algorithm, &whole, DATA, sizeof DATA);
+            ctx_final(algorithm, &whole, expected);
+
+            ctx_init(algorithm, &first);
+            ctx_update(algorithm, &first, DATA, splits[i]);
+            failures += hash_state_export(algorithm, &first, state, sizeof state) != 0;
+            failures += hash_state_info(state, hash_state_size(algorithm), &info_algorithm, &info_length) != 0;
+            failures += info_algorithm != (enum hash_algorithm)algorithm || info_length != splits[i];
+
+            /* The exporting context is still usable */
+            ctx_update(algorithm, &first, DATA + splits[i], sizeof DATA - splits[i]);
+            ctx_final(algorithm, &first, hash);
+            mismatches += memcmp(hash, expected, sizeof hash) != 0;
+
+            memset(&resumed, 0xa5, sizeof resumed);
+            failures += hash_state_import(algorithm, &resumed, state, hash_state_size(algorithm)) != 0;
+            ctx_update(algorithm, &resumed, DATA + splits[i], sizeof DATA - splits[i]);
+            ctx_final(algorithm, &resumed, hash);
+            mismatches += memcmp(hash, expected, sizeof hash) != 0;
+        }
+
+        snprintf(name, sizeof name, "%s exports and imports at every split", names[algorithm]);
+        check(!failures, name);
+        snprintf(name, sizeof name, "%s resumed hashes match", names[algorithm]);
+        check(!mismatches, name);
+    }
+}
+
+/* The format is stable, a state exported by any version 1 writer has to give exactly these bytes */
+void
+test_format(void) {
+    struct sha2_256_ctx ctx;
+    uint8_t state[HASH_STATE_MAX_SIZE];
+    char hex[2 * HASH_STATE_MAX_SIZE + 1];
+
+    puts("Testing the exported format");
+    check(hash_state_size(HASH_SHA1) == 108 && hash_state_size(HASH_SHA2_256) == 120 &&
+              hash_state_size(HASH_SHA2_512) == 216 && hash_state_size(HASH_SHA3_256) == 224,
+          "exported sizes");
+    check(hash_state_size((enum hash_algorithm)255) == 0, "unknown algorithm has no size");
+
+    sha2_256_init(&ctx);
+    sha2_256_update(&ctx, DATA, 100);
+    hash_state_export(HASH_SHA2_256, &ctx, state, sizeof state);
+    for (size_t i = 0; i < hash_state_size(HASH_SHA2_256); i++) {
+        sprintf(hex + 2 * i, "%02x", state[i]);
+    }
+    if (strcmp(hex, SHA2_256_STATE)) {
+        printf("\t       expected '%s' got '%s'\n", SHA2_256_STATE, hex);
+    }
+    check(!strcmp(hex, SHA2_256_STATE), "SHA-256 state after 100 bytes");
+}
+
+/* Damaged, truncated or mismatched states must be refused without touching the context */
+void
+test_rejects(void) {
+    struct sha2_256_ctx ctx, untouched;
+    struct sha3_ctx sha3;
+    uint8_t state[HASH_STATE_MAX_SIZE], damaged[HASH_STATE_MAX_SIZE];
+    size_t size = hash_state_size(HASH_SHA2_256);
+    size_t accepted = 0;
+
+    puts("Testing invalid states");
+    sha2_256_init(&ctx);
+    sha2_256_update(&ctx, DATA, 100);
+    hash_state_export(HASH_SHA2_256, &ctx, state, sizeof state);
+
+    check(hash_state_export(HASH_SHA2_256, &ctx, damaged, size - 1) == -1, "small buffer is rejected");
+    check(hash_state_export((enum hash_algorithm)255, &ctx, damaged, sizeof damaged) == -1,
+          "unknown algorithm is rejected");
+
+    for (size_t i = 0; i < size; i++) {
+        memcpy(damaged, state, size);
+        damaged[i] ^= 0x10;
+        memset(&ctx, 0, sizeof ctx);
+        accepted += !hash_state_import(HASH_SHA2_256, &ctx, damaged, size);
+    }
+    check(!accepted, "no state with a flipped bit is accepted");
+
+    memset(&ctx, 0, sizeof ctx);
+    memset(&untouched, 0, sizeof untouched);
+    check(hash_state_import(HASH_SHA2_256, &ctx, state, size - 1) == -1, "truncated state is rejected");
+    check(hash_state_import(HASH_SHA2_224, &ctx, state, size) == -1, "SHA-256 state is not a SHA-224 state");
+    check(!memcmp(&ctx, &untouched, sizeof ctx), "rejected imports leave the context alone");
+    check(hash_state_import(HASH_SHA3_256, &sha3, state, size) == -1, "SHA-256 state is not a SHA3-256 state");
+    check(!hash_state_import(HASH_SHA2_256, &ctx, state, size), "original state is accepted");
+}
+
+int
+main(void) {
+    for (size_t i = 0; i < sizeof DATA; i++) {
+        DATA[i] = (uint8_t)(i * 31);
+    }
+
+    test_resume();
+    test_format();
+    test_rejects();
+
+    fprintf(stderr, "%zu/%zu test cases passed\n", num_passed, num_tests);
+
+    return num_passed != num_tests;
+}
@@ -0,0 +1,205 @@
+#include "stats.h"
+
+#include "batch.h"
+#include "hmac.h"
+#include "sha.h"
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+
+#define NUM_THREADS 4
+#define CALLS_PER_THREAD 1000
+
+static uint8_t DATA[100000];
+
+size_t num_tests = 0;
+size_t num_passed = 0;
+
+static void
+check(int passed, const char *name) {
+    num_tests++;
+    if (passed) {
+        printf("\t[PASSED]: %s\n", name);
+        num_passed++;
+    } else {
+        printf("\t[FAILED] %s\n", name);
+    }
+}
+
+static struct hash_stats
+get(enum hash_algorithm algorithm) {
+    struct hash_stats stats;
+
+    hash_stats_get(algorithm, &stats);
+    return stats;
+}
+
+static uint64_t
+backend_total(const struct hash_stats *stats) {
+    uint64_t total = 0;
+
+    for (int i = 0; i < HASH_STATS_NUM_BACKENDS; i++) {
+        total += stats->blocks_by_backend[i];
+    }
+    return total;
+}
+
+void
+test_counters(void) {
+    struct sha2_256_ctx ctx;
+    struct sha3_ctx sha3;
+    struct hash_stats stats;
+    uint32_t hash32[8];
+    uint64_t hash64[8];
+
+    puts("Testing the counters");
+    hash_stats_enable(1);
+    hash_stats_reset();
+
+    sha2_256_data(DATA, 3, hash32);
+    sha2_256_data(DATA, 100, hash32);
+    sha2_256_data(DATA, sizeof DATA, hash32);
+    stats = get(HASH_SHA2_256);
+    check(stats.calls == 3 && stats.bytes == 100103, "calls and bytes");
+    check(stats.blocks == 1 + 2 + (100000 / 64 + 1), "blocks include the padding");
+    check(stats.calls_by_size[0] == 1 && stats.calls_by_size[1] == 1 && stats.calls_by_size[6] == 1, "size buckets");
+    check(backend_total(&stats) == stats.blocks, "every block has a backend");
+
+    /* 55 bytes leave room for the length in the last block, 56 do not */
+    sha2_256_init(&ctx);
+    sha2_256_update(&ctx, DATA, 30);
+    sha2_256_update(&ctx, DATA, 90);
+    sha2_256_final(&ctx, hash32);
+    stats = get(HASH_SHA2_256);
+    check(stats.calls == 5 && stats.bytes == 100223 && stats.blocks == 1566 + 1 + 2, "streaming calls");
+
+    sha2_224_data(DATA, 56, hash32);
+    stats = get(HASH_SHA2_224);
+    check(stats.calls == 1 && stats.blocks == 2 && get(HASH_SHA2_256).calls == 5, "SHA-224 is counted apart");
+
+    sha2_512_224_data(DATA, 112, hash64);
+    sha2_384_data(DATA, 111, hash64);
+    check(get(HASH_SHA2_512_224).blocks == 2 && get(HASH_SHA2_384).blocks == 1 && get(HASH_SHA2_512).calls == 0,
+          "SHA-512 functions");
+
+    hmac(HASH_SHA2_512_256, "key", 3, DATA, 100, hash64);
+    check(get(HASH_SHA2_512_256).bytes >= 100 && get(HASH_SHA2_512).calls == 0, "HMAC is counted under its own hash");
+
+    stats = get(HASH_SHA2_384);
+    pbkdf2(HASH_SHA2_384, "password", 8, "salt", 4, 1000, hash64, 48);
+    check(get(HASH_SHA2_384).blocks - stats.blocks >= 2 * 1000, "every PBKDF2 iteration is counted");
+
+    sha3_256_init(&sha3);
+    sha3_256_update(&sha3, DATA, 100);
+    sha3_256_update(&sha3, DATA, 100);
+    sha3_256_final(&sha3, hash64);
+    sha3_256_data(DATA, 136, hash64);
+    stats = get(HASH_SHA3_256);
+    check(stats.calls == 3 && stats.bytes == 336 && stats.blocks == 1 + 1 + 2, "SHA-3 permutations");
+
+    hash_stats_enable(0);
+    sha2_256_data(DATA, 1000, hash32);
+    check(get(HASH_SHA2_256).calls == 5 && !hash_stats_enabled(), "nothing is counted while disabled");
+
+    hash_stats_reset();
+    stats = get(HASH_SHA2_256);
+    check(!stats.calls && !stats.bytes && !stats.blocks && !backend_total(&stats), "reset");
+    check(hash_stats_get((enum hash_algorithm)255, &stats) == -1, "unknown algorithm is rejected");
+}
+
+void
+test_backends(void) {
+    uint32_t hash[8];
+    struct hash_stats stats;
+
+    puts("Testing the backends");
+    hash_stats_enable(1);
+    hash_stats_reset();
+
+    sha_set_backend(SHA_BACKEND_SCALAR);
+    sha1_data(DATA, 1000, hash);
+    if (!sha_set_backend(SHA_BACKEND_SHANI)) {
+        sha1_data(DATA, 1000, hash);
+        stats = get(HASH_SHA1);
+        check(stats.blocks_by_backend[HASH_STATS_SCALAR] == 16 && stats.blocks_by_backend[HASH_STATS_SHANI] == 16,
+              "scalar and SHA-NI blocks");
+    } else {
+        stats = get(HASH_SHA1);
+        check(stats.blocks_by_backend[HASH_STATS_SCALAR] == 16, "scalar blocks");
+    }
+    sha_set_backend(SHA_BACKEND_AUTO);
+
+    if (!hash_mb_set_backend(HASH_MB_AVX2)) {
+        struct hash_job jobs[20];
+
+        for (size_t i = 0; i < 20; i++) {
+            jobs[i] = (struct hash_job){DATA, 10 * i, hash};
+        }
+        sha2_256_mb(jobs, 20);
+        stats = get(HASH_SHA2_256);
+        check(stats.calls == 20 && stats.blocks_by_backend[HASH_STATS_AVX2] == stats.blocks, "multi-buffer jobs");
+        hash_mb_set_backend(HASH_MB_AUTO);
+    }
+    hash_stats_enable(0);
+}
+
+static void *
+worker(void *arg) {
+    uint64_t hash[8];
+
+    (void)arg;
+    for (size_t i = 0; i < CALLS_PER_THREAD; i++) {
+        sha2_512_data(DATA, i, hash);
+    }
+    return NULL;
+}
+
+/* Counts of threads that have exited are kept */
+void
+test_threads(void) {
+    pthread_t threads[NUM_THREADS];
+    struct hash_stats stats;
+    uint64_t bytes = 0, blocks = 0;
+    uint64_t hash[8];
+
+    puts("Testing threads");
+    hash_stats_enable(1);
+    hash_stats_reset();
+
+    for (size_t i = 0; i < CALLS_PER_THREAD; i++) {
+        bytes += i;
+        blocks += i / 128 + (i % 128 < 112 ? 1 : 2);
+    }
+
+    for (int i = 0; i < NUM_THREADS; i++) {
+        pthread_create(&threads[i], NULL, worker, NULL);
+    }
+    for (int i = 0; i < NUM_THREADS; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    sha2_512_data(DATA, 0, hash);
+
+    stats = get(HASH_SHA2_512);
+    check(stats.calls == NUM_THREADS * CALLS_PER_THREAD + 1, "calls of every thread");
+    check(stats.bytes == NUM_THREADS * bytes && stats.blocks == NUM_THREADS * blocks + 1, "bytes and blocks");
+    hash_stats_enable(0);
+}
+
+int
+main(void) {
+    for (size_t i = 0; i < sizeof DATA; i++) {
+        DATA[i] = (uint8_t)(i * 31);
+    }
+
+    test_counters();
+    test_backends();
+    test_threads();
+
+    fprintf(stderr, "%zu/%zu test cases passed\n", num_passed, num_tests);
+
+    return num_passed != num_tests;
+}
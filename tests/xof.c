@@ -0,0 +1,222 @@
+#include "sha.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+static uint8_t COUNTING[200];
+static uint8_t BINARY[1000];
+static uint8_t SAMPLE[24];
+static uint8_t LARGE[1000003];
+
+/* Outputs longer than 64 bytes are checked through the SHA3-256 hash of the output */
+struct xof_case {
+    char *name;
+    int bits;
+    const uint8_t *data;
+    size_t len;
+    char *custom;
+    size_t out_len;
+    char *expected;
+};
+
+struct tree_case {
+    char *name;
+    int bits;
+    const uint8_t *data;
+    size_t len;
+    size_t block_size;
+    char *custom;
+    size_t out_len;
+    char *expected;
+};
+
+size_t num_tests = 0;
+size_t num_passed = 0;
+
+#define ARRAY_LEN(array) ((sizeof(array)) / (sizeof *(array)))
+
+static struct xof_case test_case_xof[] = {
+    {"SHAKE128 Empty String", 128, COUNTING, 0, "", 32,
+     "7f9c2ba4e88f827d616045507605853ed73b8093f6efbc88eb1a6eacfa66ef26"},
+    {"SHAKE256 Short String", 256, (const uint8_t *)"abc", 3, "", 64,
+     "483366601360a8771c6863080cc4114d8db44530f8f1e1ee4f94ea37e78b5739"
+     "d5a15bef186a5386c75744c0527e1faa9f8726e462a12a4feb06bd8801e751e4"},
+    {"SHAKE128 Binary, 10000 bytes out", 128, BINARY, sizeof BINARY, "", 10000,
+     "ac2923a32672c5325c3813c625dc28ced38c3e6cc16f896d4d7df4b1044af9f9"},
+    {"SHAKE256 Binary, 10000 bytes out", 256, BINARY, sizeof BINARY, "", 10000,
+     "b357284f3b8bf483accec7298d41c1b249114a61289a1b5212e5a3164f53c7ed"},
+    /* SP 800-185 cSHAKE samples */
+    {"cSHAKE128 Sample #1", 128, COUNTING, 4, "Email Signature", 32,
+     "c1c36925b6409a04f1b504fcbca9d82b4017277cb5ed2b2065fc1d3814d5aaf5"},
+    {"cSHAKE128 Sample #2", 128, COUNTING, 200, "Email Signature", 32,
+     "c5221d50e4f822d96a2e8881a961420f294b7b24fe3d2094baed2c6524cc166b"},
+    {"cSHAKE256 Sample #3", 256, COUNTING, 4, "Email Signature", 64,
+     "d008828e2b80ac9d2218ffee1d070c48b8e4c87bff32c9699d5b6896eee0edd1"
+     "64020e2be0560858d9c00c037e34a96937c561a74c412bb4c746469527281c8c"},
+    {"cSHAKE256 Sample #4", 256, COUNTING, 200, "Email Signature", 64,
+     "07dc27b11e51fbac75bc7b3c1d983e8b4b85fb1defaf218912ac864302730917"
+     "27f42b17ed1df63e8ec118f04b23633c1dfb1574c8fb55cb45da8e25afb092bb"},
+};
+
+static struct tree_case test_case_tree[] = {
+    /* SP 800-185 ParallelHash samples */
+    {"ParallelHash128 Sample #1", 128, SAMPLE, sizeof SAMPLE, 8, "", 32,
+     "ba8dc1d1d979331d3f813603c67f72609ab5e44b94a0b8f9af46514454a2b4f5"},
+    {"ParallelHash128 Sample #2", 128, SAMPLE, sizeof SAMPLE, 8, "Parallel Data", 32,
+     "fc484dcb3f84dceedc353438151bee58157d6efed0445a81f165e495795b7206"},
+    {"ParallelHash256 Sample #4", 256, SAMPLE, sizeof SAMPLE, 8, "", 64,
+     "bc1ef124da34495e948ead207dd9842235da432d2bbc54b4c110e64c45110553"
+     "1b7f2a3e0ce055c02805e7c2de1fb746af97a1dd01f43b824e31b87612410429"},
+    {"ParallelHash256 Sample #5", 256, SAMPLE, sizeof SAMPLE, 8, "Parallel Data", 64,
+     "cdf15289b54f6212b4bc270528b49526006dd9b54e2b6add1ef6900dda3963bb"
+     "33a72491f236969ca8afaea29c682d47a393c065b38e29fae651a2091c833110"},
+    {"ParallelHash128 Empty String", 128, SAMPLE, 0, 8192, "", 32,
+     "c7b32e3b071f7fb9c58054c93c2f35e0d8051a270d6c0136ef849232c96cd1c5"},
+    {"ParallelHash256 Large, uneven last block", 256, LARGE, 100000, 1000, "", 32,
+     "b286c11c5091b91a3e5d5fc660b1dd37e615f3d403cf1788276d7b2f76f14dd8"},
+    {"ParallelHash128 Large, 1000 bytes out", 128, LARGE, sizeof LARGE, 8192, "libhash", 1000,
+     "8bddce248e4ae8a3f02e9f7fecee75f1414b93ce994419d221f2f1547f9fe23b"},
+};
+
+/* Format `out` the way `expected` is written and compare */
+void
+check_output(const char *name, const char *how, const uint8_t *out, size_t len, const char *expected) {
+    char digest[129];
+    uint64_t hash[4];
+
+    num_tests++;
+
+    if (len > 64) {
+        sha3_256_data(out, len, hash);
+        for (size_t j = 0; j < 4; j++) {
+            sprintf(digest + j * 16, "%016lx", hash[j]);
+        }
+    } else {
+        for (size_t j = 0; j < len; j++) {
+            sprintf(digest + j * 2, "%02x", out[j]);
+        }
+    }
+
+    if (strcmp(digest, expected)) {
+        printf("\t[FAILED] %s (%s): expected '%s' got '%s'\n", name, how, expected, digest);
+    } else {
+        printf("\t[PASSED]: %s (%s)\n", name, how);
+        num_passed++;
+    }
+}
+
+/* One-shot, then absorbing and squeezing in chunks of growing size so every block offset is hit */
+void
+test_xof(const struct xof_case *_case) {
+    uint8_t *out = malloc(_case->out_len);
+    size_t custom_len = strlen(_case->custom);
+    struct shake_ctx ctx;
+
+    if (_case->bits == 128) {
+        cshake128(_case->data, _case->len, NULL, 0, _case->custom, custom_len, out, _case->out_len);
+    } else {
+        cshake256(_case->data, _case->len, NULL, 0, _case->custom, custom_len, out, _case->out_len);
+    }
+    check_output(_case->name, "one-shot", out, _case->out_len, _case->expected);
+
+    if (!custom_len) {
+        memset(out, 0, _case->out_len);
+        if (_case->bits == 128) {
+            shake128(_case->data, _case->len, out, _case->out_len);
+        } else {
+            shake256(_case->data, _case->len, out, _case->out_len);
+        }
+        check_output(_case->name, "SHAKE one-shot", out, _case->out_len, _case->expected);
+    }
+
+    memset(out, 0, _case->out_len);
+    if (_case->bits == 128) {
+        cshake128_init(&ctx, NULL, 0, _case->custom, custom_len);
+    } else {
+        cshake256_init(&ctx, NULL, 0, _case->custom, custom_len);
+    }
+    for (size_t offset = 0, chunk = 0; offset < _case->len; offset += chunk) {
+        chunk = offset % 131 + 1 < _case->len - offset ? offset % 131 + 1 : _case->len - offset;
+        if (_case->bits == 128) {
+            shake128_update(&ctx, _case->data + offset, chunk);
+        } else {
+            shake256_update(&ctx, _case->data + offset, chunk);
+        }
+    }
+    for (size_t offset = 0, chunk = 0; offset < _case->out_len; offset += chunk) {
+        chunk = offset % 397 + 1 < _case->out_len - offset ? offset % 397 + 1 : _case->out_len - offset;
+        if (_case->bits == 128) {
+            shake128_squeeze(&ctx, out + offset, chunk);
+        } else {
+            shake256_squeeze(&ctx, out + offset, chunk);
+        }
+    }
+    check_output(_case->name, "streaming", out, _case->out_len, _case->expected);
+
+    free(out);
+}
+
+/* The tree hash must not depend on how many threads hash the leaves */
+void
+test_parallelhash(const struct tree_case *_case) {
+    static const unsigned threads[] = {1, 3, 0};
+    uint8_t *out = malloc(_case->out_len);
+
+    for (size_t i = 0; i < ARRAY_LEN(threads); i++) {
+        char how[32];
+        int status;
+
+        memset(out, 0, _case->out_len);
+        if (_case->bits == 128) {
+            status = parallelhash128(_case->data, _case->len, _case->block_size, _case->custom, strlen(_case->custom),
+                                     out, _case->out_len, threads[i]);
+        } else {
+            status = parallelhash256(_case->data, _case->len, _case->block_size, _case->custom, strlen(_case->custom),
+                                     out, _case->out_len, threads[i]);
+        }
+
+        sprintf(how, "%u threads", threads[i]);
+        if (status) {
+            num_tests++;
+            printf("\t[FAILED] %s (%s): returned %d\n", _case->name, how, status);
+        } else {
+            check_output(_case->name, how, out, _case->out_len, _case->expected);
+        }
+    }
+
+    free(out);
+}
+
+int
+main(void) {
+    for (size_t i = 0; i < sizeof COUNTING; i++) {
+        COUNTING[i] = (uint8_t)i;
+    }
+    for (size_t i = 0; i < sizeof BINARY; i++) {
+        BINARY[i] = (uint8_t)(i * 7);
+    }
+    for (size_t i = 0; i < sizeof SAMPLE; i++) {
+        SAMPLE[i] = (uint8_t)(i / 8 * 16 + i % 8);
+    }
+    for (size_t i = 0; i < sizeof LARGE; i++) {
+        LARGE[i] = (uint8_t)(i * 31 + (i >> 8));
+    }
+
+    puts("Testing SHAKE and cSHAKE");
+    for (size_t i = 0; i < ARRAY_LEN(test_case_xof); i++) {
+        test_xof(&test_case_xof[i]);
+    }
+
+    puts("Testing ParallelHash");
+    for (size_t i = 0; i < ARRAY_LEN(test_case_tree); i++) {
+        test_parallelhash(&test_case_tree[i]);
+    }
+
+    fprintf(stderr, "%zu/%zu test cases passed\n", num_passed, num_tests);
+
+    return num_passed != num_tests;
+}